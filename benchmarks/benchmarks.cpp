@@ -0,0 +1,599 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "breadboard/base_node.h"
+#include "breadboard/event.h"
+#include "breadboard/event_dispatcher.h"
+#include "breadboard/graph.h"
+#include "breadboard/graph_factory.h"
+#include "breadboard/graph_state.h"
+#include "breadboard/job_system.h"
+#include "breadboard/module_registry.h"
+#include "breadboard/modules/common.h"
+
+// Measures the throughput of the core runtime on synthetic graphs.
+//
+// The graphs are built in layers. The first layer holds `listeners` source
+// nodes that fire whenever the benchmark event is broadcast. Each of the
+// `depth` layers after it holds an equal share of the remaining nodes, and
+// every output feeds `fanout` nodes in the next layer. Each relay node only
+// passes its input on with probability `dirty`, so that ratio controls how
+// much of the graph is dirtied by an event.
+//
+// All options can be set on the command line, for example:
+//
+//     breadboard_benchmarks --nodes=10000 --depth=20 --dirty=0.1
+namespace benchmark {
+using namespace breadboard;
+
+BREADBOARD_DEFINE_EVENT(kBenchmarkEvent);
+
+const char* kModuleName = "benchmark";
+const char* kSourceNodeName = "source";
+const char* kRelayNodeName = "relay";
+const char* kCaptureNodeName = "capture_event";
+const char* kCountNodeName = "count_event";
+const char* kPrintNodeName = "print_event";
+
+// Every node broadcasts to and listens on the same broadcaster, which keeps
+// the node constructors trivial.
+NodeEventBroadcaster g_broadcaster;
+
+// Written by the nodes so that the compiler can't discard their work.
+volatile int g_sink;
+
+struct Options {
+  Options()
+      : nodes(1000),
+        depth(10),
+        fanout(2),
+        dirty(0.5),
+        listeners(8),
+        iterations(100),
+        graphs(1000),
+        events(4),
+        frames(100) {}
+
+  int nodes;
+  int depth;
+  int fanout;
+  double dirty;
+  int listeners;
+  int iterations;
+  int graphs;
+  int events;
+  int frames;
+};
+
+// Source Node:
+//   No inputs; 1 integer output.
+//   Sets its output every time the benchmark event is broadcast.
+class SourceNode : public BaseNode {
+ public:
+  virtual ~SourceNode() {}
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddOutput<int>();
+    node_sig->AddListener(kBenchmarkEvent);
+  }
+
+  virtual void Initialize(NodeArguments* args) {
+    args->BindBroadcaster(0, &g_broadcaster);
+  }
+
+  virtual void Execute(NodeArguments* args) { args->SetOutput(0, 1); }
+};
+
+// Relay Node:
+//   1 integer input and 1 boolean input; 1 integer output.
+//   Passes its input on, plus one, if the boolean input is true.
+class RelayNode : public BaseNode {
+ public:
+  virtual ~RelayNode() {}
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<int>();
+    node_sig->AddInput<bool>();
+    node_sig->AddOutput<int>();
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    int value = *args->GetInput<int>(0) + 1;
+    g_sink = value;
+    if (*args->GetInput<bool>(1)) {
+      args->SetOutput(0, value);
+    }
+  }
+};
+
+// The nodes of the event_counter sample, minus the printing.
+class CaptureEvent : public SourceNode {};
+
+class CountEvent : public BaseNode {
+ public:
+  struct State {
+    State() : count(0) {}
+    int count;
+  };
+
+  virtual ~CountEvent() {}
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<int>();
+    node_sig->AddOutput<std::string>();
+    node_sig->SetState<State>();
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    State* state = args->GetState<State>();
+    state->count += *args->GetInput<int>(0);
+    std::stringstream ss;
+    ss << state->count;
+    args->SetOutput(0, ss.str());
+  }
+};
+
+class PrintEvent : public BaseNode {
+ public:
+  virtual ~PrintEvent() {}
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<std::string>();
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    g_sink = static_cast<int>(args->GetInput<std::string>(0)->size());
+  }
+};
+
+void InitializeBenchmarkModule(ModuleRegistry* module_registry) {
+  Module* module = module_registry->RegisterModule(kModuleName);
+  module->RegisterNode<SourceNode>(kSourceNodeName);
+  module->RegisterNode<RelayNode>(kRelayNodeName);
+  module->RegisterNode<CaptureEvent>(kCaptureNodeName);
+  module->RegisterNode<CountEvent>(kCountNodeName);
+  module->RegisterNode<PrintEvent>(kPrintNodeName);
+}
+
+// A description of a graph, which can either be built directly or written
+// out in the text format understood by TextGraphFactory.
+struct NodeSpec {
+  explicit NodeSpec(const std::string& name_)
+      : name(name_), target(-1), propagate(false) {}
+
+  std::string name;
+  // The node feeding this node's first input, or -1 if it has no inputs.
+  int target;
+  // The default value of a relay node's boolean input.
+  bool propagate;
+};
+
+typedef std::vector<NodeSpec> GraphSpec;
+
+// A small linear congruential generator, so that every run builds the same
+// graphs.
+class Random {
+ public:
+  Random() : state_(12345) {}
+
+  double Next() {
+    state_ = state_ * 1103515245u + 12345u;
+    return static_cast<double>((state_ >> 8) & 0xffffff) / 0x1000000;
+  }
+
+ private:
+  unsigned int state_;
+};
+
+void GenerateSyntheticGraph(const Options& options, GraphSpec* spec) {
+  Random random;
+  spec->clear();
+  for (int i = 0; i < options.listeners; ++i) {
+    spec->push_back(NodeSpec(kSourceNodeName));
+  }
+  int layer_begin = 0;
+  int layer_size = options.listeners;
+  int depth = options.depth > 0 ? options.depth : 1;
+  int width = (options.nodes - options.listeners) / depth;
+  if (width < 1) {
+    width = 1;
+  }
+  int fanout = options.fanout > 0 ? options.fanout : 1;
+  for (int layer = 0; layer < depth; ++layer) {
+    int next_begin = static_cast<int>(spec->size());
+    for (int i = 0; i < width; ++i) {
+      NodeSpec node(kRelayNodeName);
+      node.target = layer_begin + (i / fanout) % layer_size;
+      node.propagate = random.Next() < options.dirty;
+      spec->push_back(node);
+    }
+    layer_begin = next_begin;
+    layer_size = width;
+  }
+}
+
+void GenerateEventCounterGraph(GraphSpec* spec) {
+  spec->clear();
+  spec->push_back(NodeSpec(kCaptureNodeName));
+  spec->push_back(NodeSpec(kCountNodeName));
+  spec->back().target = 0;
+  spec->push_back(NodeSpec(kPrintNodeName));
+  spec->back().target = 1;
+}
+
+// Adds the nodes and edges described by the spec to the graph, without
+// finalizing it.
+void AddNodes(const ModuleRegistry* module_registry, const GraphSpec& spec,
+              Graph* graph) {
+  const Module* module = module_registry->GetModule(kModuleName);
+  for (size_t i = 0; i < spec.size(); ++i) {
+    Node* node = graph->AddNode(module->GetNodeSignature(spec[i].name));
+    if (spec[i].target >= 0) {
+      node->input_edges().push_back(InputEdge());
+      node->input_edges().back().SetTarget(spec[i].target, 0);
+    }
+    if (spec[i].name == kRelayNodeName) {
+      node->input_edges().push_back(InputEdge());
+    }
+  }
+}
+
+// Sets the default values described by the spec on a finalized graph.
+void SetDefaultValues(const GraphSpec& spec, Graph* graph) {
+  for (size_t i = 0; i < spec.size(); ++i) {
+    if (spec[i].name == kRelayNodeName) {
+      graph->SetDefaultValue<bool>(i, 1, spec[i].propagate);
+    }
+  }
+}
+
+bool BuildGraph(const ModuleRegistry* module_registry, const GraphSpec& spec,
+                Graph* graph) {
+  AddNodes(module_registry, spec, graph);
+  if (!graph->FinalizeNodes()) {
+    return false;
+  }
+  SetDefaultValues(spec, graph);
+  return true;
+}
+
+// Writes the spec as one line per node: the node name, the node feeding its
+// first input and the default value of its boolean input.
+void WriteGraphText(const GraphSpec& spec, std::string* text) {
+  std::stringstream ss;
+  for (size_t i = 0; i < spec.size(); ++i) {
+    ss << spec[i].name << " " << spec[i].target << " " << spec[i].propagate
+       << "\n";
+  }
+  *text = ss.str();
+}
+
+// The text every file loaded by TextGraphFactory contains.
+std::string g_graph_text;
+
+bool LoadGraphText(const char* /*filename*/, std::string* output) {
+  *output = g_graph_text;
+  return true;
+}
+
+// A GraphFactory that reads the format written by WriteGraphText.
+class TextGraphFactory : public GraphFactory {
+ public:
+  TextGraphFactory(ModuleRegistry* module_registry)
+      : GraphFactory(module_registry, LoadGraphText) {}
+  virtual ~TextGraphFactory() {}
+
+ private:
+  virtual bool ParseData(ModuleRegistry* module_registry, Graph* graph,
+                         const std::string* data) {
+    const Module* module = module_registry->GetModule(kModuleName);
+    GraphSpec spec;
+    std::stringstream ss(*data);
+    std::string name;
+    int target;
+    bool propagate;
+    while (ss >> name >> target >> propagate) {
+      if (!module->GetNodeSignature(name)) {
+        return false;
+      }
+      spec.push_back(NodeSpec(name));
+      spec.back().target = target;
+      spec.back().propagate = propagate;
+    }
+    return BuildGraph(module_registry, spec, graph);
+  }
+};
+
+typedef std::chrono::steady_clock Clock;
+
+// Collects the time spent in many calls to the operation being measured.
+class Timer {
+ public:
+  explicit Timer(const char* name) : name_(name), count_(0), total_(0) {}
+
+  void Start() { start_ = Clock::now(); }
+
+  void Stop(long long count = 1) {
+    total_ += Clock::now() - start_;
+    count_ += count;
+  }
+
+  void Print() const {
+    double ns = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(total_).count());
+    double per_op = count_ > 0 ? ns / count_ : 0.0;
+    double per_second = ns > 0.0 ? count_ * 1e9 / ns : 0.0;
+    printf("%-50s %10lld ops %14.1f ns/op %14.0f ops/s\n", name_, count_,
+           per_op, per_second);
+  }
+
+ private:
+  const char* name_;
+  Clock::time_point start_;
+  long long count_;
+  Clock::duration total_;
+};
+
+void BenchmarkFinalizeNodes(const ModuleRegistry* module_registry,
+                            const Options& options, const GraphSpec& spec) {
+  Timer timer("Graph::FinalizeNodes");
+  for (int i = 0; i < options.iterations; ++i) {
+    Graph graph("synthetic");
+    AddNodes(module_registry, spec, &graph);
+    timer.Start();
+    bool finalized = graph.FinalizeNodes();
+    timer.Stop();
+    if (!finalized) {
+      printf("Failed to finalize the synthetic graph\n");
+      return;
+    }
+  }
+  timer.Print();
+}
+
+void BenchmarkLoadGraph(ModuleRegistry* module_registry,
+                        const Options& options, const GraphSpec& spec) {
+  WriteGraphText(spec, &g_graph_text);
+  TextGraphFactory factory(module_registry);
+  Timer load_timer("GraphFactory::LoadGraph");
+  Timer cached_timer("GraphFactory::LoadGraph (cached)");
+  for (int i = 0; i < options.iterations; ++i) {
+    // Each file name is only seen once, so that every graph is parsed.
+    std::stringstream ss;
+    ss << "synthetic_" << i;
+    std::string filename = ss.str();
+    load_timer.Start();
+    Graph* graph = factory.LoadGraph(filename.c_str());
+    load_timer.Stop();
+    if (!graph) {
+      printf("Failed to load the synthetic graph\n");
+      return;
+    }
+    cached_timer.Start();
+    factory.LoadGraph(filename.c_str());
+    cached_timer.Stop();
+  }
+  load_timer.Print();
+  cached_timer.Print();
+
+  // Load the same number of graphs again, this time all at once.
+  unsigned int thread_count = std::thread::hardware_concurrency();
+  ThreadPool thread_pool(thread_count > 1 ? thread_count : 1);
+  factory.set_job_system(&thread_pool);
+  std::vector<std::shared_future<Graph*>> graphs;
+  Timer async_timer("GraphFactory::LoadGraphAsync");
+  async_timer.Start();
+  for (int i = 0; i < options.iterations; ++i) {
+    std::stringstream ss;
+    ss << "async_synthetic_" << i;
+    graphs.push_back(factory.LoadGraphAsync(ss.str().c_str()));
+  }
+  factory.WaitForPendingGraphs();
+  async_timer.Stop(options.iterations);
+  async_timer.Print();
+}
+
+void BenchmarkGraphStates(const ModuleRegistry* module_registry,
+                          const Options& options, const GraphSpec& spec) {
+  Graph graph("synthetic");
+  if (!BuildGraph(module_registry, spec, &graph)) {
+    printf("Failed to build the synthetic graph\n");
+    return;
+  }
+
+  std::vector<std::unique_ptr<GraphState>> graph_states;
+  Timer initialize_timer("GraphState::Initialize");
+  for (int i = 0; i < options.graphs; ++i) {
+    graph_states.push_back(std::unique_ptr<GraphState>(new GraphState()));
+    initialize_timer.Start();
+    graph_states.back()->Initialize(&graph);
+    initialize_timer.Stop();
+  }
+  initialize_timer.Print();
+
+  // With a dispatcher, broadcasting only marks the listeners, and flushing
+  // executes every GraphState with a dirty node once.
+  EventDispatcher dispatcher;
+  g_broadcaster.set_event_dispatcher(&dispatcher);
+  EventIndex event_index = GetEventIndex(kBenchmarkEvent);
+  Timer broadcast_timer("NodeEventBroadcaster::BroadcastEvent (deferred)");
+  Timer execute_timer("GraphState::Execute (dirty)");
+  for (int i = 0; i < options.frames; ++i) {
+    broadcast_timer.Start();
+    g_broadcaster.BroadcastEventIndex(event_index);
+    broadcast_timer.Stop();
+    execute_timer.Start();
+    dispatcher.FlushEvents();
+    execute_timer.Stop(options.graphs);
+  }
+  g_broadcaster.set_event_dispatcher(nullptr);
+  broadcast_timer.Print();
+  execute_timer.Print();
+
+  // Executing a GraphState with nothing dirty measures the cost of finding
+  // out that there is nothing to do.
+  Timer clean_timer("GraphState::Execute (clean)");
+  for (int i = 0; i < options.frames; ++i) {
+    clean_timer.Start();
+    for (size_t j = 0; j < graph_states.size(); ++j) {
+      graph_states[j]->Execute();
+    }
+    clean_timer.Stop(options.graphs);
+  }
+  clean_timer.Print();
+
+  // Without a dispatcher, each broadcast executes every GraphState at once.
+  Timer immediate_timer("NodeEventBroadcaster::BroadcastEvent (immediate)");
+  for (int i = 0; i < options.frames; ++i) {
+    immediate_timer.Start();
+    g_broadcaster.BroadcastEventIndex(event_index);
+    immediate_timer.Stop();
+  }
+  immediate_timer.Print();
+}
+
+// The event_counter sample, scaled up to `graphs` instances that each
+// receive `events` events per frame.
+void BenchmarkEventCounter(const ModuleRegistry* module_registry,
+                           const Options& options) {
+  GraphSpec spec;
+  GenerateEventCounterGraph(&spec);
+  Graph graph("event_counter");
+  if (!BuildGraph(module_registry, spec, &graph)) {
+    printf("Failed to build the event counter graph\n");
+    return;
+  }
+  std::vector<std::unique_ptr<GraphState>> graph_states;
+  for (int i = 0; i < options.graphs; ++i) {
+    graph_states.push_back(std::unique_ptr<GraphState>(new GraphState()));
+    graph_states.back()->Initialize(&graph);
+  }
+
+  EventIndex event_index = GetEventIndex(kBenchmarkEvent);
+  Timer immediate_timer("event_counter frame (immediate)");
+  for (int i = 0; i < options.frames; ++i) {
+    immediate_timer.Start();
+    for (int j = 0; j < options.events; ++j) {
+      g_broadcaster.BroadcastEventIndex(event_index);
+    }
+    immediate_timer.Stop();
+  }
+  immediate_timer.Print();
+
+  EventDispatcher dispatcher;
+  g_broadcaster.set_event_dispatcher(&dispatcher);
+  Timer deferred_timer("event_counter frame (deferred)");
+  for (int i = 0; i < options.frames; ++i) {
+    deferred_timer.Start();
+    for (int j = 0; j < options.events; ++j) {
+      g_broadcaster.BroadcastEventIndex(event_index);
+    }
+    dispatcher.FlushEvents();
+    deferred_timer.Stop();
+  }
+  g_broadcaster.set_event_dispatcher(nullptr);
+  deferred_timer.Print();
+}
+
+void PrintUsage(const char* program) {
+  printf(
+      "Usage: %s [--nodes=N] [--depth=N] [--fanout=N] [--dirty=RATIO]\n"
+      "       [--listeners=N] [--iterations=N] [--graphs=N] [--events=N]\n"
+      "       [--frames=N]\n",
+      program);
+}
+
+// Parses an argument of the form --name=value. Returns false if the
+// argument does not start with the given name.
+bool ParseFlag(const char* arg, const char* name, const char** value) {
+  size_t length = strlen(name);
+  if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, name, length) != 0 ||
+      arg[2 + length] != '=') {
+    return false;
+  }
+  *value = arg + 3 + length;
+  return true;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const char* value;
+    if (ParseFlag(argv[i], "nodes", &value)) {
+      options->nodes = atoi(value);
+    } else if (ParseFlag(argv[i], "depth", &value)) {
+      options->depth = atoi(value);
+    } else if (ParseFlag(argv[i], "fanout", &value)) {
+      options->fanout = atoi(value);
+    } else if (ParseFlag(argv[i], "dirty", &value)) {
+      options->dirty = atof(value);
+    } else if (ParseFlag(argv[i], "listeners", &value)) {
+      options->listeners = atoi(value);
+    } else if (ParseFlag(argv[i], "iterations", &value)) {
+      options->iterations = atoi(value);
+    } else if (ParseFlag(argv[i], "graphs", &value)) {
+      options->graphs = atoi(value);
+    } else if (ParseFlag(argv[i], "events", &value)) {
+      options->events = atoi(value);
+    } else if (ParseFlag(argv[i], "frames", &value)) {
+      options->frames = atoi(value);
+    } else {
+      return false;
+    }
+  }
+  return options->listeners > 0;
+}
+
+void BreadboardLogFunc(const char* fmt, va_list args) { vprintf(fmt, args); }
+
+}  // namespace benchmark
+
+int main(int argc, char** argv) {
+  benchmark::Options options;
+  if (!benchmark::ParseOptions(argc, argv, &options)) {
+    benchmark::PrintUsage(argv[0]);
+    return 1;
+  }
+
+  breadboard::RegisterLogFunc(benchmark::BreadboardLogFunc);
+  breadboard::ModuleRegistry module_registry;
+  breadboard::InitializeCommonModules(&module_registry);
+  benchmark::InitializeBenchmarkModule(&module_registry);
+
+  benchmark::GraphSpec spec;
+  benchmark::GenerateSyntheticGraph(options, &spec);
+  printf(
+      "%d nodes, depth %d, fanout %d, dirty ratio %.2f, %d listeners, "
+      "%d graphs, %d events per frame\n",
+      static_cast<int>(spec.size()), options.depth, options.fanout,
+      options.dirty, options.listeners, options.graphs, options.events);
+
+  benchmark::BenchmarkFinalizeNodes(&module_registry, options, spec);
+  benchmark::BenchmarkLoadGraph(&module_registry, options, spec);
+  benchmark::BenchmarkGraphStates(&module_registry, options, spec);
+  benchmark::BenchmarkEventCounter(&module_registry, options);
+  return 0;
+}
@@ -0,0 +1,185 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_ALLOCATOR_H_
+#define BREADBOARD_ALLOCATOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/// @file breadboard/allocator.h
+///
+/// @brief An Allocator provides the memory for the buffers of Graphs and
+///        GraphStates.
+
+namespace breadboard {
+
+/// @class Allocator
+///
+/// @brief An Allocator provides the memory for the buffers of Graphs and
+///        GraphStates.
+///
+/// The buffers holding a Graph's default values and nodes, and a GraphState's
+/// outputs and state, make up most of the memory Breadboard uses. By default
+/// they come from the heap. Games that need to keep track of that memory, or
+/// keep it within a budget, can implement this interface and hand it to the
+/// GraphFactory, Graph or GraphState that allocates them.
+///
+/// Allocators must be thread safe if graphs are loaded asynchronously, or if
+/// GraphStates are created on more than one thread.
+class Allocator {
+ public:
+  /// @brief Destructor for an Allocator.
+  virtual ~Allocator() {}
+
+  /// @brief Allocate a block of memory.
+  ///
+  /// @param[in] size The size of the block in bytes. Never 0.
+  ///
+  /// @param[in] alignment The alignment of the block. Always a power of 2.
+  ///
+  /// @return The block of memory, or null if it could not be allocated.
+  virtual void* Allocate(size_t size, size_t alignment) = 0;
+
+  /// @brief Return a block of memory to the Allocator.
+  ///
+  /// @param[in] ptr A block returned by Allocate.
+  ///
+  /// @param[in] size The size that was passed to Allocate.
+  virtual void Free(void* ptr, size_t size) = 0;
+};
+
+/// @class HeapAllocator
+///
+/// @brief An Allocator that allocates from the heap, and keeps track of how
+///        much memory it has handed out.
+class HeapAllocator : public Allocator {
+ public:
+  HeapAllocator() : bytes_allocated_(0) {}
+
+  virtual void* Allocate(size_t size, size_t alignment);
+  virtual void Free(void* ptr, size_t size);
+
+  /// @brief Returns the number of bytes allocated and not yet freed.
+  ///
+  /// @return The number of bytes allocated and not yet freed.
+  size_t bytes_allocated() const { return bytes_allocated_; }
+
+ private:
+  std::atomic<size_t> bytes_allocated_;
+};
+
+/// @brief Returns the HeapAllocator used when no other Allocator is given.
+///
+/// @return The default Allocator.
+HeapAllocator* DefaultAllocator();
+
+/// @class ArenaAllocator
+///
+/// @brief An Allocator that hands out memory from large blocks and frees it
+///        all at once.
+///
+/// An ArenaAllocator suits memory that lives and dies together, such as the
+/// graphs of a level. Blocks of `block_size` bytes are taken from a parent
+/// Allocator as needed, and allocations are carved out of them one after
+/// another. Freeing an allocation does not make its memory available again.
+/// Instead, once everything allocated from it has been freed, Reset returns
+/// all of the blocks to the parent at once:
+///
+/// ~~~{.cpp}
+///     breadboard::ArenaAllocator level_arena(64 * 1024, 4 * 1024 * 1024);
+///     graph_factory.set_allocator(&level_arena);
+///     ...
+///     graph_factory.EvictUnusedGraphs();
+///     level_arena.Reset();
+/// ~~~
+///
+/// Allocations that would take the arena past its budget fail, and an error
+/// is logged.
+class ArenaAllocator : public Allocator {
+ public:
+  /// @brief Construct an ArenaAllocator.
+  ///
+  /// @param[in] block_size The size in bytes of the blocks taken from the
+  ///            parent. Larger allocations get a block of their own.
+  ///
+  /// @param[in] budget The most bytes that may be taken from the parent, or 0
+  ///            for no limit.
+  ///
+  /// @param[in] parent The Allocator the blocks are taken from.
+  ArenaAllocator(size_t block_size, size_t budget,
+                 Allocator* parent = DefaultAllocator());
+
+  /// @brief Destructor for an ArenaAllocator. Everything allocated from it
+  ///        must have been freed.
+  virtual ~ArenaAllocator();
+
+  virtual void* Allocate(size_t size, size_t alignment);
+  virtual void Free(void* ptr, size_t size);
+
+  /// @brief Return every block to the parent Allocator. Everything allocated
+  ///        from the arena must have been freed.
+  void Reset();
+
+  /// @brief Returns the number of bytes taken from the parent Allocator.
+  ///
+  /// @return The number of bytes taken from the parent Allocator.
+  size_t bytes_reserved() const { return bytes_reserved_; }
+
+  /// @brief Returns the number of bytes handed out, including padding.
+  ///
+  /// @return The number of bytes handed out since the last Reset.
+  size_t bytes_used() const { return bytes_used_; }
+
+  /// @brief Returns the most bytes that may be taken from the parent, or 0 if
+  ///        there is no limit.
+  ///
+  /// @return The budget in bytes.
+  size_t budget() const { return budget_; }
+
+ private:
+  // Disallow copying.
+  ArenaAllocator(ArenaAllocator&);
+  ArenaAllocator& operator=(ArenaAllocator&);
+
+  struct Block {
+    uint8_t* data;
+    size_t size;
+  };
+
+  // Take a new block of at least the given size from the parent. Returns
+  // false if that would exceed the budget. mutex_ must be held.
+  bool AddBlock(size_t size);
+
+  size_t block_size_;
+  size_t budget_;
+  Allocator* parent_;
+
+  // Guards everything below.
+  std::mutex mutex_;
+  std::vector<Block> blocks_;
+  // The next free byte in the last block, and the end of that block.
+  uint8_t* next_;
+  uint8_t* end_;
+  size_t bytes_reserved_;
+  size_t bytes_used_;
+  size_t allocation_count_;
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_ALLOCATOR_H_
@@ -0,0 +1,188 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_ASYNC_LOG_H_
+#define BREADBOARD_ASYNC_LOG_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "breadboard/log.h"
+
+/// @file breadboard/async_log.h
+///
+/// @brief An optional LogBackend that moves formatting output off of the
+///        calling thread.
+
+namespace breadboard {
+
+/// @class AsyncLogBackend
+///
+/// @brief A LogBackend that hands messages to a background thread.
+///
+/// Each call to CallLogFunc formats its message into a fixed size record and
+/// pushes it onto a lock-free ring buffer. A background thread drains the
+/// buffer and passes each message on to a regular LogFunc. This keeps slow
+/// sinks, such as a console or a file, off of the threads executing graphs.
+///
+/// To keep a misconfigured graph from flooding the log, two filters are
+/// applied:
+///
+/// * Each call site, identified by the address of its format string, may log
+///   at most `max_messages_per_window` messages per `rate_limit_window`. Any
+///   more are counted and reported as a single summary line once the window
+///   has passed.
+/// * Consecutive identical messages are collapsed into one, followed by a line
+///   saying how many times it was repeated.
+///
+/// If the ring buffer is full, new messages are dropped and the number of
+/// dropped messages is reported once there is room again.
+///
+/// Example usage:
+///
+/// ~~~{.cpp}
+///   AsyncLogBackend async_log(MyLogFunc);
+///   RegisterLogBackend(&async_log);
+///   ...
+///   RegisterLogBackend(nullptr);
+/// ~~~
+class AsyncLogBackend : public LogBackend {
+ public:
+  /// @brief The longest message a single record can hold, including the null
+  ///        terminator. Longer messages are truncated.
+  static const size_t kMaxMessageLength = 256;
+
+  /// @brief Construct an AsyncLogBackend and start its background thread.
+  ///
+  /// @param[in] sink The function that the background thread passes messages
+  ///            to.
+  ///
+  /// @param[in] capacity The number of records the ring buffer can hold. This
+  ///            is rounded up to a power of two.
+  ///
+  /// @param[in] max_messages_per_window The number of messages a call site may
+  ///            log per `rate_limit_window`. Zero disables rate limiting.
+  ///
+  /// @param[in] rate_limit_window The length of a rate limiting window.
+  explicit AsyncLogBackend(
+      LogFunc sink, size_t capacity = 1024,
+      uint32_t max_messages_per_window = 10,
+      std::chrono::milliseconds rate_limit_window = std::chrono::seconds(1));
+
+  /// @brief Destructor for an AsyncLogBackend.
+  ///
+  /// Any messages still in the ring buffer are passed to the sink before the
+  /// background thread exits. The backend must be unregistered first.
+  virtual ~AsyncLogBackend();
+
+  /// @brief Format a message and queue it for the background thread.
+  ///
+  /// This never blocks and never calls the sink directly, so it is safe to
+  /// call from any number of threads at once.
+  virtual void Log(const char* format, va_list args);
+
+  /// @brief Block until every message queued so far has reached the sink.
+  void Flush();
+
+  /// @brief Returns the number of messages dropped because the ring buffer
+  ///        was full.
+  ///
+  /// @return The number of messages dropped because the ring buffer was full.
+  uint64_t dropped_count() const { return dropped_count_total_; }
+
+  /// @brief Returns the number of messages suppressed by rate limiting.
+  ///
+  /// @return The number of messages suppressed by rate limiting.
+  uint64_t suppressed_count() const { return suppressed_count_total_; }
+
+ private:
+  // Disallow copying.
+  AsyncLogBackend(AsyncLogBackend&);
+  AsyncLogBackend& operator=(AsyncLogBackend&);
+
+  // A single slot in the ring buffer. The sequence number tells producers and
+  // the consumer whose turn it is to use the slot.
+  struct Record {
+    std::atomic<size_t> sequence;
+    char message[kMaxMessageLength];
+  };
+
+  // Rate limiting state for a single call site. Updates are racy between
+  // threads logging from the same site at the same moment, which only makes
+  // the limit approximate.
+  struct CallSite {
+    std::atomic<const char*> format;
+    std::atomic<int64_t> window_start;
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> suppressed;
+  };
+
+  bool Push(const char* message);
+  bool Pop(std::string* message);
+  CallSite* FindCallSite(const char* format);
+  bool AllowMessage(const char* format, int64_t now);
+  int64_t Now() const;
+
+  void DrainLoop();
+  void Drain();
+  void Emit(const std::string& message);
+  void FlushRepeats();
+  void ReportSuppressed(int64_t now);
+
+  LogFunc sink_;
+  uint32_t max_messages_per_window_;
+  int64_t rate_limit_window_;
+
+  // The ring buffer, as a bounded multi-producer, single-consumer queue.
+  std::vector<Record> records_;
+  size_t mask_;
+  std::atomic<size_t> enqueue_position_;
+  size_t dequeue_position_;
+
+  // A fixed size, open addressed table of call sites. Sites that do not fit
+  // are not rate limited.
+  std::vector<CallSite> call_sites_;
+
+  std::atomic<uint64_t> dropped_count_;
+  std::atomic<uint64_t> dropped_count_total_;
+  std::atomic<uint64_t> suppressed_count_total_;
+
+  // Only touched by the background thread. repeat_start_time_ is when the
+  // current run of repeats began.
+  std::string last_message_;
+  uint32_t repeat_count_;
+  int64_t repeat_start_time_;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  // The enqueue position the background thread has to pop up to before
+  // Flush may return, and the position it has popped up to so far.
+  size_t flush_position_;
+  size_t drained_position_;
+  std::condition_variable wake_;
+  std::condition_variable drained_;
+  bool flush_requested_;
+  bool shutting_down_;
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_ASYNC_LOG_H_
@@ -19,6 +19,7 @@
 
 #include "breadboard/event.h"
 #include "breadboard/node_arguments.h"
+#include "breadboard/node_batch_arguments.h"
 #include "breadboard/node_signature.h"
 
 /// @file breadboard/base_node.h
@@ -82,6 +83,24 @@ class BaseNode {
   /// This function is where the bulk of the interesting logic should occur in a
   /// node.
   virtual void Execute(NodeArguments* args) { (void)args; }
+
+  /// @brief ExecuteBatch is offered the chance to execute this node on many
+  /// instances of a graph at once.
+  ///
+  /// When a GraphStateBatch finds this node dirty on more than one of its
+  /// instances, it calls ExecuteBatch once with all of them rather than
+  /// calling Execute on each in turn. Nodes doing simple arithmetic can use
+  /// this to work through a whole column of values in one loop (see
+  /// NodeBatchArguments).
+  ///
+  /// Return false to have Execute called on each instance instead, which is
+  /// what the default implementation does.
+  ///
+  /// @return True if the node was executed on every instance in the batch.
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    (void)args;
+    return false;
+  }
 };
 
 }  // namespace breadboard
@@ -0,0 +1,108 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_COMPILED_GRAPH_H_
+#define BREADBOARD_COMPILED_GRAPH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "breadboard/graph.h"
+#include "breadboard/graph_factory.h"
+#include "breadboard/module_registry.h"
+
+/// @file breadboard/compiled_graph.h
+///
+/// @brief Save finalized Graphs in a binary format that can be loaded without
+///        finalizing them again.
+
+namespace breadboard {
+
+/// @brief The version of the compiled graph format written by CompileGraph.
+///
+/// Compiled graphs written with a different format version, or by a different
+/// version of Breadboard, are rejected by LoadCompiledGraph.
+static const uint32_t kCompiledGraphFormatVersion = 3;
+
+/// @brief Write a finalized Graph, along with its default values, in the
+///        compiled graph format.
+///
+/// This is meant to be run as a build step: load each graph from its source
+/// format once, with the same modules registered as the game uses, and save
+/// the result. Loading the compiled graph then skips sorting the nodes and
+/// laying out the buffers, and sets the default values directly instead of
+/// through Graph::SetDefaultValue.
+///
+/// Every type that is used by a default value must have had serialization
+/// functions registered with TypeRegistry::RegisterSerializationFuncs.
+///
+/// @param[in] graph The finalized Graph to compile.
+///
+/// @param[out] output The compiled graph.
+///
+/// @return Returns true if successful. Otherwise an error is logged and false
+///         is returned.
+bool CompileGraph(const Graph& graph, std::string* output);
+
+/// @brief Fill in an empty Graph from data written by CompileGraph.
+///
+/// The data is checked against the registered modules before it is used: every
+/// node must still exist with the same inputs, outputs, listeners and state,
+/// and every offset must fit in its buffer. The loaded Graph is finalized.
+///
+/// @param[in] module_registry The ModuleRegistry holding the nodes the graph
+///            was compiled with.
+///
+/// @param[in] data The compiled graph.
+///
+/// @param[in] size The size of the compiled graph in bytes.
+///
+/// @param[out] graph The Graph to fill in. No nodes may have been added to it.
+///
+/// @return Returns true if successful. Otherwise an error is logged and false
+///         is returned.
+bool LoadCompiledGraph(const ModuleRegistry* module_registry,
+                       const uint8_t* data, size_t size, Graph* graph);
+
+/// @class CompiledGraphFactory
+///
+/// @brief A GraphFactory that loads graphs written by CompileGraph.
+///
+/// Constructed with a LoadFileViewCallback, compiled graphs are read straight
+/// out of the FileView without being copied first.
+class CompiledGraphFactory : public GraphFactory {
+ public:
+  /// @brief Construct a factory that reads files into strings.
+  CompiledGraphFactory(ModuleRegistry* module_registry,
+                       LoadFileCallback load_file_callback)
+      : GraphFactory(module_registry, load_file_callback) {}
+
+  /// @brief Construct a factory that reads files through FileViews.
+  CompiledGraphFactory(ModuleRegistry* module_registry,
+                       LoadFileViewCallback load_file_view_callback)
+      : GraphFactory(module_registry, load_file_view_callback) {}
+
+  virtual ~CompiledGraphFactory() { WaitForPendingGraphs(); }
+
+ private:
+  virtual bool ParseData(ModuleRegistry* module_registry, Graph* graph,
+                         const std::string* data);
+  virtual bool ParseDataView(ModuleRegistry* module_registry, Graph* graph,
+                             const uint8_t* data, size_t size);
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_COMPILED_GRAPH_H_
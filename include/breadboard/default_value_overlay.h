@@ -0,0 +1,162 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_DEFAULT_VALUE_OVERLAY_H_
+#define BREADBOARD_DEFAULT_VALUE_OVERLAY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "breadboard/allocator.h"
+#include "breadboard/type.h"
+#include "breadboard/type_registry.h"
+
+/// @file breadboard/default_value_overlay.h
+///
+/// @brief A DefaultValueOverlay replaces some of the default input values of
+///        a Graph for the GraphStates it is given to.
+
+namespace breadboard {
+
+/// @class DefaultValueOverlay
+///
+/// @brief A DefaultValueOverlay replaces some of the default input values of
+///        a Graph for the GraphStates it is given to.
+///
+/// Variants of a behavior often differ only in a constant or two, such as a
+/// speed or a sound. Rather than load a Graph for each variant, load one Graph
+/// and give each variant an overlay holding just the values that differ:
+///
+/// ~~~{.cpp}
+///     breadboard::DefaultValueOverlay fast_variant;
+///     fast_variant.SetDefaultValue<float>(kMoveNode, kSpeedInput, 12.0f);
+///     ...
+///     graph_state.set_default_value_overlay(&fast_variant);
+///     graph_state.Initialize(&enemy_graph);
+/// ~~~
+///
+/// Values are set by the order in which the node was added to the Graph and
+/// the index of the input edge, just as with Graph::SetDefaultValue, but are
+/// only checked against the Graph when a GraphState is initialized with the
+/// overlay. Values set on edges that do not exist, have a different type or
+/// are connected to an output are ignored, and an error is logged.
+///
+/// One overlay may be shared by any number of GraphStates, and must outlive
+/// them. It must not be changed while any GraphState is using it.
+class DefaultValueOverlay {
+ public:
+  /// @brief Construct an empty DefaultValueOverlay.
+  DefaultValueOverlay() : values_() {}
+
+  /// @brief Destructor for a DefaultValueOverlay.
+  ~DefaultValueOverlay() { Clear(); }
+
+  /// @brief Override the default value of an input edge.
+  ///
+  /// @param[in] node_index The order in which the node was added to the
+  ///            Graph.
+  ///
+  /// @param[in] edge_index The index of the input edge on the node.
+  ///
+  /// @param[in] value The value the edge should have.
+  template <typename EdgeType>
+  void SetDefaultValue(unsigned int node_index, unsigned int edge_index,
+                       const EdgeType& value) {
+    new (AllocateValue(node_index, edge_index,
+                       TypeRegistry<EdgeType>::GetType())) EdgeType(value);
+  }
+
+  /// @brief Override the default value of an input edge, moving the value
+  ///        into place.
+  ///
+  /// @param[in] node_index The order in which the node was added to the
+  ///            Graph.
+  ///
+  /// @param[in] edge_index The index of the input edge on the node.
+  ///
+  /// @param[in] value The value to move into the overlay.
+  template <typename EdgeType>
+  void SetDefaultValue(unsigned int node_index, unsigned int edge_index,
+                       EdgeType&& value,
+                       typename std::enable_if<
+                           !std::is_reference<EdgeType>::value &&
+                           !std::is_const<EdgeType>::value>::type* = nullptr) {
+    new (AllocateValue(node_index, edge_index,
+                       TypeRegistry<EdgeType>::GetType()))
+        EdgeType(std::move(value));
+  }
+
+  /// @brief Remove every value from the overlay.
+  void Clear();
+
+  /// @brief Returns the number of values in the overlay.
+  ///
+  /// @return The number of input edges the overlay overrides.
+  size_t size() const { return values_.size(); }
+
+  /// @cond BREADBOARD_INTERNAL
+  /// @brief A value held by the overlay, and the edge it overrides.
+  ///
+  /// @note This is for internal use only.
+  struct Value {
+    unsigned int node_index;
+    unsigned int edge_index;
+    const Type* type;
+    uint8_t* data;
+  };
+
+  /// @brief Returns the values held by the overlay.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @return The values held by the overlay, in the order they were first
+  ///         set.
+  const std::vector<Value>& values() const { return values_; }
+  /// @endcond
+
+ private:
+  // Disallow copying.
+  DefaultValueOverlay(DefaultValueOverlay&);
+  DefaultValueOverlay& operator=(DefaultValueOverlay&);
+
+  // Return uninitialized memory for the value of the given edge, destroying
+  // any value that was set on it before.
+  void* AllocateValue(unsigned int node_index, unsigned int edge_index,
+                      const Type* type);
+
+  std::vector<Value> values_;
+};
+
+/// @cond BREADBOARD_INTERNAL
+/// @brief A value of a DefaultValueOverlay, found in the Graph a GraphState
+///        was initialized with.
+///
+/// @note This is for internal use only.
+struct ResolvedDefaultValue {
+  /// The offset in the Graph's input buffer of the default value that is
+  /// overridden.
+  ptrdiff_t data_offset;
+
+  /// The value that overrides it.
+  uint8_t* data;
+};
+/// @endcond
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_DEFAULT_VALUE_OVERLAY_H_
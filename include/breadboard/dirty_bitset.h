@@ -0,0 +1,127 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_DIRTY_BITSET_H_
+#define BREADBOARD_DIRTY_BITSET_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/// @file breadboard/dirty_bitset.h
+///
+/// @brief A DirtyBitset records which nodes and output edges of a GraphState
+///        have changed during the current execution.
+///
+/// @note This is for internal use only.
+
+namespace breadboard {
+
+/// @cond BREADBOARD_INTERNAL
+
+/// @brief The bits of one word of a DirtyBitset that a node checks to see
+///        whether it is dirty.
+struct DirtyMask {
+  /// The index of the word in the DirtyBitset.
+  size_t word;
+
+  /// The bits of that word to check.
+  uint64_t bits;
+};
+
+/// @class DirtyBitset
+///
+/// @brief A DirtyBitset records which nodes and output edges of a GraphState
+///        have changed during the current execution.
+///
+/// Each node and connected output edge of a Graph is given a bit when the
+/// graph uses kDirtyTrackingBitset. Setting an output sets its bit, and a node
+/// is dirty if any of the bits in its DirtyMasks are set. The bits are packed
+/// together, away from the values in the output buffer, so checking a node
+/// reads a word or two instead of a timestamp per input. Bits may be set from
+/// several threads at once while a level is executed in parallel.
+///
+/// @note This is for internal use only.
+class DirtyBitset {
+ public:
+  DirtyBitset() : words_(), word_count_(0) {}
+
+  /// @brief Size the bitset to hold the given number of bits, all cleared.
+  void Initialize(size_t bit_count) {
+    word_count_ = (bit_count + 63) / 64;
+    words_.reset(word_count_ > 0 ? new std::atomic<uint64_t>[word_count_]
+                                 : nullptr);
+    Clear();
+  }
+
+  /// @brief Returns true if the bitset holds no bits.
+  bool empty() const { return word_count_ == 0; }
+
+  /// @brief Set the given bit.
+  void Set(unsigned int bit) {
+    assert(bit / 64 < word_count_);
+    words_[bit / 64].fetch_or(uint64_t(1) << (bit % 64),
+                              std::memory_order_relaxed);
+  }
+
+  /// @brief Returns true if the given bit is set.
+  bool Test(unsigned int bit) const {
+    assert(bit / 64 < word_count_);
+    return (words_[bit / 64].load(std::memory_order_relaxed) &
+            (uint64_t(1) << (bit % 64))) != 0;
+  }
+
+  /// @brief Returns true if any of the bits in the given masks are set.
+  bool TestAny(const DirtyMask* masks, size_t count) const {
+    for (size_t i = 0; i < count; ++i) {
+      assert(masks[i].word < word_count_);
+      if (words_[masks[i].word].load(std::memory_order_relaxed) &
+          masks[i].bits) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// @brief Clear every bit.
+  void Clear() {
+    for (size_t i = 0; i < word_count_; ++i) {
+      words_[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /// @brief Exchange the bits of this bitset with another of the same size.
+  void Swap(DirtyBitset* other) {
+    assert(word_count_ == other->word_count_);
+    words_.swap(other->words_);
+  }
+
+  /// @brief Returns the number of bytes of heap memory used by the bitset.
+  size_t memory_usage() const {
+    return word_count_ * sizeof(std::atomic<uint64_t>);
+  }
+
+ private:
+  std::unique_ptr<std::atomic<uint64_t>[]> words_;
+  size_t word_count_;
+};
+
+/// @endcond
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_DIRTY_BITSET_H_
@@ -0,0 +1,104 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_DIRTY_NODE_QUEUE_H_
+#define BREADBOARD_DIRTY_NODE_QUEUE_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// @file breadboard/dirty_node_queue.h
+///
+/// @brief A DirtyNodeQueue holds the nodes of a GraphState that need to be
+///        executed, in sorted order.
+///
+/// @note This is for internal use only.
+
+namespace breadboard {
+
+/// @cond BREADBOARD_INTERNAL
+
+/// @class DirtyNodeQueue
+///
+/// @brief A DirtyNodeQueue holds the nodes of a GraphState that need to be
+///        executed, in sorted order.
+///
+/// Nodes are identified by their position in Graph::sorted_nodes(). Pushing a
+/// node that is already queued does nothing, and Pop always returns the
+/// lowest queued position, so nodes come out in an order that respects their
+/// dependencies even when they are pushed while the queue is being drained.
+///
+/// @note This is for internal use only.
+class DirtyNodeQueue {
+ public:
+  DirtyNodeQueue() : heap_(), queued_() {}
+
+  /// @brief Size the queue for a graph with the given number of nodes.
+  void Initialize(size_t node_count) {
+    heap_.clear();
+    heap_.reserve(node_count);
+    queued_.assign(node_count, 0);
+  }
+
+  /// @brief Queue the node at the given sorted position.
+  void Push(unsigned int sorted_index) {
+    assert(sorted_index < queued_.size());
+    if (!queued_[sorted_index]) {
+      queued_[sorted_index] = 1;
+      heap_.push_back(sorted_index);
+      std::push_heap(heap_.begin(), heap_.end(), std::greater<unsigned int>());
+    }
+  }
+
+  /// @brief Remove and return the lowest queued sorted position.
+  unsigned int Pop() {
+    assert(!heap_.empty());
+    std::pop_heap(heap_.begin(), heap_.end(), std::greater<unsigned int>());
+    unsigned int sorted_index = heap_.back();
+    heap_.pop_back();
+    queued_[sorted_index] = 0;
+    return sorted_index;
+  }
+
+  /// @brief Returns true if there are no queued nodes.
+  bool empty() const { return heap_.empty(); }
+
+  /// @brief Returns the number of bytes of heap memory used by the queue.
+  size_t memory_usage() const {
+    return heap_.capacity() * sizeof(unsigned int) +
+           queued_.capacity() * sizeof(uint8_t);
+  }
+
+  /// @brief Remove every queued node.
+  void Clear() {
+    for (size_t i = 0; i < heap_.size(); ++i) {
+      queued_[heap_[i]] = 0;
+    }
+    heap_.clear();
+  }
+
+ private:
+  std::vector<unsigned int> heap_;
+  std::vector<uint8_t> queued_;
+};
+
+/// @endcond
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_DIRTY_NODE_QUEUE_H_
@@ -15,9 +15,14 @@
 #ifndef BREADBOARD_EVENT_H_
 #define BREADBOARD_EVENT_H_
 
-#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
 
 #include "breadboard/node.h"
+#include "breadboard/type_registry.h"
 #include "fplutil/intrusive_list.h"
 
 /// @file breadboard/event.h
@@ -29,7 +34,9 @@
 namespace breadboard {
 
 class BaseNode;
+class EventDispatcher;
 class GraphState;
+class NodeEventBroadcaster;
 
 /// @typedef Timestamp
 ///
@@ -43,6 +50,39 @@ typedef uint32_t Timestamp;
 ///        for node events.
 typedef const char** EventId;
 
+/// @typedef EventIndex
+///
+/// @brief An EventIndex is a small integer that uniquely identifies an EventId.
+///
+/// Indices are handed out densely, starting from zero, the first time an
+/// EventId is seen, so they can be used to index into flat arrays.
+typedef unsigned int EventIndex;
+
+/// @brief A special value representing an invalid event index.
+static const EventIndex kInvalidEventIndex = static_cast<EventIndex>(-1);
+
+/// @brief Returns the EventIndex of the given EventId, assigning it the next
+///        free index if it does not have one yet.
+///
+/// Events defined with BREADBOARD_DEFINE_EVENT are assigned their index during
+/// static initialization. This function is thread safe.
+///
+/// @param[in] event_id The EventId to look up.
+///
+/// @return The EventIndex of the given EventId.
+EventIndex GetEventIndex(EventId event_id);
+
+/// @brief Returns the EventIndex of the given EventId, or kInvalidEventIndex if
+///        it has not been assigned one.
+///
+/// This function is thread safe. Each thread remembers the indices it has
+/// found, so that looking the same events up again usually takes no lock.
+///
+/// @param[in] event_id The EventId to look up.
+///
+/// @return The EventIndex of the given EventId, or kInvalidEventIndex.
+EventIndex FindEventIndex(EventId event_id);
+
 /// @class NodeEventListener
 ///
 /// @brief A NodeEventListener ensures a node is marked dirty for reevaluation
@@ -85,13 +125,63 @@ class NodeEventListener {
   ///
   /// @param[in] event_id The EventId this listener is listening for.
   NodeEventListener(GraphState* graph_state, EventId event_id)
-      : node(), graph_state_(graph_state), timestamp_(0), event_id_(event_id) {}
+      : node(),
+        graph_state_(graph_state),
+        broadcaster_(nullptr),
+        timestamp_(0),
+        event_id_(event_id),
+        event_index_(GetEventIndex(event_id)),
+        sorted_node_index_(kInvalidNodeIndex),
+        wake_tick_(0) {}
+
+  /// @brief Construct a NodeEventListener for a node in the given GraphState.
+  ///
+  /// @param[in] graph_state The GraphState that owns the node that this
+  /// NodeEventListener belongs to.
+  ///
+  /// @param[in] event_id The EventId this listener is listening for.
+  ///
+  /// @param[in] event_index The EventIndex of `event_id`.
+  ///
+  /// @param[in] sorted_node_index The position in Graph::sorted_nodes() of the
+  /// node this listener belongs to.
+  NodeEventListener(GraphState* graph_state, EventId event_id,
+                    EventIndex event_index, unsigned int sorted_node_index)
+      : node(),
+        graph_state_(graph_state),
+        broadcaster_(nullptr),
+        timestamp_(0),
+        event_id_(event_id),
+        event_index_(event_index),
+        sorted_node_index_(sorted_node_index),
+        wake_tick_(0) {}
 
   /// @brief Returns the EventId this listener is listening for.
   ///
   /// @return The EventId this listener is listening for.
   EventId event_id() const { return event_id_; }
 
+  /// @brief Returns the EventIndex of the event this listener is listening
+  /// for.
+  ///
+  /// @return The EventIndex of the event this listener is listening for.
+  EventIndex event_index() const { return event_index_; }
+
+  /// @brief Returns the broadcaster this listener was last registered with.
+  ///
+  /// @return The broadcaster this listener was last registered with.
+  NodeEventBroadcaster* broadcaster() const { return broadcaster_; }
+
+  /// @brief Returns the broadcaster this listener is registered with.
+  ///
+  /// Unlike broadcaster(), this is null once the listener has been
+  /// unregistered or its broadcaster has been destroyed.
+  ///
+  /// @return The broadcaster this listener is registered with, or null.
+  NodeEventBroadcaster* bound_broadcaster() const {
+    return node.in_list() ? broadcaster_ : nullptr;
+  }
+
   /// @brief Returns the EventId this listener is listening for.
   ///
   /// @return The EventId this listener is listening for.
@@ -102,6 +192,23 @@ class NodeEventListener {
   /// @return The current Timestamp.
   Timestamp timestamp() const { return timestamp_; }
 
+  /// @brief Returns the position in Graph::sorted_nodes() of the node this
+  /// listener belongs to, or kInvalidNodeIndex if it does not belong to a node.
+  ///
+  /// @return The sorted position of the node this listener belongs to.
+  unsigned int sorted_node_index() const { return sorted_node_index_; }
+
+  /// @brief Returns true if this listener is waiting for a timer in a
+  /// TimerWheel to fire.
+  ///
+  /// @return Whether this listener is waiting for a timer.
+  bool waiting_on_timer() const { return node.in_list() && !broadcaster_; }
+
+  /// @brief Returns the tick the timer on this listener was last set for.
+  ///
+  /// @return The tick the timer on this listener was last set for.
+  uint64_t wake_tick() const { return wake_tick_; }
+
   /// @brief Mark the node this Listener is associated with as dirty.
   void MarkDirty();
 
@@ -109,11 +216,102 @@ class NodeEventListener {
   /// @endcond
 
  private:
+  friend class GraphState;
+  friend class GraphStateHistory;
+  friend class NodeEventBroadcaster;
+  friend class TimerWheel;
+
   GraphState* graph_state_;
+  NodeEventBroadcaster* broadcaster_;
   Timestamp timestamp_;
   EventId event_id_;
+  EventIndex event_index_;
+  unsigned int sorted_node_index_;
+  uint64_t wake_tick_;
+};
+
+/// @cond BREADBOARD_INTERNAL
+
+/// @brief A value that was broadcast along with an event.
+///
+/// @note This is for internal use only.
+struct EventPayload {
+  EventPayload(const Type* type_, const void* data_)
+      : type(type_), data(data_) {}
+
+  /// @brief The type of the value, from TypeRegistry::GetType.
+  const Type* type;
+
+  /// @brief The value itself.
+  const void* data;
+};
+
+/// @brief Holds copies of the payloads broadcast by a NodeEventBroadcaster
+///        until they have been delivered.
+///
+/// Payloads are packed into blocks of memory that are kept when the buffer is
+/// cleared, so that once the buffer has grown to fit a frame's worth of
+/// payloads, later frames allocate nothing.
+///
+/// @note This is for internal use only.
+class EventPayloadBuffer {
+ public:
+  EventPayloadBuffer()
+      : blocks_(), block_index_(0), block_offset_(0), destructions_() {}
+
+  ~EventPayloadBuffer() { Clear(); }
+
+  /// @brief Copy a payload into the buffer.
+  ///
+  /// @return The copy, which stays valid until the buffer is cleared.
+  template <typename PayloadType>
+  const PayloadType* Add(const PayloadType& payload) {
+    void* ptr = Allocate(sizeof(PayloadType),
+                         std::alignment_of<PayloadType>::value);
+    PayloadType* copy = new (ptr) PayloadType(payload);
+    if (!std::is_trivially_destructible<PayloadType>::value) {
+      destructions_.push_back(Destruction(DestroyPayload<PayloadType>, copy));
+    }
+    return copy;
+  }
+
+  /// @brief Destroy every payload in the buffer, keeping its memory for
+  ///        reuse.
+  void Clear();
+
+ private:
+  struct Block {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size;
+  };
+
+  struct Destruction {
+    Destruction(void (*destroy_)(void*), void* ptr_)
+        : destroy(destroy_), ptr(ptr_) {}
+    void (*destroy)(void*);
+    void* ptr;
+  };
+
+  template <typename PayloadType>
+  static void DestroyPayload(void* ptr) {
+    static_cast<PayloadType*>(ptr)->~PayloadType();
+  }
+
+  // Return memory for an object of the given size and alignment.
+  void* Allocate(size_t size, size_t alignment);
+
+  // Disallow copying.
+  EventPayloadBuffer(EventPayloadBuffer&);
+  EventPayloadBuffer& operator=(EventPayloadBuffer&);
+
+  std::vector<Block> blocks_;
+  size_t block_index_;
+  size_t block_offset_;
+  std::vector<Destruction> destructions_;
 };
 
+/// @endcond
+
 /// @class NodeEventBroadcaster
 ///
 /// @brief A NodeEventBroadcaster is used to notify NodeEventListeners that a
@@ -135,19 +333,131 @@ class NodeEventListener {
 /// event would then execute the next time the graph itself is executed.
 class NodeEventBroadcaster {
  public:
+  NodeEventBroadcaster()
+      : event_listener_lists_(),
+        event_dispatcher_(nullptr),
+        event_payloads_(),
+        payload_buffer_(),
+        broadcast_depth_(0),
+        payload_dispatcher_(nullptr) {}
+
+  ~NodeEventBroadcaster();
+
   /// Associate the given listener with this NodeEventBroadcaster and the given
   /// event_id.
+  ///
+  /// Registering a listener that is already registered with this broadcaster
+  /// does nothing, and takes constant time.
   void RegisterListener(NodeEventListener* listener);
 
+  /// Remove the given listener from this NodeEventBroadcaster, so that it no
+  /// longer responds to its events. Listeners registered with another
+  /// broadcaster, or with none, are left alone.
+  void UnregisterListener(NodeEventListener* listener);
+
   /// For each listener registered with the given event_id on this broadcaster,
   /// mark the node associated with the listener dirty so that it will execute
   /// the next time the graph is executed.
+  ///
+  /// If this broadcaster has no EventDispatcher, each listener's GraphState is
+  /// executed immediately. Otherwise the GraphStates are added to the
+  /// dispatcher and executed by the next call to EventDispatcher::FlushEvents.
   void BroadcastEvent(EventId event_id);
 
+  /// Same as BroadcastEvent(EventId), but takes an EventIndex that has already
+  /// been looked up with GetEventIndex. This avoids looking the index up on
+  /// every call for events that are broadcast very often.
+  void BroadcastEventIndex(EventIndex event_index);
+
+  /// Same as BroadcastEventIndex(EventIndex), but also passes a value along to
+  /// the listening nodes, which can read it with
+  /// NodeArguments::GetListenerPayload instead of looking the data up
+  /// elsewhere.
+  ///
+  /// The payload is copied, and is kept until the GraphStates receiving it
+  /// have been executed: until this function returns if there is no
+  /// EventDispatcher, or until the end of the next call to
+  /// EventDispatcher::FlushEvents otherwise. Every payload broadcast in that
+  /// time is available to the listening nodes, in the order they were
+  /// broadcast. All of the payloads of an event should have the same type.
+  template <typename PayloadType>
+  void BroadcastEventIndex(EventIndex event_index, const PayloadType& payload) {
+    if (!HasListeners(event_index)) {
+      return;
+    }
+    AddPayload(event_index, TypeRegistry<PayloadType>::GetType(),
+               payload_buffer_.Add(payload));
+    BroadcastEventIndex(event_index);
+  }
+
+  /// Same as BroadcastEventIndex(EventIndex, const PayloadType&), but looks up
+  /// the EventIndex of the given EventId.
+  template <typename PayloadType>
+  void BroadcastEvent(EventId event_id, const PayloadType& payload) {
+    EventIndex event_index = FindEventIndex(event_id);
+    if (event_index != kInvalidEventIndex) {
+      BroadcastEventIndex(event_index, payload);
+    }
+  }
+
+  /// @cond BREADBOARD_INTERNAL
+  /// Returns the payloads of the given event that have not been cleared yet.
+  ArrayRef<const EventPayload> payloads(EventIndex event_index) const {
+    if (event_index >= event_payloads_.size()) {
+      return ArrayRef<const EventPayload>();
+    }
+    const std::vector<EventPayload>& payloads = event_payloads_[event_index];
+    return ArrayRef<const EventPayload>(payloads.data(), payloads.size());
+  }
+
+  /// Destroy the payloads of every event. This is called by the
+  /// EventDispatcher once it has delivered them.
+  void ClearPayloads();
+  /// @endcond
+
+  /// Set the EventDispatcher used to defer executing the GraphStates that
+  /// receive events from this broadcaster. Pass null to execute them
+  /// immediately, which is the default.
+  void set_event_dispatcher(EventDispatcher* event_dispatcher) {
+    event_dispatcher_ = event_dispatcher;
+  }
+
+  /// Returns the EventDispatcher used by this broadcaster, if any.
+  EventDispatcher* event_dispatcher() const { return event_dispatcher_; }
+
  private:
   typedef fplutil::intrusive_list<NodeEventListener> ListenerList;
 
-  std::map<EventId, ListenerList> event_listener_lists_;
+  // Disallow copying.
+  NodeEventBroadcaster(NodeEventBroadcaster&);
+  NodeEventBroadcaster& operator=(NodeEventBroadcaster&);
+
+  // Returns true if any listener has been registered for the given event.
+  bool HasListeners(EventIndex event_index) const {
+    return event_index < event_listener_lists_.size() &&
+           event_listener_lists_[event_index] &&
+           !event_listener_lists_[event_index]->empty();
+  }
+
+  // Keep track of a payload until it has been delivered.
+  void AddPayload(EventIndex event_index, const Type* type, const void* data);
+
+  // Indexed by EventIndex. Lists are only allocated for events that have had a
+  // listener registered.
+  std::vector<std::unique_ptr<ListenerList>> event_listener_lists_;
+  EventDispatcher* event_dispatcher_;
+
+  // The payloads of each event, indexed by EventIndex, and the memory that
+  // holds them.
+  std::vector<std::vector<EventPayload>> event_payloads_;
+  EventPayloadBuffer payload_buffer_;
+
+  // How many calls to BroadcastEvent are running. Without an EventDispatcher
+  // the payloads are cleared once the outermost one returns.
+  int broadcast_depth_;
+
+  // The EventDispatcher that has been asked to clear the payloads, if any.
+  EventDispatcher* payload_dispatcher_;
 };
 
 }  // namespace breadboard
@@ -199,10 +509,12 @@ class NodeEventBroadcaster {
 ///
 /// Once the event has been declared and defined, you can use it to broadcast
 /// events to graphs that are listening for those events
-#define BREADBOARD_DEFINE_EVENT(event_id)                            \
-  static const char* BREADBOARD_CONCAT2(BREADBOARD_VAR_, __LINE__) = \
-      __FILE__ ":" BREADBOARD_STRINGIZE2(__LINE__);                  \
-  ::breadboard::EventId event_id =                                   \
-      &BREADBOARD_CONCAT2(BREADBOARD_VAR_, __LINE__);
+#define BREADBOARD_DEFINE_EVENT(event_id)                                \
+  static const char* BREADBOARD_CONCAT2(BREADBOARD_VAR_, __LINE__) =     \
+      __FILE__ ":" BREADBOARD_STRINGIZE2(__LINE__);                      \
+  ::breadboard::EventId event_id =                                       \
+      &BREADBOARD_CONCAT2(BREADBOARD_VAR_, __LINE__);                    \
+  static const ::breadboard::EventIndex BREADBOARD_CONCAT2(              \
+      BREADBOARD_INDEX_, __LINE__) = ::breadboard::GetEventIndex(event_id);
 
 #endif  // BREADBOARD_EVENT_H_
@@ -0,0 +1,206 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_EVENT_DISPATCHER_H_
+#define BREADBOARD_EVENT_DISPATCHER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "breadboard/event.h"
+
+/// @file breadboard/event_dispatcher.h
+///
+/// @brief An EventDispatcher collects the GraphStates that have received
+///        events so that each one only needs to be executed once.
+
+namespace breadboard {
+
+class GraphState;
+
+/// @brief The number of posted events an EventDispatcher can hold by default.
+static const size_t kDefaultPostedEventCapacity = 1024;
+
+/// @class EventDispatcher
+///
+/// @brief An EventDispatcher collects the GraphStates that have received
+///        events so that each one only needs to be executed once.
+///
+/// By default NodeEventBroadcaster::BroadcastEvent executes the GraphState of
+/// every listener it notifies right away. When many events are broadcast in a
+/// single frame, or many nodes in the same graph listen for the same event, the
+/// same GraphState ends up being executed over and over.
+///
+/// A broadcaster that has been given an EventDispatcher instead only marks
+/// its listeners dirty and adds their GraphStates to the dispatcher. Calling
+/// FlushEvents, typically once per frame, then executes each of those
+/// GraphStates a single time:
+///
+/// ~~~{.cpp}
+///     breadboard::EventDispatcher dispatcher;
+///     entity->broadcaster.set_event_dispatcher(&dispatcher);
+///     ...
+///     // Somewhere in the game loop, after gameplay has broadcast its events:
+///     dispatcher.FlushEvents();
+/// ~~~
+///
+/// A GraphState that is destroyed while it is pending is removed from the
+/// dispatcher automatically.
+///
+/// Everything above must happen on the thread that owns the dispatcher and its
+/// broadcasters. Other threads, such as a physics or audio thread, can instead
+/// post events with PostEvent, which never blocks or allocates. Posted events
+/// are broadcast by the next call to FlushEvents, on the owning thread:
+///
+/// ~~~{.cpp}
+///     // On the physics thread:
+///     dispatcher.PostEvent(&entity->broadcaster, kCollisionEventIndex);
+/// ~~~
+class EventDispatcher {
+ public:
+  /// @brief Construct an EventDispatcher with nothing pending.
+  ///
+  /// @param[in] posted_event_capacity The number of events that can be posted
+  ///            between calls to FlushEvents. This is rounded up to a power of
+  ///            two.
+  explicit EventDispatcher(
+      size_t posted_event_capacity = kDefaultPostedEventCapacity);
+
+  /// @brief Destructor for an EventDispatcher.
+  ~EventDispatcher();
+
+  /// @brief Execute every GraphState that has received an event since the
+  ///        last flush, once each.
+  ///
+  /// If executing a GraphState causes more events to be broadcast through
+  /// this dispatcher, the GraphStates receiving them are executed before this
+  /// function returns.
+  void FlushEvents();
+
+  /// @brief Queue up an event to be broadcast by the given broadcaster the
+  ///        next time FlushEvents is called.
+  ///
+  /// This may be called from any thread. It is lock free, and never waits for
+  /// FlushEvents or for other threads posting events. Events are broadcast in
+  /// the order they were posted, and the broadcaster must still exist by
+  /// then. It should use this EventDispatcher, so that the GraphStates
+  /// receiving the events are executed once each.
+  ///
+  /// @param[in] broadcaster The broadcaster to broadcast the event from.
+  /// @param[in] event_index The EventIndex of the event, from GetEventIndex.
+  ///
+  /// @return Returns true if the event was queued, or false if the queue was
+  ///         full, in which case the event is dropped.
+  bool PostEvent(NodeEventBroadcaster* broadcaster, EventIndex event_index);
+
+  /// @brief Queue up an event to be broadcast by the given broadcaster the
+  ///        next time FlushEvents is called.
+  ///
+  /// This is the same as the overload above, except that the EventIndex is
+  /// looked up with FindEventIndex, which takes a lock. Threads that post
+  /// events often should look the index up once instead.
+  ///
+  /// @param[in] broadcaster The broadcaster to broadcast the event from.
+  /// @param[in] event_id The EventId of the event.
+  ///
+  /// @return Returns true if the event was queued, or false if the queue was
+  ///         full, in which case the event is dropped.
+  bool PostEvent(NodeEventBroadcaster* broadcaster, EventId event_id);
+
+  /// @brief Returns true if there are GraphStates waiting to be executed, or
+  ///        posted events waiting to be broadcast.
+  ///
+  /// @return True if there is anything for FlushEvents to do.
+  bool HasPendingEvents() const;
+
+  /// @cond BREADBOARD_INTERNAL
+
+  /// @brief Add a GraphState to be executed by the next call to FlushEvents.
+  ///
+  /// Adding a GraphState that is already pending does nothing.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @param[in] graph_state The GraphState to execute.
+  void AddPendingGraphState(GraphState* graph_state);
+
+  /// @brief Stop tracking a GraphState that is about to be destroyed.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @param[in] graph_state The GraphState to stop tracking.
+  void RemovePendingGraphState(GraphState* graph_state);
+
+  /// @brief Clear the payloads of the given broadcaster at the end of the
+  ///        next call to FlushEvents.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @param[in] broadcaster The broadcaster holding payloads.
+  void AddPayloadBroadcaster(NodeEventBroadcaster* broadcaster);
+
+  /// @brief Stop tracking a broadcaster that is about to be destroyed.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @param[in] broadcaster The broadcaster to stop tracking.
+  void RemovePayloadBroadcaster(NodeEventBroadcaster* broadcaster);
+
+  /// @endcond
+
+ private:
+  // Disallow copying.
+  EventDispatcher(EventDispatcher&);
+  EventDispatcher& operator=(EventDispatcher&);
+
+  // An event posted with PostEvent. The sequence number tells producers and
+  // the consumer whose turn it is to use the slot.
+  struct PostedEvent {
+    std::atomic<size_t> sequence;
+    NodeEventBroadcaster* broadcaster;
+    EventIndex event_index;
+  };
+
+  // Broadcast the events that have been posted so far.
+  void BroadcastPostedEvents();
+
+  // Take the oldest posted event off the queue. Returns false if there is
+  // none. Only called on the owning thread.
+  bool PopPostedEvent(NodeEventBroadcaster** broadcaster,
+                      EventIndex* event_index);
+
+  std::vector<GraphState*> pending_graph_states_;
+
+  // The broadcasters whose payloads are cleared when the flush is done.
+  std::vector<NodeEventBroadcaster*> payload_broadcasters_;
+
+  // A bounded lock free queue of posted events, written by any thread and
+  // read by the owning thread. The positions are kept on separate cache lines
+  // so that posting threads don't slow down the thread flushing events.
+  std::unique_ptr<PostedEvent[]> posted_events_;
+  size_t posted_event_mask_;
+  std::atomic<size_t> post_position_;
+  char padding_[64];
+  size_t pop_position_;
+
+  // The GraphStates being executed by the current call to FlushEvents. Removed
+  // GraphStates are set to null rather than erased.
+  std::vector<GraphState*> flushing_graph_states_;
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_EVENT_DISPATCHER_H_
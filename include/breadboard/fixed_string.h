@@ -0,0 +1,255 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_FIXED_STRING_H_
+#define BREADBOARD_FIXED_STRING_H_
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/// @file breadboard/fixed_string.h
+///
+/// @brief A FixedString is a string whose characters are stored inside the
+///        object itself, so it never allocates.
+
+namespace breadboard {
+
+/// @brief Formats an integer into a buffer.
+///
+/// This never allocates memory and does not depend on the current locale.
+///
+/// @param[in] value The integer to format.
+///
+/// @param[in] width The minimum number of characters to write. Shorter numbers
+/// are padded on the left with spaces.
+///
+/// @param[out] buffer The buffer to write to. It must have room for `capacity`
+/// characters plus a null terminator.
+///
+/// @param[in] capacity The maximum number of characters to write.
+///
+/// @return The number of characters the number needs, not counting the null
+/// terminator. If this is more than `capacity`, the number was truncated.
+size_t FormatInt(int value, int width, char* buffer, size_t capacity);
+
+/// @brief Formats a float into a buffer.
+///
+/// This never allocates memory.
+///
+/// @param[in] value The float to format.
+///
+/// @param[in] precision The number of digits to write after the decimal
+/// point. If this is negative, the shortest of fixed or exponent notation is
+/// used, which matches the default formatting of a `std::stringstream`.
+///
+/// @param[in] width The minimum number of characters to write. Shorter numbers
+/// are padded on the left with spaces.
+///
+/// @param[out] buffer The buffer to write to. It must have room for `capacity`
+/// characters plus a null terminator.
+///
+/// @param[in] capacity The maximum number of characters to write.
+///
+/// @return The number of characters the number needs, not counting the null
+/// terminator. If this is more than `capacity`, the number was truncated.
+size_t FormatFloat(float value, int precision, int width, char* buffer,
+                   size_t capacity);
+
+/// @class FixedString
+///
+/// @brief A string that holds up to `kCapacity` characters inside the object
+///        itself.
+///
+/// Unlike `std::string`, a FixedString never touches the heap, so it is
+/// a good edge type for short text that is rebuilt every frame, such as the
+/// numbers shown on a HUD. Nodes can format straight into an output edge:
+///
+/// ~~~{.cpp}
+///     SmallString* str = args->GetMutableOutput<SmallString>(kOutputString);
+///     if (str) {
+///       str->clear();
+///       str->AppendInt(*args->GetInput<int>(kInputScore));
+///     }
+/// ~~~
+///
+/// Anything that would grow the string past its capacity is truncated, and
+/// the function that did so returns false.
+template <size_t kCapacity>
+class FixedString {
+ public:
+  /// @brief Construct an empty FixedString.
+  FixedString() : size_(0) { data_[0] = '\0'; }
+
+  /// @brief Construct a FixedString from the given characters, truncating
+  /// them if they do not fit.
+  ///
+  /// @param[in] str A null terminated string.
+  explicit FixedString(const char* str) : size_(0) {
+    assign(str, strlen(str));
+  }
+
+  /// @brief Construct a FixedString from the given string, truncating it if it
+  /// does not fit.
+  ///
+  /// @param[in] str A string.
+  explicit FixedString(const std::string& str) : size_(0) {
+    assign(str.data(), str.size());
+  }
+
+  /// @brief Replace the contents of this string.
+  ///
+  /// @param[in] str The characters to copy.
+  ///
+  /// @param[in] size The number of characters to copy.
+  ///
+  /// @return True if all of the characters fit.
+  bool assign(const char* str, size_t size) {
+    clear();
+    return append(str, size);
+  }
+
+  /// @brief Replace the contents of this string.
+  ///
+  /// @param[in] str A null terminated string.
+  ///
+  /// @return True if all of the characters fit.
+  bool assign(const char* str) { return assign(str, strlen(str)); }
+
+  /// @brief Add characters to the end of this string.
+  ///
+  /// @param[in] str The characters to copy.
+  ///
+  /// @param[in] size The number of characters to copy.
+  ///
+  /// @return True if all of the characters fit.
+  bool append(const char* str, size_t size) {
+    size_t count = size < kCapacity - size_ ? size : kCapacity - size_;
+    memcpy(data_ + size_, str, count);
+    size_ += count;
+    data_[size_] = '\0';
+    return count == size;
+  }
+
+  /// @brief Add characters to the end of this string.
+  ///
+  /// @param[in] str A null terminated string.
+  ///
+  /// @return True if all of the characters fit.
+  bool append(const char* str) { return append(str, strlen(str)); }
+
+  /// @brief Add another FixedString to the end of this string.
+  ///
+  /// @param[in] str The string to copy.
+  ///
+  /// @return True if all of the characters fit.
+  template <size_t kOtherCapacity>
+  bool append(const FixedString<kOtherCapacity>& str) {
+    return append(str.data(), str.size());
+  }
+
+  /// @brief Format an integer onto the end of this string.
+  ///
+  /// @param[in] value The integer to format.
+  ///
+  /// @param[in] width The minimum number of characters to write. See
+  /// FormatInt.
+  ///
+  /// @return True if all of the characters fit.
+  bool AppendInt(int value, int width = 0) {
+    return Grow(FormatInt(value, width, data_ + size_, kCapacity - size_));
+  }
+
+  /// @brief Format a float onto the end of this string.
+  ///
+  /// @param[in] value The float to format.
+  ///
+  /// @param[in] precision The number of digits after the decimal point. See
+  /// FormatFloat.
+  ///
+  /// @param[in] width The minimum number of characters to write. See
+  /// FormatFloat.
+  ///
+  /// @return True if all of the characters fit.
+  bool AppendFloat(float value, int precision = -1, int width = 0) {
+    return Grow(FormatFloat(value, precision, width, data_ + size_,
+                            kCapacity - size_));
+  }
+
+  /// @brief Remove all characters from this string.
+  void clear() {
+    size_ = 0;
+    data_[0] = '\0';
+  }
+
+  /// @brief Returns the characters of this string.
+  ///
+  /// @return The characters of this string, followed by a null terminator.
+  const char* c_str() const { return data_; }
+
+  /// @brief Returns the characters of this string.
+  ///
+  /// @return The characters of this string, followed by a null terminator.
+  const char* data() const { return data_; }
+
+  /// @brief Returns a copy of this string as a `std::string`.
+  ///
+  /// @return A copy of the characters of this string.
+  std::string str() const { return std::string(data_, size_); }
+
+  /// @brief Returns the number of characters in this string.
+  ///
+  /// @return The number of characters in this string.
+  size_t size() const { return size_; }
+
+  /// @brief Returns true if this string holds no characters.
+  ///
+  /// @return Whether this string is empty.
+  bool empty() const { return size_ == 0; }
+
+  /// @brief Returns the maximum number of characters this string can hold.
+  ///
+  /// @return The maximum number of characters this string can hold.
+  static size_t capacity() { return kCapacity; }
+
+  /// @brief Returns true if both strings hold the same characters.
+  bool operator==(const FixedString& other) const {
+    return size_ == other.size_ && memcmp(data_, other.data_, size_) == 0;
+  }
+
+  /// @brief Returns true if the strings hold different characters.
+  bool operator!=(const FixedString& other) const { return !(*this == other); }
+
+ private:
+  // Account for the characters that were just formatted past the end of the
+  // string, given how many were needed. Returns false if they were truncated.
+  bool Grow(size_t needed) {
+    size_t room = kCapacity - size_;
+    size_ += needed < room ? needed : room;
+    data_[size_] = '\0';
+    return needed <= room;
+  }
+
+  size_t size_;
+  char data_[kCapacity + 1];
+};
+
+/// @brief The FixedString registered as an edge type by the common module.
+///
+/// It fits into the same 32 bytes a `std::string` typically takes up.
+typedef FixedString<32 - sizeof(size_t) - 1> SmallString;
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_FIXED_STRING_H_
@@ -0,0 +1,112 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_GENERATED_GRAPH_H_
+#define BREADBOARD_GENERATED_GRAPH_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "breadboard/compiled_graph.h"
+#include "breadboard/event.h"
+#include "breadboard/graph.h"
+#include "breadboard/graph_state.h"
+#include "breadboard/memory_buffer.h"
+#include "breadboard/module_registry.h"
+
+/// @file breadboard/generated_graph.h
+///
+/// @brief Generate C++ source for a finalized Graph, with a function that
+///        executes it in a single straight line.
+
+namespace breadboard {
+
+/// @brief Write a C++ source file that loads the given Graph and executes it
+///        without walking its nodes at runtime.
+///
+/// This is meant to be run as a build step, alongside CompileGraph, for the
+/// graphs that are executed most often. The source holds the graph in the
+/// compiled graph format, and a function that checks each node's timestamps
+/// at offsets written into the code, and executes the dirty ones in order.
+/// It defines a single function with the given name, which fills in a Graph:
+///
+/// ~~~{.cpp}
+///     bool LoadEnemyGraph(const breadboard::ModuleRegistry* module_registry,
+///                         breadboard::Graph* graph);
+/// ~~~
+///
+/// Register it with GraphFactory::RegisterGeneratedGraph so that it is used in
+/// place of the file it was generated from. The generated source must be
+/// built into the game with the same nodes registered as when it was
+/// generated; LoadCompiledGraph rejects it otherwise.
+///
+/// @param[in] graph The finalized Graph to generate source for.
+///
+/// @param[in] function_name The name of the function that loads the graph.
+///
+/// @param[out] output The generated source.
+///
+/// @return Returns true if successful. Otherwise an error is logged and false
+///         is returned.
+bool GenerateGraphSource(const Graph& graph, const std::string& function_name,
+                         std::string* output);
+
+/// @cond BREADBOARD_INTERNAL
+
+/// @class GeneratedGraphContext
+///
+/// @brief The GraphState being executed by a generated execute function.
+///
+/// @note This is for internal use only, by the code written by
+/// GenerateGraphSource.
+class GeneratedGraphContext {
+ public:
+  /// @brief Returns true if the timestamp at the given offset in the output
+  /// buffer was set during the current execution.
+  bool IsTimestampCurrent(ptrdiff_t offset) const {
+    return *output_buffer_->GetObject<Timestamp>(offset) == timestamp_;
+  }
+
+  /// @brief Returns true if the listener at the given offset in the output
+  /// buffer was signaled since the last execution.
+  bool IsListenerCurrent(ptrdiff_t offset) const {
+    return output_buffer_->GetObject<NodeEventListener>(offset)->timestamp() ==
+           timestamp_;
+  }
+
+  /// @brief Execute the node at the given position in Graph::sorted_nodes.
+  void ExecuteNode(unsigned int sorted_index);
+
+  /// @brief Record that the node at the given position in Graph::sorted_nodes
+  /// was not dirty.
+  void SkipNode(unsigned int sorted_index);
+
+ private:
+  friend class GraphState;
+
+  explicit GeneratedGraphContext(GraphState* graph_state);
+
+  GraphState* graph_state_;
+  const MemoryBuffer* output_buffer_;
+  Timestamp timestamp_;
+  const std::vector<Node*>* sorted_nodes_;
+  size_t executed_count_;
+};
+
+/// @endcond
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_GENERATED_GRAPH_H_
@@ -17,10 +17,16 @@
 
 #include <cassert>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "breadboard/allocator.h"
 #include "breadboard/log.h"
 #include "breadboard/memory_buffer.h"
+#include "breadboard/memory_stats.h"
 #include "breadboard/node.h"
 #include "breadboard/node_signature.h"
 
@@ -31,6 +37,83 @@
 
 namespace breadboard {
 
+class GeneratedGraphContext;
+class Graph;
+class GraphState;
+class ModuleRegistry;
+
+bool CompileGraph(const Graph& graph, std::string* output);
+bool LoadCompiledGraph(const ModuleRegistry* module_registry,
+                       const uint8_t* data, size_t size, Graph* graph);
+
+/// @cond BREADBOARD_INTERNAL
+
+/// @typedef GeneratedExecuteFunc
+///
+/// @brief A function written by GenerateGraphSource that executes the dirty
+/// nodes of a particular Graph.
+typedef void (*GeneratedExecuteFunc)(GeneratedGraphContext* context);
+
+/// @brief An object in the output buffer of a GraphState, identified by its
+///        type and offset.
+///
+/// @note This is for internal use only.
+struct OutputBufferObject {
+  OutputBufferObject(const Type* type_, ptrdiff_t offset_)
+      : type(type_), offset(offset_) {}
+
+  /// @brief The type of the object.
+  const Type* type;
+
+  /// @brief The offset of the object in the output buffer.
+  ptrdiff_t offset;
+};
+
+/// @endcond
+
+/// @brief How the objects in the output buffer of a GraphState are arranged.
+enum OutputBufferLayout {
+  /// @brief The output edges, listeners and state of each node are placed
+  /// together, in the order the nodes are executed in. This is the default.
+  kOutputBufferLayoutExecutionOrder,
+
+  /// @brief The timestamps and the small, trivially destructible values, such
+  /// as numbers and vectors, are packed together at the front of the buffer
+  /// in execution order. Larger values, values with destructors such as
+  /// strings, and listeners follow them. This keeps the data touched on
+  /// every execution in fewer cache lines, which helps large graphs.
+  kOutputBufferLayoutHotCold,
+};
+
+/// @brief How the nodes of a Graph are ordered for execution.
+enum ExecutionOrder {
+  /// @brief Each node is placed right after the last of the nodes it depends
+  /// on, so that chains of nodes are executed one after another. This is the
+  /// default.
+  kExecutionOrderDepthFirst,
+
+  /// @brief Nodes that do not depend on each other are rearranged so that
+  /// nodes of the same NodeSignature are executed back to back. Running the
+  /// same code many times in a row makes better use of the instruction cache
+  /// and branch predictor, which helps graphs with many nodes of a few kinds.
+  kExecutionOrderGroupedBySignature,
+};
+
+/// @brief How GraphStates of a Graph find out which nodes need executing.
+enum DirtyTracking {
+  /// @brief A node is dirty if the timestamp of the node, one of its
+  /// listeners, or one of its connected inputs is current. These timestamps
+  /// are spread throughout the output buffer. This is the default.
+  kDirtyTrackingTimestamps,
+
+  /// @brief Each node and connected output edge is also given a bit in a
+  /// dense bitset held by the GraphState, and a node is dirty if any of the
+  /// bits for it or its inputs are set. Checking a node reads a word or two
+  /// instead of a cache line per input, which helps large graphs where few
+  /// nodes change each update.
+  kDirtyTrackingBitset,
+};
+
 /// @class Graph
 ///
 /// @brief A Graph represents the relationship between a variety of nodes. It
@@ -57,7 +140,33 @@ class Graph {
       : graph_name_(graph_name),
         nodes_(),
         sorted_nodes_(),
-        nodes_finalized_(false) {}
+        executed_nodes_(),
+        node_positions_(),
+        execution_levels_(),
+        resolved_input_edges_(),
+        output_edges_(),
+        listener_offsets_(),
+        consumers_(),
+        subgraphs_(),
+        subgraph_signature_mutex_(),
+        subgraph_inputs_(),
+        subgraph_outputs_(),
+        subgraph_signature_(),
+        output_buffer_size_(0),
+        output_buffer_alignment_(1),
+        output_buffer_layout_(kOutputBufferLayoutExecutionOrder),
+        execution_order_(kExecutionOrderDepthFirst),
+        dirty_tracking_(kDirtyTrackingTimestamps),
+        dirty_bit_count_(0),
+        dirty_masks_(),
+        generated_execute_func_(nullptr),
+        allocator_(DefaultAllocator()),
+        output_buffer_copyable_(false),
+        nodes_finalized_(false),
+        graph_states_(),
+        reloading_(false),
+        removed_graph_states_(),
+        reload_count_(0) {}
 
   /// @brief Destructor for a BaseNode.
   ~Graph();
@@ -75,6 +184,44 @@ class Graph {
   ///         be set up.
   Node* AddNode(const NodeSignature* signature);
 
+  /// @brief Add a node that stands in for all of the nodes of another Graph.
+  ///
+  /// The node has the signature returned by the subgraph's
+  /// subgraph_signature(), and its edges are set up like those of any other
+  /// node. When FinalizeNodes is called, it is replaced by copies of the
+  /// subgraph's nodes, wired to whatever the subgraph node was connected to.
+  /// The copies are then sorted and analyzed along with the rest of this
+  /// Graph, so a subgraph costs no more to execute than if its nodes had been
+  /// added here directly. Inputs of the subgraph node that are not connected
+  /// start out with the subgraph's default values, which SetDefaultValue may
+  /// override as usual. Subgraphs may themselves contain subgraphs.
+  ///
+  /// This Graph keeps a reference to the subgraph until FinalizeNodes has
+  /// been called, after which it no longer needs it.
+  ///
+  /// @param[in] subgraph A finalized Graph to inline into this one.
+  ///
+  /// @return Returns the node that was just added so that its input edges can
+  ///         be set up.
+  Node* AddSubgraph(const std::shared_ptr<const Graph>& subgraph);
+
+  /// @brief Returns the signature of the node that AddSubgraph adds for this
+  ///        Graph.
+  ///
+  /// Its inputs are the input edges of this Graph that are not connected to
+  /// anything, and its outputs are the output edges that are not connected to
+  /// anything, each in the order the nodes were added, with the nodes of any
+  /// nested subgraphs last. The parameters keep the names and comments of the
+  /// edges they stand for. The signature is built the first time it is asked
+  /// for, and may be asked for from any thread.
+  ///
+  /// A Graph that is used as a subgraph must not be reloaded while other
+  /// graphs that use it are being loaded.
+  ///
+  /// @return The signature of a subgraph node for this Graph. The nodes must
+  ///         have been finalized.
+  const NodeSignature* subgraph_signature() const;
+
   /// @brief FinalizeNodes should be called once, after all nodes have been
   ///        added to the Graph, and before setting default input edge values.
   ///
@@ -92,6 +239,109 @@ class Graph {
   //          is returned.
   bool FinalizeNodes();
 
+  /// @brief Set how FinalizeNodes arranges the output buffer of the
+  ///        GraphStates of this Graph.
+  ///
+  /// This must be called before FinalizeNodes.
+  ///
+  /// @param[in] output_buffer_layout The OutputBufferLayout to use.
+  void set_output_buffer_layout(OutputBufferLayout output_buffer_layout) {
+    assert(!nodes_finalized_);
+    output_buffer_layout_ = output_buffer_layout;
+  }
+
+  /// @brief Returns how the output buffer of this Graph is arranged.
+  ///
+  /// @return The OutputBufferLayout used by FinalizeNodes.
+  OutputBufferLayout output_buffer_layout() const {
+    return output_buffer_layout_;
+  }
+
+  /// @brief Set how FinalizeNodes orders the nodes for execution.
+  ///
+  /// This must be called before FinalizeNodes.
+  ///
+  /// @param[in] execution_order The ExecutionOrder to use.
+  void set_execution_order(ExecutionOrder execution_order) {
+    assert(!nodes_finalized_);
+    execution_order_ = execution_order;
+  }
+
+  /// @brief Returns how the nodes of this Graph are ordered for execution.
+  ///
+  /// @return The ExecutionOrder used by FinalizeNodes.
+  ExecutionOrder execution_order() const { return execution_order_; }
+
+  /// @brief Set how GraphStates of this Graph track which nodes are dirty.
+  ///
+  /// This must be called before FinalizeNodes.
+  ///
+  /// @param[in] dirty_tracking The DirtyTracking to use.
+  void set_dirty_tracking(DirtyTracking dirty_tracking) {
+    assert(!nodes_finalized_);
+    dirty_tracking_ = dirty_tracking;
+  }
+
+  /// @brief Returns how GraphStates of this Graph track which nodes are dirty.
+  ///
+  /// @return The DirtyTracking used by FinalizeNodes.
+  DirtyTracking dirty_tracking() const { return dirty_tracking_; }
+
+  /// @cond BREADBOARD_INTERNAL
+
+  /// @brief Returns the number of bits in the DirtyBitsets of GraphStates of
+  ///        this Graph, which is 0 unless it uses kDirtyTrackingBitset.
+  ///
+  /// @return The number of dirty bits.
+  size_t dirty_bit_count() const { return dirty_bit_count_; }
+
+  /// @endcond
+
+  /// @brief Set the Allocator that FinalizeNodes takes the memory for this
+  ///        Graph's default values and nodes from.
+  ///
+  /// This is also where the output buffers of GraphStates initialized from
+  /// this Graph come from, unless they are given an Allocator of their own.
+  /// The Allocator must outlive this Graph and its GraphStates.
+  ///
+  /// This must be called before FinalizeNodes.
+  ///
+  /// @param[in] allocator The Allocator to use.
+  void set_allocator(Allocator* allocator) {
+    assert(!nodes_finalized_ && allocator);
+    allocator_ = allocator;
+  }
+
+  /// @brief Returns the Allocator this Graph's buffers are taken from.
+  ///
+  /// @return The Allocator this Graph's buffers are taken from.
+  Allocator* allocator() const { return allocator_; }
+
+  /// @cond BREADBOARD_INTERNAL
+  /// @brief Set the function generated by GenerateGraphSource for this Graph.
+  ///
+  /// GraphStates executed on the calling thread in kExecutionModePolling use
+  /// it in place of walking the nodes, unless their ExecutionBudget has a
+  /// limit. It is dropped when the Graph is reloaded.
+  ///
+  /// @note For internal use only, by the code written by
+  /// GenerateGraphSource.
+  ///
+  /// @param[in] generated_execute_func The function to execute the Graph
+  /// with, or null to walk the nodes.
+  void set_generated_execute_func(GeneratedExecuteFunc generated_execute_func) {
+    generated_execute_func_ = generated_execute_func;
+  }
+
+  /// @brief Returns the function generated by GenerateGraphSource for this
+  /// Graph, if any.
+  ///
+  /// @return The function to execute the Graph with, or null.
+  GeneratedExecuteFunc generated_execute_func() const {
+    return generated_execute_func_;
+  }
+  /// @endcond
+
   /// @brief Returns true if FinalizeNodes has been called.
   ///
   /// @return Returns true if FinalizeNodes has been called.
@@ -110,45 +360,97 @@ class Graph {
   template <typename EdgeType>
   void SetDefaultValue(unsigned int node_index, unsigned int edge_index,
                        const EdgeType& value) {
-    assert(nodes_finalized_);
-    if (node_index >= nodes_.size()) {
-      CallLogFunc(
-          "%s: Attempting to assign a default value on node %d when graph only "
-          "has %d nodes.",
-          graph_name_.c_str(), node_index, static_cast<int>(nodes_.size()));
-      return;
-    }
-    Node& node = nodes_[node_index];
-    const NodeSignature* signature = node.signature();
-    if (edge_index >= node.input_edges().size()) {
-      CallLogFunc(
-          "%s: Attempting to assign a default value to node %i (%s:%s), edge "
-          "%d when node only has %d input edges.",
-          graph_name_.c_str(), node_index, signature->module_name()->c_str(),
-          signature->node_name().c_str(), edge_index,
-          static_cast<int>(node.input_edges().size()));
-      return;
-    }
-    const Type* type = TypeRegistry<EdgeType>::GetType();
-    const Type* expected_type = signature->input_parameters()[edge_index].type;
-    if (type != expected_type) {
-      CallLogFunc(
-          "%s: Attempting to assign a default value of the incorrect type to "
-          "node %d (%s:%s), edge %d. Edge got type \"%s\" when it expects type "
-          "\"%s\".",
-          graph_name_.c_str(), node_index, signature->module_name()->c_str(),
-          signature->node_name().c_str(), edge_index, type->name,
-          expected_type->name);
-      return;
+    EdgeType* default_object =
+        GetDefaultObject<EdgeType>(node_index, edge_index);
+    if (default_object) {
+      *default_object = value;
     }
-    InputEdge& input_edge = node.input_edges()[edge_index];
+  }
+
+  /// @brief Set the default input edge argument for a node, moving the value
+  ///        into place.
+  ///
+  /// This is the same as the overload above, but avoids copying values such
+  /// as strings that are built just to be passed in.
+  ///
+  /// @param[in] node_index The index of the node.
+  /// @param[in] edge_index The index of the edge on the node.
+  /// @param[in] value The value to move into the given input edge.
+  template <typename EdgeType>
+  void SetDefaultValue(unsigned int node_index, unsigned int edge_index,
+                       EdgeType&& value,
+                       typename std::enable_if<
+                           !std::is_reference<EdgeType>::value &&
+                           !std::is_const<EdgeType>::value>::type* = nullptr) {
     EdgeType* default_object =
-        input_buffer_.GetObject<EdgeType>(input_edge.data_offset());
-    *default_object = value;
+        GetDefaultObject<EdgeType>(node_index, edge_index);
+    if (default_object) {
+      *default_object = std::move(value);
+    }
+  }
+
+  /// @brief Replace the nodes of this Graph with those of another Graph, and
+  ///        migrate every GraphState of this Graph over to them.
+  ///
+  /// This lets a graph be edited while the game is running, without having to
+  /// recreate the objects using it. Nodes are matched up by the order in which
+  /// they were added. A node that has the same signature, the same input edges
+  /// and the same default values as the node in its position before, and that
+  /// has no newly connected outputs, keeps its output values, state and
+  /// listeners in every GraphState. Every other node is initialized again, and
+  /// the nodes that depend on it run the next time each GraphState is executed.
+  /// Default values whose type has no equality function (see
+  /// TypeRegistry::RegisterEqualityFunc) always count as changed. Constant
+  /// nodes that depend on a changed node count as changed too, since they are
+  /// only executed when they are initialized.
+  ///
+  /// No GraphState of this Graph may be used on another thread while this is
+  /// running. Pointers to the old nodes, such as those kept by a Profiler,
+  /// are no longer valid afterwards.
+  ///
+  /// @param[in,out] replacement A finalized Graph holding the new nodes. It is
+  ///                left holding the old nodes, and should then be destroyed.
+  void Reload(Graph* replacement);
+
+  /// @brief Returns the number of times Reload has been called on this Graph.
+  ///
+  /// @return The number of times this Graph has been reloaded.
+  unsigned int reload_count() const { return reload_count_; }
+
+  /// @brief Returns an estimate of the memory used by this Graph, in bytes.
+  ///
+  /// This counts the Graph itself, its node and edge arrays, and its default
+  /// values, including the heap memory of types that have registered a
+  /// memory usage function with TypeRegistry::RegisterMemoryUsageFunc. The
+  /// BaseNode objects are not counted.
+  ///
+  /// @return The number of bytes used by this Graph.
+  size_t memory_usage() const;
+
+  /// @brief Add the memory used by this Graph to a MemoryStats report.
+  ///
+  /// This counts everything memory_usage does, as well as the BaseNode
+  /// objects, and breaks it down by module, node and edge type. Memory that
+  /// belongs to no node in particular, such as the Graph object itself, only
+  /// appears in the totals. The GraphStates of this Graph are not counted.
+  ///
+  /// @param[in,out] stats The report to add to.
+  void GetMemoryStats(MemoryStats* stats) const;
+
+  /// @brief Returns the number of GraphStates that are using this Graph.
+  ///
+  /// @return The number of initialized GraphStates of this Graph.
+  size_t graph_state_count() const {
+    std::lock_guard<std::mutex> lock(graph_states_mutex_);
+    return graph_states_.size();
   }
 
   /// @brief Return the list of nodes on this Graph.
   ///
+  /// Nodes are listed in the order they were added until FinalizeNodes is
+  /// called, which rearranges them into the same order as sorted_nodes().
+  /// Use node_position to find where a node has moved to.
+  ///
   /// @return Return the list of nodes on this Graph.
   std::vector<Node>& nodes() { return nodes_; }
 
@@ -157,6 +459,22 @@ class Graph {
   /// @return Return the list of nodes on this Graph.
   const std::vector<Node>& nodes() const { return nodes_; }
 
+  /// @brief Return the position in nodes() of the node that was added with
+  ///        the given index.
+  ///
+  /// Only valid once the nodes have been finalized. Subgraph nodes are
+  /// replaced by their contents, so their position is kInvalidNodeIndex. The
+  /// nodes they were replaced by are numbered after the nodes that were
+  /// added, in the order of the subgraphs and then of their sorted nodes.
+  ///
+  /// @param[in] node_index The order in which the node was added to the graph.
+  ///
+  /// @return The position of that node in nodes() and sorted_nodes().
+  unsigned int node_position(unsigned int node_index) const {
+    assert(nodes_finalized_ && node_index < node_positions_.size());
+    return node_positions_[node_index];
+  }
+
   /// @brief Return the sorted list of nodes on this Graph.
   ///
   /// @note This function will be removed in future versions of this library.
@@ -171,6 +489,33 @@ class Graph {
   /// @return The sorted list of nodes in this Graph.
   const std::vector<Node*>& sorted_nodes() const { return sorted_nodes_; }
 
+  /// @brief Return the sorted nodes that need to be visited each time a
+  ///        GraphState of this Graph is executed.
+  ///
+  /// This is sorted_nodes() without the constant nodes, which are executed
+  /// once when a GraphState is initialized and never again, and without the
+  /// dead nodes, which are pure nodes whose outputs never reach a node that
+  /// is not pure.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @return The sorted nodes that need to be visited each execution.
+  const std::vector<Node*>& executed_nodes() const { return executed_nodes_; }
+
+  /// @brief Return the nodes of this Graph grouped into topological levels.
+  ///
+  /// Every node in a level depends only on nodes in earlier levels, so the
+  /// nodes within a single level may be executed in any order, or
+  /// concurrently. Within each level nodes appear in the same relative order
+  /// as in sorted_nodes(). Constant and dead nodes are left out.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @return The nodes of this Graph grouped into topological levels.
+  const std::vector<std::vector<Node*>>& execution_levels() const {
+    return execution_levels_;
+  }
+
   /// @brief Returns the memory buffer used to hold all default input buffers.
   ///
   /// @note This is for internal use only.
@@ -194,26 +539,292 @@ class Graph {
   ///         to be.
   size_t output_buffer_size() const { return output_buffer_size_; }
 
+  /// @brief Returns the alignment that the memory buffer holding output edge
+  ///        data will need to have.
+  ///
+  /// This is the largest alignment of any object held in the buffer.
+  ///
+  /// @return The alignment that the memory buffer holding output edge data
+  ///         will need to have.
+  size_t output_buffer_alignment() const { return output_buffer_alignment_; }
+
+  /// @brief Returns true if every object held in the output buffer of a
+  ///        GraphState of this Graph can be copied.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @return True if every object held in the output buffer can be copied.
+  bool output_buffer_copyable() const { return output_buffer_copyable_; }
+
+  /// @brief Returns true if every edge and node state object held in the
+  ///        output buffer of a GraphState of this Graph can be copied with
+  ///        memcpy.
+  ///
+  /// Event listeners are not included, since they always need to be rebuilt.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @return True if every edge and state object can be copied with memcpy.
+  bool output_buffer_trivially_copyable() const {
+    return output_buffer_copies_.empty();
+  }
+
+  /// @brief Returns the edge and node state objects in the output buffer that
+  ///        need their constructor to be run.
+  ///
+  /// Objects that are trivially default constructible are left out, since a
+  /// zeroed buffer already holds a valid instance of them.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @return The objects that need their constructor to be run.
+  const std::vector<OutputBufferObject>& output_buffer_constructions() const {
+    return output_buffer_constructions_;
+  }
+
+  /// @brief Returns the edge and node state objects in the output buffer that
+  ///        need their destructor to be run.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @return The objects that need their destructor to be run.
+  const std::vector<OutputBufferObject>& output_buffer_destructions() const {
+    return output_buffer_destructions_;
+  }
+
+  /// @brief Returns the edge and node state objects in the output buffer that
+  ///        can not be copied with memcpy.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @return The objects that can not be copied with memcpy.
+  const std::vector<OutputBufferObject>& output_buffer_copies() const {
+    return output_buffer_copies_;
+  }
+
  private:
+  // Returns the default value of the given input edge, or null after logging
+  // an error if there is no such edge or it has a different type.
+  template <typename EdgeType>
+  EdgeType* GetDefaultObject(unsigned int node_index,
+                             unsigned int edge_index) {
+    const InputEdge* input_edge = FindDefaultInputEdge(
+        node_index, edge_index, TypeRegistry<EdgeType>::GetType());
+    return input_edge
+               ? input_buffer_.GetObject<EdgeType>(input_edge->data_offset())
+               : nullptr;
+  }
+
+  // Returns the input edge whose default value is set by SetDefaultValue, or
+  // null after logging an error if there is no such edge or it does not have
+  // the given type.
+  const InputEdge* FindDefaultInputEdge(unsigned int node_index,
+                                        unsigned int edge_index,
+                                        const Type* type) const;
+
+  friend class GraphState;
+  friend bool CompileGraph(const Graph& graph, std::string* output);
+  friend bool LoadCompiledGraph(const ModuleRegistry* module_registry,
+                                const uint8_t* data, size_t size, Graph* graph);
+
   // Disallow copying.
   Graph(Graph&);
   Graph& operator=(Graph&);
   Graph(Graph&&);
   Graph& operator=(Graph&&);
 
+  // An edge of the subgraph node, identified by the position of the node in
+  // the subgraph's nodes_ and the index of the edge on that node.
+  struct SubgraphEdge {
+    SubgraphEdge(unsigned int node_position_, unsigned int edge_index_)
+        : node_position(node_position_), edge_index(edge_index_) {}
+
+    unsigned int node_position;
+    unsigned int edge_index;
+  };
+
+  // A subgraph node added by AddSubgraph.
+  struct Subgraph {
+    Subgraph(unsigned int node_index_,
+             const std::shared_ptr<const Graph>& graph_)
+        : node_index(node_index_),
+          graph(graph_),
+          inputs(graph_->subgraph_inputs_),
+          outputs(graph_->subgraph_outputs_),
+          first_node_index(0) {}
+
+    // The order in which the subgraph node was added.
+    unsigned int node_index;
+
+    // The Graph it stands in for. This is released once it has been inlined.
+    std::shared_ptr<const Graph> graph;
+
+    // The edges of the subgraph node.
+    std::vector<SubgraphEdge> inputs;
+    std::vector<SubgraphEdge> outputs;
+
+    // The index, in node_positions_, of the node that the first of the
+    // subgraph's sorted nodes was copied to.
+    unsigned int first_node_index;
+  };
+
+  // Replace the subgraph nodes with copies of the nodes of their subgraphs,
+  // and fill in node_positions_ with where each node has moved to.
+  bool InlineSubgraphs();
+
+  // Copy the default values of the inlined nodes from their subgraphs.
+  bool CopySubgraphDefaultValues();
+
+  // Find the edges and build the signature that describe this Graph when it
+  // is used as a subgraph. subgraph_signature_mutex_ must be held.
+  void BuildSubgraphSignature() const;
+
+  // Return the subgraph added as the given node, or null.
+  const Subgraph* FindSubgraph(unsigned int node_index) const;
+
+  // Given an input edge of a subgraph node, find the input edge of the inlined
+  // node that it stands for. Logs an error and returns false if there is none.
+  bool ResolveSubgraphInput(unsigned int* node_index,
+                            unsigned int* edge_index) const;
+
+  // The nodes whose dependencies are being inserted by InsertNode, each with
+  // the index of the next input edge to look at.
+  typedef std::vector<std::pair<Node*, size_t>> NodeStack;
+
   // Utility functions used to sort the graph nodes in FinalizeNodes.
   // Returns true on success, or false if there was an error sorting the graph
   // (such as a circular).
   bool SortGraphNodes();
-  bool InsertNode(Node* node);
+  bool InsertNode(Node* node, NodeStack* stack);
+
+  // Rearrange the sorted nodes so that independent nodes of the same
+  // signature are next to each other.
+  void GroupNodesBySignature();
+
+  // Move the nodes into sorted order, so that executing the graph walks
+  // through them front to back.
+  void ReorderNodes();
+
+  // Pack the output edges and listener offsets of every node into flat
+  // arrays, and point each node at its slice.
+  void BuildEdgeArrays();
+
+  // Find the pure nodes whose outputs never reach a side effect.
+  void FindDeadNodes();
+
+  // Find the nodes whose outputs never change, and list the nodes that are
+  // neither constant nor dead in executed_nodes_.
+  void FindConstantNodes();
+
+  // Group the sorted nodes into levels that can be executed independently.
+  void BuildExecutionLevels();
+
+  // Record which nodes consume each output edge.
+  void BuildConsumerLists();
+
+  // Resolve where every input edge reads its data from.
+  void BuildResolvedInputEdges();
+
+  // Give every node and connected output edge a dirty bit. Nodes take the
+  // bits matching their sorted index, and output edges the bits after those.
+  void AssignDirtyBits();
+
+  // Build the masks of the bits each node checks to see if it is dirty.
+  void BuildDirtyMasks();
+
+  // Run the constructors of the default values in the input buffer.
+  void ConstructDefaultValues();
+
+  // List the objects in the output buffer that need to be constructed,
+  // destroyed or copied individually.
+  void BuildOutputBufferObjects();
+
+  // Record how an object of the given type in the output buffer needs to be
+  // constructed, destroyed and copied.
+  void AddOutputBufferObject(const Type* type, ptrdiff_t offset);
+
+  // Run the passes that only depend on the node order and the edges: dead and
+  // constant nodes, execution levels, consumer lists, resolved edges and
+  // dirty bits.
+  void AnalyzeNodes();
+
+  // Construct the BaseNode of every node. Those whose signature can construct
+  // them in place share one buffer, with the nodes of each signature next to
+  // each other. The rest are constructed by their signature's constructor.
+  // Returns false if the Allocator is out of memory.
+  bool ConstructBaseNodes();
+
+  // Destroy the BaseNodes constructed by ConstructBaseNodes.
+  void DestroyBaseNodes();
+
+  // Keep track of the GraphStates initialized from this Graph, so that they
+  // can be migrated by Reload.
+  void AddGraphState(GraphState* graph_state);
+  void RemoveGraphState(GraphState* graph_state);
+
+  // For each of the replacement's sorted nodes, find the position of the node
+  // in this Graph that it is unchanged from, or kInvalidNodeIndex.
+  void MatchNodes(const Graph& replacement,
+                  std::vector<unsigned int>* matches) const;
+
+  // Exchange everything but the name and the GraphStates with another Graph.
+  void SwapNodes(Graph* other);
+
+  // Returns true if the GraphState was removed while Reload was running.
+  bool WasGraphStateRemoved(GraphState* graph_state) const;
 
   const std::string graph_name_;
   std::vector<Node> nodes_;
   std::vector<Node*> sorted_nodes_;
+  std::vector<Node*> executed_nodes_;
+  // Maps the order in which nodes were added to their position in nodes_.
+  std::vector<unsigned int> node_positions_;
+  std::vector<std::vector<Node*>> execution_levels_;
+  // These hold the edges of every node back to back, in sorted order. Each
+  // node refers to its own slice of them.
+  std::vector<ResolvedInputEdge> resolved_input_edges_;
+  std::vector<OutputEdge> output_edges_;
+  std::vector<ptrdiff_t> listener_offsets_;
+  std::vector<unsigned int> consumers_;
+  // The subgraph nodes that were added, in the order they were added.
+  std::vector<Subgraph> subgraphs_;
+  // The edges that make up the signature of this Graph as a subgraph. These
+  // are built on demand, guarded by subgraph_signature_mutex_.
+  mutable std::mutex subgraph_signature_mutex_;
+  mutable std::vector<SubgraphEdge> subgraph_inputs_;
+  mutable std::vector<SubgraphEdge> subgraph_outputs_;
+  mutable std::unique_ptr<NodeSignature> subgraph_signature_;
   MemoryBuffer input_buffer_;
+  MemoryBuffer base_node_buffer_;
   size_t output_buffer_size_;
+  size_t output_buffer_alignment_;
+  OutputBufferLayout output_buffer_layout_;
+  ExecutionOrder execution_order_;
+  DirtyTracking dirty_tracking_;
+  size_t dirty_bit_count_;
+  // The dirty masks of every node back to back, in sorted order.
+  std::vector<DirtyMask> dirty_masks_;
+  GeneratedExecuteFunc generated_execute_func_;
+  Allocator* allocator_;
+  bool output_buffer_copyable_;
+  std::vector<OutputBufferObject> output_buffer_constructions_;
+  std::vector<OutputBufferObject> output_buffer_destructions_;
+  std::vector<OutputBufferObject> output_buffer_copies_;
 
   bool nodes_finalized_;
+
+  // Guards graph_states_, since GraphStates may be created and destroyed on
+  // any thread.
+  mutable std::mutex graph_states_mutex_;
+  std::vector<GraphState*> graph_states_;
+
+  // While Reload runs, the GraphStates removed since it began, so that it can
+  // skip the ones that are destroyed by nodes it initializes. Also guarded by
+  // graph_states_mutex_.
+  bool reloading_;
+  std::vector<GraphState*> removed_graph_states_;
+
+  unsigned int reload_count_;
 };
 
 }  // namespace breadboard
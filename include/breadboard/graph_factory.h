@@ -15,11 +15,18 @@
 #ifndef BREADBOARD_GRAPH_FACTORY_H_
 #define BREADBOARD_GRAPH_FACTORY_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "breadboard/graph.h"
+#include "breadboard/job_system.h"
 #include "breadboard/module_registry.h"
 
 /// @file breadboard/graph_factory.h
@@ -32,6 +39,41 @@ namespace breadboard {
 /// supplied to actually load data.
 typedef bool (*LoadFileCallback)(const char* filename, std::string* output);
 
+/// @struct FileView
+///
+/// @brief A read-only view of the contents of a file, such as a memory-mapped
+///        file or an entry in an asset bundle, that is not owned by the
+///        GraphFactory.
+struct FileView {
+  FileView() : data(nullptr), size(0), release(nullptr), user_data(nullptr) {}
+
+  /// The contents of the file.
+  const uint8_t* data;
+
+  /// The size of the file, in bytes.
+  size_t size;
+
+  /// Called once the file has been parsed and the view is no longer needed,
+  /// for example to unmap the file. May be null.
+  void (*release)(FileView* view);
+
+  /// Any data the release function needs, such as a file handle.
+  void* user_data;
+};
+
+/// A callback that loads a file by filling in a FileView instead of copying
+/// its contents into a string.
+typedef bool (*LoadFileViewCallback)(const char* filename, FileView* view);
+
+/// A reference counted handle to a Graph in the cache of a GraphFactory. A
+/// graph is never evicted from the cache while there are handles to it.
+typedef std::shared_ptr<Graph> GraphHandle;
+
+/// A function written by GenerateGraphSource, which fills in a Graph without
+/// loading or parsing a file.
+typedef bool (*GeneratedGraphLoader)(const ModuleRegistry* module_registry,
+                                     Graph* graph);
+
 /// @class GraphFactory
 ///
 /// @brief The GraphFactory is a base class that can be used to load Graphs.
@@ -41,6 +83,39 @@ typedef bool (*LoadFileCallback)(const char* filename, std::string* output);
 /// the same file is requested multiple times, the cached graph is returned. To
 /// use this class ParseData must be overridden to translate the data into nodes
 /// and edges, and to parse default values.
+///
+/// Graphs may also be loaded in the background with LoadGraphAsync, so that
+/// loading a level does not stall the main thread:
+///
+/// ~~~{.cpp}
+///     breadboard::ThreadPool thread_pool(3);
+///     graph_factory.set_job_system(&thread_pool);
+///     std::vector<std::shared_future<breadboard::Graph*>> graphs;
+///     for (size_t i = 0; i < filenames.size(); ++i) {
+///       graphs.push_back(graph_factory.LoadGraphAsync(filenames[i].c_str()));
+///     }
+///     ...
+///     breadboard::Graph* graph = graphs[0].get();
+/// ~~~
+///
+/// In that case the load file callback and ParseData are run on the
+/// JobSystem's threads, possibly several at once, and must be thread safe.
+/// Looking up modules and node signatures in the ModuleRegistry is safe as
+/// long as no modules or nodes are registered while graphs are loading.
+///
+/// A GraphFactory constructed with a LoadFileViewCallback reads each file
+/// through a FileView instead, which lets files be parsed in place, straight
+/// out of a memory mapping, without first being copied onto the heap.
+///
+/// By default every graph that is loaded stays cached until the GraphFactory
+/// is destroyed. On platforms where memory is tight, a budget can be set with
+/// set_memory_budget. Once the cached graphs use more memory than that, the
+/// least recently used graphs that are not in use are evicted. A graph is in
+/// use while there is a GraphHandle to it or a GraphState initialized from it,
+/// so when a budget is set, graphs should be loaded with AcquireGraph and the
+/// handle held for as long as the graph is needed. Graphs that have been
+/// returned as a raw pointer by LoadGraph or LoadGraphAsync are never evicted
+/// to meet the budget, only by EvictUnusedGraphs.
 class GraphFactory {
  public:
   /// @brief Construct a graph factory using the given modules.
@@ -52,23 +127,216 @@ class GraphFactory {
   GraphFactory(ModuleRegistry* module_registry,
                LoadFileCallback load_file_callback)
       : module_registry_(module_registry),
-        load_file_callback_(load_file_callback) {}
+        load_file_callback_(load_file_callback),
+        load_file_view_callback_(nullptr),
+        job_system_(nullptr),
+        allocator_(DefaultAllocator()),
+        memory_budget_(0),
+        memory_usage_(0) {}
+
+  /// @brief Construct a graph factory that reads files through FileViews.
+  ///
+  /// @param[in] module_registry The ModuleRegistry that contains the set of
+  ///            available nodes for the graph.
+  /// @param[in] load_file_view_callback The function to use to map the file
+  ///            into memory.
+  GraphFactory(ModuleRegistry* module_registry,
+               LoadFileViewCallback load_file_view_callback)
+      : module_registry_(module_registry),
+        load_file_callback_(nullptr),
+        load_file_view_callback_(load_file_view_callback),
+        job_system_(nullptr),
+        allocator_(DefaultAllocator()),
+        memory_budget_(0),
+        memory_usage_(0) {}
 
   /// @brief Destructor for a GraphFactory.
-  virtual ~GraphFactory() {}
+  ///
+  /// Waits for any graphs that are still being loaded asynchronously.
+  /// Subclasses whose ParseData depends on their own members should call
+  /// WaitForPendingGraphs from their destructor, before those members are
+  /// destroyed.
+  virtual ~GraphFactory();
 
   /// @brief Load a graph given its filename.
   ///
   /// If this file has already been loaded, a cached copy of the graph is
-  /// returned.
+  /// returned. If it is currently being loaded asynchronously, this waits for
+  /// that load to finish instead of loading it a second time.
   ///
   /// @param[in] filename The name of the file to load.
   ///
-  /// @return The loaded Graph.
+  /// @return The loaded Graph, or null if it could not be loaded.
   Graph* LoadGraph(const char* filename);
 
+  /// @brief Load a graph given its filename, and return a handle to it.
+  ///
+  /// This is the same as LoadGraph, except that the graph can not be evicted
+  /// from the cache while the handle, or any copy of it, is alive.
+  ///
+  /// @param[in] filename The name of the file to load.
+  ///
+  /// @return A handle to the loaded Graph, or null if it could not be loaded.
+  GraphHandle AcquireGraph(const char* filename);
+
+  /// @brief Start loading a graph in the background.
+  ///
+  /// The file is loaded and parsed on the JobSystem set with set_job_system,
+  /// or on the calling thread if there is none. Any number of requests for
+  /// the same file, whether made through LoadGraph or LoadGraphAsync, share a
+  /// single load. If the file has already been loaded, the returned future is
+  /// ready immediately.
+  ///
+  /// @param[in] filename The name of the file to load.
+  ///
+  /// @return A future holding the loaded Graph, or null if it could not be
+  ///         loaded.
+  std::shared_future<Graph*> LoadGraphAsync(const char* filename);
+
+  /// @brief Load a graph again from its file, and update the cached Graph and
+  ///        every GraphState that uses it in place.
+  ///
+  /// This is meant for tuning graphs while the game is running. The file is
+  /// parsed into a new Graph, which is then compared against the cached one
+  /// node by node; see Graph::Reload for which values are kept. Pointers to
+  /// the cached Graph remain valid. If the file has not been loaded before,
+  /// it is simply loaded.
+  ///
+  /// No GraphState of the graph may be used on another thread while it is
+  /// being reloaded.
+  ///
+  /// @param[in] filename The name of the file to reload.
+  ///
+  /// @return Returns true if successful. If the file could not be loaded or
+  ///         parsed, an error is logged, the cached Graph is left as it was and
+  ///         false is returned.
+  bool ReloadGraph(const char* filename);
+
+  /// @brief Register a function written by GenerateGraphSource to be used in
+  ///        place of loading the given file.
+  ///
+  /// Graphs loaded this way are executed by the generated code. ReloadGraph
+  /// still reads the file, so that graphs can be tuned while the game is
+  /// running; the reloaded graph is then executed as usual.
+  ///
+  /// @param[in] filename The name of the file the source was generated from.
+  /// @param[in] loader The generated function that fills in the graph.
+  void RegisterGeneratedGraph(const char* filename,
+                              GeneratedGraphLoader loader);
+
+  /// @brief Add a node to a graph that is being parsed, which stands in for
+  ///        the graph in another file.
+  ///
+  /// This is meant to be called from ParseData, for file formats that let one
+  /// graph use another. The other file is loaded through this GraphFactory,
+  /// and is only parsed and validated once however many graphs use it. See
+  /// Graph::AddSubgraph for how the node is set up and inlined.
+  ///
+  /// @param[in] graph The graph that is being parsed.
+  /// @param[in] filename The name of the file holding the subgraph.
+  ///
+  /// @return The node that was added, or null if the subgraph could not be
+  ///         loaded, or uses the graph being parsed. An error is logged in
+  ///         that case.
+  Node* AddSubgraph(Graph* graph, const char* filename);
+
+  /// @brief Block until every graph that is being loaded asynchronously has
+  ///        finished loading.
+  void WaitForPendingGraphs();
+
+  /// @brief Set the JobSystem that LoadGraphAsync loads graphs on.
+  ///
+  /// The JobSystem must outlive every load started on it.
+  ///
+  /// @param[in] job_system The JobSystem to use, or null to load graphs on
+  ///            the calling thread.
+  void set_job_system(JobSystem* job_system) { job_system_ = job_system; }
+
+  /// @brief Set the Allocator that the buffers of the graphs loaded from now
+  ///        on are taken from.
+  ///
+  /// Graphs keep the Allocator they were loaded with, including when they are
+  /// reloaded. The Allocator must outlive every graph loaded with it, so
+  /// evict them before destroying it.
+  ///
+  /// @param[in] allocator The Allocator to use.
+  void set_allocator(Allocator* allocator) { allocator_ = allocator; }
+
+  /// @brief Returns the Allocator that the buffers of newly loaded graphs are
+  ///        taken from.
+  ///
+  /// @return The Allocator used for newly loaded graphs.
+  Allocator* allocator() const { return allocator_; }
+
+  /// @brief Returns the JobSystem that LoadGraphAsync loads graphs on.
+  ///
+  /// @return The JobSystem that LoadGraphAsync loads graphs on, or null.
+  JobSystem* job_system() const { return job_system_; }
+
+  /// @brief Set how much memory the cached graphs may use before unused
+  ///        graphs are evicted.
+  ///
+  /// The budget is checked each time a graph is loaded, and the least
+  /// recently used graphs that have neither a GraphHandle nor a GraphState
+  /// are evicted until the cache fits. Graphs that are still in use, or that
+  /// LoadGraph or LoadGraphAsync have returned, are never evicted, so the
+  /// cache may stay over budget. Memory is measured with Graph::memory_usage.
+  ///
+  /// @param[in] memory_budget The budget in bytes, or 0 for no limit, which is
+  ///            the default.
+  void set_memory_budget(size_t memory_budget);
+
+  /// @brief Returns the memory budget of the cached graphs.
+  ///
+  /// @return The budget in bytes, or 0 if there is no limit.
+  size_t memory_budget() const;
+
+  /// @brief Returns the memory used by the cached graphs.
+  ///
+  /// @return The total Graph::memory_usage of the cached graphs, in bytes.
+  size_t memory_usage() const;
+
+  /// @brief Add the memory used by this GraphFactory and its cached graphs to
+  ///        a MemoryStats report.
+  ///
+  /// Each cached graph is counted as by Graph::GetMemoryStats. The
+  /// GraphStates of the graphs are not counted.
+  ///
+  /// @param[in,out] stats The report to add to.
+  void GetMemoryStats(MemoryStats* stats) const;
+
+  /// @brief Evict every cached graph that is not in use, regardless of the
+  ///        memory budget.
+  ///
+  /// This is useful when loading a new level, once the graphs of the old one
+  /// are no longer needed. Graphs returned by LoadGraph or LoadGraphAsync are
+  /// evicted too, so any pointers to them must no longer be used.
+  void EvictUnusedGraphs();
+
  private:
-  typedef std::unordered_map<std::string, std::unique_ptr<Graph>> GraphMap;
+  // A loaded graph, and its place in the order in which graphs were used.
+  struct CachedGraph {
+    GraphHandle graph;
+    size_t memory_usage;
+    std::list<std::string>::iterator lru_position;
+  };
+
+  typedef std::unordered_map<std::string, CachedGraph> GraphMap;
+  typedef std::unordered_map<std::string, std::shared_future<Graph*>>
+      PendingGraphMap;
+  typedef std::unordered_map<std::string, GeneratedGraphLoader>
+      GeneratedGraphMap;
+
+  // Return the graph if it has been loaded, or the load in progress if there
+  // is one. Otherwise start a new load, on the given job system if not null.
+  // If pin is true, the graph is only evicted by EvictUnusedGraphs.
+  std::shared_future<Graph*> RequestGraph(const std::string& filename,
+                                          JobSystem* job_system, bool pin);
+  // Load and parse the file, add it to the cache and fulfill the promise that
+  // other requests for the same file are waiting on. Returns a handle to the
+  // graph, which keeps it from being evicted, or null if it failed to load.
+  GraphHandle LoadPendingGraph(const std::string& filename,
+                               std::promise<Graph*>* promise);
 
   /// Parse the data loaded from a file. The data is passed to this function as a
   /// std::string. This function is responsible for filling in the graph (both
@@ -77,9 +345,50 @@ class GraphFactory {
   virtual bool ParseData(ModuleRegistry* module_registry, Graph* graph,
                          const std::string* data) = 0;
 
+  /// Parse the data of a file loaded through a LoadFileViewCallback. The data
+  /// is only valid for the duration of the call. The default implementation
+  /// copies the data into a std::string and passes it to ParseData; override
+  /// this to parse the data in place.
+  virtual bool ParseDataView(ModuleRegistry* module_registry, Graph* graph,
+                             const uint8_t* data, size_t size);
+
+  // Load the file and parse it, keeping track of which files are being parsed
+  // on this thread for AddSubgraph. If use_generated is true and a generated
+  // loader was registered for the file, it is used instead.
+  bool LoadAndParse(const std::string& filename, Graph* graph,
+                    bool use_generated);
+
+  // Load the file through whichever callback was supplied and parse it.
+  bool LoadAndParseFile(const std::string& filename, Graph* graph);
+
+  // Mark the graph as the most recently used one. mutex_ must be held.
+  void TouchGraph(CachedGraph* cached_graph);
+
+  // Evict the least recently used graphs that are not in use until the cache
+  // uses no more than the given number of bytes. The graph named keep is
+  // never evicted, and pinned graphs only if evict_pinned is true. mutex_
+  // must be held.
+  void EvictGraphs(size_t memory_limit, const std::string& keep,
+                   bool evict_pinned);
+
   ModuleRegistry* module_registry_;
   LoadFileCallback load_file_callback_;
+  LoadFileViewCallback load_file_view_callback_;
+  JobSystem* job_system_;
+  Allocator* allocator_;
+
+  // Guards everything below.
+  mutable std::mutex mutex_;
   GraphMap loaded_graphs_;
+  PendingGraphMap pending_graphs_;
+  GeneratedGraphMap generated_graphs_;
+  // The filenames of the loaded graphs, most recently used first.
+  std::list<std::string> lru_list_;
+  // The filenames of the graphs, loaded or pending, that have been handed out
+  // as raw pointers, which budget eviction would leave dangling.
+  std::unordered_set<std::string> pinned_graphs_;
+  size_t memory_budget_;
+  size_t memory_usage_;
 };
 
 }  // namespace breadboard
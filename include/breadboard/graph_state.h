@@ -15,13 +15,24 @@
 #ifndef BREADBOARD_GRAPH_STATE_H_
 #define BREADBOARD_GRAPH_STATE_H_
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <limits>
 #include <memory>
 #include <vector>
 
+#include "breadboard/default_value_overlay.h"
+#include "breadboard/dirty_bitset.h"
+#include "breadboard/dirty_node_queue.h"
 #include "breadboard/graph.h"
+#include "breadboard/job_system.h"
 #include "breadboard/memory_buffer.h"
+#include "breadboard/memory_buffer_pool.h"
+#include "breadboard/memory_stats.h"
 #include "breadboard/node.h"
+#include "breadboard/profiler.h"
 
 /// @file breadboard/graph_state.h
 ///
@@ -30,6 +41,111 @@
 
 namespace breadboard {
 
+class EventDispatcher;
+class GraphStateScheduler;
+class GraphWorld;
+class NodeArguments;
+class TimerWheel;
+
+/// @brief How a GraphState finds the nodes that need to be executed.
+enum ExecutionMode {
+  /// @brief Every node is checked for dirty inputs each time the GraphState is
+  /// executed. This is the default.
+  kExecutionModePolling,
+
+  /// @brief Nodes are queued up as their inputs change, and only the queued
+  /// nodes are visited when the GraphState is executed.
+  kExecutionModeWorklist,
+
+  /// @brief Nodes are only evaluated when a value that depends on them is
+  /// asked for with GraphState::Query.
+  kExecutionModePull,
+};
+
+/// @class ExecutionBudget
+///
+/// @brief Limits how much work GraphState::Execute does before returning.
+///
+/// A budget can limit the number of nodes executed, the time spent, or both.
+/// It is checked after each node is executed, so at least one node always
+/// runs, and a slow node can overrun the deadline by its own running time.
+/// The same budget can be passed to several GraphStates in turn, to share
+/// it between them.
+class ExecutionBudget {
+ public:
+  /// @brief The clock deadlines are measured with.
+  typedef std::chrono::steady_clock Clock;
+
+  /// @brief Construct a budget with no limits.
+  ExecutionBudget()
+      : max_nodes_(std::numeric_limits<size_t>::max()),
+        deadline_(Clock::time_point::max()),
+        nodes_executed_(0) {}
+
+  /// @brief Set the number of nodes that may be executed.
+  ///
+  /// @param[in] max_nodes The number of nodes that may be executed.
+  void set_max_nodes(size_t max_nodes) { max_nodes_ = max_nodes; }
+
+  /// @brief Returns the number of nodes that may be executed.
+  ///
+  /// @return The number of nodes that may be executed.
+  size_t max_nodes() const { return max_nodes_; }
+
+  /// @brief Set the time after which no more nodes may be executed.
+  ///
+  /// @param[in] deadline The time after which no more nodes may be executed.
+  void set_deadline(Clock::time_point deadline) { deadline_ = deadline; }
+
+  /// @brief Returns the time after which no more nodes may be executed.
+  ///
+  /// @return The time after which no more nodes may be executed.
+  Clock::time_point deadline() const { return deadline_; }
+
+  /// @brief Set the deadline to the given amount of time from now.
+  ///
+  /// @param[in] time_limit How long nodes may be executed for.
+  void set_time_limit(Clock::duration time_limit) {
+    deadline_ = Clock::now() + time_limit;
+  }
+
+  /// @brief Returns the number of nodes executed against this budget so far.
+  ///
+  /// @return The number of nodes executed against this budget so far.
+  size_t nodes_executed() const { return nodes_executed_; }
+
+  /// @brief Returns true once no more nodes may be executed.
+  ///
+  /// @return Whether the budget has been used up.
+  bool exhausted() const {
+    if (nodes_executed_ >= max_nodes_) {
+      return true;
+    }
+    // Only read the clock when there is a deadline to compare it with.
+    return deadline_ != Clock::time_point::max() && Clock::now() >= deadline_;
+  }
+
+  /// @brief Returns true if the budget places no limit on the execution.
+  ///
+  /// @return Whether neither the number of nodes nor the time is limited.
+  bool unlimited() const {
+    return max_nodes_ == std::numeric_limits<size_t>::max() &&
+           deadline_ == Clock::time_point::max();
+  }
+
+  /// @cond BREADBOARD_INTERNAL
+  /// @brief Count the given number of executed nodes against the budget.
+  ///
+  /// @param[in] count The number of nodes that were executed.
+  void RecordExecutions(size_t count) { nodes_executed_ += count; }
+  /// @endcond
+
+ private:
+  size_t max_nodes_;
+  Clock::time_point deadline_;
+  size_t nodes_executed_;
+};
+
 /// @class GraphState
 ///
 /// @brief A GraphState represents an instance of a Graph, and can be connected
@@ -40,7 +156,29 @@ namespace breadboard {
 class GraphState {
  public:
   /// @brief The default constructor for an empty GraphState object.
-  GraphState() : graph_(nullptr), output_buffer_(), timestamp_(0) {}
+  GraphState()
+      : graph_(nullptr),
+        output_buffer_(),
+        timestamp_(0),
+        dirty_bits_(),
+        next_dirty_bits_(),
+        execution_mode_(kExecutionModePolling),
+        lazy_initialization_(false),
+        deferred_initialization_count_(0),
+        memory_buffer_pool_(nullptr),
+        allocator_(nullptr),
+        default_value_overlay_(nullptr),
+        job_system_(nullptr),
+        profiler_(nullptr),
+        pending_event_dispatcher_(nullptr),
+        graph_state_index_(0),
+        execution_pending_(false),
+        execution_position_(0),
+        executing_(false),
+        deferred_nodes_(),
+        scheduler_(nullptr),
+        world_(nullptr),
+        timer_wheel_(nullptr) {}
 
   /// @brief Destructor for a BaseNode.
   ~GraphState();
@@ -52,13 +190,289 @@ class GraphState {
   /// dependency on other nodes will always run after their dependencies.
   ///
   /// @param[in] graph The Graph that defines this GraphState's nodes and edges.
-  void Initialize(Graph* graph);
+  ///
+  /// @return Returns true if successful. If there is not enough memory for
+  ///         the GraphState, an error is logged and false is returned.
+  bool Initialize(Graph* graph);
+
+  /// @brief Initialize the GraphState as a copy of another GraphState.
+  ///
+  /// This is a much cheaper way to create many instances of the same graph
+  /// than calling Initialize on each one. Initialize one GraphState as a
+  /// prototype, and then stamp out copies of it:
+  ///
+  /// ~~~{.cpp}
+  ///     prototype.Initialize(&projectile_graph);
+  ///     ...
+  ///     GraphState* projectile = new GraphState();
+  ///     projectile->InitializeFromPrototype(prototype);
+  /// ~~~
+  ///
+  /// The values of the prototype's output edges and node states are copied
+  /// with a single memcpy, and only the objects whose types are not trivially
+  /// copyable are then copied individually.
+  /// The nodes' Initialize functions are not run. Instead, each listener is
+  /// bound to the same broadcaster as the matching listener on the prototype.
+  ///
+  /// @param[in] prototype An initialized GraphState to copy.
+  ///
+  /// @return Returns true if successful. If the graph holds a type that can
+  ///         not be copied, or there is not enough memory for the GraphState,
+  ///         an error is logged and false is returned.
+  bool InitializeFromPrototype(const GraphState& prototype);
 
   /// @brief Check if this GraphState has been initialized.
   ///
   /// @return Whether or not the Graph has been initialized.
   bool IsInitialized() const { return graph_ != nullptr; }
 
+  /// @brief Set how this GraphState finds the nodes that need to be executed.
+  ///
+  /// In kExecutionModePolling every node in the graph has its inputs checked
+  /// each time the GraphState is executed, which costs time proportional to
+  /// the size of the graph even if very little has changed. In
+  /// kExecutionModeWorklist, setting an output or receiving an event queues up
+  /// the affected nodes, and executing only visits those nodes. This is a good
+  /// fit for large graphs that are mostly idle, such as event driven scripts.
+  ///
+  /// In kExecutionModePull, nothing runs until the host asks for a value with
+  /// Query, which evaluates only the nodes that value depends on. Each node
+  /// remembers the timestamp it was last evaluated at, so nodes whose inputs
+  /// have not changed since are skipped. This suits graphs that compute
+  /// values which are only read now and then, such as AI scoring functions.
+  /// Execute still works in this mode, and evaluates every executed node that
+  /// has changed since it last ran.
+  ///
+  /// Worklist and pull execution always run on the calling thread; the
+  /// JobSystem is ignored in these modes. Pull execution tracks changes with
+  /// timestamps, and ignores the Graph's DirtyTracking.
+  ///
+  /// This must be called before Initialize.
+  ///
+  /// @param[in] execution_mode The ExecutionMode to use.
+  void set_execution_mode(ExecutionMode execution_mode) {
+    assert(!IsInitialized());
+    execution_mode_ = execution_mode;
+  }
+
+  /// @brief Returns how this GraphState finds the nodes to be executed.
+  ///
+  /// @return How this GraphState finds the nodes to be executed.
+  ExecutionMode execution_mode() const { return execution_mode_; }
+
+  /// @brief Set whether nodes that allow it are initialized when they are
+  ///        first executed, rather than by Initialize.
+  ///
+  /// Creating many GraphStates at once, such as when a level is loaded, runs
+  /// BaseNode::Initialize on every node of every one of them, even on the
+  /// branches that never run. With lazy initialization turned on, Initialize
+  /// skips the nodes whose NodeSignature is initialize_deferrable, and each
+  /// of them is initialized just before it is first executed. Nodes that
+  /// never run are never initialized, unless InitializeDeferredNodes is used
+  /// to work through them a few at a time in the frames after loading.
+  ///
+  /// Constant nodes are always initialized up front. A GraphState initialized
+  /// from a prototype leaves the same nodes uninitialized as the prototype.
+  ///
+  /// This must be called before Initialize.
+  ///
+  /// @param[in] lazy_initialization Whether to defer the initialization of
+  ///            the nodes that allow it.
+  void set_lazy_initialization(bool lazy_initialization) {
+    assert(!IsInitialized());
+    lazy_initialization_ = lazy_initialization;
+  }
+
+  /// @brief Returns whether nodes that allow it are initialized when they are
+  ///        first executed.
+  ///
+  /// @return Whether lazy initialization is turned on.
+  bool lazy_initialization() const { return lazy_initialization_; }
+
+  /// @brief Initialize the nodes whose initialization has been deferred,
+  ///        until the given budget is used up.
+  ///
+  /// Nodes are initialized in the same order as by Initialize. Outputs they
+  /// set are dirty the next time this GraphState is executed. This runs on
+  /// the calling thread, and can be called between executions to spread the
+  /// cost of initializing a GraphState over several frames:
+  ///
+  /// ~~~{.cpp}
+  ///     breadboard::ExecutionBudget warm_up_budget;
+  ///     warm_up_budget.set_time_limit(std::chrono::microseconds(500));
+  ///     graph_state.InitializeDeferredNodes(&warm_up_budget);
+  /// ~~~
+  ///
+  /// @param[in,out] budget The budget to count initialized nodes against.
+  ///
+  /// @return True if no nodes are left waiting to be initialized.
+  bool InitializeDeferredNodes(ExecutionBudget* budget);
+
+  /// @brief Returns the number of nodes waiting to be initialized.
+  ///
+  /// @return The number of nodes whose initialization has been deferred and
+  ///         has not happened yet.
+  size_t deferred_initialization_count() const {
+    return deferred_initialization_count_;
+  }
+
+  /// @brief Set the pool this GraphState takes the memory for its output
+  ///        buffer from.
+  ///
+  /// By default a GraphState allocates its output buffer on the heap. When
+  /// many instances of the same Graph are created, drawing their buffers from
+  /// a shared MemoryBufferPool keeps them next to each other in memory and
+  /// avoids a heap allocation per instance. The pool's blocks must be at least
+  /// Graph::output_buffer_size() bytes and aligned to at least
+  /// Graph::output_buffer_alignment(), and the pool must outlive this
+  /// GraphState.
+  ///
+  /// This must be called before Initialize.
+  ///
+  /// @param[in] memory_buffer_pool The pool to use, or null to use the heap.
+  void set_memory_buffer_pool(MemoryBufferPool* memory_buffer_pool) {
+    assert(!IsInitialized());
+    memory_buffer_pool_ = memory_buffer_pool;
+  }
+
+  /// @brief Returns the pool this GraphState takes its output buffer from.
+  ///
+  /// @return The pool this GraphState takes its output buffer from, or null
+  ///         if it is allocated on the heap.
+  MemoryBufferPool* memory_buffer_pool() const { return memory_buffer_pool_; }
+
+  /// @brief Set the Allocator this GraphState takes the memory for its output
+  ///        buffer from, when it is not drawn from a MemoryBufferPool.
+  ///
+  /// By default the output buffer comes from the Allocator of the Graph. The
+  /// Allocator must outlive this GraphState.
+  ///
+  /// This must be called before Initialize.
+  ///
+  /// @param[in] allocator The Allocator to use, or null to use the Graph's.
+  void set_allocator(Allocator* allocator) {
+    assert(!IsInitialized());
+    allocator_ = allocator;
+  }
+
+  /// @brief Returns the Allocator set with set_allocator.
+  ///
+  /// @return The Allocator this GraphState takes its output buffer from, or
+  ///         null if it uses the Graph's.
+  Allocator* allocator() const { return allocator_; }
+
+  /// @brief Set the values that replace some of the Graph's default input
+  ///        values in this GraphState.
+  ///
+  /// The overlay is looked up in the Graph when this GraphState is
+  /// initialized, so the nodes see the overridden values from their
+  /// Initialize functions onwards, and constant nodes are computed from them.
+  /// Only the overridden values are stored, in the overlay, which may be
+  /// shared by every GraphState of the same variant. A GraphState initialized
+  /// from a prototype always uses the prototype's overlay. The overlay must
+  /// outlive this GraphState.
+  ///
+  /// This must be called before Initialize.
+  ///
+  /// @param[in] default_value_overlay The overlay to use, or null for none.
+  void set_default_value_overlay(
+      const DefaultValueOverlay* default_value_overlay) {
+    assert(!IsInitialized());
+    default_value_overlay_ = default_value_overlay;
+  }
+
+  /// @brief Returns the values that replace some of the Graph's default
+  ///        input values in this GraphState.
+  ///
+  /// @return The DefaultValueOverlay of this GraphState, or null.
+  const DefaultValueOverlay* default_value_overlay() const {
+    return default_value_overlay_;
+  }
+
+  /// @brief Set the JobSystem used to execute this GraphState in parallel.
+  ///
+  /// By default a GraphState executes its nodes one at a time on the calling
+  /// thread. When a JobSystem is set, Execute instead walks the graph one
+  /// topological level at a time (see Graph::execution_levels) and runs the
+  /// dirty nodes of each level through JobSystem::ParallelFor, waiting for the
+  /// whole level to finish before moving on to the next one. Nodes whose
+  /// NodeSignature is not thread safe are still run on the calling thread.
+  ///
+  /// Since nodes on the same level may run concurrently, nodes executed this
+  /// way must not modify state shared with other nodes without their own
+  /// synchronization.
+  ///
+  /// This must not be called while a pass started by Execute(ExecutionBudget*)
+  /// is still in progress.
+  ///
+  /// @param[in] job_system The JobSystem to use, or null to execute serially.
+  void set_job_system(JobSystem* job_system) {
+    assert(!execution_pending_);
+    job_system_ = job_system;
+  }
+
+  /// @brief Returns the JobSystem used to execute this GraphState, if any.
+  ///
+  /// @return The JobSystem used to execute this GraphState, or null if it is
+  ///         executed serially.
+  JobSystem* job_system() const { return job_system_; }
+
+  /// @brief Set the Profiler this GraphState reports node executions to.
+  ///
+  /// Every node this GraphState executes is timed and reported to the
+  /// Profiler, as is every node it visits but skips because none of its inputs
+  /// are dirty. This has no effect unless the library was built with
+  /// `BREADBOARD_PROFILING` defined; see Profiler::IsEnabled. The Profiler
+  /// must outlive this GraphState, or be unset first.
+  ///
+  /// @param[in] profiler The Profiler to report to, or null to stop profiling.
+  void set_profiler(Profiler* profiler) { profiler_ = profiler; }
+
+  /// @brief Returns the Profiler this GraphState reports to, if any.
+  ///
+  /// @return The Profiler this GraphState reports to, or null.
+  Profiler* profiler() const { return profiler_; }
+
+  /// @brief Set the TimerWheel that the nodes of this GraphState set their
+  ///        timers in.
+  ///
+  /// Nodes such as those of the timer module need a TimerWheel to wait on;
+  /// see NodeArguments::SetTimer. The same wheel is usually shared by every
+  /// GraphState. A GraphState initialized from a prototype that has no wheel
+  /// of its own takes the prototype's. The wheel must outlive this GraphState,
+  /// or be unset first.
+  ///
+  /// @param[in] timer_wheel The TimerWheel to use, or null for none.
+  void set_timer_wheel(TimerWheel* timer_wheel) { timer_wheel_ = timer_wheel; }
+
+  /// @brief Returns the TimerWheel the nodes of this GraphState set their
+  ///        timers in, if any.
+  ///
+  /// @return The TimerWheel of this GraphState, or null.
+  TimerWheel* timer_wheel() const { return timer_wheel_; }
+
+  /// @brief Bind every listener in this GraphState that listens for the given
+  ///        event to a broadcaster.
+  ///
+  /// Nodes normally bind their own listeners. This lets whatever set up a
+  /// GraphState route an event to it instead, such as a node that runs
+  /// another graph and needs to notify the nodes inside it.
+  ///
+  /// @param[in] event_id The event whose listeners should be bound.
+  ///
+  /// @param[in] broadcaster The broadcaster to bind them to.
+  void BindListeners(EventId event_id, NodeEventBroadcaster* broadcaster);
+
+  /// @brief Add the memory used by this GraphState to a MemoryStats report.
+  ///
+  /// This counts the GraphState itself, its output buffer and the heap memory
+  /// owned by its output edge values, and breaks down the output buffer by
+  /// module, node and edge type. The Graph is not counted, since it is shared
+  /// by every GraphState created from it.
+  ///
+  /// @param[in,out] stats The report to add to.
+  void GetMemoryStats(MemoryStats* stats) const;
+
   /// @cond BREADBOARD_INTERNAL
 
   /// @brief Execute all Nodes that are considered 'dirty'.
@@ -71,8 +485,107 @@ class GraphState {
   /// The order the nodes run Execute is not specified except that nodes that
   /// have a dependency on other nodes will always run after their dependencies.
   ///
+  /// If a pass started by Execute(ExecutionBudget*) is still in progress, it
+  /// is finished first.
+  ///
   /// @note This is for internal use only.
   void Execute();
+  /// @endcond
+
+  /// @brief Execute the dirty nodes until the given budget is used up.
+  ///
+  /// Nodes are executed in the same order as by Execute. If the budget runs
+  /// out before every dirty node has been executed, the pass is suspended,
+  /// and the next call picks up from the same position. The GraphState's
+  /// timestamp only advances once a pass is complete, so the nodes executed
+  /// later in the pass still see what changed earlier on. Outputs set by the
+  /// part of a pass that has run are visible right away.
+  ///
+  /// Events that arrive while a pass is suspended are held for the next pass,
+  /// just as events that arrive after a pass has finished are.
+  ///
+  /// @param[in,out] budget The budget to count executed nodes against.
+  ///
+  /// @return True if the pass was completed, or false if it was suspended.
+  bool Execute(ExecutionBudget* budget);
+
+  /// @brief Bring the value of a node's input up to date, and return it.
+  ///
+  /// If the input is connected, the node that feeds it is evaluated, along
+  /// with every node it depends on, skipping those that have not changed
+  /// since they last ran. The node the input belongs to is not executed.
+  /// Inputs that are not connected return their default value.
+  ///
+  /// ~~~{.cpp}
+  ///     graph_state.set_execution_mode(breadboard::kExecutionModePull);
+  ///     graph_state.Initialize(&scoring_graph);
+  ///     ...
+  ///     const float* score = graph_state.Query<float>(kResultNode, 0);
+  /// ~~~
+  ///
+  /// The GraphState must be in kExecutionModePull, and must not have a pass
+  /// suspended.
+  ///
+  /// @param[in] node_index The order in which the node was added to the
+  ///            Graph.
+  ///
+  /// @param[in] edge_index The index of the input edge on the node.
+  ///
+  /// @return The value of the input, or null if the edge does not exist or
+  ///         has a different type, in which case an error is logged.
+  template <typename EdgeType>
+  const EdgeType* Query(unsigned int node_index, unsigned int edge_index) {
+    return reinterpret_cast<const EdgeType*>(QueryInput(
+        node_index, edge_index, TypeRegistry<EdgeType>::GetType()));
+  }
+
+  /// @brief Returns true if a pass started by Execute(ExecutionBudget*) has
+  /// been suspended and not yet completed.
+  ///
+  /// @return Whether a pass is waiting to be resumed.
+  bool execution_pending() const { return execution_pending_; }
+
+  /// @cond BREADBOARD_INTERNAL
+
+  /// @brief Queue up the node at the given position in Graph::sorted_nodes()
+  ///        to be run the next time this GraphState is executed.
+  ///
+  /// This does nothing unless the execution mode is kExecutionModeWorklist,
+  /// or the Graph uses kDirtyTrackingBitset.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @param[in] sorted_index The node's position in Graph::sorted_nodes().
+  void MarkNodeDirty(unsigned int sorted_index) {
+    if (execution_mode_ == kExecutionModeWorklist) {
+      if (defers_events()) {
+        deferred_nodes_.push_back(sorted_index);
+      } else {
+        dirty_node_queue_.Push(sorted_index);
+      }
+    }
+    if (!dirty_bits_.empty()) {
+      // A node's own dirty bit matches its sorted index.
+      if (defers_events()) {
+        next_dirty_bits_.Set(sorted_index);
+      } else {
+        dirty_bits_.Set(sorted_index);
+      }
+    }
+  }
+
+  /// @brief Return the timestamp to give events that arrive now.
+  ///
+  /// This is the current timestamp, unless a pass is suspended, in which case
+  /// the events belong to the next pass. Events raised by the nodes of a pass
+  /// while it is running always belong to that pass.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @return The timestamp to give events that arrive now.
+  Timestamp event_timestamp() const {
+    return defers_events() ? timestamp_ + 1 : timestamp_;
+  }
 
   /// @brief Return the current timestamp.
   ///
@@ -98,19 +611,238 @@ class GraphState {
   /// @endcond
 
  private:
+  friend class BatchExecutor;
+  friend class EventDispatcher;
+  friend class GeneratedGraphContext;
+  friend class Graph;
+  friend class GraphStateHistory;
+  friend class GraphStateScheduler;
+  friend class GraphWorld;
+
   // Disallow copying.
   GraphState(GraphState&);
   GraphState& operator=(GraphState&);
   GraphState(GraphState&&);
   GraphState& operator=(GraphState&&);
 
+  // Allocate an output buffer for the given graph. Returns false and logs an
+  // error if there is not enough memory.
+  bool InitializeOutputBuffer(const Graph& graph);
+
+  // Destroy the edge values, node states and listeners in an output buffer
+  // laid out for graph_.
+  void DestroyOutputBufferObjects(MemoryBuffer* buffer);
+
+  // Replace the output buffer with one laid out for the replacement's nodes,
+  // moving over the values and listeners of the nodes that are unchanged.
+  // See Graph::Reload.
+  void MigrateOutputBuffer(const Graph& replacement,
+                           const std::vector<unsigned int>& matches);
+
+  // Returns true if events that arrive now should be held back for the next
+  // pass, because a pass is suspended between slices.
+  bool defers_events() const { return execution_pending_ && !executing_; }
+
+  // Run Initialize on each node of graph_ that is not matched to an old node,
+  // once graph_ holds the new nodes.
+  void InitializeChangedNodes(const std::vector<unsigned int>& matches);
+
+  // Find the input edges of the given graph that the DefaultValueOverlay
+  // overrides, logging an error for each value that does not fit the graph.
+  void ResolveDefaultValues(const Graph& graph);
+
+  // Returns the overridden default values, to hand to NodeArguments.
+  ArrayRef<const ResolvedDefaultValue> default_values() const {
+    return ArrayRef<const ResolvedDefaultValue>(default_values_.data(),
+                                                default_values_.size());
+  }
+
+  // Return true if the node's initialization should wait for its first
+  // execution.
+  bool ShouldDeferInitialize(const Node& node) const {
+    return lazy_initialization_ && !node.constant() &&
+           node.signature()->initialize_deferrable();
+  }
+
+  // Run the node's Initialize function with the given arguments if it was
+  // deferred and has not been run yet.
+  void InitializeDeferredNode(Node* node, NodeArguments* args) {
+    if (!deferred_initializations_.empty() &&
+        deferred_initializations_[node->sorted_index()]) {
+      RunDeferredInitialize(node, args);
+    }
+  }
+
+  // Run the Initialize function of a node whose initialization was deferred.
+  void RunDeferredInitialize(Node* node, NodeArguments* args);
+
+  // Construct the node's listeners in the output buffer.
+  void InitializeListeners(const Node& node);
+
+  // Bind the listener to the same broadcaster as the source listener, or set
+  // the same timer on it.
+  void CopyListenerBinding(const NodeEventListener& source,
+                           NodeEventListener* listener);
+
   // Return true if any of the input edges on this node point to data that has
   // been updated.
   bool IsDirty(const Node& node) const;
 
+  // Return the bitset to mark outputs in, or null if the Graph does not use
+  // kDirtyTrackingBitset.
+  DirtyBitset* dirty_bits() {
+    return dirty_bits_.empty() ? nullptr : &dirty_bits_;
+  }
+
+  // Move on to the next timestamp once a pass has completed. The events that
+  // arrived during the pass become the dirty bits of the next one.
+  void AdvanceTimestamp() {
+    ++timestamp_;
+    if (!dirty_bits_.empty()) {
+      dirty_bits_.Swap(&next_dirty_bits_);
+      next_dirty_bits_.Clear();
+    }
+  }
+
+  // Size the dirty bits for the given graph, and set them from the timestamps
+  // in the output buffer. This is how the bits are brought in line with a
+  // buffer that was copied, migrated or restored.
+  void RebuildDirtyBits(const Graph& graph);
+
+  // Run the node's Execute function with the current arguments.
+  void ExecuteNode(Node* node);
+
+  // Run the node's Execute function with the given arguments, timing it if
+  // profiling is enabled.
+  void ExecuteNode(Node* node, NodeArguments* args);
+
+  // Report to the profiler that the node was visited but not executed.
+  void RecordSkip(const Node& node) {
+#ifdef BREADBOARD_PROFILING
+    if (profiler_) {
+      profiler_->RecordSkip(node);
+    }
+#else
+    (void)node;
+#endif  // BREADBOARD_PROFILING
+  }
+
+  // Execute the dirty nodes one at a time. Returns false if the budget ran
+  // out first.
+  bool ExecuteSerial(ExecutionBudget* budget);
+
+  // Execute each level of the graph through the job system. Returns false if
+  // the budget ran out first.
+  bool ExecuteParallel(ExecutionBudget* budget);
+
+  // Execute the queued nodes, along with any nodes they queue in turn.
+  // Returns false if the budget ran out first.
+  bool ExecuteWorklist(ExecutionBudget* budget);
+
+  // Evaluate the executed nodes that have changed since they were last
+  // evaluated. Returns false if the budget ran out first.
+  bool ExecutePull(ExecutionBudget* budget);
+
+  // Evaluate the input's upstream nodes and return a pointer to its value, or
+  // log an error and return null.
+  const uint8_t* QueryInput(unsigned int node_index, unsigned int edge_index,
+                            const Type* type);
+
+  // Evaluate the node at the given position in Graph::sorted_nodes(), and
+  // the nodes it depends on, that have changed since they were last
+  // evaluated.
+  void EvaluateUpstream(unsigned int sorted_index);
+
+  // Return true if anything the node reads has changed since it was last
+  // evaluated.
+  bool IsStale(const Node& node) const;
+
+  // Execute the node, letting it see everything that changed since it was
+  // last evaluated, and record that it is now up to date.
+  void EvaluateNode(Node* node);
+
+  // Returns the number of dirty bits to allocate for the given graph.
+  size_t dirty_bit_count(const Graph& graph) const {
+    return execution_mode_ == kExecutionModePull ? 0
+                                                 : graph.dirty_bit_count();
+  }
+
   Graph* graph_;
   MemoryBuffer output_buffer_;
   Timestamp timestamp_;
+
+  // The bits of the nodes and outputs that are dirty in the current pass, and
+  // of the nodes whose events arrived while a pass was suspended. Both are
+  // empty unless the Graph uses kDirtyTrackingBitset.
+  DirtyBitset dirty_bits_;
+  DirtyBitset next_dirty_bits_;
+
+  ExecutionMode execution_mode_;
+  DirtyNodeQueue dirty_node_queue_;
+
+  // Whether initialization may be deferred, and for each node by position in
+  // Graph::sorted_nodes(), whether it has been and is still waiting. This is
+  // a byte per node rather than a bit so that nodes executed in parallel can
+  // clear their own entries. Empty unless lazy initialization is turned on.
+  bool lazy_initialization_;
+  std::vector<uint8_t> deferred_initializations_;
+  std::atomic<size_t> deferred_initialization_count_;
+
+  MemoryBufferPool* memory_buffer_pool_;
+  Allocator* allocator_;
+
+  // The overlay set with set_default_value_overlay, and its values sorted by
+  // the offset of the default value they replace.
+  const DefaultValueOverlay* default_value_overlay_;
+  std::vector<ResolvedDefaultValue> default_values_;
+
+  JobSystem* job_system_;
+
+  // Scratch space used by ExecuteParallel, kept around to avoid reallocating
+  // it every frame.
+  std::vector<Node*> parallel_nodes_;
+  std::vector<Node*> pinned_nodes_;
+
+  Profiler* profiler_;
+
+  // The EventDispatcher this GraphState is waiting to be executed by, if any.
+  EventDispatcher* pending_event_dispatcher_;
+
+  // This GraphState's position in its Graph's list of GraphStates.
+  size_t graph_state_index_;
+
+  // Whether a pass has been suspended, and where to resume it: the position
+  // in Graph::executed_nodes, or in Graph::execution_levels when a JobSystem
+  // is set. Worklist passes resume from the queue instead.
+  bool execution_pending_;
+  size_t execution_position_;
+
+  // Whether a pass is running right now. Events raised by the nodes of a
+  // resumed pass belong to that pass, so only those that arrive between its
+  // slices are held back.
+  bool executing_;
+
+  // The nodes queued by events that arrived while a worklist pass was
+  // suspended, which are queued up once it completes.
+  std::vector<unsigned int> deferred_nodes_;
+
+  // The timestamp each node was last evaluated at, by position in
+  // Graph::sorted_nodes(). Empty unless the mode is kExecutionModePull.
+  std::vector<Timestamp> evaluated_timestamps_;
+
+  // Scratch space used by EvaluateUpstream, kept around to avoid
+  // reallocating it on every query.
+  std::vector<unsigned int> upstream_stack_;
+  std::vector<unsigned int> upstream_nodes_;
+  std::vector<bool> upstream_visited_;
+
+  // The GraphStateScheduler this GraphState has been added to, if any.
+  GraphStateScheduler* scheduler_;
+
+  // The GraphWorld this GraphState has been added to, if any.
+  GraphWorld* world_;
+
+  TimerWheel* timer_wheel_;
 };
 
 }  // namespace breadboard
@@ -0,0 +1,196 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_GRAPH_STATE_BATCH_H_
+#define BREADBOARD_GRAPH_STATE_BATCH_H_
+
+#include <memory>
+#include <vector>
+
+#include "breadboard/graph.h"
+#include "breadboard/graph_state.h"
+#include "breadboard/memory_buffer.h"
+#include "breadboard/memory_buffer_pool.h"
+#include "breadboard/node_arguments.h"
+
+/// @file breadboard/graph_state_batch.h
+///
+/// @brief A GraphStateBatch owns many GraphStates that share the same Graph
+///        and executes them together.
+
+namespace breadboard {
+
+/// @cond BREADBOARD_INTERNAL
+
+/// @class BatchExecutor
+///
+/// @brief Executes many GraphStates that share the same Graph node by node.
+///
+/// This is the part of GraphStateBatch that does not depend on owning the
+/// instances, so that other objects that manage GraphStates, such as
+/// GraphWorld, can execute them the same way. It holds the scratch space used
+/// while executing, so it should be kept around between calls.
+///
+/// @note This is for internal use only.
+class BatchExecutor {
+ public:
+  BatchExecutor() : dirty_states_(), batch_arguments_(), batch_columns_() {}
+
+  /// @brief Execute all dirty nodes on each of the given GraphStates.
+  ///
+  /// Every GraphState must be initialized from `graph`, be executed serially
+  /// in kExecutionModePolling, and have no pass in progress.
+  ///
+  /// @param[in] graph The Graph that every GraphState is based on.
+  /// @param[in] graph_states The GraphStates to execute.
+  /// @param[in] count The number of GraphStates.
+  /// @param[in] profiler The Profiler that nodes run through
+  ///            BaseNode::ExecuteBatch are reported to, or null.
+  void Execute(Graph* graph, GraphState* const* graph_states, size_t count,
+               Profiler* profiler);
+
+ private:
+  // Offer the node's dirty instances to BaseNode::ExecuteBatch. Returns false
+  // if the node needs to be executed on each instance in turn instead.
+  bool ExecuteBatch(Graph* graph, Node* node, Profiler* profiler);
+
+  // Scratch space holding the dirty instances of the node being executed.
+  std::vector<GraphState*> dirty_states_;
+
+  // Scratch space used to run a node on all of its dirty instances at once.
+  std::vector<NodeArguments> batch_arguments_;
+  std::vector<std::unique_ptr<MemoryBuffer>> batch_columns_;
+};
+
+/// @endcond
+
+/// @class GraphStateBatch
+///
+/// @brief A GraphStateBatch owns many GraphStates that share the same Graph
+///        and executes them together.
+///
+/// Executing each GraphState on its own walks the whole graph once per
+/// instance. A GraphStateBatch instead executes node by node: for each node in
+/// sorted order, that node is executed on every instance where it is dirty
+/// before moving on to the next node. This keeps the code and data for a node
+/// hot in the cache while it is run across all of the instances.
+///
+/// The output buffers of the instances are drawn from a MemoryBufferPool
+/// owned by the batch, so that instances created together sit next to each
+/// other in memory.
+///
+/// Nodes that implement BaseNode::ExecuteBatch are run once on all of their
+/// dirty instances together.
+///
+/// Each instance is still a normal GraphState, and may be bound to
+/// broadcasters and inspected like any other.
+class GraphStateBatch {
+ public:
+  /// @brief Construct an empty GraphStateBatch.
+  GraphStateBatch()
+      : graph_(nullptr),
+        memory_buffer_pool_(),
+        graph_states_(),
+        graph_state_pointers_(),
+        executor_(),
+        profiler_(nullptr) {}
+
+  /// @brief Initialize the batch with `count` instances of the given graph.
+  ///
+  /// @param[in] graph The Graph that every instance in this batch is based on.
+  ///
+  /// @param[in] count The number of instances to create.
+  ///
+  /// @return Returns true if successful. If there is not enough memory for
+  ///         every instance, an error is logged and false is returned.
+  bool Initialize(Graph* graph, size_t count);
+
+  /// @brief Add one more initialized instance to the batch.
+  ///
+  /// Initialize must have been called first.
+  ///
+  /// @return The new GraphState, or nullptr if there is not enough memory for
+  ///         it.
+  GraphState* AddGraphState();
+
+  /// @brief Returns the Graph that every instance in this batch is based on.
+  ///
+  /// @return The Graph that every instance in this batch is based on.
+  Graph* graph() const { return graph_; }
+
+  /// @brief Returns the number of instances in this batch.
+  ///
+  /// @return The number of instances in this batch.
+  size_t size() const { return graph_states_.size(); }
+
+  /// @brief Returns the instance at the given index.
+  ///
+  /// @param[in] index The index of the instance.
+  ///
+  /// @return The instance at the given index.
+  GraphState* graph_state(size_t index) { return graph_states_[index].get(); }
+
+  /// @brief Returns the instance at the given index.
+  ///
+  /// @param[in] index The index of the instance.
+  ///
+  /// @return The instance at the given index.
+  const GraphState* graph_state(size_t index) const {
+    return graph_states_[index].get();
+  }
+
+  /// @brief Execute all dirty nodes on every instance in the batch.
+  ///
+  /// This has the same effect as calling GraphState::Execute on each instance
+  /// in turn, but visits the nodes in node-major order.
+  void Execute();
+
+  /// @brief Set the Profiler that every instance in this batch reports node
+  ///        executions to.
+  ///
+  /// This calls GraphState::set_profiler on every instance, including ones
+  /// added later. A node run on many instances at once through
+  /// BaseNode::ExecuteBatch is reported as a single timed execution that
+  /// counts once for each instance.
+  ///
+  /// @param[in] profiler The Profiler to report to, or null to stop profiling.
+  void set_profiler(Profiler* profiler);
+
+  /// @brief Returns the Profiler this batch reports to, if any.
+  ///
+  /// @return The Profiler this batch reports to, or null.
+  Profiler* profiler() const { return profiler_; }
+
+ private:
+  // Disallow copying.
+  GraphStateBatch(GraphStateBatch&);
+  GraphStateBatch& operator=(GraphStateBatch&);
+
+  Graph* graph_;
+
+  // Declared before graph_states_ so that it is destroyed after them.
+  std::unique_ptr<MemoryBufferPool> memory_buffer_pool_;
+  std::vector<std::unique_ptr<GraphState>> graph_states_;
+
+  // The same instances as graph_states_, as the array BatchExecutor takes.
+  std::vector<GraphState*> graph_state_pointers_;
+
+  BatchExecutor executor_;
+
+  Profiler* profiler_;
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_GRAPH_STATE_BATCH_H_
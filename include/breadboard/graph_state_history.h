@@ -0,0 +1,234 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_GRAPH_STATE_HISTORY_H_
+#define BREADBOARD_GRAPH_STATE_HISTORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "breadboard/event.h"
+#include "breadboard/graph.h"
+#include "breadboard/graph_state.h"
+#include "breadboard/memory_buffer.h"
+
+/// @file breadboard/graph_state_history.h
+///
+/// @brief A GraphStateHistory keeps snapshots of a GraphState from recent
+///        frames, so that it can be rolled back to any of them.
+
+namespace breadboard {
+
+/// @class GraphStateHistory
+///
+/// @brief A GraphStateHistory keeps snapshots of a GraphState from recent
+///        frames, so that it can be rolled back to any of them.
+///
+/// This is meant for rollback networking, where the state of every instance
+/// is saved each frame, and restored when a late input arrives so that the
+/// frames since can be simulated again:
+///
+/// ~~~{.cpp}
+///     breadboard::GraphStateHistory history(&graph, 8);
+///     ...
+///     // At the end of each frame:
+///     history.Save(graph_state, frame);
+///     ...
+///     // When an input for an earlier frame arrives:
+///     history.Restore(input_frame - 1, &graph_state);
+/// ~~~
+///
+/// A snapshot holds the output edge values and node states of the GraphState,
+/// its timestamp, which of its nodes have yet to be initialized, and the
+/// timestamp of each of its listeners. Which broadcasters the listeners are
+/// bound to, and the timers they are waiting on, are not part of a snapshot
+/// and are left as they are by Restore.
+///
+/// The snapshots are kept in a ring buffer that is allocated up front, so that
+/// saving a snapshot does not allocate. Values that can be copied with memcpy
+/// are saved as a delta from the previous snapshot: only the nodes that may
+/// have executed since then, going by their timestamps, are looked at, and of
+/// their bytes only the blocks that changed are copied. Values that can not,
+/// such as strings, are copied in full each time.
+///
+/// The Graph must not be reloaded while it has a GraphStateHistory.
+class GraphStateHistory {
+ public:
+  /// @brief Construct a GraphStateHistory for GraphStates of the given Graph.
+  ///
+  /// @param[in] graph The Graph of the GraphStates that will be saved.
+  ///
+  /// @param[in] capacity The number of snapshots to keep. Once it is full,
+  ///            saving a snapshot discards the oldest one.
+  GraphStateHistory(const Graph* graph, size_t capacity);
+
+  ~GraphStateHistory();
+
+  /// @brief Save a snapshot of the given GraphState.
+  ///
+  /// @param[in] graph_state The GraphState to save. It must be initialized
+  ///            from this history's Graph, and must not have a suspended pass.
+  ///
+  /// @param[in] frame The frame the snapshot is taken on. It must be later
+  ///            than the frame of every snapshot that is kept.
+  ///
+  /// @return Returns true if successful. If the graph holds a type that can
+  ///         not be copied, an error is logged and false is returned.
+  bool Save(const GraphState& graph_state, uint64_t frame);
+
+  /// @brief Restore the given GraphState to its state in a snapshot.
+  ///
+  /// The snapshots taken after that frame are discarded, since the frames
+  /// after it are about to be simulated again. The snapshot of the frame
+  /// itself is kept. Nodes queued up for a GraphState in
+  /// kExecutionModeWorklist are dropped.
+  ///
+  /// @param[in] frame The frame of the snapshot to restore.
+  ///
+  /// @param[in,out] graph_state The GraphState to restore. This must be the
+  ///                GraphState the snapshots were taken of, and must not have
+  ///                a suspended pass.
+  ///
+  /// @return Returns true if successful, or false if there is no snapshot of
+  ///         the given frame.
+  bool Restore(uint64_t frame, GraphState* graph_state);
+
+  /// @brief Discard every snapshot.
+  void Clear();
+
+  /// @brief Returns true if there is a snapshot of the given frame.
+  ///
+  /// @param[in] frame The frame to look for.
+  ///
+  /// @return Whether there is a snapshot of the given frame.
+  bool Contains(uint64_t frame) const;
+
+  /// @brief Returns the number of snapshots kept.
+  ///
+  /// @return The number of snapshots kept.
+  size_t size() const { return count_; }
+
+  /// @brief Returns the number of snapshots that can be kept.
+  ///
+  /// @return The number of snapshots that can be kept.
+  size_t capacity() const { return snapshots_.size(); }
+
+  /// @brief Returns the frame of the oldest snapshot. There must be one.
+  ///
+  /// @return The frame of the oldest snapshot.
+  uint64_t oldest_frame() const;
+
+  /// @brief Returns the frame of the newest snapshot. There must be one.
+  ///
+  /// @return The frame of the newest snapshot.
+  uint64_t newest_frame() const;
+
+ private:
+  // Disallow copying.
+  GraphStateHistory(GraphStateHistory&);
+  GraphStateHistory& operator=(GraphStateHistory&);
+
+  // A run of the output buffer that can be copied with memcpy.
+  struct Block {
+    Block(ptrdiff_t offset_, size_t size_) : offset(offset_), size(size_) {}
+
+    ptrdiff_t offset;
+    size_t size;
+  };
+
+  struct Snapshot {
+    Snapshot()
+        : frame(0),
+          timestamp(0),
+          deferred_initialization_count(0),
+          objects_constructed(false) {}
+
+    uint64_t frame;
+    Timestamp timestamp;
+    std::vector<Timestamp> listener_timestamps;
+
+    // Which nodes had yet to be initialized, for GraphStates that initialize
+    // their nodes lazily.
+    std::vector<uint8_t> deferred_initializations;
+    size_t deferred_initialization_count;
+
+    // Copies of the objects that can not be copied with memcpy, laid out as
+    // given by object_offsets_.
+    MemoryBuffer objects;
+    bool objects_constructed;
+
+    // The blocks that changed between this snapshot and the next one, and
+    // their contents as of this snapshot, back to back.
+    std::vector<unsigned int> undo_blocks;
+    std::vector<uint8_t> undo_bytes;
+  };
+
+  // Returns the snapshot at the given position, counting from the oldest.
+  Snapshot& snapshot(size_t position) {
+    return *snapshots_[(first_ + position) % snapshots_.size()];
+  }
+  const Snapshot& snapshot(size_t position) const {
+    return *snapshots_[(first_ + position) % snapshots_.size()];
+  }
+
+  // Split the parts of the output buffer that can be copied with memcpy into
+  // blocks, and lay out the objects that can not.
+  void BuildLayout();
+
+  // Find the blocks holding the timestamps, outputs and state of each node.
+  void BuildNodeBlocks();
+
+  // Mark the blocks of the given range of the output buffer in
+  // touched_blocks_.
+  void AddNodeBlocks(ptrdiff_t offset, size_t size);
+
+  // Returns true if the node may have changed its part of the output buffer
+  // since the given snapshot was saved.
+  bool MayHaveChanged(const GraphState& graph_state, const Node& node,
+                      const Snapshot& previous) const;
+
+  // Destroy the copies of objects held by the snapshot.
+  void DestroyObjects(Snapshot* snapshot);
+
+  // Apply the snapshot's undo blocks to current_.
+  void Undo(const Snapshot& snapshot);
+
+  const Graph* graph_;
+
+  std::vector<Block> blocks_;
+  // The blocks of each node, in order: those of node i are from
+  // node_block_starts_[i] up to node_block_starts_[i + 1].
+  std::vector<unsigned int> node_blocks_;
+  std::vector<size_t> node_block_starts_;
+  // Which blocks to compare when saving a snapshot, kept between calls.
+  std::vector<uint8_t> touched_blocks_;
+  std::vector<ptrdiff_t> listener_offsets_;
+  std::vector<ptrdiff_t> object_offsets_;
+  size_t objects_size_;
+  size_t objects_alignment_;
+
+  // The bytes of the output buffer as of the newest snapshot. Only the
+  // blocks are kept up to date.
+  std::vector<uint8_t> current_;
+
+  std::vector<std::unique_ptr<Snapshot>> snapshots_;
+  size_t first_;
+  size_t count_;
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_GRAPH_STATE_HISTORY_H_
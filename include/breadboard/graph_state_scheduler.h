@@ -0,0 +1,103 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_GRAPH_STATE_SCHEDULER_H_
+#define BREADBOARD_GRAPH_STATE_SCHEDULER_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "breadboard/graph_state.h"
+
+/// @file breadboard/graph_state_scheduler.h
+///
+/// @brief A GraphStateScheduler shares an ExecutionBudget between many
+///        GraphStates.
+
+namespace breadboard {
+
+/// @class GraphStateScheduler
+///
+/// @brief A GraphStateScheduler shares an ExecutionBudget between many
+///        GraphStates.
+///
+/// Each call to Execute continues a round in which every GraphState that has
+/// been added completes one pass. The GraphStates take their turns in the
+/// order they were added, and a GraphState that runs out of budget picks up
+/// its pass at the start of the next call. Since the next call resumes from
+/// wherever the last one stopped, rather than from the first GraphState,
+/// every instance gets to run even when there is never enough budget to
+/// finish a round in one go:
+///
+/// ~~~{.cpp}
+///     // Once per frame:
+///     breadboard::ExecutionBudget budget;
+///     budget.set_time_limit(std::chrono::milliseconds(2));
+///     scheduler.Execute(&budget);
+/// ~~~
+///
+/// A GraphState removes itself from its scheduler when it is destroyed.
+class GraphStateScheduler {
+ public:
+  /// @brief Construct an empty GraphStateScheduler.
+  GraphStateScheduler()
+      : graph_states_(), next_graph_state_(0), remaining_in_round_(0) {}
+
+  ~GraphStateScheduler();
+
+  /// @brief Add the given GraphState to the end of the schedule.
+  ///
+  /// The GraphState must be initialized, and can only belong to one scheduler
+  /// at a time.
+  ///
+  /// @param[in] graph_state The GraphState to add.
+  void AddGraphState(GraphState* graph_state);
+
+  /// @brief Remove the given GraphState from the schedule.
+  ///
+  /// A pass it has in progress stays suspended.
+  ///
+  /// @param[in] graph_state The GraphState to remove.
+  void RemoveGraphState(GraphState* graph_state);
+
+  /// @brief Returns the number of GraphStates in the schedule.
+  ///
+  /// @return The number of GraphStates in the schedule.
+  size_t size() const { return graph_states_.size(); }
+
+  /// @brief Execute GraphStates in turn until the round is complete or the
+  /// budget is used up.
+  ///
+  /// @param[in,out] budget The budget shared by all of the GraphStates.
+  ///
+  /// @return True if every GraphState completed its pass for this round, in
+  ///         which case the next call starts a new round.
+  bool Execute(ExecutionBudget* budget);
+
+ private:
+  // Disallow copying.
+  GraphStateScheduler(GraphStateScheduler&);
+  GraphStateScheduler& operator=(GraphStateScheduler&);
+
+  std::vector<GraphState*> graph_states_;
+
+  // The GraphState whose turn it is, and how many GraphStates, counting on
+  // from it, have yet to complete a pass in this round.
+  size_t next_graph_state_;
+  size_t remaining_in_round_;
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_GRAPH_STATE_SCHEDULER_H_
@@ -0,0 +1,205 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_GRAPH_WORLD_H_
+#define BREADBOARD_GRAPH_WORLD_H_
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "breadboard/graph.h"
+#include "breadboard/graph_state.h"
+#include "breadboard/graph_state_batch.h"
+#include "breadboard/job_system.h"
+
+/// @file breadboard/graph_world.h
+///
+/// @brief A GraphWorld keeps track of every live GraphState and executes them
+///        all once per frame.
+
+namespace breadboard {
+
+/// @brief The number of GraphStates a GraphWorld puts in each shard by
+///        default.
+static const size_t kDefaultGraphWorldShardSize = 64;
+
+/// @class GraphWorld
+///
+/// @brief A GraphWorld keeps track of every live GraphState and executes them
+///        all once per frame.
+///
+/// GraphStates added to a GraphWorld are grouped by their Graph, and each
+/// group is split into shards of a fixed size. Tick executes every GraphState
+/// that may have work to do. Each shard is one unit of work on the JobSystem,
+/// so the GraphStates of a shard are always executed together, on a single
+/// thread, one after another:
+///
+/// ~~~{.cpp}
+///     breadboard::ThreadPool thread_pool(3);
+///     breadboard::GraphWorld world(&thread_pool);
+///     world.AddGraphState(&enemy->graph_state);
+///     ...
+///     // Once per frame:
+///     world.Tick();
+/// ~~~
+///
+/// Within a shard, the GraphStates that are executed serially in
+/// kExecutionModePolling are executed node by node, as by GraphStateBatch, so
+/// nodes that implement BaseNode::ExecuteBatch get to run on all of them at
+/// once. GraphStates in kExecutionModeWorklist are only executed if they have
+/// nodes queued up, and GraphStates in kExecutionModePull are executed on
+/// their own. A pass suspended by GraphState::Execute(ExecutionBudget*)
+/// is finished.
+///
+/// Shards whose Graph has a node that is not thread safe (see
+/// NodeSignature::set_thread_safe) are executed on the calling thread, after
+/// the others. Nodes in other shards may run on any thread, alongside nodes of
+/// other GraphStates, so they must not modify state shared with other
+/// GraphStates without their own synchronization.
+///
+/// A GraphState removes itself from its GraphWorld when it is destroyed.
+/// GraphStates must not be added, removed or destroyed while Tick is running.
+class GraphWorld {
+ public:
+  /// @brief Construct an empty GraphWorld.
+  ///
+  /// @param[in] job_system The JobSystem to spread shards across, or null to
+  ///            execute everything on the calling thread. It must outlive
+  ///            this GraphWorld.
+  explicit GraphWorld(JobSystem* job_system = nullptr)
+      : job_system_(job_system),
+        shard_size_(kDefaultGraphWorldShardSize),
+        groups_(),
+        group_map_(),
+        graph_state_count_(0),
+        parallel_shards_(),
+        pinned_shards_() {}
+
+  ~GraphWorld();
+
+  /// @brief Add the given GraphState to this GraphWorld.
+  ///
+  /// The GraphState must be initialized, and can only belong to one GraphWorld
+  /// at a time.
+  ///
+  /// @param[in] graph_state The GraphState to add.
+  void AddGraphState(GraphState* graph_state);
+
+  /// @brief Remove the given GraphState from this GraphWorld.
+  ///
+  /// @param[in] graph_state The GraphState to remove.
+  void RemoveGraphState(GraphState* graph_state);
+
+  /// @brief Execute every GraphState that may have work to do.
+  void Tick();
+
+  /// @brief Returns the number of GraphStates in this GraphWorld.
+  ///
+  /// @return The number of GraphStates in this GraphWorld.
+  size_t size() const { return graph_state_count_; }
+
+  /// @brief Returns the number of different Graphs used by the GraphStates in
+  ///        this GraphWorld.
+  ///
+  /// @return The number of different Graphs in this GraphWorld.
+  size_t graph_count() const { return groups_.size(); }
+
+  /// @brief Set the JobSystem that shards are spread across.
+  ///
+  /// @param[in] job_system The JobSystem to use, or null to execute everything
+  ///            on the calling thread.
+  void set_job_system(JobSystem* job_system) { job_system_ = job_system; }
+
+  /// @brief Returns the JobSystem that shards are spread across, if any.
+  ///
+  /// @return The JobSystem that shards are spread across, or null.
+  JobSystem* job_system() const { return job_system_; }
+
+  /// @brief Set the most GraphStates a shard may hold.
+  ///
+  /// Smaller shards spread the work more evenly across threads, while larger
+  /// ones let more instances share each call to BaseNode::ExecuteBatch. This
+  /// only affects GraphStates added afterwards.
+  ///
+  /// @param[in] shard_size The most GraphStates a shard may hold.
+  void set_shard_size(size_t shard_size) {
+    assert(shard_size > 0);
+    shard_size_ = shard_size;
+  }
+
+  /// @brief Returns the most GraphStates a shard may hold.
+  ///
+  /// @return The most GraphStates a shard may hold.
+  size_t shard_size() const { return shard_size_; }
+
+ private:
+  // Disallow copying.
+  GraphWorld(GraphWorld&);
+  GraphWorld& operator=(GraphWorld&);
+
+  // A run of GraphStates of the same Graph that are always executed together.
+  struct Shard {
+    explicit Shard(Graph* graph_) : graph(graph_) {}
+
+    Graph* graph;
+    std::vector<GraphState*> graph_states;
+
+    // Scratch space holding the GraphStates that can be executed node by
+    // node.
+    std::vector<GraphState*> batched_states;
+    BatchExecutor executor;
+  };
+
+  // The shards of every GraphState of one Graph.
+  struct GraphGroup {
+    explicit GraphGroup(Graph* graph_)
+        : graph(graph_),
+          thread_safe(IsThreadSafe(*graph_)),
+          reload_count(graph_->reload_count()) {}
+
+    Graph* graph;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    // Whether the Graph may be executed on any thread, as of the given number
+    // of reloads.
+    bool thread_safe;
+    unsigned int reload_count;
+  };
+
+  // Execute the GraphStates of the shard that may have work to do.
+  static void ExecuteShard(Shard* shard);
+
+  // Returns true if every node the Graph executes may run on any thread.
+  static bool IsThreadSafe(const Graph& graph);
+
+  JobSystem* job_system_;
+  size_t shard_size_;
+
+  // The groups, in the order their Graphs were first added, and an index of
+  // them by Graph.
+  std::vector<std::unique_ptr<GraphGroup>> groups_;
+  std::unordered_map<const Graph*, GraphGroup*> group_map_;
+  size_t graph_state_count_;
+
+  // Scratch space used by Tick, kept around to avoid reallocating it every
+  // frame.
+  std::vector<Shard*> parallel_shards_;
+  std::vector<Shard*> pinned_shards_;
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_GRAPH_WORLD_H_
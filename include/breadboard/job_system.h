@@ -0,0 +1,134 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_JOB_SYSTEM_H_
+#define BREADBOARD_JOB_SYSTEM_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @file breadboard/job_system.h
+///
+/// @brief A JobSystem is an interface Breadboard uses to spread work across
+///        multiple threads.
+
+namespace breadboard {
+
+/// @typedef ParallelForFunc
+///
+/// @brief A function (or functor) that is run once for each index of a
+///        JobSystem::ParallelFor call.
+typedef std::function<void(size_t)> ParallelForFunc;
+
+/// @typedef JobFunc
+///
+/// @brief A function (or functor) that is run once by JobSystem::Submit.
+typedef std::function<void()> JobFunc;
+
+/// @class JobSystem
+///
+/// @brief A JobSystem is an interface Breadboard uses to spread work across
+///        multiple threads.
+///
+/// Breadboard does not require any particular threading library. If your game
+/// already has a job system or work-stealing scheduler, implement this
+/// interface on top of it and pass it to the objects that support parallel
+/// execution, such as GraphState::set_job_system. If not, the ThreadPool class
+/// provides a simple default implementation.
+class JobSystem {
+ public:
+  /// @brief Destructor for a JobSystem.
+  virtual ~JobSystem() {}
+
+  /// @brief Run `func` once for every index in the range [0, count).
+  ///
+  /// The calls may happen in any order and on any thread, including the
+  /// calling thread. This function must not return until every call has
+  /// completed, which makes each call to ParallelFor act as a barrier.
+  ///
+  /// @param[in] count The number of indices to run.
+  ///
+  /// @param[in] func The function to run for each index.
+  virtual void ParallelFor(size_t count, const ParallelForFunc& func) = 0;
+
+  /// @brief Run `func` once, at some point in the future.
+  ///
+  /// Unlike ParallelFor, this returns without waiting for the job to finish.
+  /// It is used for long running work that the calling thread does not want
+  /// to wait on, such as GraphFactory::LoadGraphAsync. The default
+  /// implementation runs the job on the calling thread before returning.
+  ///
+  /// @param[in] func The function to run.
+  virtual void Submit(const JobFunc& func) { func(); }
+};
+
+/// @class ThreadPool
+///
+/// @brief A simple JobSystem backed by a fixed number of worker threads.
+///
+/// Indices of a ParallelFor call are handed out one at a time to whichever
+/// thread asks for one next, and the calling thread participates as well, so
+/// uneven workloads are balanced across the pool.
+class ThreadPool : public JobSystem {
+ public:
+  /// @brief Construct a ThreadPool with the given number of worker threads.
+  ///
+  /// @param[in] worker_count The number of threads to create. If zero, all
+  ///            work is done on the calling thread.
+  explicit ThreadPool(size_t worker_count);
+
+  /// @brief Destructor for a ThreadPool. Blocks until all workers have exited.
+  virtual ~ThreadPool();
+
+  /// @brief Returns the number of worker threads in this pool.
+  ///
+  /// @return The number of worker threads in this pool.
+  size_t worker_count() const { return workers_.size(); }
+
+  virtual void ParallelFor(size_t count, const ParallelForFunc& func);
+
+  /// @brief Queue `func` to be run by the next free worker thread.
+  ///
+  /// If the pool has no worker threads, `func` is run on the calling thread.
+  /// Jobs that are still queued when the pool is destroyed are run before the
+  /// workers exit.
+  ///
+  /// @param[in] func The function to run.
+  virtual void Submit(const JobFunc& func);
+
+ private:
+  // Disallow copying.
+  ThreadPool(ThreadPool&);
+  ThreadPool& operator=(ThreadPool&);
+
+  typedef std::function<void()> Task;
+
+  void Enqueue(const Task& task);
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;
+  std::deque<Task> tasks_;
+  std::mutex mutex_;
+  std::condition_variable task_available_;
+  bool shutting_down_;
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_JOB_SYSTEM_H_
@@ -37,9 +37,39 @@ typedef void (*LogFunc)(const char* fmt, va_list args);
 /// @param[in] The function to use for logging.
 void RegisterLogFunc(LogFunc log_func);
 
+/// @class LogBackend
+///
+/// @brief An object that receives every call to CallLogFunc.
+///
+/// A LogBackend is useful when logging needs state that a plain LogFunc can
+/// not carry, such as a queue feeding a background thread. See
+/// AsyncLogBackend for an example.
+class LogBackend {
+ public:
+  virtual ~LogBackend() {}
+
+  /// @brief Handle a single log message.
+  ///
+  /// This may be called from any thread that executes graphs.
+  ///
+  /// @param[in] format The format string of the message.
+  /// @param[in] args The arguments to format.
+  virtual void Log(const char* format, va_list args) = 0;
+};
+
+/// @brief Register a logging backend with the library.
+///
+/// While a backend is registered it receives all messages instead of the
+/// registered LogFunc. Pass nullptr to go back to the LogFunc. This should not
+/// be called while other threads may be logging.
+///
+/// @param[in] The backend to use for logging, or nullptr.
+void RegisterLogBackend(LogBackend* log_backend);
+
 /// @brief Call the registered log function with the provided format string.
 ///
-/// This does nothing if no logging function has been registered.
+/// If a LogBackend has been registered the message is passed to it instead.
+/// This does nothing if neither has been registered.
 ///
 /// @param[in] format The format string to print.
 /// @param[in] ... The arguments to format.
@@ -18,7 +18,11 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
-#include <vector>
+#include <cstring>
+#include <utility>
+
+#include "breadboard/allocator.h"
+#include "breadboard/memory_buffer_pool.h"
 
 /// @file breadboard/memory_buffer.h
 ///
@@ -32,7 +36,7 @@ namespace breadboard {
 
 /// @class MemoryBuffer
 ///
-/// @brief MemoryBuffer is a simple wrapper around a vector of bytes that makes
+/// @brief MemoryBuffer is a simple wrapper around a block of bytes that makes
 /// it easy to convert offsets into concrete types.
 ///
 /// The buffer size may only be set once. Once the buffer is initialized,
@@ -45,7 +49,17 @@ namespace breadboard {
 class MemoryBuffer {
  public:
   /// @class Construct an uninitialized MemoryBuffer.
-  MemoryBuffer() : buffer_() {}
+  MemoryBuffer()
+      : data_(nullptr), size_(0), pool_(nullptr), allocator_(nullptr) {}
+
+  /// @brief Destructor for a MemoryBuffer.
+  ~MemoryBuffer() {
+    if (pool_) {
+      pool_->Free(data_);
+    } else if (allocator_) {
+      allocator_->Free(data_, size_);
+    }
+  }
 
   /// @brief Sets the buffer to the desired size.
   ///
@@ -53,32 +67,99 @@ class MemoryBuffer {
   /// are no use cases currently where resizing would be allowed, so to prevent
   /// misuse any attempt to resize it again will assert.
   ///
+  /// The contents of the buffer start out zeroed.
+  ///
   /// @note This is for internal use only.
   ///
   /// @note This may only be called once.
   ///
   /// @param[in] size The size in bytes bytes of the buffer.
-  void Initialize(size_t size) {
-    assert(buffer_.size() == 0);
-    buffer_.resize(size);
+  ///
+  /// @param[in] alignment The alignment of the start of the buffer. Must be a
+  /// power of 2.
+  ///
+  /// @param[in] allocator The Allocator to take the memory from.
+  ///
+  /// @return True if successful, or false if the Allocator is out of memory,
+  ///         in which case the buffer is left uninitialized.
+  bool Initialize(size_t size, size_t alignment = 1,
+                  Allocator* allocator = DefaultAllocator()) {
+    assert(size_ == 0);
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    if (size > 0) {
+      data_ = static_cast<uint8_t*>(allocator->Allocate(size, alignment));
+      if (!data_) {
+        return false;
+      }
+      memset(data_, 0, size);
+      size_ = size;
+      allocator_ = allocator;
+    }
+    return true;
   }
 
+  /// @brief Sets the buffer to the desired size, taking the memory for it from
+  /// the given pool.
+  ///
+  /// The pool's blocks must be at least `size` bytes. The memory is returned to
+  /// the pool when this MemoryBuffer is destroyed.
+  ///
+  /// @note This is for internal use only.
+  ///
+  /// @note This may only be called once.
+  ///
+  /// @param[in] size The size in bytes bytes of the buffer.
+  ///
+  /// @param[in] pool The pool to take the memory from.
+  ///
+  /// @return True if successful, or false if the pool is out of memory, in
+  ///         which case the buffer is left uninitialized.
+  bool Initialize(size_t size, MemoryBufferPool* pool) {
+    assert(size_ == 0);
+    assert(size <= pool->block_size());
+    if (size > 0) {
+      data_ = pool->Allocate();
+      if (!data_) {
+        return false;
+      }
+      size_ = size;
+      pool_ = pool;
+    }
+    return true;
+  }
+
+  /// @brief Exchange the contents of this buffer with another.
+  ///
+  /// The memory itself is not moved, so pointers into either buffer remain
+  /// valid.
+  ///
+  /// @param[in,out] other The buffer to exchange contents with.
+  void Swap(MemoryBuffer* other) {
+    std::swap(data_, other->data_);
+    std::swap(size_, other->size_);
+    std::swap(pool_, other->pool_);
+    std::swap(allocator_, other->allocator_);
+  }
+
+  /// @brief Returns the size in bytes of the buffer.
+  ///
+  /// @return The size in bytes of the buffer.
+  size_t size() const { return size_; }
+
   /// @brief Returns a raw pointer to the desired offset in the buffer.
   ///
   /// @return A raw pointer to the desired offset in the buffer.
   uint8_t* GetObjectPtr(ptrdiff_t offset) {
-    assert(buffer_.size() > 0 &&
-           offset < static_cast<ptrdiff_t>(buffer_.size()));
-    return buffer_.data() + offset;
+    assert(size_ > 0 && offset < static_cast<ptrdiff_t>(size_));
+    return data_ + offset;
   }
 
   /// @brief Returns a raw pointer to the desired offset in the buffer.
   ///
   /// @return A raw pointer to the desired offset in the buffer.
   const uint8_t* GetObjectPtr(ptrdiff_t offset) const {
-    assert(buffer_.size() > 0 &&
-           offset < static_cast<ptrdiff_t>(buffer_.size()));
-    return buffer_.data() + offset;
+    assert(size_ > 0 && offset < static_cast<ptrdiff_t>(size_));
+    return data_ + offset;
   }
 
   /// @brief Returns a pointer to an object located at the given offset.
@@ -104,7 +185,15 @@ class MemoryBuffer {
   }
 
  private:
-  std::vector<uint8_t> buffer_;
+  // Disallow copying.
+  MemoryBuffer(MemoryBuffer&);
+  MemoryBuffer& operator=(MemoryBuffer&);
+
+  uint8_t* data_;
+  size_t size_;
+  // The pool or allocator the buffer was taken from, if any.
+  MemoryBufferPool* pool_;
+  Allocator* allocator_;
 };
 
 /// @endcond
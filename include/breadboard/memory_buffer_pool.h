@@ -0,0 +1,116 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_MEMORY_BUFFER_POOL_H_
+#define BREADBOARD_MEMORY_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "breadboard/allocator.h"
+
+/// @file breadboard/memory_buffer_pool.h
+///
+/// @brief A MemoryBufferPool hands out fixed size, aligned blocks of memory
+///        for MemoryBuffers from large slabs.
+
+namespace breadboard {
+
+/// @class MemoryBufferPool
+///
+/// @brief A MemoryBufferPool hands out fixed size, aligned blocks of memory
+///        for MemoryBuffers from large slabs.
+///
+/// By default each GraphState makes its own heap allocation for its output
+/// buffer. When many GraphStates are created from the same Graph, they can
+/// instead share a pool whose blocks are sized and aligned for that Graph:
+///
+/// ~~~{.cpp}
+///     breadboard::MemoryBufferPool pool(graph.output_buffer_size(),
+///                                       graph.output_buffer_alignment(), 256);
+///     graph_state.set_memory_buffer_pool(&pool);
+///     graph_state.Initialize(&graph);
+/// ~~~
+///
+/// Blocks are carved out of slabs of `blocks_per_slab` blocks at a time, so
+/// GraphStates created one after another sit next to each other in memory,
+/// and creating or destroying one does not touch the heap unless a new slab
+/// is needed. Freed blocks are reused before new slabs are allocated. Slabs
+/// are only released when the pool is destroyed, so the pool must outlive
+/// every GraphState using it.
+///
+/// A MemoryBufferPool is not thread safe.
+class MemoryBufferPool {
+ public:
+  /// @brief Construct a MemoryBufferPool.
+  ///
+  /// @param[in] block_size The size in bytes of each block.
+  ///
+  /// @param[in] alignment The alignment of each block. Must be a power of 2.
+  ///
+  /// @param[in] blocks_per_slab The number of blocks to allocate at a time.
+  ///
+  /// @param[in] allocator The Allocator to take the slabs from.
+  MemoryBufferPool(size_t block_size, size_t alignment, size_t blocks_per_slab,
+                   Allocator* allocator = DefaultAllocator());
+
+  /// @brief Destructor for a MemoryBufferPool. Returns every slab to the
+  ///        Allocator.
+  ~MemoryBufferPool();
+
+  /// @brief Returns the size in bytes of each block.
+  ///
+  /// @return The size in bytes of each block.
+  size_t block_size() const { return block_size_; }
+
+  /// @brief Returns the alignment of each block.
+  ///
+  /// @return The alignment of each block.
+  size_t alignment() const { return alignment_; }
+
+  /// @brief Returns a zeroed block of memory.
+  ///
+  /// @return A zeroed block of memory, aligned to alignment(), or nullptr if
+  ///         the Allocator is out of memory.
+  uint8_t* Allocate();
+
+  /// @brief Returns a block to the pool so that it can be reused.
+  ///
+  /// @param[in] block A block previously returned by Allocate.
+  void Free(uint8_t* block);
+
+ private:
+  // Disallow copying.
+  MemoryBufferPool(MemoryBufferPool&);
+  MemoryBufferPool& operator=(MemoryBufferPool&);
+
+  // Allocate a new slab and add all of its blocks to the free list. Returns
+  // false if the Allocator is out of memory.
+  bool AllocateSlab();
+
+  size_t block_size_;
+  size_t alignment_;
+  size_t stride_;
+  size_t blocks_per_slab_;
+  size_t slab_size_;
+  Allocator* allocator_;
+
+  std::vector<uint8_t*> slabs_;
+  std::vector<uint8_t*> free_blocks_;
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_MEMORY_BUFFER_POOL_H_
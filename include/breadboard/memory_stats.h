@@ -0,0 +1,120 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_MEMORY_STATS_H_
+#define BREADBOARD_MEMORY_STATS_H_
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+#include "breadboard/type.h"
+
+/// @file breadboard/memory_stats.h
+///
+/// @brief MemoryStats is a report of the memory used by Graphs, GraphStates
+///        and GraphFactories.
+
+namespace breadboard {
+
+class NodeSignature;
+
+/// @struct MemoryStats
+///
+/// @brief A report of how much memory is used by Graphs, GraphStates and
+///        GraphFactories, and what it is used for.
+///
+/// A report is filled in by passing it to Graph::GetMemoryStats,
+/// GraphState::GetMemoryStats or GraphFactory::GetMemoryStats. Each of these
+/// adds to whatever the report already holds, so one report can total up the
+/// memory used by a whole level:
+///
+/// ~~~{.cpp}
+///     breadboard::MemoryStats stats;
+///     graph_factory.GetMemoryStats(&stats);
+///     for (size_t i = 0; i < graph_states.size(); ++i) {
+///       graph_states[i]->GetMemoryStats(&stats);
+///     }
+///     assert(stats.total_bytes <= kLevelMemoryBudget);
+/// ~~~
+///
+/// The sizes are estimates. Heap memory is counted by the capacity of the
+/// containers that own it, without allocator overhead, and the heap memory
+/// owned by edge values is only counted for types that have registered a
+/// memory usage function with TypeRegistry::RegisterMemoryUsageFunc.
+struct MemoryStats {
+  MemoryStats()
+      : total_bytes(0),
+        graph_bytes(0),
+        graph_state_bytes(0),
+        graph_factory_bytes(0),
+        base_node_bytes(0),
+        heap_value_bytes(0),
+        module_bytes(),
+        node_bytes(),
+        type_bytes() {}
+
+  /// @brief The total number of bytes counted.
+  size_t total_bytes;
+
+  /// @brief The bytes used by Graphs, including their BaseNode objects and
+  /// default values.
+  size_t graph_bytes;
+
+  /// @brief The bytes used by GraphStates, including their output buffers.
+  size_t graph_state_bytes;
+
+  /// @brief The bytes used by GraphFactories for their own bookkeeping, not
+  /// counting the graphs they have cached.
+  size_t graph_factory_bytes;
+
+  /// @brief The bytes used by the BaseNode objects of Graphs. These are also
+  /// counted in graph_bytes.
+  size_t base_node_bytes;
+
+  /// @brief The heap memory owned by default values and output edge values,
+  /// such as the characters of strings. These are also counted in graph_bytes
+  /// and graph_state_bytes.
+  size_t heap_value_bytes;
+
+  /// @brief The bytes used by the nodes of each module, by module name.
+  std::map<std::string, size_t> module_bytes;
+
+  /// @brief The bytes used by the nodes of each type, by `module:node` name.
+  ///
+  /// This counts the Node, its edges and BaseNode in the Graph, and its
+  /// timestamps, edge values, listeners and state in each GraphState.
+  std::map<std::string, size_t> node_bytes;
+
+  /// @brief The bytes used by the default values and output edge values of
+  /// each edge type, including the heap memory they own, by type name.
+  std::map<std::string, size_t> type_bytes;
+
+  /// @brief Add the totals and breakdowns of another report to this one.
+  ///
+  /// @param[in] other The report to add.
+  void Add(const MemoryStats& other);
+
+  /// @cond BREADBOARD_INTERNAL
+  /// @brief Count bytes used by a node with the given signature.
+  void AddNodeBytes(const NodeSignature* signature, size_t bytes);
+
+  /// @brief Count bytes used by a value of the given type.
+  void AddTypeBytes(const Type* type, size_t bytes);
+  /// @endcond
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_MEMORY_STATS_H_
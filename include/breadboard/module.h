@@ -15,7 +15,10 @@
 #ifndef BREADBOARD_MODULE_H_
 #define BREADBOARD_MODULE_H_
 
+#include <cstdint>
+#include <new>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 
 #include "breadboard/base_node.h"
@@ -28,15 +31,27 @@
 
 namespace breadboard {
 
+class ModuleRegistry;
+
 /// @class Module
 ///
 /// A module is a collection of related NodeSignatures. For example, it may make
 /// sense to make a Math module for basic math operations, or an Entity module
 /// for entity operations.
+///
+/// Like the ModuleRegistry, a Module is safe to read from many threads at
+/// once after all of its nodes have been registered.
 class Module {
  public:
   /// @brief Create a Module with the given name.
-  explicit Module(const std::string& module_name) : module_name_(module_name) {}
+  ///
+  /// @param[in] module_name The name of the module.
+  ///
+  /// @param[in] module_registry If not null, the ModuleRegistry to index the
+  ///            signatures of this module's nodes by NodeSignatureId.
+  explicit Module(const std::string& module_name,
+                  ModuleRegistry* module_registry = nullptr)
+      : module_name_(module_name), module_registry_(module_registry) {}
 
   /// @brief Register a node of type DerivedNode.
   ///
@@ -54,20 +69,7 @@ class Module {
   void RegisterNode(const std::string& node_name,
                     const NodeConstructor& constructor,
                     const NodeDestructor& destructor) {
-    auto result = signatures_.insert(std::make_pair(
-        node_name,
-        NodeSignature(&module_name_, node_name, constructor, destructor)));
-    NodeDictionary::iterator iter = result.first;
-
-    bool success = result.second;
-    if (!success) {
-      CallLogFunc(
-          "A node named \"%s\" has already been registered in module \"%s\".",
-          node_name.c_str(), module_name_.c_str());
-      return;
-    }
-    NodeSignature* signature = &iter->second;
-    DerivedNode::OnRegister(signature);
+    AddNodeSignature<DerivedNode>(node_name, constructor, destructor);
   }
 
   /// @brief Register a node of type DerivedNode.
@@ -109,7 +111,15 @@ class Module {
   /// @param[in] node_name The name of the new node.
   template <typename DerivedNode>
   void RegisterNode(const std::string& node_name) {
-    return RegisterNode<DerivedNode>(node_name, DefaultNew<DerivedNode>);
+    NodeSignature* signature = AddNodeSignature<DerivedNode>(
+        node_name, DefaultNew<DerivedNode>, DefaultDelete);
+    if (signature) {
+      // Every node is constructed as exactly a DerivedNode, so Execute can be
+      // called without going through the virtual function table, and the
+      // Graph can construct them in its own memory.
+      signature->set_execute_func(DirectExecute<DerivedNode>);
+      signature->set_placement_new_func(PlacementNew<DerivedNode>);
+    }
   }
 
   /// @brief Returns a pointer to the NodeSignature for a registered node.
@@ -129,6 +139,42 @@ class Module {
  private:
   typedef std::unordered_map<std::string, NodeSignature> NodeDictionary;
 
+  // Add the signature of a node of type DerivedNode. Returns the signature, or
+  // null if a node of that name has already been registered.
+  template <typename DerivedNode>
+  NodeSignature* AddNodeSignature(const std::string& node_name,
+                                  const NodeConstructor& constructor,
+                                  const NodeDestructor& destructor) {
+    auto result = signatures_.insert(std::make_pair(
+        node_name,
+        NodeSignature(&module_name_, node_name, constructor, destructor)));
+    NodeDictionary::iterator iter = result.first;
+
+    bool success = result.second;
+    if (!success) {
+      CallLogFunc(
+          "A node named \"%s\" has already been registered in module \"%s\".",
+          node_name.c_str(), module_name_.c_str());
+      return nullptr;
+    }
+    NodeSignature* signature = &iter->second;
+    signature->set_base_node_size(sizeof(DerivedNode));
+    signature->set_base_node_alignment(std::alignment_of<DerivedNode>::value);
+    DerivedNode::OnRegister(signature);
+    if (module_registry_) {
+      IndexNodeSignature(signature);
+    }
+    return signature;
+  }
+
+  // Add the signature to the ModuleRegistry's index of NodeSignatureIds.
+  void IndexNodeSignature(const NodeSignature* signature);
+
+  template <typename DerivedNode>
+  static void DirectExecute(BaseNode* base_node, NodeArguments* args) {
+    static_cast<DerivedNode*>(base_node)->DerivedNode::Execute(args);
+  }
+
   template <typename DerivedNode>
   static BaseNode* DefaultNew() {
     return new DerivedNode();
@@ -136,8 +182,14 @@ class Module {
 
   static void DefaultDelete(BaseNode* object) { delete object; }
 
+  template <typename DerivedNode>
+  static BaseNode* PlacementNew(uint8_t* ptr) {
+    return new (ptr) DerivedNode();
+  }
+
   std::string module_name_;
   NodeDictionary signatures_;
+  ModuleRegistry* module_registry_;
 };
 
 }  // namespace breadboard
@@ -17,6 +17,8 @@
 
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "breadboard/module.h"
 #include "breadboard/version.h"
@@ -31,6 +33,10 @@ namespace breadboard {
 /// @brief The ModuleRegistry is a collection of Modules.
 ///
 /// This acts as a central repository for all modules used in your project.
+///
+/// Registering modules is not thread safe. Once every module has been
+/// registered, looking them up with GetModule may be done from any number of
+/// threads at once, as GraphFactory::LoadGraphAsync does.
 class ModuleRegistry {
  public:
   /// Construct a ModuleRegistry.
@@ -50,17 +56,38 @@ class ModuleRegistry {
   /// @return a pointer to a module given its name.
   const Module* GetModule(const std::string& module_name) const;
 
+  /// @brief Returns the NodeSignature with the given ID.
+  ///
+  /// Every node registered with a Module of this ModuleRegistry can be found
+  /// by the NodeSignatureId made from its module and node names. This is a
+  /// binary search over a flat array, so it avoids hashing the names.
+  ///
+  /// @param[in] id The NodeSignatureId of the node.
+  ///
+  /// @return The NodeSignature with that ID, or null if there is none, in
+  ///         which case an error is logged.
+  const NodeSignature* GetNodeSignature(NodeSignatureId id) const;
+
   /// @brief Returns the current Breadboard version structure.
   ///
   /// @return The current Breadboard version structure.
   const BreadboardVersion* version() const { return version_; }
 
  private:
+  friend class Module;
+
   typedef std::unordered_map<std::string, Module> ModuleDictionary;
+  typedef std::pair<NodeSignatureId, const NodeSignature*> SignatureIndexEntry;
+
+  // Add a newly registered signature to signature_index_.
+  void AddNodeSignatureId(const NodeSignature* signature);
 
   // The dictionary of modules, keyed by name.
   ModuleDictionary modules_;
 
+  // Every registered NodeSignature, sorted by ID.
+  std::vector<SignatureIndexEntry> signature_index_;
+
   // Current version of Breadboard.
   const BreadboardVersion* version_;
 };
@@ -0,0 +1,213 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_MODULES_LOOP_H_
+#define BREADBOARD_MODULES_LOOP_H_
+
+#include <memory>
+#include <string>
+
+#include "breadboard/base_node.h"
+#include "breadboard/event.h"
+#include "breadboard/graph_factory.h"
+#include "breadboard/graph_state.h"
+#include "breadboard/log.h"
+#include "breadboard/module_registry.h"
+#include "breadboard/node.h"
+
+/// @file breadboard/modules/loop.h
+///
+/// @brief Initialize the loop module, and register loops over other types.
+
+namespace breadboard {
+
+/// @brief Broadcast by a for_each node to the graph it runs, once for each
+/// element of its collection.
+BREADBOARD_DECLARE_EVENT(kLoopIterationEventId)
+
+/// @brief The payload of a kLoopIterationEventId event.
+template <typename T>
+struct LoopIteration {
+  LoopIteration(const T& element_, int index_)
+      : element(element_), index(index_) {}
+
+  /// @brief The current element of the collection.
+  T element;
+
+  /// @brief The index of the current element in the collection.
+  int index;
+};
+
+/// @class ForEachNode
+///
+/// @brief Runs a graph once for each element of a collection.
+///
+/// When triggered, the graph named by the Body input is loaded through the
+/// GraphFactory, if it has not been already, and each element of the
+/// collection is broadcast to it in turn. The body sees each element through
+/// the outputs of its LoopElementNode, and runs to completion before the next
+/// one is broadcast, all within this node's Execute. The Done output fires
+/// once every element has been visited.
+///
+/// Each instance of the node keeps its own GraphState of the body, which lasts
+/// as long as the instance does, so the body can remember things from one
+/// element, or one trigger, to the next.
+template <typename T>
+class ForEachNode : public BaseNode {
+ public:
+  enum { kInputTrigger, kInputCollection, kInputBody };
+  enum { kOutputDone };
+
+  struct ForEachState {
+    ForEachState() : loaded(false) {}
+
+    bool loaded;
+    std::string body_name;
+    NodeEventBroadcaster broadcaster;
+    // Declared after the broadcaster, so that its listeners are unlinked
+    // before the broadcaster goes away.
+    std::unique_ptr<GraphState> body;
+
+   private:
+    // Disallow copying.
+    ForEachState(const ForEachState&);
+    ForEachState& operator=(const ForEachState&);
+  };
+
+  explicit ForEachNode(GraphFactory* graph_factory)
+      : graph_factory_(graph_factory) {}
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<void>(kInputTrigger, "Trigger");
+    node_sig->AddInput<ArrayRef<const T>>(kInputCollection, "Collection");
+    node_sig->AddInput<std::string>(kInputBody, "Body",
+                                    "The file name of the graph to run for "
+                                    "each element");
+    node_sig->AddOutput<void>(kOutputDone, "Done");
+    node_sig->SetState<ForEachState>();
+    node_sig->set_thread_safe(false);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    if (!args->IsInputDirty(kInputTrigger)) {
+      return;
+    }
+    ForEachState* state = args->GetState<ForEachState>();
+    auto body_name = args->GetInput<std::string>(kInputBody);
+    if (!state->loaded || state->body_name != *body_name) {
+      // Only try to load each body once, rather than every time the node is
+      // triggered.
+      state->loaded = true;
+      state->body_name = *body_name;
+      state->body.reset();
+      Graph* body_graph = graph_factory_->LoadGraph(body_name->c_str());
+      if (body_graph) {
+        state->body.reset(new GraphState());
+        state->body->Initialize(body_graph);
+        state->body->BindListeners(kLoopIterationEventId, &state->broadcaster);
+      } else {
+        CallLogFunc("Could not load graph \"%s\" to run for each element.",
+                    body_name->c_str());
+      }
+    }
+    if (!state->body) {
+      return;
+    }
+
+    static const EventIndex event_index = GetEventIndex(kLoopIterationEventId);
+    auto collection = args->GetInput<ArrayRef<const T>>(kInputCollection);
+    for (size_t i = 0; i < collection->size(); ++i) {
+      state->broadcaster.BroadcastEventIndex(
+          event_index,
+          LoopIteration<T>((*collection)[i], static_cast<int>(i)));
+    }
+    args->SetOutput(kOutputDone);
+  }
+
+ private:
+  GraphFactory* graph_factory_;
+};
+
+/// @class LoopElementNode
+///
+/// @brief Outputs the element that a ForEachNode is visiting, in the graph
+///        it runs.
+template <typename T>
+class LoopElementNode : public BaseNode {
+ public:
+  enum { kOutputElement, kOutputIndex };
+  enum { kListenerIteration };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddOutput<T>(kOutputElement, "Element");
+    node_sig->AddOutput<int>(kOutputIndex, "Index");
+    node_sig->AddListener(kListenerIteration, kLoopIterationEventId);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    const LoopIteration<T>* iteration =
+        args->GetListenerPayload<LoopIteration<T>>(kListenerIteration);
+    if (iteration) {
+      args->SetOutput(kOutputElement, iteration->element);
+      args->SetOutput(kOutputIndex, iteration->index);
+    }
+  }
+};
+
+/// @brief Register nodes that loop over collections of the given type.
+///
+/// This registers `for_each_<type_name>`, a ForEachNode, and
+/// `<type_name>_element`, the LoopElementNode to use in the graphs it runs.
+/// Collections are passed around as an `ArrayRef<const T>`, which must have
+/// been registered with the TypeRegistry first, and which refers to elements
+/// owned by the node that output it:
+///
+/// ~~~{.cpp}
+///     TypeRegistry<ArrayRef<const EntityRef>>::RegisterType("EntityList");
+///     RegisterLoopNodes<EntityRef>(module, graph_factory, "entity");
+/// ~~~
+///
+/// @param[in,out] module The module to register the nodes in.
+///
+/// @param[in] graph_factory The GraphFactory used to load the graphs that
+/// for_each runs. It must outlive the module.
+///
+/// @param[in] type_name The name to give the nodes.
+template <typename T>
+void RegisterLoopNodes(Module* module, GraphFactory* graph_factory,
+                       const std::string& type_name) {
+  auto for_each_ctor = [graph_factory]() {
+    return new ForEachNode<T>(graph_factory);
+  };
+  module->RegisterNode<ForEachNode<T>>("for_each_" + type_name, for_each_ctor);
+  module->RegisterNode<LoopElementNode<T>>(type_name + "_element");
+}
+
+/// @brief Initialize the loop module.
+///
+/// This registers the `IntList` type, a `range` node that outputs a list of
+/// consecutive integers, and the loop nodes for `int`. The common modules must
+/// have been initialized first.
+///
+/// @param[in,out] module_registry The ModuleRegistry that will hold the module
+/// registered by this function.
+///
+/// @param[in] graph_factory The GraphFactory used to load the graphs that
+/// for_each nodes run.
+void InitializeLoopModule(ModuleRegistry* module_registry,
+                          GraphFactory* graph_factory);
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_MODULES_LOOP_H_
@@ -0,0 +1,37 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_MODULES_TIMER_H_
+#define BREADBOARD_MODULES_TIMER_H_
+
+#include "breadboard/module_registry.h"
+
+/// @file breadboard/modules/timer.h
+///
+/// @brief Initialize the timer module.
+
+namespace breadboard {
+
+/// @brief Initialize the timer module.
+///
+/// The nodes in this module wait on the TimerWheel of their GraphState, which
+/// must be set with GraphState::set_timer_wheel.
+///
+/// @param[in,out] module_registry The ModuleRegistry that will hold the module
+/// registered by this function.
+void InitializeTimerModule(ModuleRegistry* module_registry);
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_MODULES_TIMER_H_
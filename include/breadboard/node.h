@@ -19,6 +19,7 @@
 #include <cstddef>
 #include <vector>
 
+#include "breadboard/dirty_bitset.h"
 #include "breadboard/type.h"
 
 /// @file breadboard/node.h
@@ -30,6 +31,7 @@ namespace breadboard {
 class Node;
 class NodeSignature;
 class BaseNode;
+class NodeArguments;
 class OutputEdge;
 
 /// @cond BREADBOARD_INTERNAL
@@ -40,6 +42,40 @@ static const unsigned int kInvalidNodeIndex = static_cast<unsigned int>(-1);
 /// @brief A special value representing an invalid edge index.
 static const unsigned int kInvalidEdgeIndex = static_cast<unsigned int>(-1);
 
+/// @brief An ArrayRef refers to a contiguous run of objects owned by someone
+/// else.
+///
+/// Once a Graph has been finalized, the edges of all of its nodes are packed
+/// into a handful of arrays owned by the Graph, and each node refers to its
+/// own slice of them.
+///
+/// An `ArrayRef<const T>` can also be registered as an edge type, to pass a
+/// collection from one node to another without copying it. The elements must
+/// be owned by the node that outputs it, usually in its state, and stay valid
+/// until that node executes again. See breadboard/modules/loop.h.
+template <typename T>
+class ArrayRef {
+ public:
+  ArrayRef() : data_(nullptr), size_(0) {}
+  ArrayRef(T* data, size_t size) : data_(data), size_(size) {}
+
+  T* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  T* begin() const { return data_; }
+  T* end() const { return data_ + size_; }
+
+  T& operator[](size_t index) const {
+    assert(index < size_);
+    return data_[index];
+  }
+
+ private:
+  T* data_;
+  size_t size_;
+};
+
 /// @brief An OutputEdgeTarget represents a specific output edge on a node in a
 /// graph.
 ///
@@ -118,11 +154,19 @@ class InputEdge {
 /// will be updated as well.
 class OutputEdge {
  public:
-  OutputEdge() : connected_(false), timestamp_offset_(0), data_offset_(0) {}
+  OutputEdge()
+      : connected_(false), aliased_(false), timestamp_offset_(0),
+        data_offset_(0), dirty_bit_(0) {}
 
   bool connected() const { return connected_; }
   void set_connected(bool connected) { connected_ = connected; }
 
+  /// True if the data belongs to the output edge feeding one of this node's
+  /// inputs, as declared by NodeSignature::SetOutputAlias. The data is then
+  /// never constructed, copied or destroyed through this edge.
+  bool aliased() const { return aliased_; }
+  void set_aliased(bool aliased) { aliased_ = aliased; }
+
   void set_timestamp_offset(ptrdiff_t timestamp_offset) {
     timestamp_offset_ = timestamp_offset;
   }
@@ -131,11 +175,51 @@ class OutputEdge {
   void set_data_offset(ptrdiff_t data_offset) { data_offset_ = data_offset; }
   ptrdiff_t data_offset() const { return data_offset_; }
 
+  /// The bit set in the GraphState's DirtyBitset when this edge is set, if
+  /// the Graph uses kDirtyTrackingBitset.
+  void set_dirty_bit(unsigned int dirty_bit) { dirty_bit_ = dirty_bit; }
+  unsigned int dirty_bit() const { return dirty_bit_; }
+
+  /// The positions in Graph::sorted_nodes() of the nodes that have an input
+  /// edge connected to this output edge.
+  void set_consumers(const ArrayRef<const unsigned int>& consumers) {
+    consumers_ = consumers;
+  }
+  const ArrayRef<const unsigned int>& consumers() const { return consumers_; }
+
  private:
   bool connected_;
+  bool aliased_;
 
   ptrdiff_t timestamp_offset_;
   ptrdiff_t data_offset_;
+  unsigned int dirty_bit_;
+
+  ArrayRef<const unsigned int> consumers_;
+};
+
+/// @brief A ResolvedInputEdge is where the data for an InputEdge can be found,
+/// worked out once when the graph is finalized.
+///
+/// Reading an InputEdge directly means looking up the node it is connected to
+/// and then that node's output edge before the data can be found. The Graph
+/// stores the resolved edges of every node in one flat array, in sorted order,
+/// so that executing a node only needs to read its own slice of that array.
+struct ResolvedInputEdge {
+  /// True if the data is held in the GraphState's output buffer, or false if
+  /// it is a default value held in the Graph's input buffer.
+  bool connected;
+
+  /// The offset of the data in the buffer that holds it.
+  ptrdiff_t data_offset;
+
+  /// The offset of the connected output edge's timestamp in the GraphState's
+  /// output buffer. Only meaningful if the edge is connected.
+  ptrdiff_t timestamp_offset;
+
+  /// The dirty bit of the connected output edge. Only meaningful if the edge
+  /// is connected and the Graph uses kDirtyTrackingBitset.
+  unsigned int dirty_bit;
 };
 
 /// @brief A Node specifies the connections between nodes in a graph.
@@ -157,9 +241,22 @@ class Node {
 
   /// @brief Return a pointer to the derived type holding this node's behavior.
   ///
-  /// @return A pointer to the derived type holding this node's behavior.
+  /// @return A pointer to the derived type holding this node's behavior, or
+  /// null if the Graph has not been finalized yet.
   BaseNode* base_node() { return base_node_; }
 
+  /// @brief Set the object holding this node's behavior. This is done by the
+  /// Graph when it is finalized.
+  void set_base_node(BaseNode* base_node) { base_node_ = base_node; }
+
+  /// @brief Run this node's Execute function with the given arguments.
+  ///
+  /// This calls the NodeSignature's execute function, which avoids the
+  /// virtual call where it can.
+  ///
+  /// @param[in] args The arguments to execute the node with.
+  void Execute(NodeArguments* args) { execute_func_(base_node_, args); }
+
   /// @brief Return a list of the input edges to this node.
   ///
   /// @return A list of the input edges to this node.
@@ -170,24 +267,71 @@ class Node {
   /// @return A list of the input edges to this node.
   const std::vector<InputEdge>& input_edges() const { return input_edges_; }
 
+  /// @brief Return the resolved locations of this node's input edges.
+  ///
+  /// This points into an array owned by the Graph, and is only valid once the
+  /// Graph's nodes have been finalized.
+  ///
+  /// @return The resolved locations of this node's input edges.
+  const ResolvedInputEdge* resolved_input_edges() const {
+    return resolved_input_edges_;
+  }
+
+  /// @brief Set the resolved locations of this node's input edges.
+  void set_resolved_input_edges(const ResolvedInputEdge* resolved_input_edges) {
+    resolved_input_edges_ = resolved_input_edges;
+  }
+
   /// @brief Return a list of the output edges to this node.
   ///
+  /// This points into an array owned by the Graph, and is empty until the
+  /// Graph's nodes have been finalized.
+  ///
   /// @return A list of the output edges to this node.
-  std::vector<OutputEdge>& output_edges() { return output_edges_; }
+  ArrayRef<OutputEdge> output_edges() { return output_edges_; }
 
-  /// @brief Return a list of the input edges to this node.
+  /// @brief Return a list of the output edges to this node.
   ///
-  /// @return A list of the input edges to this node.
-  const std::vector<OutputEdge>& output_edges() const { return output_edges_; }
+  /// @return A list of the output edges to this node.
+  ArrayRef<const OutputEdge> output_edges() const {
+    return ArrayRef<const OutputEdge>(output_edges_.data(),
+                                      output_edges_.size());
+  }
+
+  /// @brief Set the output edges of this node.
+  void set_output_edges(const ArrayRef<OutputEdge>& output_edges) {
+    output_edges_ = output_edges;
+  }
 
   /// @brief Return a list of the NodeEventListener offsets in this node.
   ///
+  /// This points into an array owned by the Graph, and is empty until the
+  /// Graph's nodes have been finalized.
+  ///
   /// @return A list of the NodeEventListener offsets in this node.
-  std::vector<ptrdiff_t>& listener_offsets() { return listener_offsets_; }
-  const std::vector<ptrdiff_t>& listener_offsets() const {
+  const ArrayRef<const ptrdiff_t>& listener_offsets() const {
     return listener_offsets_;
   }
 
+  /// @brief Set the NodeEventListener offsets of this node.
+  void set_listener_offsets(const ArrayRef<const ptrdiff_t>& listener_offsets) {
+    listener_offsets_ = listener_offsets;
+  }
+
+  /// @brief Return the bits of a GraphState's DirtyBitset that are set when
+  /// this node is dirty.
+  ///
+  /// This points into an array owned by the Graph, and is empty unless the
+  /// Graph uses kDirtyTrackingBitset.
+  ///
+  /// @return The masks to check, one for each word they cover.
+  const ArrayRef<const DirtyMask>& dirty_masks() const { return dirty_masks_; }
+
+  /// @brief Set the DirtyMasks of this node.
+  void set_dirty_masks(const ArrayRef<const DirtyMask>& dirty_masks) {
+    dirty_masks_ = dirty_masks;
+  }
+
   /// @brief Return a list of the NodeEventListener offsets in this node.
   ///
   /// @return A list of the NodeEventListener offsets in this node.
@@ -196,6 +340,13 @@ class Node {
   }
   ptrdiff_t timestamp_offset() const { return timestamp_offset_; }
 
+  /// @brief The offset of this node's per-instance state, if it has any.
+  void set_state_offset(ptrdiff_t state_offset) {
+    state_offset_ = state_offset;
+  }
+  /// @brief The offset of this node's per-instance state, if it has any.
+  ptrdiff_t state_offset() const { return state_offset_; }
+
   /// @brief Used for sorting the nodes in the graph.
   void set_inserted(bool inserted) { inserted_ = inserted; }
   /// @brief Used for sorting the nodes in the graph.
@@ -205,18 +356,47 @@ class Node {
   /// @brief Used for sorting the nodes in the graph.
   bool visited() const { return visited_; }
 
+  /// @brief Whether this node only ever needs to be executed once, because
+  /// its outputs depend only on values that never change.
+  void set_constant(bool constant) { constant_ = constant; }
+  /// @brief Whether this node only ever needs to be executed once, because
+  /// its outputs depend only on values that never change.
+  bool constant() const { return constant_; }
+
+  /// @brief Whether this node can be skipped entirely, because nothing it
+  /// outputs ever reaches a node with side effects.
+  void set_dead(bool dead) { dead_ = dead; }
+  /// @brief Whether this node can be skipped entirely, because nothing it
+  /// outputs ever reaches a node with side effects.
+  bool dead() const { return dead_; }
+
+  /// @brief The position of this node in Graph::sorted_nodes().
+  void set_sorted_index(unsigned int sorted_index) {
+    sorted_index_ = sorted_index;
+  }
+  /// @brief The position of this node in Graph::sorted_nodes().
+  unsigned int sorted_index() const { return sorted_index_; }
+
  private:
   const NodeSignature* signature_;
   BaseNode* base_node_;
+  // The same as NodeSignature::execute_func, kept here to save a load.
+  void (*execute_func_)(BaseNode*, NodeArguments*);
 
   std::vector<InputEdge> input_edges_;
-  std::vector<OutputEdge> output_edges_;
-  std::vector<ptrdiff_t> listener_offsets_;
+  const ResolvedInputEdge* resolved_input_edges_;
+  ArrayRef<OutputEdge> output_edges_;
+  ArrayRef<const ptrdiff_t> listener_offsets_;
+  ArrayRef<const DirtyMask> dirty_masks_;
 
   ptrdiff_t timestamp_offset_;
+  ptrdiff_t state_offset_;
 
+  unsigned int sorted_index_;
   bool inserted_;
   bool visited_;
+  bool constant_;
+  bool dead_;
 };
 
 /// @brief Convenience function to get the type of a node's input edges.
@@ -15,12 +15,20 @@
 #ifndef BREADBOARD_NODE_ARGUMENTS_H_
 #define BREADBOARD_NODE_ARGUMENTS_H_
 
+#include <cassert>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "breadboard/default_value_overlay.h"
+#include "breadboard/dirty_bitset.h"
+#include "breadboard/dirty_node_queue.h"
 #include "breadboard/event.h"
 #include "breadboard/log.h"
 #include "breadboard/memory_buffer.h"
 #include "breadboard/node.h"
+#include "breadboard/node_signature.h"
+#include "breadboard/timer_wheel.h"
 #include "breadboard/type_registry.h"
 
 /// @file breadboard/node_arguments.h
@@ -54,14 +62,45 @@ class NodeArguments {
   /// @param[in] output_memory The MemoryBuffer for the output edges.
   ///
   /// @param[in] timestamp The current timestamp.
+  ///
+  /// @param[in] dirty_node_queue If not null, the consumers of any output edge
+  /// that is set are pushed onto this queue.
+  ///
+  /// @param[in] dirty_bits If not null, the dirty bit of any output edge that
+  /// is set is set in this bitset, and input edges are checked against it.
   NodeArguments(const Node* node, const std::vector<Node>* nodes,
                 MemoryBuffer* input_memory, MemoryBuffer* output_memory,
-                Timestamp timestamp)
+                Timestamp timestamp,
+                DirtyNodeQueue* dirty_node_queue = nullptr,
+                DirtyBitset* dirty_bits = nullptr)
       : node_(node),
         nodes_(nodes),
         input_memory_(input_memory),
         output_memory_(output_memory),
-        timestamp_(timestamp) {}
+        timestamp_(timestamp),
+        dirty_since_(timestamp),
+        dirty_node_queue_(dirty_node_queue),
+        dirty_bits_(dirty_bits),
+        default_values_() {}
+
+  /// @brief Set the oldest timestamp at which a change to an input or
+  ///        listener still counts as dirty.
+  ///
+  /// By default only changes made at the current timestamp are dirty. A node
+  /// evaluated in kExecutionModePull may not have run for several
+  /// timestamps, and needs to see everything that changed since it last did.
+  ///
+  /// @param[in] dirty_since The oldest timestamp that counts as dirty.
+  void set_dirty_since(Timestamp dirty_since) { dirty_since_ = dirty_since; }
+
+  /// @brief Set the values that replace some of the default values in the
+  ///        input memory.
+  ///
+  /// @param[in] default_values The values of the GraphState's
+  ///            DefaultValueOverlay, sorted by offset.
+  void set_default_values(ArrayRef<const ResolvedDefaultValue> default_values) {
+    default_values_ = default_values;
+  }
   /// @endcond BREADBOARD_INTERNAL
 
   /// @brief Returns the value of this input edge.
@@ -88,15 +127,7 @@ class NodeArguments {
   template <typename EdgeType>
   EdgeType* GetInput(size_t argument_index) const {
     VerifyInputPreconditions(argument_index, TypeRegistry<EdgeType>::GetType());
-
-    const InputEdge& input_edge = node_->input_edges()[argument_index];
-    if (input_edge.connected()) {
-      const OutputEdgeTarget& target_edge = input_edge.target();
-      const OutputEdge& output_edge = target_edge.GetTargetEdge(nodes_);
-      return output_memory_->GetObject<EdgeType>(output_edge.data_offset());
-    } else {
-      return input_memory_->GetObject<EdgeType>(input_edge.data_offset());
-    }
+    return GetVerifiedInput<EdgeType>(argument_index);
   }
 
   /// @brief Returns true if the given input argument index has been modified
@@ -113,6 +144,66 @@ class NodeArguments {
   /// broadcaster since the last execution of this graph.
   bool IsListenerDirty(size_t listener_index) const;
 
+  /// @brief Returns the number of payloads that the given listener has
+  /// received along with its events since the last execution of this graph.
+  ///
+  /// Payloads are sent with NodeEventBroadcaster::BroadcastEvent. Events
+  /// broadcast without one are not counted.
+  ///
+  /// @param listener_index The index of the listener.
+  ///
+  /// @return The number of payloads available to GetListenerPayload.
+  size_t GetListenerPayloadCount(size_t listener_index) const {
+    return GetListenerPayloads(listener_index).size();
+  }
+
+  /// @brief Returns one of the payloads that the given listener has received
+  /// since the last execution of this graph.
+  ///
+  /// Payloads are numbered in the order they were broadcast, so a node can
+  /// handle every collision of a frame rather than just the last one:
+  ///
+  /// ~~~{.cpp}
+  ///     size_t count = args->GetListenerPayloadCount(kOnCollision);
+  ///     for (size_t i = 0; i < count; ++i) {
+  ///       const CollisionData* collision =
+  ///           args->GetListenerPayload<CollisionData>(kOnCollision, i);
+  ///       ...
+  ///     }
+  /// ~~~
+  ///
+  /// The template argument must match the type of the payload.
+  ///
+  /// @param listener_index The index of the listener.
+  ///
+  /// @param payload_index The index of the payload, which must be less than
+  /// GetListenerPayloadCount.
+  ///
+  /// @return A pointer to the payload.
+  template <typename PayloadType>
+  const PayloadType* GetListenerPayload(size_t listener_index,
+                                        size_t payload_index) const {
+    ArrayRef<const EventPayload> payloads = GetListenerPayloads(listener_index);
+    assert(payload_index < payloads.size());
+    VerifyPayloadPreconditions(listener_index, payloads[payload_index],
+                               TypeRegistry<PayloadType>::GetType());
+    return static_cast<const PayloadType*>(payloads[payload_index].data);
+  }
+
+  /// @brief Returns the most recent payload that the given listener has
+  /// received since the last execution of this graph.
+  ///
+  /// @param listener_index The index of the listener.
+  ///
+  /// @return A pointer to the payload, or null if there is none.
+  template <typename PayloadType>
+  const PayloadType* GetListenerPayload(size_t listener_index) const {
+    size_t count = GetListenerPayloadCount(listener_index);
+    return count > 0 ? GetListenerPayload<PayloadType>(listener_index,
+                                                       count - 1)
+                     : nullptr;
+  }
+
   /// @brief Sets the value of the specified output edge.
   ///
   /// Each node has number of typed outputs (specified by the NodeSignature).
@@ -140,23 +231,69 @@ class NodeArguments {
   /// @param value The value to set this output edge to.
   template <typename EdgeType>
   void SetOutput(size_t argument_index, const EdgeType& value) {
-    VerifyOutputPreconditions(argument_index,
-                              TypeRegistry<EdgeType>::GetType());
-
-    const OutputEdge& output_edge = node_->output_edges()[argument_index];
-    if (!output_edge.connected()) {
-      // Nothing is consuming this output, so no need to store it.
-      return;
+    EdgeType* data = PrepareOutput(argument_index, &value);
+    if (data) {
+      *data = value;
     }
+  }
 
-    // Mark that this value has changed.
-    Timestamp* timestamp =
-        output_memory_->GetObject<Timestamp>(output_edge.timestamp_offset());
-    *timestamp = timestamp_;
+  /// @brief Sets the value of the specified output edge by moving the given
+  /// value into it.
+  ///
+  /// This overload is chosen automatically when the value is a temporary, and
+  /// otherwise behaves the same as SetOutput(size_t, const EdgeType&):
+  ///
+  /// ~~~{.cpp}
+  ///     std::string result = ...
+  ///     outputs.SetOutput(0, std::move(result));
+  /// ~~~
+  ///
+  /// @param argument_index The index of the input edge. Node that the template
+  /// argument of this index must match the one specified in the NodeSignature.
+  ///
+  /// @param value The value to move into this output edge.
+  template <typename EdgeType>
+  typename std::enable_if<!std::is_reference<EdgeType>::value &&
+                          !std::is_const<EdgeType>::value>::type
+  SetOutput(size_t argument_index, EdgeType&& value) {
+    EdgeType* data = PrepareOutput(argument_index, &value);
+    if (data) {
+      *data = std::move(value);
+    }
+  }
 
-    EdgeType* data =
-        output_memory_->GetObject<EdgeType>(output_edge.data_offset());
-    *data = value;
+  /// @brief Returns a pointer to the value held by the specified output edge
+  /// and marks it dirty.
+  ///
+  /// This allows a node to update an output in place, reusing any memory the
+  /// previous value had allocated, rather than building a new value and
+  /// copying it in:
+  ///
+  /// ~~~{.cpp}
+  ///     std::string* result = args->GetMutableOutput<std::string>(0);
+  ///     if (result) {
+  ///       result->assign(*str_a);
+  ///       result->append(*str_b);
+  ///     }
+  /// ~~~
+  ///
+  /// The edge is always marked dirty, even if the node suppresses unchanged
+  /// outputs, since the value can not be compared before it is modified.
+  /// Outputs that alias an input (see NodeSignature::SetOutputAlias) share
+  /// that input's storage, so they must be set with SetOutput instead.
+  ///
+  /// @param argument_index The index of the output edge. Node that the
+  /// template argument of this index must match the one specified in the
+  /// NodeSignature.
+  ///
+  /// @return A pointer to the value of the given output edge, or null if the
+  /// edge is not connected to any inputs, in which case there is nowhere to
+  /// store the value.
+  template <typename EdgeType>
+  EdgeType* GetMutableOutput(size_t argument_index) {
+    VerifyOutputPreconditions(argument_index,
+                              TypeRegistry<EdgeType>::GetType());
+    return GetVerifiedMutableOutput<EdgeType>(argument_index);
   }
 
   /// @brief Marks an output edge as dirty without updating its value.
@@ -175,17 +312,25 @@ class NodeArguments {
   /// argument of this index must be `void`.
   void SetOutput(size_t argument_index) {
     VerifyOutputPreconditions(argument_index, TypeRegistry<void>::GetType());
+    SetVerifiedOutput(argument_index);
+  }
 
-    const OutputEdge& output_edge = node_->output_edges()[argument_index];
-    if (!output_edge.connected()) {
-      // Nothing is consuming this output, so no need to store it.
-      return;
-    }
-
-    // Mark that this value has changed.
-    Timestamp* timestamp =
-        output_memory_->GetObject<Timestamp>(output_edge.timestamp_offset());
-    *timestamp = timestamp_;
+  /// @brief Returns this node's per-instance state in the current GraphState.
+  ///
+  /// The state type must have been declared with NodeSignature::SetState, and
+  /// the template argument must match it. Typical usage would look like this:
+  ///
+  /// ~~~{.cpp}
+  ///     CounterState* state = args->GetState<CounterState>();
+  ///     state->count++;
+  /// ~~~
+  ///
+  /// @return A pointer to this node's per-instance state.
+  template <typename StateType>
+  StateType* GetState() const {
+    VerifyStatePreconditions(sizeof(StateType),
+                             std::alignment_of<StateType>::value);
+    return output_memory_->GetObject<StateType>(node_->state_offset());
   }
 
   /// @brief Binds the given broadcasater to the listener at the given index.
@@ -196,15 +341,234 @@ class NodeArguments {
   ///
   /// @param listener_index The index of the listener.
   ///
-  /// @param broadcaster The broadcaster to bind the given listener to.
+  /// @param broadcaster The broadcaster to bind the given listener to. If this
+  /// is null, the listener is unbound instead.
   void BindBroadcaster(size_t listener_index,
                        NodeEventBroadcaster* broadcaster) {
-    NodeEventListener* listener = output_memory_->GetObject<NodeEventListener>(
-        node_->listener_offsets()[listener_index]);
-    broadcaster->RegisterListener(listener);
+    if (broadcaster) {
+      broadcaster->RegisterListener(GetListener(listener_index));
+    } else {
+      UnbindBroadcaster(listener_index);
+    }
+  }
+
+  /// @brief Binds the listener at the given index to the broadcaster of an
+  /// input, looking the broadcaster up only when it may have changed.
+  ///
+  /// The listener lives with the rest of this node's data in the GraphState,
+  /// and remembers which broadcaster it is bound to. As long as it is bound
+  /// and the input has not changed since the last execution, this does
+  /// nothing and `get_broadcaster` is not called. Otherwise the listener is
+  /// bound to the broadcaster returned by `get_broadcaster`, or unbound if it
+  /// returns null. There is no need to unbind when the GraphState goes away,
+  /// as its listeners unlink themselves when they are destroyed.
+  ///
+  /// This can be called from both Initialize and Execute:
+  ///
+  /// ~~~{.cpp}
+  ///     virtual void Execute(NodeArguments* args) {
+  ///       args->BindBroadcasterToInput(
+  ///           kListenerOnCollision, kInputEntity, [this, args]() {
+  ///             auto entity = args->GetInput<EntityRef>(kInputEntity);
+  ///             return graph_component_->GetCreateBroadcaster(*entity);
+  ///           });
+  ///       ...
+  ///     }
+  /// ~~~
+  ///
+  /// @param listener_index The index of the listener.
+  ///
+  /// @param input_index The index of the input that determines which
+  /// broadcaster the listener is bound to.
+  ///
+  /// @param get_broadcaster A function taking no arguments that returns the
+  /// NodeEventBroadcaster to bind to.
+  ///
+  /// @return True if the listener was bound again.
+  template <typename GetBroadcasterFunc>
+  bool BindBroadcasterToInput(size_t listener_index, size_t input_index,
+                              const GetBroadcasterFunc& get_broadcaster) {
+    if (GetBoundBroadcaster(listener_index) && !IsInputDirty(input_index)) {
+      return false;
+    }
+    BindBroadcaster(listener_index, get_broadcaster());
+    return true;
+  }
+
+  /// @brief Unbinds the listener at the given index from its broadcaster, if
+  /// it has one.
+  ///
+  /// @param listener_index The index of the listener.
+  void UnbindBroadcaster(size_t listener_index);
+
+  /// @brief Returns the broadcaster the listener at the given index is bound
+  /// to.
+  ///
+  /// @param listener_index The index of the listener.
+  ///
+  /// @return The broadcaster the listener is bound to, or null if it is not
+  /// bound to one.
+  NodeEventBroadcaster* GetBoundBroadcaster(size_t listener_index) const {
+    return GetListener(listener_index)->bound_broadcaster();
+  }
+
+  /// @brief Sets a timer that marks the listener at the given index dirty
+  /// once the given number of ticks have passed.
+  ///
+  /// The timer is set in the GraphState's TimerWheel; see
+  /// GraphState::set_timer_wheel. The listener should be listening for
+  /// kTimerEventId. A timer that has already been set on it is replaced, and
+  /// if it was bound to a broadcaster, it is unbound.
+  ///
+  /// @param listener_index The index of the listener.
+  ///
+  /// @param ticks The number of ticks to wait. This is at least one.
+  void SetTimer(size_t listener_index, Tick ticks);
+
+  /// @brief Sets a timer that marks the listener at the given index dirty
+  /// once the given amount of time has passed.
+  ///
+  /// This is the same as SetTimer, but the time is rounded up to a whole
+  /// number of ticks.
+  ///
+  /// @param listener_index The index of the listener.
+  ///
+  /// @param seconds The number of seconds to wait.
+  void SetTimerSeconds(size_t listener_index, double seconds);
+
+  /// @brief Cancels the timer on the listener at the given index, if it has
+  /// one.
+  ///
+  /// @param listener_index The index of the listener.
+  void CancelTimer(size_t listener_index);
+
+  /// @brief Returns true if the listener at the given index is waiting for
+  /// its timer to fire.
+  ///
+  /// @param listener_index The index of the listener.
+  ///
+  /// @return Whether the listener has a timer set.
+  bool IsTimerSet(size_t listener_index) const {
+    return GetListener(listener_index)->waiting_on_timer();
   }
 
  private:
+  friend class NodeBatchArguments;
+  template <typename InputList, typename OutputList, typename ListenerList>
+  friend class TypedNode;
+
+  // The accessors below skip the checks on the index and type, for callers
+  // that have already made sure of them.
+
+  template <typename EdgeType>
+  EdgeType* GetVerifiedInput(size_t argument_index) const {
+    const ResolvedInputEdge& input_edge =
+        node_->resolved_input_edges()[argument_index];
+    if (input_edge.connected) {
+      return output_memory_->GetObject<EdgeType>(input_edge.data_offset);
+    }
+    return GetVerifiedDefaultValue<EdgeType>(input_edge.data_offset);
+  }
+
+  // Returns the default value at the given offset in the input memory, or
+  // the value that overrides it.
+  template <typename EdgeType>
+  EdgeType* GetVerifiedDefaultValue(ptrdiff_t data_offset) const {
+    if (!default_values_.empty()) {
+      uint8_t* data = FindDefaultValue(data_offset);
+      if (data) {
+        return reinterpret_cast<EdgeType*>(data);
+      }
+    }
+    return input_memory_->GetObject<EdgeType>(data_offset);
+  }
+
+  // Returns the value that overrides the default value at the given offset
+  // in the input memory, or null if there is none.
+  uint8_t* FindDefaultValue(ptrdiff_t data_offset) const;
+
+  template <typename EdgeType>
+  EdgeType* GetVerifiedMutableOutput(size_t argument_index) {
+    const OutputEdge& output_edge = node_->output_edges()[argument_index];
+    if (!output_edge.connected()) {
+      return nullptr;
+    }
+    // Writing through an aliased edge would change the value of the edge it
+    // shares storage with, upstream of this node.
+    assert(!output_edge.aliased());
+
+    MarkOutputDirty(output_edge);
+    return output_memory_->GetObject<EdgeType>(output_edge.data_offset());
+  }
+
+  void SetVerifiedOutput(size_t argument_index) {
+    const OutputEdge& output_edge = node_->output_edges()[argument_index];
+    if (!output_edge.connected()) {
+      // Nothing is consuming this output, so no need to store it.
+      return;
+    }
+
+    MarkOutputDirty(output_edge);
+  }
+
+  // Mark that the value of this output edge has changed, and queue up the
+  // nodes that consume it if there is a queue to put them on.
+  void MarkOutputDirty(const OutputEdge& output_edge) {
+    Timestamp* timestamp =
+        output_memory_->GetObject<Timestamp>(output_edge.timestamp_offset());
+    *timestamp = timestamp_;
+    if (dirty_bits_) {
+      dirty_bits_->Set(output_edge.dirty_bit());
+    }
+    if (dirty_node_queue_) {
+      const ArrayRef<const unsigned int>& consumers = output_edge.consumers();
+      for (size_t i = 0; i < consumers.size(); ++i) {
+        dirty_node_queue_->Push(consumers[i]);
+      }
+    }
+  }
+
+  // Get ready to store the given value in an output edge. Returns the storage
+  // for the edge, which has been marked dirty, or null if the value does not
+  // need to be stored.
+  template <typename EdgeType>
+  EdgeType* PrepareOutput(size_t argument_index, const EdgeType* value) {
+    VerifyOutputPreconditions(argument_index,
+                              TypeRegistry<EdgeType>::GetType());
+    return PrepareVerifiedOutput(argument_index, value);
+  }
+
+  // Same as PrepareOutput, for an output that has already been verified.
+  template <typename EdgeType>
+  EdgeType* PrepareVerifiedOutput(size_t argument_index,
+                                  const EdgeType* value) {
+    const OutputEdge& output_edge = node_->output_edges()[argument_index];
+    if (!output_edge.connected()) {
+      // Nothing is consuming this output, so no need to store it.
+      return nullptr;
+    }
+
+    if (output_edge.aliased()) {
+      // The edge already holds the value of the input it aliases.
+      MarkOutputDirty(output_edge);
+      return nullptr;
+    }
+
+    if (node_->signature()->suppress_unchanged_outputs() &&
+        IsOutputUnchanged(argument_index, output_edge,
+                          reinterpret_cast<const uint8_t*>(value))) {
+      return nullptr;
+    }
+
+    MarkOutputDirty(output_edge);
+    return output_memory_->GetObject<EdgeType>(output_edge.data_offset());
+  }
+
+  // Returns true if the output edge has been set before and already holds the
+  // given value, according to its type's equality function.
+  bool IsOutputUnchanged(size_t argument_index, const OutputEdge& output_edge,
+                         const uint8_t* value) const;
+
   // Check to make sure the argument index is in range and the type being
   // retrieved is the type expected.
   void VerifyInputPreconditions(size_t argument_index,
@@ -217,11 +581,43 @@ class NodeArguments {
 
   void VerifyListenerPreconditions(size_t listener_index) const;
 
+  // Returns the TimerWheel of the GraphState, logging an error if there is
+  // none.
+  TimerWheel* GetTimerWheel(size_t listener_index) const;
+
+  // Returns true if a change made at the given timestamp is dirty.
+  bool IsTimestampDirty(Timestamp timestamp) const {
+    return timestamp >= dirty_since_ && timestamp <= timestamp_;
+  }
+
+  // Returns the listener at the given index.
+  NodeEventListener* GetListener(size_t listener_index) const {
+    return output_memory_->GetObject<NodeEventListener>(
+        node_->listener_offsets()[listener_index]);
+  }
+
+  // Returns the payloads the listener has received, or nothing if it has not
+  // been signaled since the last execution.
+  ArrayRef<const EventPayload> GetListenerPayloads(
+      size_t listener_index) const;
+
+  // Check to make sure the payload is of the type being retrieved.
+  void VerifyPayloadPreconditions(size_t listener_index,
+                                  const EventPayload& payload,
+                                  const Type* requested_type) const;
+
+  // Check to make sure the node has a state of the expected size and alignment.
+  void VerifyStatePreconditions(size_t size, size_t alignment) const;
+
   const Node* node_;
   const std::vector<Node>* nodes_;
   MemoryBuffer* input_memory_;
   MemoryBuffer* output_memory_;
   Timestamp timestamp_;
+  Timestamp dirty_since_;
+  DirtyNodeQueue* dirty_node_queue_;
+  DirtyBitset* dirty_bits_;
+  ArrayRef<const ResolvedDefaultValue> default_values_;
 };
 
 }  // namespace breadboard
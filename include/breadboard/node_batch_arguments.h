@@ -0,0 +1,266 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_NODE_BATCH_ARGUMENTS_H_
+#define BREADBOARD_NODE_BATCH_ARGUMENTS_H_
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "breadboard/memory_buffer.h"
+#include "breadboard/node.h"
+#include "breadboard/node_arguments.h"
+#include "breadboard/type_registry.h"
+
+/// @file breadboard/node_batch_arguments.h
+///
+/// @brief NodeBatchArguments gives a node access to its input and output edges
+/// on many instances of a graph at once.
+
+namespace breadboard {
+
+/// @class NodeBatchArguments
+///
+/// @brief NodeBatchArguments gives a node access to its input and output edges
+/// on many instances of a graph at once.
+///
+/// When a GraphStateBatch finds the same node dirty on more than one of its
+/// instances, it first offers all of them to the node's
+/// BaseNode::ExecuteBatch function. Rather than reading one value at a time,
+/// a node can gather each input into a column holding that input's value on
+/// every instance, compute a column of results in one tight loop, and then
+/// scatter the results back out to the instances:
+///
+/// ~~~{.cpp}
+///     virtual bool ExecuteBatch(NodeBatchArguments* args) {
+///       const float* a = args->GatherInput<float>(kInputA);
+///       const float* b = args->GatherInput<float>(kInputB);
+///       float* result = args->AllocateColumn<float>();
+///       for (size_t i = 0; i < args->size(); ++i) {
+///         result[i] = a[i] + b[i];
+///       }
+///       args->ScatterOutput(kOutputResult, result);
+///       return true;
+///     }
+/// ~~~
+///
+/// Columns are contiguous and aligned to kColumnAlignment bytes, so loops like
+/// this one are easily vectorized by the compiler. They are only valid until
+/// ExecuteBatch returns, and may only hold trivially copyable types.
+class NodeBatchArguments {
+ public:
+  /// @brief The alignment of the start of every column, in bytes.
+  static const size_t kColumnAlignment = 16;
+
+  /// @cond BREADBOARD_INTERNAL
+  /// @brief Construct a NodeBatchArguments object for the given instances of
+  /// a node.
+  ///
+  /// @note For internal use only.
+  ///
+  /// @param[in] instances The arguments of the node on each instance. These
+  /// must all refer to the same node.
+  ///
+  /// @param[in] size The number of instances.
+  ///
+  /// @param[in] columns Storage for columns, which is kept around between
+  /// batches so that it can be reused.
+  NodeBatchArguments(NodeArguments* instances, size_t size,
+                     std::vector<std::unique_ptr<MemoryBuffer>>* columns)
+      : instances_(instances), size_(size), columns_(columns), next_column_(0) {
+    assert(size > 0);
+  }
+  /// @endcond
+
+  /// @brief Returns the number of instances in this batch.
+  ///
+  /// @return The number of instances in this batch.
+  size_t size() const { return size_; }
+
+  /// @brief Returns the arguments of the node on a single instance.
+  ///
+  /// @param[in] index The index of the instance, less than size().
+  ///
+  /// @return The arguments of the node on the given instance.
+  NodeArguments* instance(size_t index) {
+    assert(index < size_);
+    return &instances_[index];
+  }
+
+  /// @brief Returns a column that can hold one value of the given type for
+  /// every instance in this batch.
+  ///
+  /// The values in the column are unspecified.
+  ///
+  /// @return A column that can hold size() values.
+  template <typename T>
+  T* AllocateColumn() {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Columns may only hold trivially copyable types.");
+    static_assert(std::alignment_of<T>::value <= kColumnAlignment,
+                  "Type is too strictly aligned to be held in a column.");
+    return reinterpret_cast<T*>(AllocateColumn(sizeof(T) * size_));
+  }
+
+  /// @brief Returns a column holding the value of the given input edge on
+  /// every instance in this batch.
+  ///
+  /// @param[in] argument_index The index of the input edge. Note that the
+  /// template argument of this index must match the one specified in the
+  /// NodeSignature.
+  ///
+  /// @return A column holding size() values, in the same order as the
+  /// instances.
+  template <typename EdgeType>
+  const EdgeType* GatherInput(size_t argument_index) {
+    EdgeType* column = AllocateColumn<EdgeType>();
+    const NodeArguments& first = instances_[0];
+    first.VerifyInputPreconditions(argument_index,
+                                   TypeRegistry<EdgeType>::GetType());
+    const ResolvedInputEdge& input_edge =
+        first.node_->resolved_input_edges()[argument_index];
+    if (input_edge.connected) {
+      for (size_t i = 0; i < size_; ++i) {
+        column[i] = *instances_[i].output_memory_->GetObject<EdgeType>(
+            input_edge.data_offset);
+      }
+    } else {
+      // Default values are held by the graph, but an instance's
+      // DefaultValueOverlay may replace them.
+      for (size_t i = 0; i < size_; ++i) {
+        column[i] = *instances_[i].GetVerifiedDefaultValue<EdgeType>(
+            input_edge.data_offset);
+      }
+    }
+    return column;
+  }
+
+  /// @brief Returns a column of pointers to the value of the given input
+  /// edge on every instance in this batch.
+  ///
+  /// Unlike GatherInput, this works with any type, since the values
+  /// themselves are not copied.
+  ///
+  /// @param[in] argument_index The index of the input edge. Note that the
+  /// template argument of this index must match the one specified in the
+  /// NodeSignature.
+  ///
+  /// @return A column holding size() pointers, in the same order as the
+  /// instances.
+  template <typename EdgeType>
+  const EdgeType* const* GatherInputPointers(size_t argument_index) {
+    const EdgeType** column = AllocateColumn<const EdgeType*>();
+    const NodeArguments& first = instances_[0];
+    first.VerifyInputPreconditions(argument_index,
+                                   TypeRegistry<EdgeType>::GetType());
+    const ResolvedInputEdge& input_edge =
+        first.node_->resolved_input_edges()[argument_index];
+    if (input_edge.connected) {
+      for (size_t i = 0; i < size_; ++i) {
+        column[i] = instances_[i].output_memory_->GetObject<EdgeType>(
+            input_edge.data_offset);
+      }
+    } else {
+      for (size_t i = 0; i < size_; ++i) {
+        column[i] = instances_[i].GetVerifiedDefaultValue<EdgeType>(
+            input_edge.data_offset);
+      }
+    }
+    return column;
+  }
+
+  /// @brief Returns a column of pointers to the value of the given output
+  /// edge on every instance in this batch, and marks them all dirty.
+  ///
+  /// This has the same effect as calling NodeArguments::GetMutableOutput on
+  /// each instance in turn, and works with any type. It can not be used on
+  /// outputs that alias an input.
+  ///
+  /// @param[in] argument_index The index of the output edge. Note that the
+  /// template argument of this index must match the one specified in the
+  /// NodeSignature.
+  ///
+  /// @return A column holding size() pointers, in the same order as the
+  /// instances, or null if the edge is not connected to any inputs.
+  template <typename EdgeType>
+  EdgeType* const* GetMutableOutputPointers(size_t argument_index) {
+    const NodeArguments& first = instances_[0];
+    first.VerifyOutputPreconditions(argument_index,
+                                    TypeRegistry<EdgeType>::GetType());
+    const OutputEdge& output_edge =
+        first.node_->output_edges()[argument_index];
+    if (!output_edge.connected()) {
+      return nullptr;
+    }
+    assert(!output_edge.aliased());
+    EdgeType** column = AllocateColumn<EdgeType*>();
+    for (size_t i = 0; i < size_; ++i) {
+      NodeArguments& instance = instances_[i];
+      instance.MarkOutputDirty(output_edge);
+      column[i] = instance.output_memory_->GetObject<EdgeType>(
+          output_edge.data_offset());
+    }
+    return column;
+  }
+
+  /// @brief Sets the value of the given output edge on every instance in
+  /// this batch.
+  ///
+  /// This has the same effect as calling NodeArguments::SetOutput on each
+  /// instance in turn.
+  ///
+  /// @param[in] argument_index The index of the output edge. Note that the
+  /// template argument of this index must match the one specified in the
+  /// NodeSignature.
+  ///
+  /// @param[in] values A column holding size() values, in the same order as
+  /// the instances.
+  template <typename EdgeType>
+  void ScatterOutput(size_t argument_index, const EdgeType* values) {
+    const NodeArguments& first = instances_[0];
+    first.VerifyOutputPreconditions(argument_index,
+                                    TypeRegistry<EdgeType>::GetType());
+    if (!first.node_->output_edges()[argument_index].connected()) {
+      // Nothing is consuming this output, so no need to store it.
+      return;
+    }
+    for (size_t i = 0; i < size_; ++i) {
+      EdgeType* data =
+          instances_[i].PrepareVerifiedOutput(argument_index, &values[i]);
+      if (data) {
+        *data = values[i];
+      }
+    }
+  }
+
+ private:
+  // Disallow copying.
+  NodeBatchArguments(NodeBatchArguments&);
+  NodeBatchArguments& operator=(NodeBatchArguments&);
+
+  // Return the next column, making sure it can hold at least `size` bytes.
+  uint8_t* AllocateColumn(size_t size);
+
+  NodeArguments* instances_;
+  size_t size_;
+  std::vector<std::unique_ptr<MemoryBuffer>>* columns_;
+  size_t next_column_;
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_NODE_BATCH_ARGUMENTS_H_
@@ -15,8 +15,11 @@
 #ifndef BREADBOARD_NODE_SIGNATURE_H_
 #define BREADBOARD_NODE_SIGNATURE_H_
 
+#include <cstdint>
 #include <functional>
+#include <new>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "breadboard/event.h"
@@ -30,6 +33,7 @@
 namespace breadboard {
 
 class BaseNode;
+class NodeArguments;
 
 /// @typedef NodeConstructor
 ///
@@ -43,6 +47,39 @@ typedef std::function<BaseNode*()> NodeConstructor;
 /// object that extends BaseNode.
 typedef std::function<void(BaseNode*)> NodeDestructor;
 
+/// @typedef NodePlacementNewFunc
+///
+/// @brief A typedef for a function that constructs a new object that extends
+/// BaseNode in the given memory.
+typedef BaseNode* (*NodePlacementNewFunc)(uint8_t* ptr);
+
+/// @typedef NodeExecuteFunc
+///
+/// @brief A typedef for a function that runs BaseNode::Execute on the given
+/// node.
+typedef void (*NodeExecuteFunc)(BaseNode*, NodeArguments*);
+
+/// @typedef NodeSignatureId
+///
+/// @brief A stable 64-bit identifier for a NodeSignature, derived from the
+/// names of its module and node.
+typedef uint64_t NodeSignatureId;
+
+/// @brief Returns the NodeSignatureId of the node with the given names.
+///
+/// The ID is the 64-bit FNV-1a hash of the module name, a zero byte and then
+/// the node name. It does not depend on the platform or on the order in which
+/// nodes are registered, so tools that write graph files can compute it
+/// themselves.
+///
+/// @param[in] module_name The name of the node's module.
+///
+/// @param[in] node_name The name of the node.
+///
+/// @return The NodeSignatureId for those names.
+NodeSignatureId MakeNodeSignatureId(const std::string& module_name,
+                                    const std::string& node_name);
+
 /// @class NodeParameter
 ///
 /// @brief A struct that holds data about input and output parameters, such as
@@ -75,7 +112,8 @@ struct NodeParameter {
 /// @brief A struct that holds data about listener parameters, such as what
 /// events are listened for and why.
 struct ListenerParameter {
-  ListenerParameter() : event_id(nullptr), comment() {}
+  ListenerParameter()
+      : event_id(nullptr), event_index(kInvalidEventIndex), comment() {}
 
   /// @brief Construct a ListenerParameter object with the given data.
   ///
@@ -83,11 +121,16 @@ struct ListenerParameter {
   ///
   /// @param[in] comment_ A short description of the purpose of this listener.
   ListenerParameter(EventId event_id_, std::string comment_)
-      : event_id(event_id_), comment(comment_) {}
+      : event_id(event_id_),
+        event_index(GetEventIndex(event_id_)),
+        comment(comment_) {}
 
   /// @brief The event id of this parameter.
   EventId event_id;
 
+  /// @brief The EventIndex of event_id, looked up when the listener is added.
+  EventIndex event_index;
+
   /// @brief A short description of the purpose of this listener.
   std::string comment;
 };
@@ -126,8 +169,19 @@ class NodeSignature {
                 const NodeDestructor& destructor)
       : module_name_(module_name),
         node_name_(node_name),
+        id_(MakeNodeSignatureId(*module_name, node_name)),
         constructor_(constructor),
-        destructor_(destructor) {}
+        destructor_(destructor),
+        state_type_(),
+        has_state_(false),
+        suppress_unchanged_outputs_(false),
+        thread_safe_(true),
+        pure_(false),
+        initialize_deferrable_(false),
+        base_node_size_(0),
+        base_node_alignment_(1),
+        placement_new_func_(nullptr),
+        execute_func_(VirtualExecute) {}
 
   /// @brief Returns the name of the module of the node that this NodeSignature
   /// represents.
@@ -140,6 +194,12 @@ class NodeSignature {
   /// @return The name of the node that this NodeSignature represents.
   const std::string& node_name() const { return node_name_; }
 
+  /// @brief Returns the NodeSignatureId of the node that this NodeSignature
+  /// represents.
+  ///
+  /// @return The ID made from the module and node names.
+  NodeSignatureId id() const { return id_; }
+
   /// @brief Adds an input edge to a node signature.
   ///
   /// Call this function once for each input edge parameter on the node,
@@ -480,6 +540,26 @@ class NodeSignature {
     AddListener(static_cast<int>(event_listeners_.size()), event_id, "");
   }
 
+  /// @brief Add an input edge with the given parameter after the others.
+  ///
+  /// This is for signatures that are built at runtime, whose types are not
+  /// known at compile time.
+  ///
+  /// @param[in] parameter The type, name and comment of the input.
+  void AddInputParameter(const NodeParameter& parameter) {
+    input_parameters_.push_back(parameter);
+  }
+
+  /// @brief Add an output edge with the given parameter after the others.
+  ///
+  /// This is for signatures that are built at runtime, whose types are not
+  /// known at compile time.
+  ///
+  /// @param[in] parameter The type, name and comment of the output.
+  void AddOutputParameter(const NodeParameter& parameter) {
+    output_parameters_.push_back(parameter);
+  }
+
   /// @brief Returns the list of input types.
   ///
   /// @return The list of output types.
@@ -501,6 +581,302 @@ class NodeSignature {
     return event_listeners_;
   }
 
+  /// @brief Declares a struct holding the per-instance state of nodes of this
+  /// type.
+  ///
+  /// Each Node owns a single BaseNode object which is shared by every
+  /// GraphState created from the same Graph, so member variables on a BaseNode
+  /// are shared between all of those instances. Nodes that need to keep track
+  /// of something between calls to Execute, such as a counter, should instead
+  /// declare a state struct. Each GraphState allocates and default constructs
+  /// one alongside its edge data, and it may be accessed with
+  /// NodeArguments::GetState:
+  ///
+  /// ~~~{.cpp}
+  ///     struct CounterState {
+  ///       CounterState() : count(0) {}
+  ///       int count;
+  ///     };
+  ///     static void OnRegister(NodeSignature* node_sig) {
+  ///       node_sig->AddInput<int>();
+  ///       node_sig->SetState<CounterState>();
+  ///     }
+  ///     virtual void Execute(NodeArguments* args) {
+  ///       args->GetState<CounterState>()->count += *args->GetInput<int>(0);
+  ///     }
+  /// ~~~
+  ///
+  /// Unlike edge types, state types do not need to be registered with the
+  /// TypeRegistry.
+  template <typename StateType>
+  void SetState() {
+    state_type_ = Type("state", sizeof(StateType),
+                       std::alignment_of<StateType>::value,
+                       StatePlacementNew<StateType>,
+                       StateOperatorDelete<StateType>);
+    InitializeTypeTraits<StateType>(&state_type_, true, true);
+    has_state_ = true;
+  }
+
+  /// @brief Returns the type of this node's per-instance state, or null if it
+  /// has none.
+  ///
+  /// @return The type of this node's per-instance state, or null.
+  const Type* state_type() const { return has_state_ ? &state_type_ : nullptr; }
+
+  /// @brief Declares whether setting an output to the value it already holds
+  /// should be ignored.
+  ///
+  /// Normally every call to NodeArguments::SetOutput marks the output edge
+  /// dirty, so every node connected to it runs again, even if the value did
+  /// not change. Pure nodes that tend to recompute the same result, like
+  /// comparisons, can turn this on so that an unchanged value stops there:
+  ///
+  /// ~~~{.cpp}
+  ///     static void OnRegister(NodeSignature* node_sig) {
+  ///       node_sig->AddInput<int>();
+  ///       node_sig->AddInput<int>();
+  ///       node_sig->AddOutput<bool>();
+  ///       node_sig->set_suppress_unchanged_outputs(true);
+  ///     }
+  /// ~~~
+  ///
+  /// Only outputs whose Type has an equality function (see
+  /// TypeRegistry::RegisterEqualityFunc) are compared; other outputs are
+  /// always marked dirty. An output that has never been set since the
+  /// GraphState was initialized is always marked dirty too.
+  ///
+  /// @param[in] suppress_unchanged_outputs Whether to ignore setting an output
+  /// to its current value.
+  void set_suppress_unchanged_outputs(bool suppress_unchanged_outputs) {
+    suppress_unchanged_outputs_ = suppress_unchanged_outputs;
+  }
+
+  /// @brief Returns whether setting an output to its current value is ignored.
+  ///
+  /// @return Whether setting an output to its current value is ignored.
+  bool suppress_unchanged_outputs() const {
+    return suppress_unchanged_outputs_;
+  }
+
+  /// @brief Declares that an output of this node always holds the value of
+  /// one of its inputs.
+  ///
+  /// Nodes that act on a value and then pass it on unchanged, such as an
+  /// audio channel, would otherwise keep a copy of it at every hop of a
+  /// chain. When the input is connected, the output instead shares the
+  /// input's storage in the GraphState, and setting the output marks it dirty
+  /// without copying anything:
+  ///
+  /// ~~~{.cpp}
+  ///     static void OnRegister(NodeSignature* node_sig) {
+  ///       node_sig->AddInput<Channel>(kInputChannel);
+  ///       node_sig->AddOutput<Channel>(kOutputChannel);
+  ///       node_sig->SetOutputAlias(kOutputChannel, kInputChannel);
+  ///     }
+  ///     virtual void Execute(NodeArguments* args) {
+  ///       auto channel = args->GetInput<Channel>(kInputChannel);
+  ///       channel->Stop();
+  ///       args->SetOutput(kOutputChannel, *channel);
+  ///     }
+  /// ~~~
+  ///
+  /// The output must only ever be set to the input's value. Since the two
+  /// share storage, the nodes reading the output see a new value as soon as
+  /// it arrives at the input, although they still only run once the output
+  /// is set. When the input has a default value, the output gets storage of
+  /// its own and is copied into as usual.
+  ///
+  /// @param[in] output_index The index of the output.
+  ///
+  /// @param[in] input_index The index of the input it holds the value of,
+  /// which must have the same type.
+  void SetOutputAlias(int output_index, int input_index);
+
+  /// @brief Returns the index of the input that the given output holds the
+  /// value of, or -1 if it holds a value of its own.
+  ///
+  /// @param[in] output_index The index of the output.
+  ///
+  /// @return The index of the aliased input, or -1.
+  int output_alias(size_t output_index) const {
+    return output_index < output_aliases_.size()
+               ? output_aliases_[output_index]
+               : -1;
+  }
+
+  /// @brief Declares whether nodes of this type may be executed on a thread
+  /// other than the one that called GraphState::Execute.
+  ///
+  /// When a GraphState is executed in parallel (see GraphState::set_job_system)
+  /// independent nodes may run concurrently on worker threads. Nodes that touch
+  /// systems which are not thread safe, such as an entity system or an audio
+  /// engine, should call this from OnRegister with `false` so that they are
+  /// always run on the calling thread, one at a time:
+  ///
+  /// ~~~{.cpp}
+  ///     static void OnRegister(NodeSignature* node_sig) {
+  ///       node_sig->AddInput<EntityRef>(kInputEntity);
+  ///       node_sig->set_thread_safe(false);
+  ///     }
+  /// ~~~
+  ///
+  /// Nodes are considered thread safe by default.
+  ///
+  /// @param[in] thread_safe Whether nodes of this type may run on any thread.
+  void set_thread_safe(bool thread_safe) { thread_safe_ = thread_safe; }
+
+  /// @brief Returns whether nodes of this type may run on any thread.
+  ///
+  /// @return Whether nodes of this type may run on any thread.
+  bool thread_safe() const { return thread_safe_; }
+
+  /// @brief Declares whether the outputs of nodes of this type depend on
+  /// nothing but their inputs.
+  ///
+  /// A pure node has no side effects, listens for no events and keeps no
+  /// per-instance state, so running it again with the same inputs always
+  /// produces the same outputs. Arithmetic, comparison and conversion nodes
+  /// are typically pure:
+  ///
+  /// ~~~{.cpp}
+  ///     static void OnRegister(NodeSignature* node_sig) {
+  ///       node_sig->AddInput<int>();
+  ///       node_sig->AddInput<int>();
+  ///       node_sig->AddOutput<int>();
+  ///       node_sig->set_pure(true);
+  ///     }
+  /// ~~~
+  ///
+  /// When every input of a pure node is either a default value or connected
+  /// to another such node, the node is constant: it is executed once, right
+  /// after it is initialized, and then skipped by GraphState::Execute.
+  ///
+  /// Nodes are not considered pure by default.
+  ///
+  /// @param[in] pure Whether the outputs of nodes of this type depend only
+  /// on their inputs.
+  void set_pure(bool pure) { pure_ = pure; }
+
+  /// @brief Returns whether the outputs of nodes of this type depend only on
+  /// their inputs.
+  ///
+  /// @return Whether the outputs of nodes of this type depend only on their
+  /// inputs.
+  bool pure() const { return pure_; }
+
+  /// @brief Declares whether nodes of this type may put off running
+  /// BaseNode::Initialize until they are first executed.
+  ///
+  /// Initializing every node of a graph up front can be costly when many
+  /// instances are created at once, such as when a level is loaded, and is
+  /// wasted on nodes that never run. A GraphState with lazy initialization
+  /// turned on (see GraphState::set_lazy_initialization) skips Initialize on
+  /// nodes of a deferrable type, and runs it just before the node's first
+  /// execution instead, or when GraphState::InitializeDeferredNodes gets to
+  /// it.
+  ///
+  /// Only declare this for nodes that do not need to be initialized in order
+  /// to become dirty. A node that binds the listener it waits on in
+  /// Initialize will not hear its first event until it has been initialized
+  /// by InitializeDeferredNodes.
+  ///
+  /// Nodes may not defer initialization by default.
+  ///
+  /// @param[in] initialize_deferrable Whether nodes of this type may be
+  /// initialized on their first execution.
+  void set_initialize_deferrable(bool initialize_deferrable) {
+    initialize_deferrable_ = initialize_deferrable;
+  }
+
+  /// @brief Returns whether nodes of this type may put off running
+  /// BaseNode::Initialize until they are first executed.
+  ///
+  /// @return Whether nodes of this type may be initialized on their first
+  /// execution.
+  bool initialize_deferrable() const { return initialize_deferrable_; }
+
+  /// @brief Set the size of the BaseNode objects this NodeSignature
+  /// constructs.
+  ///
+  /// This is filled in by Module::RegisterNode, and is used to estimate the
+  /// memory used by a Graph (see Graph::GetMemoryStats).
+  ///
+  /// @note For internal use only.
+  ///
+  /// @param[in] base_node_size The size of the BaseNode objects in bytes.
+  void set_base_node_size(size_t base_node_size) {
+    base_node_size_ = base_node_size;
+  }
+
+  /// @brief Returns the size of the BaseNode objects this NodeSignature
+  /// constructs, or 0 if it is not known.
+  ///
+  /// @return The size of the BaseNode objects in bytes.
+  size_t base_node_size() const { return base_node_size_; }
+
+  /// @brief Set the alignment of the BaseNode objects this NodeSignature
+  /// constructs.
+  ///
+  /// This is filled in by Module::RegisterNode.
+  ///
+  /// @note For internal use only.
+  ///
+  /// @param[in] base_node_alignment The alignment of the BaseNode objects.
+  void set_base_node_alignment(size_t base_node_alignment) {
+    base_node_alignment_ = base_node_alignment;
+  }
+
+  /// @brief Returns the alignment of the BaseNode objects this NodeSignature
+  /// constructs.
+  ///
+  /// @return The alignment of the BaseNode objects.
+  size_t base_node_alignment() const { return base_node_alignment_; }
+
+  /// @brief Set the function used to construct nodes of this type in memory
+  /// owned by the Graph.
+  ///
+  /// This is filled in by Module::RegisterNode for nodes that are constructed
+  /// with their default constructor. Nodes with a custom constructor are
+  /// allocated by it instead.
+  ///
+  /// @note For internal use only.
+  ///
+  /// @param[in] placement_new_func The function that constructs a node in the
+  /// given memory, or null.
+  void set_placement_new_func(NodePlacementNewFunc placement_new_func) {
+    placement_new_func_ = placement_new_func;
+  }
+
+  /// @brief Returns the function used to construct nodes of this type in
+  /// memory owned by the Graph, or null if they are constructed by
+  /// Constructor.
+  ///
+  /// @return The function that constructs a node in the given memory.
+  NodePlacementNewFunc placement_new_func() const {
+    return placement_new_func_;
+  }
+
+  /// @brief Set the function used to run BaseNode::Execute on nodes of this
+  /// type.
+  ///
+  /// By default, Execute is called through the virtual function table. When
+  /// the exact type of the nodes is known, Module::RegisterNode replaces this
+  /// with a function that calls it directly.
+  ///
+  /// @note For internal use only.
+  ///
+  /// @param[in] execute_func The function used to execute nodes of this type.
+  void set_execute_func(NodeExecuteFunc execute_func) {
+    execute_func_ = execute_func;
+  }
+
+  /// @brief Returns the function used to run BaseNode::Execute on nodes of
+  /// this type.
+  ///
+  /// @return The function used to execute nodes of this type.
+  NodeExecuteFunc execute_func() const { return execute_func_; }
+
   /// @brief Constructs a new object of the type that this NodeSignature
   /// represents.
   ///
@@ -520,13 +896,37 @@ class NodeSignature {
  private:
   NodeSignature();
 
+  template <typename StateType>
+  static void StatePlacementNew(uint8_t* ptr) {
+    new (ptr) StateType();
+  }
+
+  template <typename StateType>
+  static void StateOperatorDelete(uint8_t* ptr) {
+    reinterpret_cast<StateType*>(ptr)->~StateType();
+  }
+
+  static void VirtualExecute(BaseNode* base_node, NodeArguments* args);
+
   const std::string* module_name_;
   std::string node_name_;
+  NodeSignatureId id_;
   NodeConstructor constructor_;
   NodeDestructor destructor_;
   std::vector<NodeParameter> input_parameters_;
   std::vector<NodeParameter> output_parameters_;
   std::vector<ListenerParameter> event_listeners_;
+  std::vector<int> output_aliases_;
+  Type state_type_;
+  bool has_state_;
+  bool suppress_unchanged_outputs_;
+  bool thread_safe_;
+  bool pure_;
+  bool initialize_deferrable_;
+  size_t base_node_size_;
+  size_t base_node_alignment_;
+  NodePlacementNewFunc placement_new_func_;
+  NodeExecuteFunc execute_func_;
 };
 
 }  // namespaced breadboard
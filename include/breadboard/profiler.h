@@ -0,0 +1,197 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_PROFILER_H_
+#define BREADBOARD_PROFILER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "breadboard/node.h"
+
+/// @file breadboard/profiler.h
+///
+/// @brief A Profiler records how often and for how long the nodes in a graph
+///        are executed.
+
+namespace breadboard {
+
+/// @brief How often and for how long a node, or every node of a given type,
+///        was executed while being profiled.
+struct NodeProfile {
+  NodeProfile()
+      : execution_count(0), skip_count(0), total_time(0) {}
+
+  /// @brief The number of times the node was executed.
+  uint64_t execution_count;
+
+  /// @brief The number of times the node was visited but skipped, because
+  /// none of its inputs were dirty.
+  uint64_t skip_count;
+
+  /// @brief The total wall time spent executing the node, in nanoseconds.
+  uint64_t total_time;
+};
+
+/// @brief The profile of a single node in a graph.
+struct NodeProfileEntry {
+  /// @brief The node that was profiled.
+  const Node* node;
+
+  /// @brief The name of the node's type, as `module_name:node_name`.
+  std::string name;
+
+  /// @brief How often and for how long the node was executed.
+  NodeProfile profile;
+};
+
+/// @brief The profile of every node of a given type.
+struct SignatureProfileEntry {
+  /// @brief The signature of the nodes that were profiled.
+  const NodeSignature* signature;
+
+  /// @brief The name of the nodes' type, as `module_name:node_name`.
+  std::string name;
+
+  /// @brief How often and for how long nodes of this type were executed.
+  NodeProfile profile;
+};
+
+/// @class Profiler
+///
+/// @brief A Profiler records how often and for how long the nodes in a graph
+///        are executed.
+///
+/// Profiling is compiled out unless the library is built with
+/// `BREADBOARD_PROFILING` defined (the `breadboard_enable_profiling` CMake
+/// option). In that case, every GraphState that has been given a Profiler
+/// reports each node it executes or skips:
+///
+/// ~~~{.cpp}
+///     breadboard::Profiler profiler;
+///     graph_state->set_profiler(&profiler);
+///     ...
+///     // Once per frame:
+///     std::vector<breadboard::SignatureProfileEntry> frame;
+///     profiler.GetSignatureProfiles(&frame);
+///     SendToTelemetry(frame);
+///     profiler.Reset();
+/// ~~~
+///
+/// When tracing is enabled, each execution is also kept as an event that can
+/// be exported with ExportChromeTrace and loaded into `chrome://tracing`.
+///
+/// A Profiler may be shared by any number of GraphStates, including ones
+/// executed in parallel.
+class Profiler {
+ public:
+  /// @brief The clock used to time node executions.
+  typedef std::chrono::steady_clock Clock;
+
+  /// @brief Construct a Profiler that has not recorded anything yet.
+  Profiler();
+
+  /// @brief Returns true if the library was built with profiling enabled.
+  ///
+  /// If it was not, no GraphState will ever report to a Profiler.
+  ///
+  /// @return True if the library was built with profiling enabled.
+  static bool IsEnabled();
+
+  /// @brief Set whether each execution is kept as a trace event, in addition
+  ///        to being counted.
+  ///
+  /// @param[in] trace_enabled Whether to keep trace events.
+  void set_trace_enabled(bool trace_enabled);
+
+  /// @brief Returns whether each execution is kept as a trace event.
+  ///
+  /// @return Whether each execution is kept as a trace event.
+  bool trace_enabled() const { return trace_enabled_; }
+
+  /// @brief Forget everything recorded so far.
+  void Reset();
+
+  /// @brief Get the profile of every node that has been executed or skipped
+  ///        since the last Reset.
+  ///
+  /// @param[out] profiles The profiles, sorted from most to least total
+  ///             time.
+  void GetNodeProfiles(std::vector<NodeProfileEntry>* profiles) const;
+
+  /// @brief Get the profile of every type of node that has been executed or
+  ///        skipped since the last Reset.
+  ///
+  /// @param[out] profiles The profiles, sorted from most to least total
+  ///             time.
+  void GetSignatureProfiles(std::vector<SignatureProfileEntry>* profiles) const;
+
+  /// @brief Write the trace events recorded since the last Reset in the
+  ///        Chrome trace event JSON format.
+  ///
+  /// @param[out] json The JSON document.
+  void ExportChromeTrace(std::string* json) const;
+
+  /// @cond BREADBOARD_INTERNAL
+
+  /// @brief Record that the node was executed `count` times between `start`
+  ///        and `end`.
+  ///
+  /// @note This is for internal use only.
+  void RecordExecution(const Node& node, Clock::time_point start,
+                       Clock::time_point end, uint64_t count = 1);
+
+  /// @brief Record that the node was visited but skipped.
+  ///
+  /// @note This is for internal use only.
+  void RecordSkip(const Node& node);
+
+  /// @endcond
+
+ private:
+  // Disallow copying.
+  Profiler(Profiler&);
+  Profiler& operator=(Profiler&);
+
+  struct TraceEvent {
+    const Node* node;
+    Clock::time_point start;
+    Clock::time_point end;
+    unsigned int thread_index;
+  };
+
+  // Returns a small number identifying the calling thread.
+  unsigned int ThreadIndex();
+
+  mutable std::mutex mutex_;
+  bool trace_enabled_;
+  Clock::time_point epoch_;
+  std::unordered_map<const Node*, NodeProfile> node_profiles_;
+  std::vector<TraceEvent> trace_events_;
+  std::vector<std::thread::id> threads_;
+};
+
+/// @cond BREADBOARD_INTERNAL
+/// @brief Returns the name of a node's type, as `module_name:node_name`.
+std::string GetNodeTypeName(const Node& node);
+/// @endcond
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_PROFILER_H_
@@ -0,0 +1,131 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_STRING_ID_H_
+#define BREADBOARD_STRING_ID_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+/// @file breadboard/string_id.h
+///
+/// @brief A StringId is an interned string that can be compared in constant
+///        time.
+
+namespace breadboard {
+
+/// @class StringId
+///
+/// @brief A StringId is an interned string that can be compared in constant
+///        time.
+///
+/// Every StringId made from the same characters points at the same copy of
+/// them, which is kept for the lifetime of the program. Comparing or hashing
+/// two StringIds therefore only looks at the pointers, and copying one is as
+/// cheap as copying a pointer. This makes StringId a better edge type than
+/// `std::string` for names and identifiers that are compared or used as keys
+/// far more often than they are built:
+///
+/// ~~~{.cpp}
+///     static const StringId kPlayer("player");
+///     ...
+///     if (*args->GetInput<StringId>(kInputTag) == kPlayer) {
+///       ...
+///     }
+/// ~~~
+///
+/// Interning a string takes a lock and a hash table lookup, so a StringId
+/// should be made once, up front, rather than every time it is needed.
+/// The default StringId is the empty string, as is a StringId whose bytes are
+/// all zero.
+class StringId {
+ public:
+  /// @brief Construct the empty StringId.
+  StringId() : string_(nullptr) {}
+
+  /// @brief Construct the StringId for the given characters, interning them if
+  /// they have not been seen before.
+  ///
+  /// @param[in] str A null terminated string.
+  explicit StringId(const char* str);
+
+  /// @brief Construct the StringId for the given string, interning it if it
+  /// has not been seen before.
+  ///
+  /// @param[in] str A string.
+  explicit StringId(const std::string& str);
+
+  /// @brief Returns the interned string.
+  ///
+  /// @return The interned string, which lasts for the lifetime of the program.
+  const std::string& str() const;
+
+  /// @brief Returns the interned string as a null terminated string.
+  ///
+  /// @return The characters of the interned string.
+  const char* c_str() const { return str().c_str(); }
+
+  /// @brief Returns true if this is the empty string.
+  ///
+  /// @return Whether this is the empty string.
+  bool empty() const { return string_ == nullptr; }
+
+  /// @brief Returns true if both StringIds hold the same characters.
+  bool operator==(const StringId& other) const {
+    return string_ == other.string_;
+  }
+
+  /// @brief Returns true if the StringIds hold different characters.
+  bool operator!=(const StringId& other) const {
+    return string_ != other.string_;
+  }
+
+  /// @brief Orders StringIds so that they can be used as keys in sorted
+  /// containers.
+  ///
+  /// The order is consistent for the lifetime of the program, but has nothing
+  /// to do with the characters of the strings.
+  bool operator<(const StringId& other) const {
+    return std::less<const std::string*>()(string_, other.string_);
+  }
+
+  /// @brief Returns a hash of this StringId.
+  ///
+  /// @return A hash of this StringId.
+  size_t Hash() const { return std::hash<const std::string*>()(string_); }
+
+ private:
+  // Set string_ to the interned copy of the given characters.
+  void Intern(const char* data, size_t size);
+
+  // The interned copy of the string, or null for the empty string.
+  const std::string* string_;
+};
+
+}  // namespace breadboard
+
+namespace std {
+
+/// @brief Allows StringIds to be used as keys in unordered containers.
+template <>
+struct hash<breadboard::StringId> {
+  size_t operator()(const breadboard::StringId& string_id) const {
+    return string_id.Hash();
+  }
+};
+
+}  // namespace std
+
+#endif  // BREADBOARD_STRING_ID_H_
@@ -0,0 +1,181 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_TIMER_WHEEL_H_
+#define BREADBOARD_TIMER_WHEEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "breadboard/event.h"
+#include "fplutil/intrusive_list.h"
+
+/// @file breadboard/timer_wheel.h
+///
+/// @brief A TimerWheel wakes up nodes once a given amount of time has passed.
+
+namespace breadboard {
+
+class EventDispatcher;
+
+/// @brief A point in time, counted in the ticks of a TimerWheel.
+typedef uint64_t Tick;
+
+/// @brief The length of a tick in a TimerWheel by default, in seconds.
+static const double kDefaultSecondsPerTick = 1.0 / 60.0;
+
+/// @brief The event listened for by nodes that set timers.
+///
+/// Nodes that want to be woken up by a TimerWheel add a listener for this
+/// event, and then set a timer on it with NodeArguments::SetTimer.
+BREADBOARD_DECLARE_EVENT(kTimerEventId)
+
+/// @class TimerWheel
+///
+/// @brief A TimerWheel wakes up nodes once a given amount of time has passed.
+///
+/// Without a TimerWheel, a node that waits for some amount of time has to
+/// poll a clock every frame, which keeps it and everything upstream of it
+/// dirty. A node can instead set a timer on one of its listeners, and then
+/// not be executed at all until the timer goes off:
+///
+/// ~~~{.cpp}
+///     static void OnRegister(NodeSignature* node_sig) {
+///       node_sig->AddInput<void>(kInputTrigger);
+///       node_sig->AddOutput<void>(kOutputDone);
+///       node_sig->AddListener(kListenerTimer, kTimerEventId);
+///     }
+///
+///     virtual void Execute(NodeArguments* args) {
+///       if (args->IsListenerDirty(kListenerTimer)) {
+///         args->SetOutput(kOutputDone);
+///       }
+///       if (args->IsInputDirty(kInputTrigger)) {
+///         args->SetTimerSeconds(kListenerTimer, 2.0);
+///       }
+///     }
+/// ~~~
+///
+/// A single TimerWheel is meant to be shared by every GraphState in the game,
+/// through GraphState::set_timer_wheel, and advanced once per frame. Setting,
+/// cancelling and firing a timer all take constant time, however many timers
+/// are waiting. The timers are kept in a hierarchical timing wheel: four
+/// levels of 256 slots each, where each level counts time in units 256 times
+/// coarser than the one below it. Timers are moved down a level as their
+/// time draws near.
+///
+/// A listener with a timer set is not bound to any broadcaster, and a timer
+/// is cancelled if its GraphState is destroyed.
+class TimerWheel {
+ public:
+  /// @brief Construct a TimerWheel.
+  ///
+  /// @param[in] seconds_per_tick The length of a tick, in seconds.
+  explicit TimerWheel(double seconds_per_tick = kDefaultSecondsPerTick);
+
+  ~TimerWheel();
+
+  /// @brief Returns the length of a tick, in seconds.
+  ///
+  /// @return The length of a tick, in seconds.
+  double seconds_per_tick() const { return seconds_per_tick_; }
+
+  /// @brief Returns the number of ticks the wheel has advanced by so far.
+  ///
+  /// @return The current tick.
+  Tick current_tick() const { return current_tick_; }
+
+  /// @brief Returns the number of ticks that cover the given amount of time.
+  ///
+  /// @param[in] seconds An amount of time, in seconds.
+  ///
+  /// @return The number of ticks, rounded up.
+  Tick SecondsToTicks(double seconds) const;
+
+  /// @brief Advance the wheel by the given number of ticks, firing every timer
+  /// that comes due along the way.
+  ///
+  /// @param[in] ticks The number of ticks to advance by.
+  void Advance(Tick ticks);
+
+  /// @brief Advance the wheel by the given amount of time.
+  ///
+  /// Time that does not add up to a whole tick is carried over to the next
+  /// call.
+  ///
+  /// @param[in] seconds The number of seconds to advance by.
+  void AdvanceSeconds(double seconds);
+
+  /// @brief Set the EventDispatcher used to defer executing the GraphStates
+  /// whose timers fire. Pass null to execute them immediately, which is the
+  /// default.
+  ///
+  /// @param[in] event_dispatcher The EventDispatcher to use.
+  void set_event_dispatcher(EventDispatcher* event_dispatcher) {
+    event_dispatcher_ = event_dispatcher;
+  }
+
+  /// @brief Returns the EventDispatcher used by this wheel, if any.
+  ///
+  /// @return The EventDispatcher used by this wheel, or null.
+  EventDispatcher* event_dispatcher() const { return event_dispatcher_; }
+
+  /// @cond BREADBOARD_INTERNAL
+  /// @brief Set a timer on the given listener, replacing the one it already
+  /// has or unbinding it from its broadcaster.
+  ///
+  /// @param[in] listener The listener to mark dirty when the timer fires.
+  ///
+  /// @param[in] wake_tick The tick to fire on. Ticks that have already passed
+  /// fire on the next one.
+  void SetTimer(NodeEventListener* listener, Tick wake_tick);
+
+  /// @brief Cancel the timer on the given listener, if it has one.
+  ///
+  /// @param[in] listener The listener to cancel the timer of.
+  void CancelTimer(NodeEventListener* listener);
+  /// @endcond
+
+ private:
+  typedef fplutil::intrusive_list<NodeEventListener> ListenerList;
+
+  // Disallow copying.
+  TimerWheel(TimerWheel&);
+  TimerWheel& operator=(TimerWheel&);
+
+  // Put the listener in the slot that matches how far away its tick is.
+  void Insert(NodeEventListener* listener);
+
+  // Take every listener out of the given list and insert it again.
+  void Reinsert(ListenerList* listener_list);
+
+  // Advance by a single tick.
+  void Step();
+
+  double seconds_per_tick_;
+  Tick current_tick_;
+  double carried_seconds_;
+  EventDispatcher* event_dispatcher_;
+
+  // The slots of every level in turn, followed by the timers that are too far
+  // away for any of them.
+  std::vector<std::unique_ptr<ListenerList>> slots_;
+  ListenerList overflow_;
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_TIMER_WHEEL_H_
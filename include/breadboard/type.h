@@ -17,6 +17,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <string>
 
 /// @file breadboard/type.h
 ///
@@ -37,6 +38,45 @@ typedef void (*PlacementNewFunc)(uint8_t*);
 /// memory address.
 typedef void (*OperatorDeleteFunc)(uint8_t*);
 
+/// @typedef PlacementCopyFunc
+///
+/// @brief A typedef for a function pointer that copy constructs a type at the
+/// first address from the object at the second address.
+typedef void (*PlacementCopyFunc)(uint8_t*, const uint8_t*);
+
+/// @typedef PlacementMoveFunc
+///
+/// @brief A typedef for a function pointer that move constructs a type at the
+/// first address from the object at the second address.
+typedef void (*PlacementMoveFunc)(uint8_t*, uint8_t*);
+
+/// @typedef EqualityFunc
+///
+/// @brief A typedef for a function pointer that returns true if the objects at
+/// the two given addresses are equal.
+typedef bool (*EqualityFunc)(const uint8_t*, const uint8_t*);
+
+/// @typedef SerializeFunc
+///
+/// @brief A typedef for a function pointer that appends a representation of
+/// the object at the given address to the string, such that it can be read
+/// back by the matching DeserializeFunc.
+typedef void (*SerializeFunc)(const uint8_t*, std::string*);
+
+/// @typedef DeserializeFunc
+///
+/// @brief A typedef for a function pointer that reads the given bytes, written
+/// by the matching SerializeFunc, into the already constructed object at the
+/// given address. Returns false if the bytes are not valid.
+typedef bool (*DeserializeFunc)(const uint8_t*, size_t, uint8_t*);
+
+/// @typedef MemoryUsageFunc
+///
+/// @brief A typedef for a function pointer that returns the number of bytes
+/// of heap memory owned by the object at the given address, not counting the
+/// object itself.
+typedef size_t (*MemoryUsageFunc)(const uint8_t*);
+
 /// @struct Type
 ///
 /// @brief Metadata about types that are used as input and output edge
@@ -73,7 +113,16 @@ struct Type {
         size(size_),
         alignment(alignment_),
         placement_new_func(placement_new_func_),
-        operator_delete_func(operator_delete_func_) {}
+        operator_delete_func(operator_delete_func_),
+        placement_copy_func(nullptr),
+        placement_move_func(nullptr),
+        equality_func(nullptr),
+        serialize_func(nullptr),
+        deserialize_func(nullptr),
+        memory_usage_func(nullptr),
+        trivially_default_constructible(false),
+        trivially_destructible(false),
+        trivially_copyable(false) {}
 
   /// @brief The name of the type.
   const char* name;
@@ -89,6 +138,40 @@ struct Type {
 
   /// @brief The function used to delete and instance of the Type.
   OperatorDeleteFunc operator_delete_func;
+
+  /// @brief The function used to copy construct an instance of the type, or
+  /// null if the type can not be copied.
+  PlacementCopyFunc placement_copy_func;
+
+  /// @brief The function used to move construct an instance of the type, or
+  /// null if the type can not be moved.
+  PlacementMoveFunc placement_move_func;
+
+  /// @brief The function used to compare two instances of the type, or null if
+  /// no equality function has been registered.
+  EqualityFunc equality_func;
+
+  /// @brief The function used to write out an instance of the type, or null if
+  /// no serialization functions have been registered.
+  SerializeFunc serialize_func;
+
+  /// @brief The function used to read back an instance of the type, or null if
+  /// no serialization functions have been registered.
+  DeserializeFunc deserialize_func;
+
+  /// @brief The function used to find how much heap memory an instance of the
+  /// type owns, or null if instances own none or it is not known.
+  MemoryUsageFunc memory_usage_func;
+
+  /// @brief Whether constructing an instance of the type may be skipped when
+  /// its memory has already been zeroed.
+  bool trivially_default_constructible;
+
+  /// @brief Whether destroying an instance of the type may be skipped.
+  bool trivially_destructible;
+
+  /// @brief Whether instances of the type may be copied with memcpy.
+  bool trivially_copyable;
 };
 
 }  // namespace breadboard
@@ -16,7 +16,11 @@
 #define BREADBOARD_TYPE_REGISTRY_H_
 
 #include <cassert>
+#include <cstring>
+#include <new>
+#include <string>
 #include <type_traits>
+#include <utility>
 
 #include "breadboard/type.h"
 
@@ -26,6 +30,82 @@
 
 namespace breadboard {
 
+/// @cond BREADBOARD_INTERNAL
+
+// Copy constructs a T at the destination from the T at the source.
+template <typename T>
+void DefaultPlacementCopy(uint8_t* destination, const uint8_t* source) {
+  new (destination) T(*reinterpret_cast<const T*>(source));
+}
+
+template <typename T>
+PlacementCopyFunc GetDefaultPlacementCopyFunc(std::true_type) {
+  return DefaultPlacementCopy<T>;
+}
+
+template <typename T>
+PlacementCopyFunc GetDefaultPlacementCopyFunc(std::false_type) {
+  return nullptr;
+}
+
+/// @brief Returns a function that copy constructs a T, or null if T can not be
+///        copy constructed.
+template <typename T>
+PlacementCopyFunc GetDefaultPlacementCopyFunc() {
+  return GetDefaultPlacementCopyFunc<T>(
+      typename std::is_copy_constructible<T>::type());
+}
+
+// Move constructs a T at the destination from the T at the source.
+template <typename T>
+void DefaultPlacementMove(uint8_t* destination, uint8_t* source) {
+  new (destination) T(std::move(*reinterpret_cast<T*>(source)));
+}
+
+template <typename T>
+PlacementMoveFunc GetDefaultPlacementMoveFunc(std::true_type) {
+  return DefaultPlacementMove<T>;
+}
+
+template <typename T>
+PlacementMoveFunc GetDefaultPlacementMoveFunc(std::false_type) {
+  return nullptr;
+}
+
+/// @brief Returns a function that move constructs a T, or null if T can not be
+///        move constructed.
+template <typename T>
+PlacementMoveFunc GetDefaultPlacementMoveFunc() {
+  return GetDefaultPlacementMoveFunc<T>(
+      typename std::is_move_constructible<T>::type());
+}
+
+/// @brief Fill in the copy and move functions and the traits of a Type that
+///        represents T.
+///
+/// @param[in] type The Type to fill in.
+///
+/// @param[in] default_construction True if the Type constructs T with its
+/// default constructor. Types with a custom PlacementNewFunc are never treated
+/// as trivially default constructible.
+///
+/// @param[in] default_destruction True if the Type destroys T with its
+/// destructor. Types with a custom OperatorDeleteFunc are never treated as
+/// trivially destructible.
+template <typename T>
+void InitializeTypeTraits(Type* type, bool default_construction,
+                          bool default_destruction) {
+  type->placement_copy_func = GetDefaultPlacementCopyFunc<T>();
+  type->placement_move_func = GetDefaultPlacementMoveFunc<T>();
+  type->trivially_default_constructible =
+      default_construction && std::is_trivially_default_constructible<T>::value;
+  type->trivially_destructible =
+      default_destruction && std::is_trivially_destructible<T>::value;
+  type->trivially_copyable = std::is_trivially_copyable<T>::value;
+}
+
+/// @endcond
+
 /// @class TypeRegistry
 ///
 /// @brief Types that are to be used as input and output edge parameters on
@@ -68,6 +148,9 @@ struct TypeRegistry {
     initialized_ = true;
     type_ = Type(name, sizeof(EdgeType), std::alignment_of<EdgeType>::value,
                  placement_new_func, operator_delete_func);
+    InitializeTypeTraits<EdgeType>(
+        &type_, placement_new_func == DefaultPlacementNew,
+        operator_delete_func == DefaultOperatorDelete);
   }
 
   /// @brief Register a type with Breadboard so that it may be used as input and
@@ -102,6 +185,77 @@ struct TypeRegistry {
     RegisterType(name, DefaultPlacementNew);
   }
 
+  /// @brief Register a function used to compare two values of the type.
+  ///
+  /// Nodes whose NodeSignature suppresses unchanged outputs (see
+  /// NodeSignature::set_suppress_unchanged_outputs) use this function to
+  /// avoid marking an output edge dirty when it is set to the value it
+  /// already holds. Types with no equality function are always marked dirty.
+  ///
+  /// The type must have been registered first.
+  ///
+  /// @param[in] equality_func The function used to compare two values.
+  static void RegisterEqualityFunc(const EqualityFunc& equality_func) {
+    assert(initialized_);
+    type_.equality_func = equality_func;
+  }
+
+  /// @brief Register `operator==` as the function used to compare two values
+  /// of the type.
+  ///
+  /// See RegisterEqualityFunc(const EqualityFunc&) for details.
+  static void RegisterEqualityFunc() {
+    RegisterEqualityFunc(DefaultEquality);
+  }
+
+  /// @brief Register the functions used to write out and read back values of
+  /// the type.
+  ///
+  /// Default values can only be saved in a compiled graph (see CompileGraph)
+  /// if their type has serialization functions.
+  ///
+  /// The type must have been registered first.
+  ///
+  /// @param[in] serialize_func The function used to write out a value.
+  ///
+  /// @param[in] deserialize_func The function used to read back a value.
+  static void RegisterSerializationFuncs(
+      const SerializeFunc& serialize_func,
+      const DeserializeFunc& deserialize_func) {
+    assert(initialized_);
+    type_.serialize_func = serialize_func;
+    type_.deserialize_func = deserialize_func;
+  }
+
+  /// @brief Register functions that write out and read back the bytes of the
+  /// value as they are.
+  ///
+  /// This may only be used for trivially copyable types that hold no pointers
+  /// or handles, since the bytes are read back in a different run of the
+  /// program. See RegisterSerializationFuncs(const SerializeFunc&,
+  /// const DeserializeFunc&) for details.
+  static void RegisterSerializationFuncs() {
+    static_assert(std::is_trivially_copyable<EdgeType>::value,
+                  "Only trivially copyable types can be serialized bytewise");
+    RegisterSerializationFuncs(BytewiseSerialize, BytewiseDeserialize);
+  }
+
+  /// @brief Register the function used to find how much heap memory a value
+  /// of the type owns.
+  ///
+  /// This is used to account for the memory held by default values, such as
+  /// the characters of a string, when budgeting the memory used by cached
+  /// graphs (see GraphFactory::set_memory_budget).
+  ///
+  /// The type must have been registered first.
+  ///
+  /// @param[in] memory_usage_func The function used to measure a value.
+  static void RegisterMemoryUsageFunc(
+      const MemoryUsageFunc& memory_usage_func) {
+    assert(initialized_);
+    type_.memory_usage_func = memory_usage_func;
+  }
+
   /// @brief Return the Type object that represents EdgeType.
   ///
   /// @return The Type object that represents EdgeType.
@@ -111,8 +265,26 @@ struct TypeRegistry {
   static Type type_;
   static bool initialized_;
 
+  static void BytewiseSerialize(const uint8_t* ptr, std::string* output) {
+    output->append(reinterpret_cast<const char*>(ptr), sizeof(EdgeType));
+  }
+
+  static bool BytewiseDeserialize(const uint8_t* data, size_t size,
+                                  uint8_t* ptr) {
+    if (size != sizeof(EdgeType)) {
+      return false;
+    }
+    memcpy(ptr, data, size);
+    return true;
+  }
+
   static void DefaultPlacementNew(uint8_t* ptr) { new (ptr) EdgeType(); }
 
+  static bool DefaultEquality(const uint8_t* a, const uint8_t* b) {
+    return *reinterpret_cast<const EdgeType*>(a) ==
+           *reinterpret_cast<const EdgeType*>(b);
+  }
+
   static void DefaultOperatorDelete(uint8_t* ptr) {
     (void)ptr;
     reinterpret_cast<EdgeType*>(ptr)->~EdgeType();
@@ -150,6 +322,11 @@ struct TypeRegistry<void> {
     initialized_ = true;
     type_ = Type(name, kVoidSize, kVoidAlignment, VoidPlacementNew,
                  VoidOperatorDelete);
+    type_.placement_copy_func = VoidPlacementCopy;
+    type_.placement_move_func = VoidPlacementMove;
+    type_.trivially_default_constructible = true;
+    type_.trivially_destructible = true;
+    type_.trivially_copyable = true;
   }
 
   /// @brief Return the Type object that represents the type `void`.
@@ -164,6 +341,8 @@ struct TypeRegistry<void> {
   // Do nothing.
   static void VoidPlacementNew(uint8_t*) {}
   static void VoidOperatorDelete(uint8_t*) {}
+  static void VoidPlacementCopy(uint8_t*, const uint8_t*) {}
+  static void VoidPlacementMove(uint8_t*, uint8_t*) {}
 
   TypeRegistry();
 };
@@ -0,0 +1,204 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BREADBOARD_TYPED_NODE_H_
+#define BREADBOARD_TYPED_NODE_H_
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "breadboard/base_node.h"
+#include "breadboard/event.h"
+#include "breadboard/node_arguments.h"
+#include "breadboard/node_signature.h"
+
+/// @file breadboard/typed_node.h
+///
+/// @brief A TypedNode is a BaseNode whose edges are declared as template
+///        arguments, so that they can be checked at compile time.
+
+namespace breadboard {
+
+/// @brief The types of the input edges of a TypedNode, in order.
+template <typename... EdgeTypes>
+struct Inputs {};
+
+/// @brief The types of the output edges of a TypedNode, in order.
+template <typename... EdgeTypes>
+struct Outputs {};
+
+/// @brief The events listened for by the listeners of a TypedNode, in order.
+///
+/// Each argument is the address of an EventId defined with
+/// BREADBOARD_DEFINE_EVENT, such as `&kTimerEventId`.
+template <EventId*... EventIds>
+struct Listeners {};
+
+/// @cond BREADBOARD_INTERNAL
+template <size_t Index, typename... Types>
+struct TypeAt;
+
+template <typename First, typename... Rest>
+struct TypeAt<0, First, Rest...> {
+  typedef First type;
+};
+
+template <size_t Index, typename First, typename... Rest>
+struct TypeAt<Index, First, Rest...> {
+  typedef typename TypeAt<Index - 1, Rest...>::type type;
+};
+/// @endcond
+
+template <typename InputList, typename OutputList,
+          typename ListenerList = Listeners<>>
+class TypedNode;
+
+/// @class TypedNode
+///
+/// @brief A TypedNode is a BaseNode whose edges are declared as template
+///        arguments, so that they can be checked at compile time.
+///
+/// The NodeSignature is built from the template arguments, so there is no need
+/// to write OnRegister. Edges are accessed by an index given as a template
+/// argument. Using an index that is out of range, or a value of the wrong
+/// type, fails to compile, so these accessors skip the checks that
+/// NodeArguments::GetInput and NodeArguments::SetOutput make on every call:
+///
+/// ~~~{.cpp}
+///     class AddNode
+///         : public breadboard::TypedNode<breadboard::Inputs<int, int>,
+///                                        breadboard::Outputs<int>> {
+///      public:
+///       enum { kInputA, kInputB };
+///       enum { kOutputResult };
+///
+///       virtual void Execute(breadboard::NodeArguments* args) {
+///         SetOutput<kOutputResult>(
+///             args, *GetInput<kInputA>(args) + *GetInput<kInputB>(args));
+///       }
+///     };
+/// ~~~
+///
+/// Nodes that need to set more on their NodeSignature, such as names for their
+/// edges or NodeSignature::set_pure, can still write their own OnRegister, as
+/// long as it calls TypedNode::OnRegister first. Other than that, the edges
+/// must not be changed, as the accessors rely on them matching the template
+/// arguments. NodeArguments may still be used for everything else, such as
+/// listeners and state.
+template <typename... InputTypes, typename... OutputTypes,
+          EventId*... EventIds>
+class TypedNode<Inputs<InputTypes...>, Outputs<OutputTypes...>,
+                Listeners<EventIds...>> : public BaseNode {
+ public:
+  /// @brief The number of input edges.
+  static const size_t kInputCount = sizeof...(InputTypes);
+
+  /// @brief The number of output edges.
+  static const size_t kOutputCount = sizeof...(OutputTypes);
+
+  /// @brief The number of listeners.
+  static const size_t kListenerCount = sizeof...(EventIds);
+
+  /// @brief Adds the edges and listeners given as template arguments to the
+  ///        NodeSignature, in order.
+  ///
+  /// @param[in,out] signature The NodeSignature of the node being registered.
+  static void OnRegister(NodeSignature* signature) {
+    int expand[] = {0, (signature->AddInput<InputTypes>(), 0)...};
+    int expand_outputs[] = {0, (signature->AddOutput<OutputTypes>(), 0)...};
+    int expand_listeners[] = {0, (signature->AddListener(*EventIds), 0)...};
+    (void)expand;
+    (void)expand_outputs;
+    (void)expand_listeners;
+  }
+
+ protected:
+  /// @brief The type of the input edge at the given index.
+  template <size_t Index>
+  using InputType = typename TypeAt<Index, InputTypes...>::type;
+
+  /// @brief The type of the output edge at the given index.
+  template <size_t Index>
+  using OutputType = typename TypeAt<Index, OutputTypes...>::type;
+
+  /// @brief Returns the value of the input edge at the given index.
+  ///
+  /// @param[in] args The arguments passed to Initialize or Execute.
+  ///
+  /// @return A pointer to the value of the input edge.
+  template <size_t Index>
+  static InputType<Index>* GetInput(const NodeArguments* args) {
+    static_assert(Index < kInputCount, "Input index out of range.");
+    return args->GetVerifiedInput<InputType<Index>>(Index);
+  }
+
+  /// @brief Sets the value of the output edge at the given index.
+  ///
+  /// @param[in,out] args The arguments passed to Initialize or Execute.
+  ///
+  /// @param[in] value The value to set the output edge to.
+  template <size_t Index>
+  static void SetOutput(NodeArguments* args,
+                        const OutputType<Index>& value) {
+    static_assert(Index < kOutputCount, "Output index out of range.");
+    OutputType<Index>* data = args->PrepareVerifiedOutput(Index, &value);
+    if (data) {
+      *data = value;
+    }
+  }
+
+  /// @brief Sets the value of the output edge at the given index by moving
+  ///        the given value into it.
+  ///
+  /// @param[in,out] args The arguments passed to Initialize or Execute.
+  ///
+  /// @param[in] value The value to move into the output edge.
+  template <size_t Index>
+  static void SetOutput(NodeArguments* args, OutputType<Index>&& value) {
+    static_assert(Index < kOutputCount, "Output index out of range.");
+    OutputType<Index>* data = args->PrepareVerifiedOutput(Index, &value);
+    if (data) {
+      *data = std::move(value);
+    }
+  }
+
+  /// @brief Marks the `void` output edge at the given index dirty.
+  ///
+  /// @param[in,out] args The arguments passed to Initialize or Execute.
+  template <size_t Index>
+  static void SetOutput(NodeArguments* args) {
+    static_assert(Index < kOutputCount, "Output index out of range.");
+    static_assert(std::is_void<OutputType<Index>>::value,
+                  "Only void outputs can be set without a value.");
+    args->SetVerifiedOutput(Index);
+  }
+
+  /// @brief Returns the value held by the output edge at the given index and
+  ///        marks it dirty.
+  ///
+  /// @param[in,out] args The arguments passed to Initialize or Execute.
+  ///
+  /// @return A pointer to the value of the output edge, or null if the edge
+  /// is not connected to any inputs.
+  template <size_t Index>
+  static OutputType<Index>* GetMutableOutput(NodeArguments* args) {
+    static_assert(Index < kOutputCount, "Output index out of range.");
+    return args->GetVerifiedMutableOutput<OutputType<Index>>(Index);
+  }
+};
+
+}  // namespace breadboard
+
+#endif  // BREADBOARD_TYPED_NODE_H_
@@ -34,22 +34,42 @@ LOCAL_C_INCLUDES := \
   $(LOCAL_EXPORT_C_INCLUDES)
 
 LOCAL_SRC_FILES := \
+  src/breadboard/allocator.cpp \
+  src/breadboard/async_log.cpp \
+  src/breadboard/compiled_graph.cpp \
+  src/breadboard/default_value_overlay.cpp \
   src/breadboard/event.cpp \
+  src/breadboard/event_dispatcher.cpp \
+  src/breadboard/fixed_string.cpp \
+  src/breadboard/generated_graph.cpp \
   src/breadboard/graph.cpp \
   src/breadboard/graph_factory.cpp \
   src/breadboard/graph_state.cpp \
+  src/breadboard/graph_state_batch.cpp \
+  src/breadboard/graph_state_history.cpp \
+  src/breadboard/graph_state_scheduler.cpp \
+  src/breadboard/graph_world.cpp \
+  src/breadboard/job_system.cpp \
   src/breadboard/log.cpp \
+  src/breadboard/memory_buffer_pool.cpp \
+  src/breadboard/memory_stats.cpp \
   src/breadboard/module.cpp \
   src/breadboard/module_registry.cpp \
   src/breadboard/node.cpp \
   src/breadboard/node_arguments.cpp \
+  src/breadboard/node_batch_arguments.cpp \
   src/breadboard/node_signature.cpp \
+  src/breadboard/profiler.cpp \
+  src/breadboard/string_id.cpp \
+  src/breadboard/timer_wheel.cpp \
   src/breadboard/type_registry.cpp \
   src/breadboard/version.cpp \
   src/modules/common.cpp \
   src/modules/debug.cpp \
   src/modules/logic.cpp \
+  src/modules/loop.cpp \
   src/modules/math.cpp \
-  src/modules/string.cpp
+  src/modules/string.cpp \
+  src/modules/timer.cpp
 
 include $(BUILD_STATIC_LIBRARY)
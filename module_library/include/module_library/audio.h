@@ -16,13 +16,18 @@
 #define FPL_BREADBOARD_MODULE_LIBRARY_AUDIO_H_
 
 #include "breadboard/module_registry.h"
+#include "module_library/audio_queue.h"
 #include "pindrop/pindrop.h"
 
 namespace breadboard {
 namespace module_library {
 
+// If an AudioCommandQueue is given, play_sound records its requests there
+// instead of playing them right away, and may then be used from graphs running
+// on other threads. The queue must outlive the module.
 void InitializeAudioModule(breadboard::ModuleRegistry* module_registry,
-                           pindrop::AudioEngine* audio_engine);
+                           pindrop::AudioEngine* audio_engine,
+                           AudioCommandQueue* audio_command_queue = nullptr);
 
 }  // namespace module_library
 }  // namespace breadboard
@@ -0,0 +1,143 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPL_BREADBOARD_MODULE_LIBRARY_AUDIO_QUEUE_H_
+#define FPL_BREADBOARD_MODULE_LIBRARY_AUDIO_QUEUE_H_
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "breadboard/event.h"
+#include "mathfu/glsl_mappings.h"
+#include "pindrop/pindrop.h"
+
+namespace breadboard {
+namespace module_library {
+
+// Broadcast by an AudioCommandQueue to the node that asked for a sound, with
+// the pindrop::Channel it is playing on as the payload. The channel is invalid
+// if the sound was dropped.
+BREADBOARD_DECLARE_EVENT(kSoundStartedEventId)
+
+// Collects the sounds that graphs ask to play during a frame, and plays them
+// together when Submit is called.
+//
+// When the audio module is given an AudioCommandQueue, its play_sound node
+// records a request here instead of calling pindrop directly. Submit then
+// thins out the requests before any of them reach the AudioEngine:
+//
+//   * Requests for the same sound that are within the merge radius of one
+//     another are played once, at the loudest of their gains.
+//   * No more instances of a sound are kept playing than its instance limit,
+//     counting the ones this queue started earlier that are still playing.
+//     Requests over the limit are dropped.
+//
+// Every request is answered with a kSoundStartedEventId event carrying the
+// channel the sound ended up on, so merged requests all get the same channel.
+// Submit should be called once per frame, outside of graph execution.
+class AudioCommandQueue {
+ public:
+  explicit AudioCommandQueue(pindrop::AudioEngine* audio_engine);
+
+  // Requests for the same sound closer together than this are merged. The
+  // default is zero, which only merges requests at the same location.
+  void set_merge_radius(float merge_radius) { merge_radius_ = merge_radius; }
+  float merge_radius() const { return merge_radius_; }
+
+  // The number of instances of a sound that may play at once, unless it has a
+  // limit of its own. The default is 8.
+  void set_default_instance_limit(int instance_limit) {
+    default_instance_limit_ = instance_limit;
+  }
+  int default_instance_limit() const { return default_instance_limit_; }
+
+  // Set the number of instances of the given sound that may play at once.
+  void SetInstanceLimit(pindrop::SoundHandle sound, int instance_limit);
+
+  // Ask for a sound to be played by the next call to Submit, which will answer
+  // by broadcasting kSoundStartedEventId on the given broadcaster.
+  void PlaySound(pindrop::SoundHandle sound, const mathfu::vec3& location,
+                 float gain, NodeEventBroadcaster* broadcaster);
+
+  // Forget the requests that would be answered on the given broadcaster, which
+  // must be called before it is destroyed.
+  void CancelRequests(NodeEventBroadcaster* broadcaster);
+
+  // Play the sounds requested since the last call, and let the nodes that
+  // asked for them know which channels they are playing on.
+  void Submit();
+
+ private:
+  struct Request {
+    pindrop::SoundHandle sound;
+    float location[3];
+    float gain;
+    NodeEventBroadcaster* broadcaster;
+    // The index of the sound in sounds_ that this request was merged into, or
+    // -1 if it was dropped.
+    int sound_index;
+  };
+
+  // A sound that is going to be played.
+  struct Sound {
+    pindrop::SoundHandle sound;
+    mathfu::vec3 location;
+    float gain;
+    pindrop::Channel channel;
+  };
+
+  // A sound that this queue started.
+  struct PlayingSound {
+    pindrop::SoundHandle sound;
+    pindrop::Channel channel;
+  };
+
+  // Disallow copying.
+  AudioCommandQueue(const AudioCommandQueue&);
+  AudioCommandQueue& operator=(const AudioCommandQueue&);
+
+  // Returns the instance limit of the given sound.
+  int InstanceLimit(pindrop::SoundHandle sound) const;
+
+  // Returns the number of instances of the given sound that are playing or
+  // about to be.
+  int InstanceCount(pindrop::SoundHandle sound) const;
+
+  // Merge the given request into the sounds that will be played, or decide to
+  // drop it.
+  void AssignSound(Request* request);
+
+  pindrop::AudioEngine* audio_engine_;
+  float merge_radius_;
+  int default_instance_limit_;
+  std::vector<std::pair<pindrop::SoundHandle, int>> instance_limits_;
+
+  // Guards requests_ and delivering_, which may be touched from any thread.
+  std::mutex mutex_;
+  std::vector<Request> requests_;
+
+  // The requests being answered by Submit. Requests are answered without
+  // holding the lock, since the graphs that receive them may ask for more.
+  std::vector<Request> delivering_;
+
+  // Only touched by Submit.
+  std::vector<Sound> sounds_;
+  std::vector<PlayingSound> playing_;
+};
+
+}  // namespace module_library
+}  // namespace breadboard
+
+#endif  // FPL_BREADBOARD_MODULE_LIBRARY_AUDIO_QUEUE_H_
@@ -0,0 +1,124 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPL_BREADBOARD_MODULE_LIBRARY_COMPONENT_COMMANDS_H_
+#define FPL_BREADBOARD_MODULE_LIBRARY_COMPONENT_COMMANDS_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "corgi/entity_manager.h"
+#include "corgi_component_library/rendermesh.h"
+#include "corgi_component_library/transform.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace breadboard {
+namespace module_library {
+
+// Records writes to component data made by graphs, so that they can be
+// applied together at a point of the frame the game chooses.
+//
+// Nodes that write to components directly have to run on the main thread, and
+// scatter their writes across component storage in whatever order the graphs
+// happen to run. When the transform and rendermesh modules are given a
+// ComponentCommandBuffer, their set_scale, set_visible and set_tint nodes
+// record a command instead, and are marked thread safe so that they can run
+// on any thread. Each thread records into its own list, so recording takes no
+// lock after a thread's first command.
+//
+// Apply sorts the commands by kind and by entity, drops all but the last
+// command of each kind for each entity, and applies the rest in one pass. If
+// several threads set the same thing on the same entity, which of them wins is
+// not defined. Apply must not be called
+// while graphs are executing. Until it is, the components still hold their old
+// values.
+class ComponentCommandBuffer {
+ public:
+  ComponentCommandBuffer(
+      corgi::component_library::TransformComponent* transform_component,
+      corgi::component_library::RenderMeshComponent* render_mesh_component);
+
+  // Record setting the scale of the given entity's transform.
+  void SetScale(const corgi::EntityRef& entity, const mathfu::vec3& scale);
+
+  // Record setting the visibility of the given entity's render mesh, and those
+  // of its children.
+  void SetVisible(const corgi::EntityRef& entity, bool visible);
+
+  // Record setting the tint of the given entity's render mesh.
+  void SetTint(const corgi::EntityRef& entity, const mathfu::vec4& tint);
+
+  // Apply every command recorded since the last call, then forget them.
+  void Apply();
+
+  // Returns the number of commands waiting to be applied.
+  size_t command_count() const;
+
+ private:
+  // The order of these is the order in which the commands are applied.
+  enum CommandType { kSetScale, kSetVisible, kSetTint };
+
+  struct Command {
+    CommandType type;
+    corgi::EntityRef entity;
+    // The position of the command once the lanes have been merged, which
+    // keeps the commands of each thread in the order they were recorded.
+    size_t sequence;
+    // Held as plain floats so that commands need no special alignment.
+    float value[4];
+  };
+
+  // The commands recorded by one thread.
+  struct Lane {
+    std::thread::id thread_id;
+    std::vector<Command> commands;
+  };
+
+  // Disallow copying.
+  ComponentCommandBuffer(const ComponentCommandBuffer&);
+  ComponentCommandBuffer& operator=(const ComponentCommandBuffer&);
+
+  // Returns the lane of the calling thread, making one if needed.
+  Lane* GetLane();
+
+  // Add a command to the lane of the calling thread.
+  void Record(CommandType type, const corgi::EntityRef& entity, float x,
+              float y, float z, float w);
+
+  // Apply a fully sorted, deduplicated command.
+  void ApplyCommand(const Command& command);
+
+  corgi::component_library::TransformComponent* transform_component_;
+  corgi::component_library::RenderMeshComponent* render_mesh_component_;
+
+  // Identifies this buffer to the per-thread cache of lanes. Unlike its
+  // address, it is never reused by another buffer.
+  uint64_t id_;
+
+  // Guards lanes_ itself, but not the commands in each lane, which are only
+  // touched by their own thread until Apply.
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Lane>> lanes_;
+
+  // Reused by Apply to merge the lanes.
+  std::vector<Command> merged_;
+};
+
+}  // namespace module_library
+}  // namespace breadboard
+
+#endif  // FPL_BREADBOARD_MODULE_LIBRARY_COMPONENT_COMMANDS_H_
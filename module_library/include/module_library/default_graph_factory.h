@@ -30,7 +30,10 @@ class DefaultGraphFactory : public breadboard::GraphFactory {
   DefaultGraphFactory(breadboard::ModuleRegistry* module_registry,
                       breadboard::LoadFileCallback load_file_callback)
       : breadboard::GraphFactory(module_registry, load_file_callback) {}
-  virtual ~DefaultGraphFactory() {}
+  DefaultGraphFactory(breadboard::ModuleRegistry* module_registry,
+                      breadboard::LoadFileViewCallback load_file_view_callback)
+      : breadboard::GraphFactory(module_registry, load_file_view_callback) {}
+  virtual ~DefaultGraphFactory() { WaitForPendingGraphs(); }
 
 #ifdef BREADBOARD_MODULE_LIBRARY_BUILD_PINDROP
   void set_audio_engine(pindrop::AudioEngine* audio_engine) {
@@ -44,6 +47,9 @@ class DefaultGraphFactory : public breadboard::GraphFactory {
  private:
   virtual bool ParseData(breadboard::ModuleRegistry* module_registry,
                          breadboard::Graph* graph, const std::string* data);
+  virtual bool ParseDataView(breadboard::ModuleRegistry* module_registry,
+                             breadboard::Graph* graph, const uint8_t* data,
+                             size_t size);
 
 #ifdef BREADBOARD_MODULE_LIBRARY_BUILD_PINDROP
   pindrop::AudioEngine* audio_engine_;
@@ -15,6 +15,11 @@
 #ifndef FPL_BREADBOARD_MODULE_LIBRARY_ENTITY_H_
 #define FPL_BREADBOARD_MODULE_LIBRARY_ENTITY_H_
 
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "breadboard/event.h"
 #include "breadboard/module_registry.h"
 #include "corgi_component_library/graph.h"
 #include "corgi_component_library/meta.h"
@@ -23,13 +28,49 @@
 namespace breadboard {
 namespace module_library {
 
+// Broadcast by EntityIdBroadcasters when the entity with a given ID is created
+// or deleted.
+BREADBOARD_DECLARE_EVENT(kEntityChangedEventId)
+
+// Holds a broadcaster for each entity ID that an entity node has looked up, so
+// that the node only resolves its ID again when the entity it names changes.
+//
+// The game is expected to call NotifyEntityChanged whenever it adds an entity
+// to, or removes one from, the MetaComponent's dictionary.
+class EntityIdBroadcasters {
+ public:
+  EntityIdBroadcasters() {}
+
+  // Returns the broadcaster for the given entity ID, making it if needed.
+  NodeEventBroadcaster* GetBroadcaster(const std::string& entity_id);
+
+  // Lets the nodes that resolved the given entity ID know that the entity it
+  // names has been created or deleted. Does nothing if no node ever looked
+  // this ID up.
+  void NotifyEntityChanged(const std::string& entity_id);
+
+ private:
+  // Disallow copying.
+  EntityIdBroadcasters(const EntityIdBroadcasters&);
+  EntityIdBroadcasters& operator=(const EntityIdBroadcasters&);
+
+  // Broadcasters are held by pointer so that the listeners linked into them
+  // stay put as the map grows.
+  std::unordered_map<std::string, std::unique_ptr<NodeEventBroadcaster>>
+      broadcasters_;
+};
+
 void SetGraphEntity(::corgi::EntityRef entity);
 
+// If entity_id_broadcasters is given, entity nodes listen for changes to the
+// entity they resolved rather than looking it up whenever they are triggered.
+// It must outlive every GraphState using the module.
 void InitializeEntityModule(
     breadboard::ModuleRegistry* module_registry,
     ::corgi::EntityManager* entity_manager,
     ::corgi::component_library::MetaComponent* meta_component,
-    ::corgi::component_library::GraphComponent* graph_component);
+    ::corgi::component_library::GraphComponent* graph_component,
+    EntityIdBroadcasters* entity_id_broadcasters = nullptr);
 
 }  // namespace module_library
 }  // namespace breadboard
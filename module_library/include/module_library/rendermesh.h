@@ -17,13 +17,17 @@
 
 #include "breadboard/module_registry.h"
 #include "corgi_component_library/rendermesh.h"
+#include "module_library/component_commands.h"
 
 namespace breadboard {
 namespace module_library {
 
+// If commands is given, set_visible and set_tint record into it instead of
+// writing to the render mesh component, and may run on any thread.
 void InitializeRenderMeshModule(
     breadboard::ModuleRegistry* module_registry,
-    ::corgi::component_library::RenderMeshComponent* render_mesh_component);
+    ::corgi::component_library::RenderMeshComponent* render_mesh_component,
+    ComponentCommandBuffer* commands = nullptr);
 
 }  // namespace module_library
 }  // namespace breadboard
@@ -15,16 +15,25 @@
 #ifndef FPL_BREADBOARD_MODULE_LIBRARY_TRANSFORM_H_
 #define FPL_BREADBOARD_MODULE_LIBRARY_TRANSFORM_H_
 
+#include "breadboard/graph_factory.h"
 #include "breadboard/module_registry.h"
 #include "corgi_component_library/transform.h"
+#include "module_library/component_commands.h"
 #include "module_library/entity.h"
 
 namespace breadboard {
 namespace module_library {
 
+// Registers the EntityList type, which the children node outputs. If
+// graph_factory is given, the for_each_entity and entity_element nodes are
+// registered as well, and load the graphs they run through it. If commands is
+// given, set_scale records into it instead of writing to the transform
+// component, and may run on any thread.
 void InitializeTransformModule(
     breadboard::ModuleRegistry* module_registry,
-    corgi::component_library::TransformComponent* transform_component);
+    corgi::component_library::TransformComponent* transform_component,
+    breadboard::GraphFactory* graph_factory = nullptr,
+    ComponentCommandBuffer* commands = nullptr);
 
 }  // namespace module_library
 }  // namespace breadboard
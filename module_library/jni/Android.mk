@@ -63,6 +63,8 @@ LOCAL_C_INCLUDES := \
 LOCAL_SRC_FILES := \
   src/animation.cpp \
   src/audio.cpp \
+  src/audio_queue.cpp \
+  src/component_commands.cpp \
   src/entity.cpp \
   src/physics.cpp \
   src/rendermesh.cpp \
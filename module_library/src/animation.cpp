@@ -60,24 +60,31 @@ class AnimationCompleteNode : public BaseNode {
     node_sig->AddOutput<void>(kOutputAnimationComplete, "Animation Complete");
     node_sig->AddListener(kListenerAnimationComplete,
                           kAnimationCompleteEventId);
+    node_sig->set_thread_safe(false);
   }
 
-  virtual void Initialize(NodeArguments* args) {
-    EntityRef entity = *args->GetInput<EntityRef>(kInputEntity);
-    if (entity) {
-      args->BindBroadcaster(kListenerAnimationComplete,
-                            graph_component_->GetCreateBroadcaster(entity));
-    }
-  }
+  virtual void Initialize(NodeArguments* args) { BindEntity(args); }
 
   virtual void Execute(NodeArguments* args) {
-    Initialize(args);
+    BindEntity(args);
     if (args->IsListenerDirty(kListenerAnimationComplete)) {
       args->SetOutput(kOutputAnimationComplete);
     }
   }
 
  private:
+  // Only look up the entity's broadcaster when the entity has changed, and
+  // stop listening if it has been cleared.
+  void BindEntity(NodeArguments* args) {
+    args->BindBroadcasterToInput(
+        kListenerAnimationComplete, kInputEntity,
+        [this, args]() -> NodeEventBroadcaster* {
+          EntityRef entity = *args->GetInput<EntityRef>(kInputEntity);
+          return entity ? graph_component_->GetCreateBroadcaster(entity)
+                        : nullptr;
+        });
+  }
+
   GraphComponent* graph_component_;
 };
 
@@ -102,6 +109,7 @@ class PlayAnimationNode : public BaseNode {
     node_sig->AddInput<int>(kInputAnimIndex, "Animation Index",
                             "The animation index to play");
     node_sig->AddOutput<void>(kOutputTrigger);
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -140,6 +148,7 @@ class AnimationIndexNode : public breadboard::BaseNode {
     node_sig->AddInput<void>(kInputTrigger, "Trigger");
     node_sig->AddInput<EntityRef>(kInputEntity, "Entity");
     node_sig->AddOutput<int>(kOutputAnimIndex, "Trigger");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(breadboard::NodeArguments* args) {
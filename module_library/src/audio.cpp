@@ -15,9 +15,11 @@
 #include "module_library/audio.h"
 
 #include "breadboard/base_node.h"
+#include "breadboard/event.h"
 #include "breadboard/module_registry.h"
 #include "breadboard/type_registry.h"
 #include "mathfu/glsl_mappings.h"
+#include "module_library/audio_queue.h"
 #include "pindrop/pindrop.h"
 
 using breadboard::BaseNode;
@@ -49,6 +51,7 @@ class PlaySoundNode : public BaseNode {
     node_sig->AddInput<vec3>(kInputLocation, "Location");
     node_sig->AddInput<float>(kInputGain, "Gain");
     node_sig->AddOutput<Channel>(kOutputChannel, "Channel");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -65,6 +68,73 @@ class PlaySoundNode : public BaseNode {
   AudioEngine* audio_engine_;
 };
 
+// Asks an AudioCommandQueue to play the given sound when it is next submitted.
+// Takes the same arguments as PlaySoundNode, and outputs the channel once the
+// queue has played the sound. The channel is invalid if the sound was dropped.
+class QueuedPlaySoundNode : public BaseNode {
+ public:
+  enum { kInputPlay, kInputSoundHandle, kInputLocation, kInputGain };
+  enum { kOutputChannel };
+  enum { kListenerSoundStarted };
+
+  struct QueuedPlaySoundState {
+    QueuedPlaySoundState() : audio_command_queue(nullptr) {}
+    ~QueuedPlaySoundState() {
+      if (audio_command_queue) {
+        audio_command_queue->CancelRequests(&broadcaster);
+      }
+    }
+
+    AudioCommandQueue* audio_command_queue;
+    NodeEventBroadcaster broadcaster;
+
+   private:
+    // Disallow copying.
+    QueuedPlaySoundState(const QueuedPlaySoundState&);
+    QueuedPlaySoundState& operator=(const QueuedPlaySoundState&);
+  };
+
+  QueuedPlaySoundNode(AudioCommandQueue* audio_command_queue)
+      : audio_command_queue_(audio_command_queue) {}
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<void>(kInputPlay, "Play");
+    node_sig->AddInput<SoundHandle>(kInputSoundHandle, "Sound");
+    node_sig->AddInput<vec3>(kInputLocation, "Location");
+    node_sig->AddInput<float>(kInputGain, "Gain");
+    node_sig->AddOutput<Channel>(kOutputChannel, "Channel");
+    node_sig->AddListener(kListenerSoundStarted, kSoundStartedEventId);
+    node_sig->SetState<QueuedPlaySoundState>();
+    // Requests are only recorded, so graphs may run on any thread.
+    node_sig->set_thread_safe(true);
+  }
+
+  virtual void Initialize(NodeArguments* args) {
+    QueuedPlaySoundState* state = args->GetState<QueuedPlaySoundState>();
+    state->audio_command_queue = audio_command_queue_;
+    args->BindBroadcaster(kListenerSoundStarted, &state->broadcaster);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    QueuedPlaySoundState* state = args->GetState<QueuedPlaySoundState>();
+    const Channel* channel =
+        args->GetListenerPayload<Channel>(kListenerSoundStarted);
+    if (channel) {
+      args->SetOutput(kOutputChannel, *channel);
+    }
+    if (args->IsInputDirty(kInputPlay)) {
+      auto handle = args->GetInput<SoundHandle>(kInputSoundHandle);
+      auto location = args->GetInput<vec3>(kInputLocation);
+      auto gain = args->GetInput<float>(kInputGain);
+      audio_command_queue_->PlaySound(*handle, *location, *gain,
+                                      &state->broadcaster);
+    }
+  }
+
+ private:
+  AudioCommandQueue* audio_command_queue_;
+};
+
 // Checks if a given audio channel is playing.
 class PlayingNode : public BaseNode {
  public:
@@ -74,7 +144,9 @@ class PlayingNode : public BaseNode {
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<Channel>(kInputChannel, "Channel");
     node_sig->AddOutput<Channel>(kOutputChannel, "Channel");
+    node_sig->SetOutputAlias(kOutputChannel, kInputChannel);
     node_sig->AddOutput<bool>(kOutputPlaying, "Result");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -93,6 +165,8 @@ class StopNode : public BaseNode {
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<Channel>(kInputChannel, "Channel");
     node_sig->AddOutput<Channel>(kOutputChannel, "Channel");
+    node_sig->SetOutputAlias(kOutputChannel, kInputChannel);
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -112,6 +186,8 @@ class SetGainNode : public BaseNode {
     node_sig->AddInput<Channel>(kInputChannel, "Channel");
     node_sig->AddInput<float>(kInputGain, "Gain");
     node_sig->AddOutput<Channel>(kOutputChannel, "Channel");
+    node_sig->SetOutputAlias(kOutputChannel, kInputChannel);
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -131,7 +207,9 @@ class GainNode : public BaseNode {
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<Channel>(kInputChannel, "Channel");
     node_sig->AddOutput<Channel>(kOutputChannel, "Channel");
+    node_sig->SetOutputAlias(kOutputChannel, kInputChannel);
     node_sig->AddOutput<float>(kOutputGain, "Gain");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -151,6 +229,8 @@ class SetLocationNode : public BaseNode {
     node_sig->AddInput<Channel>(kInputChannel);
     node_sig->AddInput<vec3>(kInputLocation);
     node_sig->AddOutput<Channel>(kOutputChannel);
+    node_sig->SetOutputAlias(kOutputChannel, kInputChannel);
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -170,7 +250,9 @@ class LocationNode : public BaseNode {
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<Channel>(kInputChannel, "Channel");
     node_sig->AddOutput<Channel>(kOutputChannel, "Channel");
+    node_sig->SetOutputAlias(kOutputChannel, kInputChannel);
     node_sig->AddOutput<vec3>(kOutputLocation, "Location");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -181,14 +263,22 @@ class LocationNode : public BaseNode {
 };
 
 void InitializeAudioModule(ModuleRegistry* module_registry,
-                           AudioEngine* audio_engine) {
-  auto play_sound_ctor = [audio_engine]() {
-    return new PlaySoundNode(audio_engine);
-  };
+                           AudioEngine* audio_engine,
+                           AudioCommandQueue* audio_command_queue) {
   TypeRegistry<Channel>::RegisterType("Channel");
   TypeRegistry<SoundHandle>::RegisterType("SoundHandle");
   Module* module = module_registry->RegisterModule("audio");
-  module->RegisterNode<PlaySoundNode>("play_sound", play_sound_ctor);
+  if (audio_command_queue) {
+    auto play_sound_ctor = [audio_command_queue]() {
+      return new QueuedPlaySoundNode(audio_command_queue);
+    };
+    module->RegisterNode<QueuedPlaySoundNode>("play_sound", play_sound_ctor);
+  } else {
+    auto play_sound_ctor = [audio_engine]() {
+      return new PlaySoundNode(audio_engine);
+    };
+    module->RegisterNode<PlaySoundNode>("play_sound", play_sound_ctor);
+  }
   module->RegisterNode<PlayingNode>("playing");
   module->RegisterNode<StopNode>("stop");
   module->RegisterNode<SetGainNode>("set_gain");
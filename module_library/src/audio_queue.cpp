@@ -0,0 +1,183 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "module_library/audio_queue.h"
+
+using mathfu::vec3;
+using pindrop::Channel;
+using pindrop::SoundHandle;
+
+namespace breadboard {
+namespace module_library {
+
+BREADBOARD_DEFINE_EVENT(kSoundStartedEventId)
+
+static const int kDefaultInstanceLimit = 8;
+
+AudioCommandQueue::AudioCommandQueue(pindrop::AudioEngine* audio_engine)
+    : audio_engine_(audio_engine),
+      merge_radius_(0.0f),
+      default_instance_limit_(kDefaultInstanceLimit) {}
+
+void AudioCommandQueue::SetInstanceLimit(SoundHandle sound,
+                                         int instance_limit) {
+  for (size_t i = 0; i < instance_limits_.size(); ++i) {
+    if (instance_limits_[i].first == sound) {
+      instance_limits_[i].second = instance_limit;
+      return;
+    }
+  }
+  instance_limits_.push_back(std::make_pair(sound, instance_limit));
+}
+
+void AudioCommandQueue::PlaySound(SoundHandle sound, const vec3& location,
+                                  float gain,
+                                  NodeEventBroadcaster* broadcaster) {
+  Request request;
+  request.sound = sound;
+  request.location[0] = location[0];
+  request.location[1] = location[1];
+  request.location[2] = location[2];
+  request.gain = gain;
+  request.broadcaster = broadcaster;
+  request.sound_index = -1;
+  std::lock_guard<std::mutex> lock(mutex_);
+  requests_.push_back(request);
+}
+
+void AudioCommandQueue::CancelRequests(NodeEventBroadcaster* broadcaster) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < requests_.size(); ++i) {
+    if (requests_[i].broadcaster == broadcaster) {
+      requests_[i].broadcaster = nullptr;
+    }
+  }
+  for (size_t i = 0; i < delivering_.size(); ++i) {
+    if (delivering_[i].broadcaster == broadcaster) {
+      delivering_[i].broadcaster = nullptr;
+    }
+  }
+}
+
+int AudioCommandQueue::InstanceLimit(SoundHandle sound) const {
+  for (size_t i = 0; i < instance_limits_.size(); ++i) {
+    if (instance_limits_[i].first == sound) {
+      return instance_limits_[i].second;
+    }
+  }
+  return default_instance_limit_;
+}
+
+int AudioCommandQueue::InstanceCount(SoundHandle sound) const {
+  int count = 0;
+  for (size_t i = 0; i < playing_.size(); ++i) {
+    if (playing_[i].sound == sound) {
+      ++count;
+    }
+  }
+  for (size_t i = 0; i < sounds_.size(); ++i) {
+    if (sounds_[i].sound == sound) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+void AudioCommandQueue::AssignSound(Request* request) {
+  vec3 location(request->location[0], request->location[1],
+                request->location[2]);
+  float merge_radius_squared = merge_radius_ * merge_radius_;
+  for (size_t i = 0; i < sounds_.size(); ++i) {
+    Sound& sound = sounds_[i];
+    if (sound.sound == request->sound) {
+      vec3 offset = sound.location - location;
+      if (vec3::DotProduct(offset, offset) <= merge_radius_squared) {
+        if (request->gain > sound.gain) {
+          sound.gain = request->gain;
+        }
+        request->sound_index = static_cast<int>(i);
+        return;
+      }
+    }
+  }
+  if (InstanceCount(request->sound) >= InstanceLimit(request->sound)) {
+    request->sound_index = -1;
+    return;
+  }
+  Sound sound;
+  sound.sound = request->sound;
+  sound.location = location;
+  sound.gain = request->gain;
+  request->sound_index = static_cast<int>(sounds_.size());
+  sounds_.push_back(sound);
+}
+
+void AudioCommandQueue::Submit() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    delivering_.swap(requests_);
+    requests_.clear();
+  }
+
+  // Forget the sounds that have finished, so that they no longer count
+  // against their instance limits.
+  size_t still_playing = 0;
+  for (size_t i = 0; i < playing_.size(); ++i) {
+    if (playing_[i].channel.Playing()) {
+      playing_[still_playing++] = playing_[i];
+    }
+  }
+  playing_.resize(still_playing);
+
+  sounds_.clear();
+  for (size_t i = 0; i < delivering_.size(); ++i) {
+    if (delivering_[i].broadcaster) {
+      AssignSound(&delivering_[i]);
+    }
+  }
+  for (size_t i = 0; i < sounds_.size(); ++i) {
+    Sound& sound = sounds_[i];
+    sound.channel =
+        audio_engine_->PlaySound(sound.sound, sound.location, sound.gain);
+    PlayingSound playing_sound;
+    playing_sound.sound = sound.sound;
+    playing_sound.channel = sound.channel;
+    playing_.push_back(playing_sound);
+  }
+
+  static const EventIndex event_index = GetEventIndex(kSoundStartedEventId);
+  for (size_t i = 0;; ++i) {
+    NodeEventBroadcaster* broadcaster;
+    int sound_index;
+    {
+      // A graph that receives a channel may destroy another GraphState that
+      // is waiting for one, which cancels its requests.
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (i >= delivering_.size()) {
+        delivering_.clear();
+        break;
+      }
+      broadcaster = delivering_[i].broadcaster;
+      sound_index = delivering_[i].sound_index;
+    }
+    if (broadcaster) {
+      Channel channel =
+          sound_index >= 0 ? sounds_[sound_index].channel : Channel();
+      broadcaster->BroadcastEventIndex(event_index, channel);
+    }
+  }
+}
+
+}  // namespace module_library
+}  // namespace breadboard
@@ -0,0 +1,208 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "module_library/component_commands.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+using corgi::component_library::RenderMeshComponent;
+using corgi::component_library::RenderMeshData;
+using corgi::component_library::TransformComponent;
+using corgi::component_library::TransformData;
+using corgi::EntityRef;
+using mathfu::vec3;
+using mathfu::vec4;
+
+namespace breadboard {
+namespace module_library {
+
+namespace {
+
+// Every thread remembers the lane it last recorded into, so that looking it up
+// again does not need the buffer's lock.
+struct LaneCache {
+  uint64_t buffer_id;
+  void* lane;
+};
+
+thread_local LaneCache g_lane_cache = {0, nullptr};
+
+uint64_t NextBufferId() {
+  static std::atomic<uint64_t> next_id(1);
+  return next_id.fetch_add(1);
+}
+
+}  // namespace
+
+ComponentCommandBuffer::ComponentCommandBuffer(
+    TransformComponent* transform_component,
+    RenderMeshComponent* render_mesh_component)
+    : transform_component_(transform_component),
+      render_mesh_component_(render_mesh_component),
+      id_(NextBufferId()) {}
+
+void ComponentCommandBuffer::SetScale(const EntityRef& entity,
+                                      const vec3& scale) {
+  Record(kSetScale, entity, scale[0], scale[1], scale[2], 0.0f);
+}
+
+void ComponentCommandBuffer::SetVisible(const EntityRef& entity,
+                                        bool visible) {
+  Record(kSetVisible, entity, visible ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+void ComponentCommandBuffer::SetTint(const EntityRef& entity,
+                                     const vec4& tint) {
+  Record(kSetTint, entity, tint[0], tint[1], tint[2], tint[3]);
+}
+
+ComponentCommandBuffer::Lane* ComponentCommandBuffer::GetLane() {
+  if (g_lane_cache.buffer_id == id_) {
+    return static_cast<Lane*>(g_lane_cache.lane);
+  }
+  std::thread::id thread_id = std::this_thread::get_id();
+  std::lock_guard<std::mutex> lock(mutex_);
+  Lane* lane = nullptr;
+  for (size_t i = 0; i < lanes_.size(); ++i) {
+    if (lanes_[i]->thread_id == thread_id) {
+      lane = lanes_[i].get();
+      break;
+    }
+  }
+  if (!lane) {
+    lanes_.push_back(std::unique_ptr<Lane>(new Lane()));
+    lane = lanes_.back().get();
+    lane->thread_id = thread_id;
+  }
+  g_lane_cache.buffer_id = id_;
+  g_lane_cache.lane = lane;
+  return lane;
+}
+
+void ComponentCommandBuffer::Record(CommandType type, const EntityRef& entity,
+                                    float x, float y, float z, float w) {
+  Command command;
+  command.type = type;
+  command.entity = entity;
+  command.sequence = 0;
+  command.value[0] = x;
+  command.value[1] = y;
+  command.value[2] = z;
+  command.value[3] = w;
+  GetLane()->commands.push_back(command);
+}
+
+size_t ComponentCommandBuffer::command_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t count = 0;
+  for (size_t i = 0; i < lanes_.size(); ++i) {
+    count += lanes_[i]->commands.size();
+  }
+  return count;
+}
+
+void ComponentCommandBuffer::Apply() {
+  merged_.clear();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < lanes_.size(); ++i) {
+      std::vector<Command>& commands = lanes_[i]->commands;
+      merged_.insert(merged_.end(), commands.begin(), commands.end());
+      commands.clear();
+    }
+  }
+  for (size_t i = 0; i < merged_.size(); ++i) {
+    merged_[i].sequence = i;
+  }
+
+  // Group the commands by kind and then by where the entity's data lives, so
+  // that each component's storage is walked in order.
+  std::sort(merged_.begin(), merged_.end(),
+            [](const Command& a, const Command& b) {
+              if (a.type != b.type) {
+                return a.type < b.type;
+              }
+              if (a.entity.index() != b.entity.index()) {
+                return a.entity.index() < b.entity.index();
+              }
+              return a.sequence < b.sequence;
+            });
+
+  // Only the last of each run of commands for the same thing counts.
+  // Visibility is set recursively, so a parent's command may override one on
+  // its child; those are moved to the front of merged_, which has already
+  // been walked past, to be applied in the order they were recorded.
+  size_t visible_count = 0;
+  for (size_t i = 0; i < merged_.size(); ++i) {
+    const Command& command = merged_[i];
+    bool superseded = i + 1 < merged_.size() &&
+                      merged_[i + 1].type == command.type &&
+                      merged_[i + 1].entity == command.entity;
+    if (superseded) {
+      continue;
+    }
+    if (command.type == kSetVisible) {
+      merged_[visible_count++] = command;
+    } else {
+      ApplyCommand(command);
+    }
+  }
+  std::sort(merged_.begin(), merged_.begin() + visible_count,
+            [](const Command& a, const Command& b) {
+              return a.sequence < b.sequence;
+            });
+  for (size_t i = 0; i < visible_count; ++i) {
+    ApplyCommand(merged_[i]);
+  }
+  merged_.clear();
+}
+
+void ComponentCommandBuffer::ApplyCommand(const Command& command) {
+  // Entities may have been deleted since the command was recorded.
+  if (!command.entity.IsValid()) {
+    return;
+  }
+  const float* value = command.value;
+  switch (command.type) {
+    case kSetScale: {
+      assert(transform_component_);
+      TransformData* transform_data =
+          transform_component_->GetComponentData(command.entity);
+      if (transform_data) {
+        transform_data->scale = vec3(value[0], value[1], value[2]);
+      }
+      break;
+    }
+    case kSetVisible: {
+      assert(render_mesh_component_);
+      render_mesh_component_->SetVisibilityRecursively(command.entity,
+                                                       value[0] != 0.0f);
+      break;
+    }
+    case kSetTint: {
+      assert(render_mesh_component_);
+      RenderMeshData* render_mesh_data =
+          render_mesh_component_->GetComponentData(command.entity);
+      if (render_mesh_data) {
+        render_mesh_data->tint = vec4(value[0], value[1], value[2], value[3]);
+      }
+      break;
+    }
+  }
+}
+
+}  // namespace module_library
+}  // namespace breadboard
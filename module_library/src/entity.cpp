@@ -14,6 +14,8 @@
 
 #include "module_library/entity.h"
 
+#include <string>
+
 #include "breadboard/base_node.h"
 #include "breadboard/module_registry.h"
 #include "corgi_component_library/meta.h"
@@ -24,6 +26,7 @@ using breadboard::BaseNode;
 using breadboard::ModuleRegistry;
 using breadboard::Module;
 using breadboard::NodeArguments;
+using breadboard::NodeEventBroadcaster;
 using breadboard::NodeSignature;
 using breadboard::TypeRegistry;
 using corgi::component_library::GraphComponent;
@@ -34,29 +37,94 @@ using corgi::EntityRef;
 namespace breadboard {
 namespace module_library {
 
+BREADBOARD_DEFINE_EVENT(kEntityChangedEventId)
+
+NodeEventBroadcaster* EntityIdBroadcasters::GetBroadcaster(
+    const std::string& entity_id) {
+  std::unique_ptr<NodeEventBroadcaster>& broadcaster =
+      broadcasters_[entity_id];
+  if (!broadcaster) {
+    broadcaster.reset(new NodeEventBroadcaster());
+  }
+  return broadcaster.get();
+}
+
+void EntityIdBroadcasters::NotifyEntityChanged(const std::string& entity_id) {
+  static const breadboard::EventIndex event_index =
+      breadboard::GetEventIndex(kEntityChangedEventId);
+  auto iter = broadcasters_.find(entity_id);
+  if (iter != broadcasters_.end()) {
+    iter->second->BroadcastEventIndex(event_index);
+  }
+}
+
 // Given an input string, return the named entity.
+//
+// The entity is only looked up when the ID changes, or when the entity with
+// that ID is created or deleted, and only then are the nodes downstream
+// triggered. If the entity does not exist, an invalid EntityRef is output
+// until it is created.
 class EntityNode : public BaseNode {
  public:
   enum { kInputTrigger, kInputEntityId };
   enum { kOutputEntity };
+  enum { kListenerEntityChanged };
+
+  // The entity last resolved by each instance of the node.
+  struct EntityNodeState {
+    EntityNodeState() : resolved(false) {}
+    bool resolved;
+    std::string entity_id;
+    EntityRef entity;
+  };
+
+  EntityNode(MetaComponent* meta_component,
+             EntityIdBroadcasters* entity_id_broadcasters)
+      : meta_component_(meta_component),
+        entity_id_broadcasters_(entity_id_broadcasters) {}
 
-  EntityNode(MetaComponent* meta_component) : meta_component_(meta_component) {}
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<void>(kInputTrigger, "Trigger");
     node_sig->AddInput<std::string>(kInputEntityId, "Entity ID");
     node_sig->AddOutput<EntityRef>(kOutputEntity, "Entity");
+    node_sig->AddListener(kListenerEntityChanged, kEntityChangedEventId);
+    node_sig->SetState<EntityNodeState>();
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
+    EntityNodeState* state = args->GetState<EntityNodeState>();
     auto entity_id = args->GetInput<std::string>(kInputEntityId);
+    bool id_changed = !state->resolved || state->entity_id != *entity_id;
+    if (id_changed) {
+      state->entity_id = *entity_id;
+      if (entity_id_broadcasters_) {
+        args->BindBroadcaster(
+            kListenerEntityChanged,
+            entity_id_broadcasters_->GetBroadcaster(*entity_id));
+      }
+    }
+
+    // Without broadcasters there is no word of new entities, so keep looking
+    // for a missing one each time the node is triggered.
+    bool stale = args->IsListenerDirty(kListenerEntityChanged) ||
+                 (!entity_id_broadcasters_ && !state->entity.IsValid());
+    if (!id_changed && !stale) {
+      return;
+    }
+
     EntityRef entity =
         meta_component_->GetEntityFromDictionary(entity_id->c_str());
-    assert(entity.IsValid());
-    args->SetOutput(kOutputEntity, entity);
+    if (!state->resolved || !(entity == state->entity)) {
+      state->resolved = true;
+      state->entity = entity;
+      args->SetOutput(kOutputEntity, entity);
+    }
   }
 
  private:
   MetaComponent* meta_component_;
+  EntityIdBroadcasters* entity_id_broadcasters_;
 };
 
 // Return the entity that owns this graph.
@@ -69,6 +137,7 @@ class GraphEntityNode : public BaseNode {
 
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddOutput<EntityRef>(kOutputEntity, "Entity");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Initialize(NodeArguments* args) {
@@ -90,6 +159,7 @@ class DeleteEntityNode : public BaseNode {
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<void>(kInputTrigger, "Trigger");
     node_sig->AddInput<EntityRef>(kInputEntity, "Entity");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -106,9 +176,10 @@ class DeleteEntityNode : public BaseNode {
 void InitializeEntityModule(ModuleRegistry* module_registry,
                             EntityManager* entity_manager,
                             MetaComponent* meta_component,
-                            GraphComponent* graph_component) {
-  auto entity_ctor = [meta_component]() {
-    return new EntityNode(meta_component);
+                            GraphComponent* graph_component,
+                            EntityIdBroadcasters* entity_id_broadcasters) {
+  auto entity_ctor = [meta_component, entity_id_broadcasters]() {
+    return new EntityNode(meta_component, entity_id_broadcasters);
   };
   auto graph_entity_ctor = [graph_component]() {
     return new GraphEntityNode(graph_component);
@@ -48,22 +48,28 @@ class OnCollisionNode : public BaseNode {
     node_sig->AddInput<EntityRef>(kInputEntity, "Entity");
     node_sig->AddOutput<void>(kOutputCollision, "Collision");
     node_sig->AddListener(kCollisionEventId);
+    node_sig->set_thread_safe(false);
   }
 
-  virtual void Initialize(NodeArguments* args) {
-    auto entity = args->GetInput<EntityRef>(kInputEntity);
-    args->BindBroadcaster(kListenerOnCollision,
-                          graph_component_->GetCreateBroadcaster(*entity));
-  }
+  virtual void Initialize(NodeArguments* args) { BindEntity(args); }
 
   virtual void Execute(NodeArguments* args) {
-    Initialize(args);
+    BindEntity(args);
     if (args->IsListenerDirty(kListenerOnCollision)) {
       args->SetOutput(kOutputCollision);
     }
   }
 
  private:
+  // Only look up the entity's broadcaster when the entity has changed.
+  void BindEntity(NodeArguments* args) {
+    args->BindBroadcasterToInput(
+        kListenerOnCollision, kInputEntity, [this, args]() {
+          auto entity = args->GetInput<EntityRef>(kInputEntity);
+          return graph_component_->GetCreateBroadcaster(*entity);
+        });
+  }
+
   GraphComponent* graph_component_;
 };
 
@@ -97,6 +103,7 @@ class CollisionDataNode : public BaseNode {
     node_sig->AddOutput<EntityRef>(kOutputEntityB, "Entity B");
     node_sig->AddOutput<mathfu::vec3>(kOutputPositionB, "Position B");
     node_sig->AddOutput<std::string>(kOutputTagB, "Tag B");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Initialize(NodeArguments* args) {
@@ -127,6 +134,7 @@ class VelocityNode : public BaseNode {
     node_sig->AddInput<void>(kInputTrigger, "Trigger");
     node_sig->AddInput<EntityRef>(kInputEntity, "Entity");
     node_sig->AddOutput<mathfu::vec3>(kOutputVelocity, "Velocity");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
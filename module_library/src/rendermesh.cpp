@@ -16,6 +16,7 @@
 
 #include "breadboard/base_node.h"
 #include "breadboard/module_registry.h"
+#include "module_library/component_commands.h"
 
 using breadboard::BaseNode;
 using breadboard::ModuleRegistry;
@@ -33,19 +34,25 @@ namespace module_library {
 class SetVisibleNode : public BaseNode {
  public:
   enum { kInputEntity, kInputVisible };
-  SetVisibleNode(RenderMeshComponent* render_mesh_component)
-      : render_mesh_component_(render_mesh_component) {}
+  SetVisibleNode(RenderMeshComponent* render_mesh_component,
+                 ComponentCommandBuffer* commands)
+      : render_mesh_component_(render_mesh_component), commands_(commands) {}
 
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<EntityRef>(kInputEntity, "Entity");
     node_sig->AddInput<bool>(kInputVisible, "Visible");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Initialize(NodeArguments* args) {
     auto entity = args->GetInput<EntityRef>(kInputEntity);
     if (entity->IsValid()) {
-      render_mesh_component_->SetVisibilityRecursively(
-          *entity, *args->GetInput<bool>(kInputVisible));
+      bool visible = *args->GetInput<bool>(kInputVisible);
+      if (commands_) {
+        commands_->SetVisible(*entity, visible);
+      } else {
+        render_mesh_component_->SetVisibilityRecursively(*entity, visible);
+      }
     }
   }
 
@@ -53,28 +60,50 @@ class SetVisibleNode : public BaseNode {
 
  private:
   RenderMeshComponent* render_mesh_component_;
+  ComponentCommandBuffer* commands_;
+};
+
+// A SetVisibleNode that records into a ComponentCommandBuffer, and so can run
+// on any thread.
+class DeferredSetVisibleNode : public SetVisibleNode {
+ public:
+  DeferredSetVisibleNode(RenderMeshComponent* render_mesh_component,
+                         ComponentCommandBuffer* commands)
+      : SetVisibleNode(render_mesh_component, commands) {}
+
+  static void OnRegister(NodeSignature* node_sig) {
+    SetVisibleNode::OnRegister(node_sig);
+    node_sig->set_thread_safe(true);
+  }
 };
 
 // Sets the tint color of RenderMesh.
 class SetTintNode : public BaseNode {
  public:
   enum { kInputTrigger, kInputEntity, kInputTint };
-  SetTintNode(RenderMeshComponent* render_mesh_component)
-      : render_mesh_component_(render_mesh_component) {}
+  SetTintNode(RenderMeshComponent* render_mesh_component,
+              ComponentCommandBuffer* commands)
+      : render_mesh_component_(render_mesh_component), commands_(commands) {}
 
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<void>(kInputTrigger, "Trigger");
     node_sig->AddInput<EntityRef>(kInputEntity, "Entity");
     node_sig->AddInput<mathfu::vec4>(kInputTint, "Tint");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Initialize(NodeArguments* args) {
     if (args->IsInputDirty(kInputTrigger)) {
       auto entity = args->GetInput<EntityRef>(kInputEntity);
       if (entity->IsValid()) {
-        RenderMeshData* render_mesh_data =
-            render_mesh_component_->GetComponentData(*entity);
-        render_mesh_data->tint = *args->GetInput<mathfu::vec4>(kInputTint);
+        auto tint = args->GetInput<mathfu::vec4>(kInputTint);
+        if (commands_) {
+          commands_->SetTint(*entity, *tint);
+        } else {
+          RenderMeshData* render_mesh_data =
+              render_mesh_component_->GetComponentData(*entity);
+          render_mesh_data->tint = *tint;
+        }
       }
     }
   }
@@ -83,19 +112,47 @@ class SetTintNode : public BaseNode {
 
  private:
   RenderMeshComponent* render_mesh_component_;
+  ComponentCommandBuffer* commands_;
+};
+
+// A SetTintNode that records into a ComponentCommandBuffer, and so can run on
+// any thread.
+class DeferredSetTintNode : public SetTintNode {
+ public:
+  DeferredSetTintNode(RenderMeshComponent* render_mesh_component,
+                      ComponentCommandBuffer* commands)
+      : SetTintNode(render_mesh_component, commands) {}
+
+  static void OnRegister(NodeSignature* node_sig) {
+    SetTintNode::OnRegister(node_sig);
+    node_sig->set_thread_safe(true);
+  }
 };
 
 void InitializeRenderMeshModule(ModuleRegistry* module_registry,
-                                RenderMeshComponent* render_mesh_component) {
-  auto set_visible_ctor = [render_mesh_component]() {
-    return new SetVisibleNode(render_mesh_component);
-  };
-  auto set_tint_ctor = [render_mesh_component]() {
-    return new SetTintNode(render_mesh_component);
-  };
+                                RenderMeshComponent* render_mesh_component,
+                                ComponentCommandBuffer* commands) {
   Module* module = module_registry->RegisterModule("rendermesh");
-  module->RegisterNode<SetVisibleNode>("set_visible", set_visible_ctor);
-  module->RegisterNode<SetTintNode>("set_tint", set_tint_ctor);
+  if (commands) {
+    auto set_visible_ctor = [render_mesh_component, commands]() {
+      return new DeferredSetVisibleNode(render_mesh_component, commands);
+    };
+    auto set_tint_ctor = [render_mesh_component, commands]() {
+      return new DeferredSetTintNode(render_mesh_component, commands);
+    };
+    module->RegisterNode<DeferredSetVisibleNode>("set_visible",
+                                                 set_visible_ctor);
+    module->RegisterNode<DeferredSetTintNode>("set_tint", set_tint_ctor);
+  } else {
+    auto set_visible_ctor = [render_mesh_component]() {
+      return new SetVisibleNode(render_mesh_component, nullptr);
+    };
+    auto set_tint_ctor = [render_mesh_component]() {
+      return new SetTintNode(render_mesh_component, nullptr);
+    };
+    module->RegisterNode<SetVisibleNode>("set_visible", set_visible_ctor);
+    module->RegisterNode<SetTintNode>("set_tint", set_tint_ctor);
+  }
 }
 
 }  // namespace module_library
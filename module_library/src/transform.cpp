@@ -15,18 +15,24 @@
 #include "module_library/transform.h"
 
 #include <string>
+#include <vector>
 
 #include "breadboard/base_node.h"
 #include "breadboard/module_registry.h"
+#include "breadboard/modules/loop.h"
 #include "corgi/entity_manager.h"
 #include "corgi_component_library/transform.h"
 #include "mathfu/glsl_mappings.h"
+#include "module_library/component_commands.h"
 
+using breadboard::ArrayRef;
 using breadboard::BaseNode;
+using breadboard::GraphFactory;
 using breadboard::ModuleRegistry;
 using breadboard::Module;
 using breadboard::NodeArguments;
 using breadboard::NodeSignature;
+using breadboard::TypeRegistry;
 using corgi::component_library::TransformComponent;
 using corgi::component_library::TransformData;
 using corgi::EntityRef;
@@ -48,6 +54,7 @@ class ChildNode : public BaseNode {
     node_sig->AddInput<EntityRef>(kInputParent, "Parent");
     node_sig->AddInput<int>(kInputChildIndex, "Child Index");
     node_sig->AddOutput<EntityRef>(kOutputChild, "Child");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Initialize(NodeArguments* args) {
@@ -76,6 +83,59 @@ class ChildNode : public BaseNode {
   TransformComponent* transform_component_;
 };
 
+// Returns all of the children of the given entity, in order.
+class ChildrenNode : public BaseNode {
+ public:
+  enum { kInputParent };
+  enum { kOutputChildren };
+
+  // Holds the children that the output refers to.
+  struct ChildrenState {
+    ChildrenState() {}
+
+    std::vector<EntityRef> children;
+
+   private:
+    // Disallow copying, since the output of a copy would refer to the children
+    // of the original.
+    ChildrenState(const ChildrenState&);
+    ChildrenState& operator=(const ChildrenState&);
+  };
+
+  ChildrenNode(TransformComponent* transform_component)
+      : transform_component_(transform_component) {}
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<EntityRef>(kInputParent, "Parent");
+    node_sig->AddOutput<ArrayRef<const EntityRef>>(kOutputChildren,
+                                                    "Children");
+    node_sig->SetState<ChildrenState>();
+    node_sig->set_thread_safe(false);
+  }
+
+  virtual void Initialize(NodeArguments* args) {
+    ChildrenState* state = args->GetState<ChildrenState>();
+    state->children.clear();
+    auto entity = args->GetInput<EntityRef>(kInputParent);
+    if (entity->IsValid()) {
+      TransformData* transform_data =
+          transform_component_->GetComponentData(*entity);
+      for (auto iter = transform_data->children.begin();
+           iter != transform_data->children.end(); ++iter) {
+        state->children.push_back(iter->owner);
+      }
+    }
+    args->SetOutput(kOutputChildren,
+                    ArrayRef<const EntityRef>(state->children.data(),
+                                              state->children.size()));
+  }
+
+  virtual void Execute(NodeArguments* args) { Initialize(args); }
+
+ private:
+  TransformComponent* transform_component_;
+};
+
 // Returns the position of the entity in world space.
 class WorldPositionNode : public BaseNode {
  public:
@@ -88,6 +148,7 @@ class WorldPositionNode : public BaseNode {
     node_sig->AddInput<void>(kInputTrigger, "Trigger");
     node_sig->AddInput<EntityRef>(kInputEntity, "Entity");
     node_sig->AddOutput<vec3>(kOutputPosition, "Position");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Initialize(NodeArguments* args) {
@@ -107,20 +168,27 @@ class WorldPositionNode : public BaseNode {
 class SetScaleNode : public BaseNode {
  public:
   enum { kInputEntity, kInputScale };
-  SetScaleNode(TransformComponent* transform_component)
-      : transform_component_(transform_component) {}
+  SetScaleNode(TransformComponent* transform_component,
+               ComponentCommandBuffer* commands)
+      : transform_component_(transform_component), commands_(commands) {}
 
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<EntityRef>(kInputEntity, "Entity");
     node_sig->AddInput<vec3>(kInputScale, "Scale");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Initialize(NodeArguments* args) {
     auto entity = args->GetInput<EntityRef>(kInputEntity);
     if (entity->IsValid()) {
-      TransformData* transform_data =
-          transform_component_->GetComponentData(*entity);
-      transform_data->scale = *args->GetInput<vec3>(kInputScale);
+      auto scale = args->GetInput<vec3>(kInputScale);
+      if (commands_) {
+        commands_->SetScale(*entity, *scale);
+      } else {
+        TransformData* transform_data =
+            transform_component_->GetComponentData(*entity);
+        transform_data->scale = *scale;
+      }
     }
   }
 
@@ -128,24 +196,57 @@ class SetScaleNode : public BaseNode {
 
  private:
   TransformComponent* transform_component_;
+  ComponentCommandBuffer* commands_;
+};
+
+// A SetScaleNode that records into a ComponentCommandBuffer, and so can run on
+// any thread.
+class DeferredSetScaleNode : public SetScaleNode {
+ public:
+  DeferredSetScaleNode(TransformComponent* transform_component,
+                       ComponentCommandBuffer* commands)
+      : SetScaleNode(transform_component, commands) {}
+
+  static void OnRegister(NodeSignature* node_sig) {
+    SetScaleNode::OnRegister(node_sig);
+    node_sig->set_thread_safe(true);
+  }
 };
 
 void InitializeTransformModule(ModuleRegistry* module_registry,
-                               TransformComponent* transform_component) {
+                               TransformComponent* transform_component,
+                               GraphFactory* graph_factory,
+                               ComponentCommandBuffer* commands) {
   auto world_position_ctor = [transform_component]() {
     return new WorldPositionNode(transform_component);
   };
-  auto set_scale_ctor = [transform_component]() {
-    return new SetScaleNode(transform_component);
+  auto set_scale_ctor = [transform_component, commands]() {
+    return new SetScaleNode(transform_component, commands);
+  };
+  auto deferred_set_scale_ctor = [transform_component, commands]() {
+    return new DeferredSetScaleNode(transform_component, commands);
   };
   auto child_ctor = [transform_component]() {
     return new ChildNode(transform_component);
   };
+  auto children_ctor = [transform_component]() {
+    return new ChildrenNode(transform_component);
+  };
+  TypeRegistry<ArrayRef<const EntityRef>>::RegisterType("EntityList");
   Module* module = module_registry->RegisterModule("transform");
   module->RegisterNode<ChildNode>("child", child_ctor);
+  module->RegisterNode<ChildrenNode>("children", children_ctor);
   module->RegisterNode<WorldPositionNode>("world_position",
                                           world_position_ctor);
-  module->RegisterNode<SetScaleNode>("set_scale", set_scale_ctor);
+  if (commands) {
+    module->RegisterNode<DeferredSetScaleNode>("set_scale",
+                                               deferred_set_scale_ctor);
+  } else {
+    module->RegisterNode<SetScaleNode>("set_scale", set_scale_ctor);
+  }
+  if (graph_factory) {
+    RegisterLoopNodes<EntityRef>(module, graph_factory, "entity");
+  }
 }
 
 }  // namespace module_library
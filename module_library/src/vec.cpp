@@ -14,6 +14,10 @@
 
 #include "module_library/vec.h"
 
+#include <cmath>
+#include <cstring>
+#include <string>
+
 #include "breadboard/base_node.h"
 #include "breadboard/module_registry.h"
 #include "mathfu/glsl_mappings.h"
@@ -22,6 +26,7 @@ using breadboard::BaseNode;
 using breadboard::Module;
 using breadboard::ModuleRegistry;
 using breadboard::NodeArguments;
+using breadboard::NodeBatchArguments;
 using breadboard::NodeSignature;
 using breadboard::TypeRegistry;
 using mathfu::vec3;
@@ -30,6 +35,114 @@ using mathfu::vec4;
 namespace breadboard {
 namespace module_library {
 
+// The number of elements in each vector type.
+template <typename T>
+struct VectorSize;
+
+template <>
+struct VectorSize<vec3> {
+  enum { kValue = 3 };
+};
+
+template <>
+struct VectorSize<vec4> {
+  enum { kValue = 4 };
+};
+
+// A batch of vectors stored as a structure of arrays: one column per element,
+// each holding that element of the vector on every instance in the batch.
+// Laid out this way, operations on whole vectors become a few simple loops
+// over contiguous floats, which the compiler can vectorize across instances.
+template <typename T>
+struct VectorLanes {
+  const float* elements[VectorSize<T>::kValue];
+};
+
+// Gather a vector input from every instance in the batch into lanes.
+template <typename T>
+static VectorLanes<T> GatherLanes(NodeBatchArguments* args, size_t input) {
+  const T* const* vectors = args->GatherInputPointers<T>(input);
+  const size_t size = args->size();
+  VectorLanes<T> lanes;
+  for (int j = 0; j < VectorSize<T>::kValue; ++j) {
+    float* column = args->AllocateColumn<float>();
+    for (size_t i = 0; i < size; ++i) {
+      column[i] = (*vectors[i])[j];
+    }
+    lanes.elements[j] = column;
+  }
+  return lanes;
+}
+
+// Set a vector output on every instance in the batch from lanes.
+template <typename T>
+static void ScatterLanes(NodeBatchArguments* args, size_t output,
+                         const VectorLanes<T>& lanes) {
+  T* const* vectors = args->GetMutableOutputPointers<T>(output);
+  if (!vectors) {
+    return;
+  }
+  const size_t size = args->size();
+  for (size_t i = 0; i < size; ++i) {
+    T& vector = *vectors[i];
+    for (int j = 0; j < VectorSize<T>::kValue; ++j) {
+      vector[j] = lanes.elements[j][i];
+    }
+  }
+}
+
+// Apply `op` to each element of `a` and the matching element of `b`.
+template <typename T, typename Op>
+static VectorLanes<T> ElementwiseLanes(NodeBatchArguments* args,
+                                       const VectorLanes<T>& a,
+                                       const VectorLanes<T>& b, Op op) {
+  const size_t size = args->size();
+  VectorLanes<T> result;
+  for (int j = 0; j < VectorSize<T>::kValue; ++j) {
+    float* column = args->AllocateColumn<float>();
+    for (size_t i = 0; i < size; ++i) {
+      column[i] = op(a.elements[j][i], b.elements[j][i]);
+    }
+    result.elements[j] = column;
+  }
+  return result;
+}
+
+// Apply `op` to each element of `a` and that instance's scalar.
+template <typename T, typename Op>
+static VectorLanes<T> ScalarLanes(NodeBatchArguments* args,
+                                  const VectorLanes<T>& a,
+                                  const float* scalars, Op op) {
+  const size_t size = args->size();
+  VectorLanes<T> result;
+  for (int j = 0; j < VectorSize<T>::kValue; ++j) {
+    float* column = args->AllocateColumn<float>();
+    for (size_t i = 0; i < size; ++i) {
+      column[i] = op(a.elements[j][i], scalars[i]);
+    }
+    result.elements[j] = column;
+  }
+  return result;
+}
+
+// Compute the dot product of each pair of vectors.
+template <typename T>
+static float* DotProductLanes(NodeBatchArguments* args,
+                              const VectorLanes<T>& a,
+                              const VectorLanes<T>& b) {
+  const size_t size = args->size();
+  float* result = args->AllocateColumn<float>();
+  for (size_t i = 0; i < size; ++i) {
+    result[i] = 0.0f;
+  }
+  for (int j = 0; j < VectorSize<T>::kValue; ++j) {
+    for (size_t i = 0; i < size; ++i) {
+      result[i] += a.elements[j][i] * b.elements[j][i];
+    }
+  }
+  return result;
+}
+
 // Creates a vector from 3 floats.
 class Vec3Node : public BaseNode {
  public:
@@ -41,6 +154,7 @@ class Vec3Node : public BaseNode {
     node_sig->AddInput<float>(kInputY, "Y");
     node_sig->AddInput<float>(kInputZ, "Z");
     node_sig->AddOutput<vec3>(kOutputVec, "Vector");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -49,6 +163,15 @@ class Vec3Node : public BaseNode {
     auto z = args->GetInput<float>(kInputZ);
     args->SetOutput(kOutputVec, vec3(*x, *y, *z));
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    VectorLanes<vec3> lanes;
+    lanes.elements[0] = args->GatherInput<float>(kInputX);
+    lanes.elements[1] = args->GatherInput<float>(kInputY);
+    lanes.elements[2] = args->GatherInput<float>(kInputZ);
+    ScatterLanes(args, kOutputVec, lanes);
+    return true;
+  }
 };
 
 // Returns the individual elements of the given vector.
@@ -62,6 +185,7 @@ class ElementsVec3Node : public BaseNode {
     node_sig->AddOutput<float>(kOutputX, "X");
     node_sig->AddOutput<float>(kOutputY, "Y");
     node_sig->AddOutput<float>(kOutputZ, "Z");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -70,6 +194,14 @@ class ElementsVec3Node : public BaseNode {
     args->SetOutput(kOutputY, vec->y);
     args->SetOutput(kOutputZ, vec->z);
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    VectorLanes<vec3> lanes = GatherLanes<vec3>(args, kInputVector);
+    args->ScatterOutput(kOutputX, lanes.elements[0]);
+    args->ScatterOutput(kOutputY, lanes.elements[1]);
+    args->ScatterOutput(kOutputZ, lanes.elements[2]);
+    return true;
+  }
 };
 
 // Creates a vector from 4 floats.
@@ -84,6 +216,7 @@ class Vec4Node : public BaseNode {
     node_sig->AddInput<float>(kInputZ, "Z");
     node_sig->AddInput<float>(kInputW, "W");
     node_sig->AddOutput<vec3>(kOutputVec, "Vector");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -107,6 +240,7 @@ class ElementsVec4Node : public BaseNode {
     node_sig->AddOutput<float>(kOutputY, "Y");
     node_sig->AddOutput<float>(kOutputZ, "Z");
     node_sig->AddOutput<float>(kOutputW, "W");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -116,6 +250,15 @@ class ElementsVec4Node : public BaseNode {
     args->SetOutput(kOutputZ, vec->z);
     args->SetOutput(kOutputW, vec->w);
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    VectorLanes<vec4> lanes = GatherLanes<vec4>(args, kInputVector);
+    args->ScatterOutput(kOutputX, lanes.elements[0]);
+    args->ScatterOutput(kOutputY, lanes.elements[1]);
+    args->ScatterOutput(kOutputZ, lanes.elements[2]);
+    args->ScatterOutput(kOutputW, lanes.elements[3]);
+    return true;
+  }
 };
 
 // Adds the two given vectors.
@@ -129,6 +272,7 @@ class AddNode : public BaseNode {
     node_sig->AddInput<T>(kInputA, "A");
     node_sig->AddInput<T>(kInputB, "B");
     node_sig->AddOutput<T>(kOutputSum, "Sum");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -136,6 +280,15 @@ class AddNode : public BaseNode {
     auto vec_b = args->GetInput<T>(kInputB);
     args->SetOutput(kOutputSum, *vec_a + *vec_b);
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    VectorLanes<T> a = GatherLanes<T>(args, kInputA);
+    VectorLanes<T> b = GatherLanes<T>(args, kInputB);
+    ScatterLanes(args, kOutputSum,
+                 ElementwiseLanes(args, a, b,
+                                  [](float x, float y) { return x + y; }));
+    return true;
+  }
 };
 
 // Subtracts the two given vectors.
@@ -149,6 +302,7 @@ class SubtractNode : public BaseNode {
     node_sig->AddInput<T>(kInputA, "A");
     node_sig->AddInput<T>(kInputB, "B");
     node_sig->AddOutput<T>(kOutputDifference, "Difference");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -156,6 +310,15 @@ class SubtractNode : public BaseNode {
     auto vec_b = args->GetInput<T>(kInputB);
     args->SetOutput(kOutputDifference, *vec_a - *vec_b);
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    VectorLanes<T> a = GatherLanes<T>(args, kInputA);
+    VectorLanes<T> b = GatherLanes<T>(args, kInputB);
+    ScatterLanes(args, kOutputDifference,
+                 ElementwiseLanes(args, a, b,
+                                  [](float x, float y) { return x - y; }));
+    return true;
+  }
 };
 
 template <typename T>
@@ -168,6 +331,7 @@ class ScalarMultiplyNode : public BaseNode {
     node_sig->AddInput<T>(kInputVector, "Vector");
     node_sig->AddInput<float>(kInputScalar, "Scalar");
     node_sig->AddOutput<T>(kOutputProduct, "Product");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -175,6 +339,15 @@ class ScalarMultiplyNode : public BaseNode {
     auto scalar = args->GetInput<float>(kInputScalar);
     args->SetOutput(kOutputProduct, *vec * *scalar);
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    VectorLanes<T> vec = GatherLanes<T>(args, kInputVector);
+    const float* scalar = args->GatherInput<float>(kInputScalar);
+    ScatterLanes(args, kOutputProduct,
+                 ScalarLanes(args, vec, scalar,
+                             [](float x, float s) { return x * s; }));
+    return true;
+  }
 };
 
 template <typename T>
@@ -187,6 +360,7 @@ class ScalarDivideNode : public BaseNode {
     node_sig->AddInput<T>(kInputVector, "Vector");
     node_sig->AddInput<float>(kInputScalar, "Scalar");
     node_sig->AddOutput<T>(kOutputQuotient, "Quotient");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -194,6 +368,15 @@ class ScalarDivideNode : public BaseNode {
     auto scalar = args->GetInput<float>(kInputScalar);
     args->SetOutput(kOutputQuotient, *vec / *scalar);
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    VectorLanes<T> vec = GatherLanes<T>(args, kInputVector);
+    const float* scalar = args->GatherInput<float>(kInputScalar);
+    ScatterLanes(args, kOutputQuotient,
+                 ScalarLanes(args, vec, scalar,
+                             [](float x, float s) { return x / s; }));
+    return true;
+  }
 };
 
 template <typename T>
@@ -206,6 +389,7 @@ class CrossProductNode : public BaseNode {
     node_sig->AddInput<T>(kInputA, "A");
     node_sig->AddInput<T>(kInputB, "B");
     node_sig->AddOutput<T>(kOutputCrossProduct, "Cross Product");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -213,6 +397,29 @@ class CrossProductNode : public BaseNode {
     auto vec_b = args->GetInput<T>(kInputB);
     args->SetOutput(kOutputCrossProduct, T::CrossProduct(*vec_a, *vec_b));
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    VectorLanes<T> a = GatherLanes<T>(args, kInputA);
+    VectorLanes<T> b = GatherLanes<T>(args, kInputB);
+    const size_t size = args->size();
+    float* x = args->AllocateColumn<float>();
+    float* y = args->AllocateColumn<float>();
+    float* z = args->AllocateColumn<float>();
+    for (size_t i = 0; i < size; ++i) {
+      x[i] = a.elements[1][i] * b.elements[2][i] -
+             a.elements[2][i] * b.elements[1][i];
+      y[i] = a.elements[2][i] * b.elements[0][i] -
+             a.elements[0][i] * b.elements[2][i];
+      z[i] = a.elements[0][i] * b.elements[1][i] -
+             a.elements[1][i] * b.elements[0][i];
+    }
+    VectorLanes<T> result;
+    result.elements[0] = x;
+    result.elements[1] = y;
+    result.elements[2] = z;
+    ScatterLanes(args, kOutputCrossProduct, result);
+    return true;
+  }
 };
 
 template <typename T>
@@ -225,6 +432,7 @@ class DotProductNode : public BaseNode {
     node_sig->AddInput<T>(kInputA, "A");
     node_sig->AddInput<T>(kInputB, "B");
     node_sig->AddOutput<float>(kOutputDotProduct, "Dot Product");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -232,6 +440,13 @@ class DotProductNode : public BaseNode {
     auto vec_b = args->GetInput<T>(kInputB);
     args->SetOutput(kOutputDotProduct, vec3::DotProduct(*vec_a, *vec_b));
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    VectorLanes<T> a = GatherLanes<T>(args, kInputA);
+    VectorLanes<T> b = GatherLanes<T>(args, kInputB);
+    args->ScatterOutput(kOutputDotProduct, DotProductLanes(args, a, b));
+    return true;
+  }
 };
 
 template <typename T>
@@ -243,12 +458,24 @@ class LengthNode : public BaseNode {
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<T>(kInputVector, "Vector");
     node_sig->AddOutput<float>(kOutputLength, "Length");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
     auto vec = args->GetInput<T>(kInputVector);
     args->SetOutput(kOutputLength, vec->Length());
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    VectorLanes<T> vec = GatherLanes<T>(args, kInputVector);
+    float* length = DotProductLanes(args, vec, vec);
+    const size_t size = args->size();
+    for (size_t i = 0; i < size; ++i) {
+      length[i] = std::sqrt(length[i]);
+    }
+    args->ScatterOutput(kOutputLength, length);
+    return true;
+  }
 };
 
 template <typename T>
@@ -265,15 +492,41 @@ Module* InitializeVecModuleType(ModuleRegistry* module_registry,
   return module;
 }
 
+// Vectors may be padded out for SIMD, so only their elements are written.
+template <typename T>
+static void SerializeVector(const uint8_t* ptr, std::string* output) {
+  const T& vector = *reinterpret_cast<const T*>(ptr);
+  for (int i = 0; i < VectorSize<T>::kValue; ++i) {
+    float element = vector[i];
+    output->append(reinterpret_cast<const char*>(&element), sizeof(element));
+  }
+}
+
+template <typename T>
+static bool DeserializeVector(const uint8_t* data, size_t size, uint8_t* ptr) {
+  if (size != VectorSize<T>::kValue * sizeof(float)) {
+    return false;
+  }
+  T& vector = *reinterpret_cast<T*>(ptr);
+  for (int i = 0; i < VectorSize<T>::kValue; ++i) {
+    memcpy(&vector[i], data + i * sizeof(float), sizeof(float));
+  }
+  return true;
+}
+
 void InitializeVecModule(ModuleRegistry* module_registry) {
   // Initialize vec3 module
   TypeRegistry<vec3>::RegisterType("Vec3");
+  TypeRegistry<vec3>::RegisterSerializationFuncs(SerializeVector<vec3>,
+                                                 DeserializeVector<vec3>);
   Module* module = InitializeVecModuleType<vec3>(module_registry, "vec3");
   module->RegisterNode<Vec3Node>("vec3");
   module->RegisterNode<ElementsVec3Node>("elements");
 
   // Initialize vec4 module
   TypeRegistry<vec4>::RegisterType("Vec4");
+  TypeRegistry<vec4>::RegisterSerializationFuncs(SerializeVector<vec4>,
+                                                 DeserializeVector<vec4>);
   module = InitializeVecModuleType<vec3>(module_registry, "vec4");
   module->RegisterNode<Vec4Node>("vec4");
   module->RegisterNode<ElementsVec4Node>("elements");
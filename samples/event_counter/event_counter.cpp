@@ -70,25 +70,30 @@ class CaptureEvent : public BaseNode {
 //    One integer input, one std::string output
 //    Accept input and add it into internal counter,
 //    pass counter value to output as std::string
+//    The counter is kept in per-GraphState node state, so that every
+//    GraphState created from the same graph counts separately.
 class CountEvent : public BaseNode {
  public:
-  CountEvent() : count_(0) {}
+  struct State {
+    State() : count(0) {}
+    int count;
+  };
+
   virtual ~CountEvent() {}
 
   static void OnRegister(NodeSignature *node_sig) {
     node_sig->AddInput<int>();
     node_sig->AddOutput<std::string>();
+    node_sig->SetState<State>();
   }
 
   virtual void Execute(NodeArguments *args) {
-    count_ += *args->GetInput<int>(0);
+    State *state = args->GetState<State>();
+    state->count += *args->GetInput<int>(0);
     std::stringstream ss;
-    ss << count_;
+    ss << state->count;
     args->SetOutput(0, ss.str());
   }
-
- private:
-  int count_;
 };
 
 // PrintEvent Node:
@@ -188,9 +193,11 @@ extern "C" int main(int /*argc*/, char **argv) {
     breadboard::NodeEventListener listener(&graph_state, sample::kCounterEvent);
     broadcaster.RegisterListener(&listener);
 
+    breadboard::EventIndex event_index =
+        breadboard::GetEventIndex(sample::kCounterEvent);
     int loop = 0;
     while (loop++ < 500) {
-      broadcaster.BroadcastEvent(sample::kCounterEvent);
+      broadcaster.BroadcastEventIndex(event_index);
     }
   }
 
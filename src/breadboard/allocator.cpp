@@ -0,0 +1,147 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/allocator.h"
+
+#include <cassert>
+#include <new>
+
+#include "breadboard/log.h"
+
+namespace breadboard {
+
+static uintptr_t AlignAddress(uintptr_t address, size_t alignment) {
+  return (address + alignment - 1) & ~(alignment - 1);
+}
+
+void* HeapAllocator::Allocate(size_t size, size_t alignment) {
+  assert(size > 0 && alignment > 0 && (alignment & (alignment - 1)) == 0);
+  // Over-allocate so that the block can be aligned, with room in front of it
+  // to remember where the allocation starts.
+  uint8_t* allocation = static_cast<uint8_t*>(
+      ::operator new(size + alignment - 1 + sizeof(void*), std::nothrow));
+  if (!allocation) {
+    return nullptr;
+  }
+  uintptr_t address = reinterpret_cast<uintptr_t>(allocation + sizeof(void*));
+  uint8_t* block = reinterpret_cast<uint8_t*>(AlignAddress(address, alignment));
+  reinterpret_cast<void**>(block)[-1] = allocation;
+  bytes_allocated_ += size;
+  return block;
+}
+
+void HeapAllocator::Free(void* ptr, size_t size) {
+  assert(ptr);
+  bytes_allocated_ -= size;
+  ::operator delete(static_cast<void**>(ptr)[-1]);
+}
+
+HeapAllocator* DefaultAllocator() {
+  static HeapAllocator* allocator = new HeapAllocator();
+  return allocator;
+}
+
+ArenaAllocator::ArenaAllocator(size_t block_size, size_t budget,
+                               Allocator* parent)
+    : block_size_(block_size),
+      budget_(budget),
+      parent_(parent),
+      mutex_(),
+      blocks_(),
+      next_(nullptr),
+      end_(nullptr),
+      bytes_reserved_(0),
+      bytes_used_(0),
+      allocation_count_(0) {}
+
+ArenaAllocator::~ArenaAllocator() { Reset(); }
+
+bool ArenaAllocator::AddBlock(size_t size) {
+  if (budget_ && bytes_reserved_ + size > budget_) {
+    return false;
+  }
+  Block block;
+  block.data = static_cast<uint8_t*>(parent_->Allocate(size, sizeof(void*)));
+  if (!block.data) {
+    return false;
+  }
+  block.size = size;
+  blocks_.push_back(block);
+  bytes_reserved_ += size;
+  return true;
+}
+
+void* ArenaAllocator::Allocate(size_t size, size_t alignment) {
+  assert(size > 0 && alignment > 0 && (alignment & (alignment - 1)) == 0);
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Allocations that would not leave room in a block for anything else get a
+  // block of their own, so that the current block can still be used.
+  size_t padded_size = size + alignment - 1;
+  if (padded_size > block_size_ / 2) {
+    if (!AddBlock(padded_size)) {
+      CallLogFunc(
+          "Could not allocate %d bytes: The arena is over its budget of %d "
+          "bytes.",
+          static_cast<int>(size), static_cast<int>(budget_));
+      return nullptr;
+    }
+    ++allocation_count_;
+    bytes_used_ += padded_size;
+    uintptr_t address = reinterpret_cast<uintptr_t>(blocks_.back().data);
+    return reinterpret_cast<void*>(AlignAddress(address, alignment));
+  }
+  uintptr_t address =
+      AlignAddress(reinterpret_cast<uintptr_t>(next_), alignment);
+  if (!next_ || address + size > reinterpret_cast<uintptr_t>(end_)) {
+    if (!AddBlock(block_size_)) {
+      CallLogFunc(
+          "Could not allocate %d bytes: The arena is over its budget of %d "
+          "bytes.",
+          static_cast<int>(size), static_cast<int>(budget_));
+      return nullptr;
+    }
+    next_ = blocks_.back().data;
+    end_ = next_ + block_size_;
+    address = AlignAddress(reinterpret_cast<uintptr_t>(next_), alignment);
+  }
+  uint8_t* block = reinterpret_cast<uint8_t*>(address);
+  bytes_used_ += (block + size) - next_;
+  next_ = block + size;
+  ++allocation_count_;
+  return block;
+}
+
+void ArenaAllocator::Free(void* ptr, size_t size) {
+  assert(ptr);
+  (void)ptr;
+  (void)size;
+  std::lock_guard<std::mutex> lock(mutex_);
+  assert(allocation_count_ > 0);
+  --allocation_count_;
+}
+
+void ArenaAllocator::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  assert(allocation_count_ == 0);
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    parent_->Free(blocks_[i].data, blocks_[i].size);
+  }
+  blocks_.clear();
+  next_ = nullptr;
+  end_ = nullptr;
+  bytes_reserved_ = 0;
+  bytes_used_ = 0;
+}
+
+}  // namespace breadboard
@@ -0,0 +1,297 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/async_log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace breadboard {
+
+namespace {
+
+// How often the background thread wakes up to look for new messages when
+// nobody asks it to flush.
+const std::chrono::milliseconds kDrainInterval(10);
+
+// The number of call sites that can be rate limited.
+const size_t kCallSiteCount = 256;
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+// LogFunc takes a va_list, so messages the background thread produces itself
+// need to be passed through a variadic function first.
+void CallSink(LogFunc sink, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  sink(format, args);
+  va_end(args);
+}
+
+}  // namespace
+
+AsyncLogBackend::AsyncLogBackend(LogFunc sink, size_t capacity,
+                                 uint32_t max_messages_per_window,
+                                 std::chrono::milliseconds rate_limit_window)
+    : sink_(sink),
+      max_messages_per_window_(max_messages_per_window),
+      rate_limit_window_(rate_limit_window.count()),
+      records_(RoundUpToPowerOfTwo(capacity < 2 ? 2 : capacity)),
+      mask_(records_.size() - 1),
+      enqueue_position_(0),
+      dequeue_position_(0),
+      call_sites_(kCallSiteCount),
+      dropped_count_(0),
+      dropped_count_total_(0),
+      suppressed_count_total_(0),
+      repeat_count_(0),
+      repeat_start_time_(0),
+      flush_position_(0),
+      drained_position_(0),
+      flush_requested_(false),
+      shutting_down_(false) {
+  for (size_t i = 0; i < records_.size(); ++i) {
+    records_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < call_sites_.size(); ++i) {
+    CallSite& site = call_sites_[i];
+    site.format.store(nullptr, std::memory_order_relaxed);
+    site.window_start.store(0, std::memory_order_relaxed);
+    site.count.store(0, std::memory_order_relaxed);
+    site.suppressed.store(0, std::memory_order_relaxed);
+  }
+  thread_ = std::thread(&AsyncLogBackend::DrainLoop, this);
+}
+
+AsyncLogBackend::~AsyncLogBackend() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+void AsyncLogBackend::Log(const char* format, va_list args) {
+  if (!AllowMessage(format, Now())) {
+    return;
+  }
+  char message[kMaxMessageLength];
+  vsnprintf(message, sizeof(message), format, args);
+  if (!Push(message)) {
+    dropped_count_.fetch_add(1, std::memory_order_relaxed);
+    dropped_count_total_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void AsyncLogBackend::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Every message logged before now has claimed a slot below this position.
+  // Popping up to it also waits for any of those slots that another thread
+  // is still writing, which a count of finished pushes would skip past.
+  size_t target = enqueue_position_.load(std::memory_order_acquire);
+  flush_position_ = std::max(flush_position_, target);
+  flush_requested_ = true;
+  wake_.notify_one();
+  drained_.wait(lock,
+                [this, target]() { return drained_position_ >= target; });
+}
+
+int64_t AsyncLogBackend::Now() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// A bounded multi-producer queue in the style of Dmitry Vyukov's: each slot's
+// sequence number equals the enqueue position that may claim it next, and
+// becomes that position plus one once the message is written.
+bool AsyncLogBackend::Push(const char* message) {
+  size_t position = enqueue_position_.load(std::memory_order_relaxed);
+  Record* record;
+  for (;;) {
+    record = &records_[position & mask_];
+    size_t sequence = record->sequence.load(std::memory_order_acquire);
+    intptr_t difference =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+    if (difference == 0) {
+      if (enqueue_position_.compare_exchange_weak(
+              position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // The consumer has not caught up to this slot yet; the buffer is full.
+      return false;
+    } else {
+      position = enqueue_position_.load(std::memory_order_relaxed);
+    }
+  }
+  strncpy(record->message, message, kMaxMessageLength - 1);
+  record->message[kMaxMessageLength - 1] = '\0';
+  record->sequence.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+bool AsyncLogBackend::Pop(std::string* message) {
+  Record* record = &records_[dequeue_position_ & mask_];
+  size_t sequence = record->sequence.load(std::memory_order_acquire);
+  if (sequence != dequeue_position_ + 1) {
+    return false;
+  }
+  message->assign(record->message);
+  record->sequence.store(dequeue_position_ + mask_ + 1,
+                         std::memory_order_release);
+  ++dequeue_position_;
+  return true;
+}
+
+AsyncLogBackend::CallSite* AsyncLogBackend::FindCallSite(const char* format) {
+  size_t start = (reinterpret_cast<uintptr_t>(format) >> 3) % kCallSiteCount;
+  for (size_t i = 0; i < kCallSiteCount; ++i) {
+    CallSite* site = &call_sites_[(start + i) % kCallSiteCount];
+    const char* existing = site->format.load(std::memory_order_acquire);
+    if (existing == format) {
+      return site;
+    }
+    if (existing == nullptr) {
+      if (site->format.compare_exchange_strong(existing, format,
+                                               std::memory_order_acq_rel)) {
+        return site;
+      }
+      // Another thread claimed this slot first, possibly for this same call
+      // site.
+      if (existing == format) {
+        return site;
+      }
+    }
+  }
+  return nullptr;
+}
+
+bool AsyncLogBackend::AllowMessage(const char* format, int64_t now) {
+  if (max_messages_per_window_ == 0) {
+    return true;
+  }
+  CallSite* site = FindCallSite(format);
+  if (!site) {
+    return true;
+  }
+  int64_t window_start = site->window_start.load(std::memory_order_relaxed);
+  if (now - window_start >= rate_limit_window_ &&
+      site->window_start.compare_exchange_strong(window_start, now,
+                                                 std::memory_order_relaxed)) {
+    site->count.store(0, std::memory_order_relaxed);
+  }
+  if (site->count.fetch_add(1, std::memory_order_relaxed) <
+      max_messages_per_window_) {
+    return true;
+  }
+  site->suppressed.fetch_add(1, std::memory_order_relaxed);
+  suppressed_count_total_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void AsyncLogBackend::DrainLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait_for(lock, kDrainInterval,
+                   [this]() { return flush_requested_ || shutting_down_; });
+    bool flush_seen = flush_requested_;
+    bool flushing = flush_seen || shutting_down_;
+    lock.unlock();
+
+    Drain();
+    int64_t now = Now();
+    ReportSuppressed(flushing ? INT64_MAX : now);
+    if (repeat_count_ &&
+        (flushing || now - repeat_start_time_ >= rate_limit_window_)) {
+      FlushRepeats();
+    }
+
+    lock.lock();
+    drained_position_ = dequeue_position_;
+    // Keep going without waiting while a slot Flush is waiting for is still
+    // being written.
+    if (flush_seen && drained_position_ >= flush_position_) {
+      flush_requested_ = false;
+    }
+    drained_.notify_all();
+    if (shutting_down_) {
+      return;
+    }
+  }
+}
+
+void AsyncLogBackend::Drain() {
+  std::string message;
+  while (Pop(&message)) {
+    Emit(message);
+  }
+  uint64_t dropped = dropped_count_.exchange(0, std::memory_order_relaxed);
+  if (dropped) {
+    FlushRepeats();
+    CallSink(sink_, "Log buffer full: dropped %llu messages.",
+             static_cast<unsigned long long>(dropped));
+  }
+}
+
+void AsyncLogBackend::Emit(const std::string& message) {
+  if (message == last_message_) {
+    // The summary is due a window after the first repeat, however many more
+    // keep arriving.
+    if (repeat_count_++ == 0) {
+      repeat_start_time_ = Now();
+    }
+    return;
+  }
+  FlushRepeats();
+  CallSink(sink_, "%s", message.c_str());
+  last_message_ = message;
+}
+
+void AsyncLogBackend::FlushRepeats() {
+  if (repeat_count_) {
+    CallSink(sink_, "Last message repeated %u more times.", repeat_count_);
+    repeat_count_ = 0;
+  }
+}
+
+void AsyncLogBackend::ReportSuppressed(int64_t now) {
+  for (size_t i = 0; i < call_sites_.size(); ++i) {
+    CallSite& site = call_sites_[i];
+    const char* format = site.format.load(std::memory_order_acquire);
+    if (!format) {
+      continue;
+    }
+    int64_t window_start = site.window_start.load(std::memory_order_relaxed);
+    if (now - window_start < rate_limit_window_ ||
+        site.suppressed.load(std::memory_order_relaxed) == 0) {
+      continue;
+    }
+    uint32_t suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+    if (suppressed) {
+      FlushRepeats();
+      CallSink(sink_, "Suppressed %u messages like \"%s\".", suppressed, format);
+    }
+  }
+}
+
+}  // namespace breadboard
@@ -0,0 +1,609 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/compiled_graph.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "breadboard/event.h"
+#include "breadboard/log.h"
+#include "breadboard/version.h"
+
+namespace breadboard {
+
+namespace {
+
+const char kMagic[4] = {'B', 'B', 'C', 'G'};
+
+// Written in the byte order of the machine that compiled the graph, so that
+// a graph compiled for a different byte order is rejected.
+const uint32_t kByteOrderMark = 0x01020304;
+
+// Appends values to the compiled graph.
+class Writer {
+ public:
+  explicit Writer(std::string* output) : output_(output) {}
+
+  template <typename T>
+  void Write(T value) {
+    static_assert(std::is_arithmetic<T>::value, "Only write plain numbers");
+    output_->append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void WriteString(const std::string& str) {
+    Write(static_cast<uint32_t>(str.size()));
+    output_->append(str);
+  }
+
+  void WriteType(const Type* type) {
+    WriteString(type ? type->name : "");
+    Write(static_cast<uint32_t>(type ? type->size : 0));
+    Write(static_cast<uint32_t>(type ? type->alignment : 0));
+  }
+
+  void WriteOffset(ptrdiff_t offset) { Write(static_cast<int64_t>(offset)); }
+
+ private:
+  std::string* output_;
+};
+
+// Reads values back out of a compiled graph. Once a read runs past the end of
+// the data every later read fails too, so callers only need to check ok() at
+// convenient points.
+class Reader {
+ public:
+  Reader(const uint8_t* data, size_t size)
+      : data_(data), end_(data + size), ok_(true) {}
+
+  bool ok() const { return ok_; }
+
+  template <typename T>
+  T Read() {
+    T value = T();
+    const uint8_t* bytes = ReadBytes(sizeof(value));
+    if (bytes) {
+      memcpy(&value, bytes, sizeof(value));
+    }
+    return value;
+  }
+
+  const uint8_t* ReadBytes(size_t size) {
+    if (!ok_ || static_cast<size_t>(end_ - data_) < size) {
+      ok_ = false;
+      return nullptr;
+    }
+    const uint8_t* bytes = data_;
+    data_ += size;
+    return bytes;
+  }
+
+  std::string ReadString() {
+    uint32_t size = Read<uint32_t>();
+    const uint8_t* bytes = ReadBytes(size);
+    return bytes ? std::string(reinterpret_cast<const char*>(bytes), size)
+                 : std::string();
+  }
+
+  // Returns true if the next type written matches the given type.
+  bool ReadType(const Type* type) {
+    std::string name = ReadString();
+    uint32_t size = Read<uint32_t>();
+    uint32_t alignment = Read<uint32_t>();
+    if (!type) {
+      return ok_ && name.empty();
+    }
+    return ok_ && name == type->name && size == type->size &&
+           alignment == type->alignment;
+  }
+
+  // Reads the number of items that follow, each of which takes up at least
+  // the given number of bytes. This fails if there is not enough data left for
+  // that many items, so that corrupt data can't cause huge allocations.
+  uint32_t ReadCount(size_t min_item_size) {
+    uint32_t count = Read<uint32_t>();
+    if (static_cast<uint64_t>(count) * min_item_size >
+        static_cast<size_t>(end_ - data_)) {
+      ok_ = false;
+      return 0;
+    }
+    return count;
+  }
+
+  ptrdiff_t ReadOffset() { return static_cast<ptrdiff_t>(Read<int64_t>()); }
+
+ private:
+  const uint8_t* data_;
+  const uint8_t* end_;
+  bool ok_;
+};
+
+// Checks that the objects in a buffer fit inside of it, while working out the
+// most space and the alignment that the buffer could need for them.
+class BufferBounds {
+ public:
+  BufferBounds(uint64_t size, size_t min_alignment)
+      : size_(size), max_size_(0), alignment_(min_alignment) {}
+
+  // Returns true if an object of the given size and alignment fits in the
+  // buffer at the offset.
+  bool Contains(ptrdiff_t offset, size_t size, size_t alignment) {
+    max_size_ += size + alignment - 1;
+    alignment_ = std::max(alignment_, alignment);
+    return offset >= 0 && offset % alignment == 0 &&
+           static_cast<uint64_t>(offset) + size <= size_;
+  }
+
+  bool Contains(ptrdiff_t offset, const Type* type) {
+    return Contains(offset, type->size, type->alignment);
+  }
+
+  template <typename T>
+  bool Contains(ptrdiff_t offset) {
+    return Contains(offset, sizeof(T), std::alignment_of<T>::value);
+  }
+
+  // Returns true if the buffer is no larger than its objects could need, and
+  // has the alignment that they need. This must be checked before the buffer is
+  // allocated so that corrupt data can't cause huge allocations.
+  bool IsValid(uint64_t alignment) const {
+    return size_ <= max_size_ && alignment == alignment_;
+  }
+
+ private:
+  uint64_t size_;
+  uint64_t max_size_;
+  size_t alignment_;
+};
+
+void WriteSignature(const NodeSignature* signature, Writer* writer) {
+  writer->WriteString(*signature->module_name());
+  writer->WriteString(signature->node_name());
+  const std::vector<NodeParameter>& inputs = signature->input_parameters();
+  writer->Write(static_cast<uint32_t>(inputs.size()));
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    writer->WriteType(inputs[i].type);
+  }
+  const std::vector<NodeParameter>& outputs = signature->output_parameters();
+  writer->Write(static_cast<uint32_t>(outputs.size()));
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    writer->WriteType(outputs[i].type);
+  }
+  writer->Write(static_cast<uint32_t>(signature->event_listeners().size()));
+  writer->WriteType(signature->state_type());
+}
+
+bool ReadParameters(const std::vector<NodeParameter>& parameters,
+                    Reader* reader) {
+  if (reader->Read<uint32_t>() != parameters.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    if (!reader->ReadType(parameters[i].type)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Looks up the signature that was written by WriteSignature, and checks that
+// it still has the same interface.
+const NodeSignature* ReadSignature(const ModuleRegistry* module_registry,
+                                   const std::string& graph_name,
+                                   Reader* reader) {
+  std::string module_name = reader->ReadString();
+  std::string node_name = reader->ReadString();
+  if (!reader->ok()) {
+    return nullptr;
+  }
+  const Module* module = module_registry->GetModule(module_name);
+  const NodeSignature* signature =
+      module ? module->GetNodeSignature(node_name) : nullptr;
+  if (!signature) {
+    return nullptr;
+  }
+  if (!ReadParameters(signature->input_parameters(), reader) ||
+      !ReadParameters(signature->output_parameters(), reader) ||
+      reader->Read<uint32_t>() != signature->event_listeners().size() ||
+      !reader->ReadType(signature->state_type())) {
+    CallLogFunc(
+        "Could not load compiled graph \"%s\": Node %s:%s has changed since "
+        "the graph was compiled.",
+        graph_name.c_str(), module_name.c_str(), node_name.c_str());
+    return nullptr;
+  }
+  return signature;
+}
+
+}  // namespace
+
+bool CompileGraph(const Graph& graph, std::string* output) {
+  assert(graph.nodes_finalized());
+  const std::string& graph_name = graph.graph_name_;
+  output->clear();
+  Writer writer(output);
+
+  // Header.
+  output->append(kMagic, sizeof(kMagic));
+  writer.Write(kCompiledGraphFormatVersion);
+  writer.Write(kByteOrderMark);
+  const BreadboardVersion& version = Version();
+  writer.Write(version.major);
+  writer.Write(version.minor);
+  writer.Write(version.revision);
+  writer.Write(static_cast<uint32_t>(sizeof(NodeEventListener)));
+  writer.Write(
+      static_cast<uint32_t>(std::alignment_of<NodeEventListener>::value));
+
+  // Every distinct node type, so that each only has to be looked up once.
+  std::vector<const NodeSignature*> signatures;
+  std::unordered_map<const NodeSignature*, uint32_t> signature_indices;
+  for (size_t i = 0; i < graph.nodes_.size(); ++i) {
+    const NodeSignature* signature = graph.nodes_[i].signature();
+    if (signature_indices.insert(std::make_pair(
+            signature, static_cast<uint32_t>(signatures.size()))).second) {
+      signatures.push_back(signature);
+    }
+  }
+  writer.Write(static_cast<uint32_t>(signatures.size()));
+  for (size_t i = 0; i < signatures.size(); ++i) {
+    WriteSignature(signatures[i], &writer);
+  }
+
+  // Buffer layout.
+  size_t input_alignment = 1;
+  for (size_t i = 0; i < graph.nodes_.size(); ++i) {
+    const Node& node = graph.nodes_[i];
+    const std::vector<NodeParameter>& inputs =
+        node.signature()->input_parameters();
+    for (size_t j = 0; j < inputs.size(); ++j) {
+      if (!node.input_edges()[j].connected() &&
+          inputs[j].type->alignment > input_alignment) {
+        input_alignment = inputs[j].type->alignment;
+      }
+    }
+  }
+  writer.Write(static_cast<uint64_t>(graph.input_buffer_.size()));
+  writer.Write(static_cast<uint64_t>(input_alignment));
+  writer.Write(static_cast<uint64_t>(graph.output_buffer_size_));
+  writer.Write(static_cast<uint64_t>(graph.output_buffer_alignment_));
+
+  // Nodes, in sorted order.
+  writer.Write(static_cast<uint32_t>(graph.nodes_.size()));
+  for (size_t i = 0; i < graph.nodes_.size(); ++i) {
+    const Node& node = graph.nodes_[i];
+    writer.Write(signature_indices[node.signature()]);
+    for (size_t j = 0; j < node.input_edges().size(); ++j) {
+      const InputEdge& edge = node.input_edges()[j];
+      writer.Write(static_cast<uint8_t>(edge.connected()));
+      if (edge.connected()) {
+        writer.Write(static_cast<uint32_t>(edge.target().node_index()));
+        writer.Write(static_cast<uint32_t>(edge.target().edge_index()));
+      } else {
+        writer.WriteOffset(edge.data_offset());
+      }
+    }
+    for (size_t j = 0; j < node.output_edges().size(); ++j) {
+      const OutputEdge& edge = node.output_edges()[j];
+      writer.Write(static_cast<uint8_t>(edge.connected()));
+      writer.Write(static_cast<uint8_t>(edge.aliased()));
+      writer.WriteOffset(edge.timestamp_offset());
+      writer.WriteOffset(edge.data_offset());
+    }
+    writer.WriteOffset(node.timestamp_offset());
+    writer.WriteOffset(node.state_offset());
+    for (size_t j = 0; j < node.listener_offsets().size(); ++j) {
+      writer.WriteOffset(node.listener_offsets()[j]);
+    }
+  }
+  // Subgraph nodes have been inlined, and have no position, so there may be
+  // more positions than nodes.
+  writer.Write(static_cast<uint32_t>(graph.node_positions_.size()));
+  for (size_t i = 0; i < graph.node_positions_.size(); ++i) {
+    writer.Write(static_cast<uint32_t>(graph.node_positions_[i]));
+  }
+
+  // Default values.
+  std::string value;
+  for (size_t i = 0; i < graph.nodes_.size(); ++i) {
+    const Node& node = graph.nodes_[i];
+    const NodeSignature* signature = node.signature();
+    for (size_t j = 0; j < node.input_edges().size(); ++j) {
+      const InputEdge& edge = node.input_edges()[j];
+      const Type* type = signature->input_parameters()[j].type;
+      if (edge.connected() || type->size == 0) {
+        continue;
+      }
+      if (!type->serialize_func) {
+        CallLogFunc(
+            "Could not compile graph \"%s\": Node %d (%s:%s), edge %d has a "
+            "default value of type \"%s\", which can not be serialized.",
+            graph_name.c_str(), static_cast<int>(i),
+            signature->module_name()->c_str(), signature->node_name().c_str(),
+            static_cast<int>(j), type->name);
+        output->clear();
+        return false;
+      }
+      value.clear();
+      type->serialize_func(
+          graph.input_buffer_.GetObjectPtr(edge.data_offset()), &value);
+      writer.WriteString(value);
+    }
+  }
+  return true;
+}
+
+bool LoadCompiledGraph(const ModuleRegistry* module_registry,
+                       const uint8_t* data, size_t size, Graph* graph) {
+  assert(graph->nodes_.empty() && !graph->nodes_finalized_);
+  const std::string& graph_name = graph->graph_name_;
+  Reader reader(data, size);
+
+  const uint8_t* magic = reader.ReadBytes(sizeof(kMagic));
+  if (!magic || memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+    CallLogFunc("Could not load compiled graph \"%s\": Not a compiled graph.",
+                graph_name.c_str());
+    return false;
+  }
+  uint32_t format_version = reader.Read<uint32_t>();
+  uint32_t byte_order_mark = reader.Read<uint32_t>();
+  const BreadboardVersion& version = Version();
+  uint8_t major = reader.Read<uint8_t>();
+  uint8_t minor = reader.Read<uint8_t>();
+  uint8_t revision = reader.Read<uint8_t>();
+  uint32_t listener_size = reader.Read<uint32_t>();
+  uint32_t listener_alignment = reader.Read<uint32_t>();
+  if (format_version != kCompiledGraphFormatVersion ||
+      byte_order_mark != kByteOrderMark || major != version.major ||
+      minor != version.minor || revision != version.revision ||
+      listener_size != sizeof(NodeEventListener) ||
+      listener_alignment != std::alignment_of<NodeEventListener>::value) {
+    CallLogFunc(
+        "Could not load compiled graph \"%s\": It was compiled for a "
+        "different version of Breadboard or a different platform.",
+        graph_name.c_str());
+    return false;
+  }
+
+  // Each signature holds at least its module and node names.
+  std::vector<const NodeSignature*> signatures(
+      reader.ReadCount(2 * sizeof(uint32_t)));
+  for (size_t i = 0; reader.ok() && i < signatures.size(); ++i) {
+    signatures[i] = ReadSignature(module_registry, graph_name, &reader);
+    if (!signatures[i]) {
+      return false;
+    }
+  }
+
+  uint64_t input_size = reader.Read<uint64_t>();
+  uint64_t input_alignment = reader.Read<uint64_t>();
+  uint64_t output_size = reader.Read<uint64_t>();
+  uint64_t output_alignment = reader.Read<uint64_t>();
+  // Each node holds at least its signature, timestamp and state.
+  uint32_t node_count =
+      reader.ReadCount(sizeof(uint32_t) + 2 * sizeof(int64_t));
+  BufferBounds input_bounds(input_size, 1);
+  BufferBounds output_bounds(output_size,
+                             std::alignment_of<Timestamp>::value);
+
+  // Read the nodes back in sorted order, checking that every edge points at
+  // an earlier node and every object fits in its buffer. The output edges and
+  // listener offsets are held aside until the graph's arrays for them exist.
+  std::vector<Node>& nodes = graph->nodes_;
+  std::vector<OutputEdge> output_edges;
+  std::vector<ptrdiff_t> listener_offsets;
+  std::vector<bool> output_edges_used;
+  std::vector<size_t> first_output_edges;
+  nodes.reserve(node_count);
+  bool valid = reader.ok();
+  for (uint32_t i = 0; valid && i < node_count; ++i) {
+    uint32_t signature_index = reader.Read<uint32_t>();
+    if (signature_index >= signatures.size()) {
+      valid = false;
+      break;
+    }
+    const NodeSignature* signature = signatures[signature_index];
+    nodes.push_back(Node(signature));
+    Node& node = nodes.back();
+    first_output_edges.push_back(output_edges.size());
+
+    const std::vector<NodeParameter>& inputs = signature->input_parameters();
+    for (size_t j = 0; valid && j < inputs.size(); ++j) {
+      node.input_edges().push_back(InputEdge());
+      InputEdge& edge = node.input_edges().back();
+      if (reader.Read<uint8_t>()) {
+        uint32_t target_node = reader.Read<uint32_t>();
+        uint32_t target_edge = reader.Read<uint32_t>();
+        valid = target_node < i;
+        if (valid) {
+          const std::vector<NodeParameter>& outputs =
+              nodes[target_node].signature()->output_parameters();
+          valid = target_edge < outputs.size() &&
+                  outputs[target_edge].type == inputs[j].type;
+        }
+        if (valid) {
+          edge.SetTarget(target_node, target_edge);
+          output_edges_used.resize(output_edges.size(), false);
+          output_edges_used[first_output_edges[target_node] + target_edge] =
+              true;
+        }
+      } else {
+        ptrdiff_t offset = reader.ReadOffset();
+        valid = input_bounds.Contains(offset, inputs[j].type);
+        edge.SetDataOffset(offset);
+      }
+    }
+
+    const std::vector<NodeParameter>& outputs = signature->output_parameters();
+    for (size_t j = 0; valid && j < outputs.size(); ++j) {
+      OutputEdge edge;
+      bool connected = reader.Read<uint8_t>() != 0;
+      bool aliased = reader.Read<uint8_t>() != 0;
+      edge.set_connected(connected);
+      edge.set_aliased(aliased);
+      edge.set_timestamp_offset(reader.ReadOffset());
+      edge.set_data_offset(reader.ReadOffset());
+      valid = !connected ||
+              (output_bounds.Contains<Timestamp>(edge.timestamp_offset()) &&
+               output_bounds.Contains(edge.data_offset(), outputs[j].type));
+      if (valid && aliased) {
+        // An aliased edge must share the data of the edge feeding the input
+        // its signature says it aliases.
+        int alias = signature->output_alias(j);
+        valid = connected && alias >= 0 &&
+                node.input_edges()[alias].connected();
+        if (valid) {
+          const OutputEdgeTarget& target = node.input_edges()[alias].target();
+          const OutputEdge& source_edge =
+              output_edges[first_output_edges[target.node_index()] +
+                           target.edge_index()];
+          valid = source_edge.data_offset() == edge.data_offset();
+        }
+      }
+      output_edges.push_back(edge);
+    }
+
+    node.set_timestamp_offset(reader.ReadOffset());
+    node.set_state_offset(reader.ReadOffset());
+    const Type* state_type = signature->state_type();
+    valid = valid &&
+            output_bounds.Contains<Timestamp>(node.timestamp_offset()) &&
+            (!state_type ||
+             output_bounds.Contains(node.state_offset(), state_type));
+    for (size_t j = 0; valid && j < signature->event_listeners().size(); ++j) {
+      listener_offsets.push_back(reader.ReadOffset());
+      valid = output_bounds.Contains<NodeEventListener>(
+          listener_offsets.back());
+    }
+    valid = valid && reader.ok();
+  }
+
+  valid = valid && input_bounds.IsValid(input_alignment) &&
+          output_bounds.IsValid(output_alignment);
+
+  // An output edge only has room in the buffer if something is connected to
+  // it, so the two have to agree.
+  output_edges_used.resize(output_edges.size(), false);
+  for (size_t i = 0; valid && i < output_edges.size(); ++i) {
+    valid = output_edges[i].connected() == output_edges_used[i];
+  }
+
+  std::vector<unsigned int>& node_positions = graph->node_positions_;
+  uint32_t position_count = valid ? reader.ReadCount(sizeof(uint32_t)) : 0;
+  valid = valid && reader.ok() && position_count >= node_count;
+  node_positions.resize(position_count);
+  std::vector<bool> positions_used(node_count, false);
+  uint32_t used_count = 0;
+  for (uint32_t i = 0; valid && i < position_count; ++i) {
+    uint32_t position = reader.Read<uint32_t>();
+    node_positions[i] = position;
+    if (position == kInvalidNodeIndex) {
+      continue;
+    }
+    valid = reader.ok() && position < node_count && !positions_used[position];
+    if (valid) {
+      positions_used[position] = true;
+      ++used_count;
+    }
+  }
+  valid = valid && reader.ok() && used_count == node_count;
+  if (!valid) {
+    // The default values have not been constructed yet, so the graph must not
+    // try to destroy them.
+    nodes.clear();
+    node_positions.clear();
+    CallLogFunc("Could not load compiled graph \"%s\": The data is corrupt.",
+                graph_name.c_str());
+    return false;
+  }
+
+  // Everything has been checked, so the graph can now be put together.
+  graph->sorted_nodes_.resize(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    nodes[i].set_inserted(true);
+    nodes[i].set_sorted_index(static_cast<unsigned int>(i));
+    graph->sorted_nodes_[i] = &nodes[i];
+  }
+  graph->BuildEdgeArrays();
+  assert(graph->output_edges_.size() == output_edges.size());
+  assert(graph->listener_offsets_.size() == listener_offsets.size());
+  std::copy(output_edges.begin(), output_edges.end(),
+            graph->output_edges_.begin());
+  std::copy(listener_offsets.begin(), listener_offsets.end(),
+            graph->listener_offsets_.begin());
+  if (!graph->input_buffer_.Initialize(static_cast<size_t>(input_size),
+                                       static_cast<size_t>(input_alignment),
+                                       graph->allocator_)) {
+    CallLogFunc("Could not load compiled graph \"%s\": Out of memory.",
+                graph_name.c_str());
+    return false;
+  }
+  graph->output_buffer_size_ = static_cast<size_t>(output_size);
+  graph->output_buffer_alignment_ = static_cast<size_t>(output_alignment);
+  graph->ConstructDefaultValues();
+
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    Node& node = nodes[i];
+    const NodeSignature* signature = node.signature();
+    for (size_t j = 0; j < node.input_edges().size(); ++j) {
+      const InputEdge& edge = node.input_edges()[j];
+      const Type* type = signature->input_parameters()[j].type;
+      if (edge.connected() || type->size == 0) {
+        continue;
+      }
+      uint32_t value_size = reader.Read<uint32_t>();
+      const uint8_t* value = reader.ReadBytes(value_size);
+      if (!value || !type->deserialize_func ||
+          !type->deserialize_func(
+              value, value_size,
+              graph->input_buffer_.GetObjectPtr(edge.data_offset()))) {
+        CallLogFunc(
+            "Could not load compiled graph \"%s\": Could not read the default "
+            "value of node %d (%s:%s), edge %d.",
+            graph_name.c_str(), static_cast<int>(i),
+            signature->module_name()->c_str(), signature->node_name().c_str(),
+            static_cast<int>(j));
+        return false;
+      }
+    }
+  }
+
+  graph->BuildOutputBufferObjects();
+  graph->AnalyzeNodes();
+  if (!graph->ConstructBaseNodes()) {
+    CallLogFunc("Could not load compiled graph \"%s\": Out of memory.",
+                graph_name.c_str());
+    return false;
+  }
+  graph->nodes_finalized_ = true;
+  return true;
+}
+
+bool CompiledGraphFactory::ParseData(ModuleRegistry* module_registry,
+                                     Graph* graph, const std::string* data) {
+  return LoadCompiledGraph(module_registry,
+                           reinterpret_cast<const uint8_t*>(data->data()),
+                           data->size(), graph);
+}
+
+bool CompiledGraphFactory::ParseDataView(ModuleRegistry* module_registry,
+                                         Graph* graph, const uint8_t* data,
+                                         size_t size) {
+  return LoadCompiledGraph(module_registry, data, size, graph);
+}
+
+}  // namespace breadboard
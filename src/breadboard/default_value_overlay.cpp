@@ -0,0 +1,64 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/default_value_overlay.h"
+
+#include <cassert>
+
+namespace breadboard {
+
+// The Allocator never hands out empty blocks.
+static size_t AllocationSize(const Type* type) {
+  return type->size > 0 ? type->size : 1;
+}
+
+void* DefaultValueOverlay::AllocateValue(unsigned int node_index,
+                                         unsigned int edge_index,
+                                         const Type* type) {
+  assert(type);
+  for (size_t i = 0; i < values_.size(); ++i) {
+    Value& value = values_[i];
+    if (value.node_index == node_index && value.edge_index == edge_index) {
+      value.type->operator_delete_func(value.data);
+      if (value.type->size != type->size ||
+          value.type->alignment != type->alignment) {
+        DefaultAllocator()->Free(value.data, AllocationSize(value.type));
+        value.data = static_cast<uint8_t*>(
+            DefaultAllocator()->Allocate(AllocationSize(type),
+                                         type->alignment));
+      }
+      value.type = type;
+      return value.data;
+    }
+  }
+  Value value;
+  value.node_index = node_index;
+  value.edge_index = edge_index;
+  value.type = type;
+  value.data = static_cast<uint8_t*>(
+      DefaultAllocator()->Allocate(AllocationSize(type), type->alignment));
+  values_.push_back(value);
+  return value.data;
+}
+
+void DefaultValueOverlay::Clear() {
+  for (size_t i = 0; i < values_.size(); ++i) {
+    const Value& value = values_[i];
+    value.type->operator_delete_func(value.data);
+    DefaultAllocator()->Free(value.data, AllocationSize(value.type));
+  }
+  values_.clear();
+}
+
+}  // namespace breadboard
@@ -13,57 +13,220 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <mutex>
+#include <unordered_map>
 
 #include "breadboard/event.h"
+#include "breadboard/event_dispatcher.h"
 #include "breadboard/graph_state.h"
 #include "breadboard/node_arguments.h"
 
 namespace breadboard {
 
-void NodeEventListener::MarkDirty() { timestamp_ = graph_state_->timestamp(); }
+namespace {
 
-void NodeEventBroadcaster::RegisterListener(NodeEventListener* listener) {
-  auto list_iter = event_listener_lists_.find(listener->event_id());
-  if (list_iter == event_listener_lists_.end()) {
-    auto insert_result = event_listener_lists_.insert(std::make_pair(
-        listener->event_id(), ListenerList(&NodeEventListener::node)));
-    list_iter = insert_result.first;
-  }
-
-  // We don't want to insert this node into more than one list, so if its in a
-  // list we remove it before adding it to the new list. If its already in the
-  // list we're going to add it to, we don't need to do anything.
-  ListenerList& listener_list = list_iter->second;
-  bool in_list = listener->node.in_list();
-  if (in_list) {
-    bool found = false;
-    for (auto listener_iter = listener_list.begin();
-         listener_iter != listener_list.end(); ++listener_iter) {
-      if (&*listener_iter == listener) {
-        found = true;
-        break;
+// Maps each EventId that has been seen to its EventIndex. Events may be
+// defined in any translation unit and looked up from any thread, so access is
+// guarded by a mutex.
+struct EventIndexRegistry {
+  std::mutex mutex;
+  std::unordered_map<EventId, EventIndex> indices;
+};
+
+EventIndexRegistry& GetEventIndexRegistry() {
+  // Constructed on first use so that it is available to events defined during
+  // static initialization in other translation units.
+  static EventIndexRegistry registry;
+  return registry;
+}
+
+// Each thread remembers the indices it has found most recently, so that
+// looking them up again does not need the registry's lock.
+struct EventIndexCacheEntry {
+  EventId event_id;
+  EventIndex event_index;
+};
+
+const size_t kEventIndexCacheSize = 16;
+
+thread_local EventIndexCacheEntry g_event_index_cache[kEventIndexCacheSize];
+
+}  // namespace
+
+EventIndex GetEventIndex(EventId event_id) {
+  EventIndexRegistry& registry = GetEventIndexRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  auto result = registry.indices.insert(std::make_pair(
+      event_id, static_cast<EventIndex>(registry.indices.size())));
+  return result.first->second;
+}
+
+EventIndex FindEventIndex(EventId event_id) {
+  // Indices never change once they are assigned, so the ones that have been
+  // found can be kept without the lock. Events that have no index yet are not
+  // cached, since they may be assigned one later.
+  EventIndexCacheEntry& entry =
+      g_event_index_cache[(reinterpret_cast<uintptr_t>(event_id) /
+                           sizeof(*event_id)) %
+                          kEventIndexCacheSize];
+  if (entry.event_id == event_id) {
+    return entry.event_index;
+  }
+  EventIndexRegistry& registry = GetEventIndexRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  auto iter = registry.indices.find(event_id);
+  if (iter == registry.indices.end()) {
+    return kInvalidEventIndex;
+  }
+  entry.event_id = event_id;
+  entry.event_index = iter->second;
+  return iter->second;
+}
+
+void NodeEventListener::MarkDirty() {
+  timestamp_ = graph_state_->event_timestamp();
+  if (sorted_node_index_ != kInvalidNodeIndex) {
+    graph_state_->MarkNodeDirty(sorted_node_index_);
+  }
+}
+
+// Payloads smaller than this share blocks with each other.
+static const size_t kPayloadBlockSize = 4096;
+
+void* EventPayloadBuffer::Allocate(size_t size, size_t alignment) {
+  while (true) {
+    if (block_index_ < blocks_.size()) {
+      Block& block = blocks_[block_index_];
+      uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+      uintptr_t address = (base + block_offset_ + alignment - 1) &
+                          ~static_cast<uintptr_t>(alignment - 1);
+      size_t end = static_cast<size_t>(address - base) + size;
+      if (end <= block.size) {
+        block_offset_ = end;
+        return reinterpret_cast<void*>(address);
+      }
+      // Move on to the next block, which may be left over from a previous
+      // frame.
+      ++block_index_;
+      block_offset_ = 0;
+      continue;
+    }
+    Block block;
+    block.size = std::max(kPayloadBlockSize, size + alignment - 1);
+    block.data.reset(new uint8_t[block.size]);
+    blocks_.push_back(std::move(block));
+  }
+}
+
+void EventPayloadBuffer::Clear() {
+  for (size_t i = 0; i < destructions_.size(); ++i) {
+    destructions_[i].destroy(destructions_[i].ptr);
+  }
+  destructions_.clear();
+  block_index_ = 0;
+  block_offset_ = 0;
+}
+
+NodeEventBroadcaster::~NodeEventBroadcaster() {
+  if (payload_dispatcher_) {
+    payload_dispatcher_->RemovePayloadBroadcaster(this);
+  }
+  // Unlink the listeners that are still bound so that none of them is left
+  // pointing at this broadcaster.
+  for (size_t i = 0; i < event_listener_lists_.size(); ++i) {
+    ListenerList* listener_list = event_listener_lists_[i].get();
+    if (listener_list) {
+      while (!listener_list->empty()) {
+        NodeEventListener& listener = listener_list->front();
+        listener.node.remove();
+        listener.broadcaster_ = nullptr;
       }
     }
-    if (!found) {
-      listener->node.remove();
-      in_list = false;
+  }
+}
+
+void NodeEventBroadcaster::AddPayload(EventIndex event_index, const Type* type,
+                                      const void* data) {
+  if (event_index >= event_payloads_.size()) {
+    event_payloads_.resize(event_index + 1);
+  }
+  event_payloads_[event_index].push_back(EventPayload(type, data));
+  // With an EventDispatcher, the payloads have to outlive this broadcast, so
+  // the dispatcher clears them once it has executed the GraphStates.
+  if (event_dispatcher_ && !payload_dispatcher_) {
+    payload_dispatcher_ = event_dispatcher_;
+    payload_dispatcher_->AddPayloadBroadcaster(this);
+  }
+}
+
+void NodeEventBroadcaster::ClearPayloads() {
+  for (size_t i = 0; i < event_payloads_.size(); ++i) {
+    event_payloads_[i].clear();
+  }
+  payload_buffer_.Clear();
+  payload_dispatcher_ = nullptr;
+}
+
+void NodeEventBroadcaster::RegisterListener(NodeEventListener* listener) {
+  // Each listener can only be in one list at a time, and remembers which
+  // broadcaster owns that list, so re-registering with the same broadcaster
+  // is a no-op.
+  if (listener->node.in_list()) {
+    if (listener->broadcaster_ == this) {
+      return;
     }
+    listener->node.remove();
+  }
+
+  EventIndex event_index = listener->event_index();
+  if (event_index >= event_listener_lists_.size()) {
+    event_listener_lists_.resize(event_index + 1);
+  }
+  std::unique_ptr<ListenerList>& listener_list =
+      event_listener_lists_[event_index];
+  if (!listener_list) {
+    listener_list.reset(new ListenerList(&NodeEventListener::node));
   }
-  if (!in_list) {
-    listener_list.push_back(*listener);
+  listener_list->push_back(*listener);
+  listener->broadcaster_ = this;
+}
+
+void NodeEventBroadcaster::UnregisterListener(NodeEventListener* listener) {
+  if (listener->broadcaster_ == this && listener->node.in_list()) {
+    listener->node.remove();
+    listener->broadcaster_ = nullptr;
   }
 }
 
 void NodeEventBroadcaster::BroadcastEvent(EventId event_id) {
-  auto list_iter = event_listener_lists_.find(event_id);
-  if (list_iter != event_listener_lists_.end()) {
-    ListenerList& listener_list = list_iter->second;
-    for (auto listener_iter = listener_list.begin();
-         listener_iter != listener_list.end(); ++listener_iter) {
-      listener_iter->MarkDirty();
+  EventIndex event_index = FindEventIndex(event_id);
+  if (event_index != kInvalidEventIndex) {
+    BroadcastEventIndex(event_index);
+  }
+}
+
+void NodeEventBroadcaster::BroadcastEventIndex(EventIndex event_index) {
+  if (event_index >= event_listener_lists_.size() ||
+      !event_listener_lists_[event_index]) {
+    return;
+  }
+  ListenerList& listener_list = *event_listener_lists_[event_index];
+  ++broadcast_depth_;
+  for (auto listener_iter = listener_list.begin();
+       listener_iter != listener_list.end(); ++listener_iter) {
+    listener_iter->MarkDirty();
+    if (event_dispatcher_) {
+      event_dispatcher_->AddPendingGraphState(listener_iter->graph_state());
+    } else {
       listener_iter->graph_state()->Execute();
     }
   }
+  --broadcast_depth_;
+  // The GraphStates have already been executed, so the payloads have been
+  // delivered, unless an EventDispatcher is still holding on to them.
+  if (broadcast_depth_ == 0 && !payload_dispatcher_) {
+    ClearPayloads();
+  }
 }
 
 }  // namespace breadboard
@@ -0,0 +1,197 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/event_dispatcher.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+#include "breadboard/graph_state.h"
+
+namespace breadboard {
+
+EventDispatcher::EventDispatcher(size_t posted_event_capacity)
+    : pending_graph_states_(),
+      payload_broadcasters_(),
+      posted_events_(),
+      posted_event_mask_(0),
+      post_position_(0),
+      pop_position_(0),
+      flushing_graph_states_() {
+  size_t capacity = 1;
+  while (capacity < posted_event_capacity) {
+    capacity *= 2;
+  }
+  posted_events_.reset(new PostedEvent[capacity]);
+  posted_event_mask_ = capacity - 1;
+  // Each slot starts out free for the producer whose position matches.
+  for (size_t i = 0; i < capacity; ++i) {
+    posted_events_[i].sequence.store(i, std::memory_order_relaxed);
+    posted_events_[i].broadcaster = nullptr;
+    posted_events_[i].event_index = kInvalidEventIndex;
+  }
+}
+
+EventDispatcher::~EventDispatcher() {
+  for (size_t i = 0; i < pending_graph_states_.size(); ++i) {
+    pending_graph_states_[i]->pending_event_dispatcher_ = nullptr;
+  }
+  for (size_t i = 0; i < payload_broadcasters_.size(); ++i) {
+    payload_broadcasters_[i]->ClearPayloads();
+  }
+}
+
+void EventDispatcher::AddPayloadBroadcaster(
+    NodeEventBroadcaster* broadcaster) {
+  payload_broadcasters_.push_back(broadcaster);
+}
+
+void EventDispatcher::RemovePayloadBroadcaster(
+    NodeEventBroadcaster* broadcaster) {
+  auto iter = std::find(payload_broadcasters_.begin(),
+                        payload_broadcasters_.end(), broadcaster);
+  if (iter != payload_broadcasters_.end()) {
+    payload_broadcasters_.erase(iter);
+  }
+}
+
+void EventDispatcher::AddPendingGraphState(GraphState* graph_state) {
+  if (graph_state->pending_event_dispatcher_ == this) {
+    return;
+  }
+  // A GraphState can only wait on one dispatcher at a time.
+  assert(graph_state->pending_event_dispatcher_ == nullptr);
+  graph_state->pending_event_dispatcher_ = this;
+  pending_graph_states_.push_back(graph_state);
+}
+
+void EventDispatcher::RemovePendingGraphState(GraphState* graph_state) {
+  auto iter = std::find(pending_graph_states_.begin(),
+                        pending_graph_states_.end(), graph_state);
+  if (iter != pending_graph_states_.end()) {
+    pending_graph_states_.erase(iter);
+  }
+  std::replace(flushing_graph_states_.begin(), flushing_graph_states_.end(),
+               graph_state, static_cast<GraphState*>(nullptr));
+  graph_state->pending_event_dispatcher_ = nullptr;
+}
+
+// This is Dmitry Vyukov's bounded multiple producer queue. A producer claims
+// a position by advancing post_position_, fills in the slot and then
+// publishes it by updating the slot's sequence number. Since there is only
+// ever one consumer, it doesn't need to claim anything.
+bool EventDispatcher::PostEvent(NodeEventBroadcaster* broadcaster,
+                                EventIndex event_index) {
+  size_t position = post_position_.load(std::memory_order_relaxed);
+  PostedEvent* posted_event;
+  while (true) {
+    posted_event = &posted_events_[position & posted_event_mask_];
+    size_t sequence = posted_event->sequence.load(std::memory_order_acquire);
+    ptrdiff_t difference =
+        static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(position);
+    if (difference == 0) {
+      if (post_position_.compare_exchange_weak(position, position + 1,
+                                               std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // The consumer has not caught up with this slot yet; the queue is full.
+      return false;
+    } else {
+      // Another producer claimed this position first.
+      position = post_position_.load(std::memory_order_relaxed);
+    }
+  }
+  posted_event->broadcaster = broadcaster;
+  posted_event->event_index = event_index;
+  posted_event->sequence.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+bool EventDispatcher::PostEvent(NodeEventBroadcaster* broadcaster,
+                                EventId event_id) {
+  EventIndex event_index = FindEventIndex(event_id);
+  // An event that has never been seen has no listeners to receive it.
+  if (event_index == kInvalidEventIndex) {
+    return true;
+  }
+  return PostEvent(broadcaster, event_index);
+}
+
+bool EventDispatcher::PopPostedEvent(NodeEventBroadcaster** broadcaster,
+                                     EventIndex* event_index) {
+  PostedEvent* posted_event =
+      &posted_events_[pop_position_ & posted_event_mask_];
+  size_t sequence = posted_event->sequence.load(std::memory_order_acquire);
+  if (sequence != pop_position_ + 1) {
+    return false;
+  }
+  *broadcaster = posted_event->broadcaster;
+  *event_index = posted_event->event_index;
+  // Hand the slot back to whichever producer next wraps around to it.
+  posted_event->sequence.store(pop_position_ + posted_event_mask_ + 1,
+                               std::memory_order_release);
+  ++pop_position_;
+  return true;
+}
+
+void EventDispatcher::BroadcastPostedEvents() {
+  // Only take what fits in the queue at once, so that threads that keep
+  // posting can't hold up the flush forever.
+  NodeEventBroadcaster* broadcaster;
+  EventIndex event_index;
+  for (size_t i = 0;
+       i <= posted_event_mask_ && PopPostedEvent(&broadcaster, &event_index);
+       ++i) {
+    broadcaster->BroadcastEventIndex(event_index);
+  }
+}
+
+bool EventDispatcher::HasPendingEvents() const {
+  if (!pending_graph_states_.empty()) {
+    return true;
+  }
+  const PostedEvent& posted_event =
+      posted_events_[pop_position_ & posted_event_mask_];
+  return posted_event.sequence.load(std::memory_order_acquire) ==
+         pop_position_ + 1;
+}
+
+void EventDispatcher::FlushEvents() {
+  // Flushing from inside a flush would execute GraphStates out from under the
+  // outer call.
+  assert(flushing_graph_states_.empty());
+  BroadcastPostedEvents();
+  while (!pending_graph_states_.empty()) {
+    flushing_graph_states_.swap(pending_graph_states_);
+    for (size_t i = 0; i < flushing_graph_states_.size(); ++i) {
+      GraphState* graph_state = flushing_graph_states_[i];
+      if (graph_state) {
+        // Clear this first so that events broadcast while executing queue the
+        // GraphState up again.
+        graph_state->pending_event_dispatcher_ = nullptr;
+        graph_state->Execute();
+      }
+    }
+    flushing_graph_states_.clear();
+  }
+  // Every GraphState that received a payload has now been executed.
+  for (size_t i = 0; i < payload_broadcasters_.size(); ++i) {
+    payload_broadcasters_[i]->ClearPayloads();
+  }
+  payload_broadcasters_.clear();
+}
+
+}  // namespace breadboard
@@ -0,0 +1,70 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/fixed_string.h"
+
+#include <cstdio>
+
+namespace breadboard {
+
+size_t FormatInt(int value, int width, char* buffer, size_t capacity) {
+  // Write the digits backwards into a scratch buffer, which is big enough for
+  // every digit of the largest int and its sign. The magnitude is taken as an
+  // unsigned value so that the most negative int can be negated.
+  char digits[3 * sizeof(int) + 1];
+  char* end = digits + sizeof(digits);
+  char* begin = end;
+  unsigned int magnitude = value < 0 ? 0u - static_cast<unsigned int>(value)
+                                     : static_cast<unsigned int>(value);
+  do {
+    *--begin = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0) {
+    *--begin = '-';
+  }
+
+  size_t length = static_cast<size_t>(end - begin);
+  size_t min_width = width > 0 ? static_cast<size_t>(width) : 0;
+  size_t padding = min_width > length ? min_width - length : 0;
+  size_t needed = padding + length;
+  size_t written = 0;
+  for (; written < padding && written < capacity; ++written) {
+    buffer[written] = ' ';
+  }
+  for (; written < needed && written < capacity; ++written) {
+    buffer[written] = *begin++;
+  }
+  if (buffer) {
+    buffer[written] = '\0';
+  }
+  return needed;
+}
+
+size_t FormatFloat(float value, int precision, int width, char* buffer,
+                   size_t capacity) {
+  // snprintf writes straight into the buffer without allocating, and already
+  // handles rounding, infinities and NaN correctly.
+  if (width < 0) {
+    width = 0;
+  }
+  // Without a buffer there is no room even for the null terminator.
+  size_t size = buffer ? capacity + 1 : 0;
+  int needed = precision < 0
+                   ? snprintf(buffer, size, "%*g", width, value)
+                   : snprintf(buffer, size, "%*.*f", width, precision, value);
+  return needed < 0 ? 0 : static_cast<size_t>(needed);
+}
+
+}  // namespace breadboard
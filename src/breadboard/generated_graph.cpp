@@ -0,0 +1,184 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/generated_graph.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+#include "breadboard/log.h"
+
+namespace breadboard {
+
+// The number of bytes of the compiled graph written on each line.
+static const size_t kBytesPerLine = 12;
+
+// Append a formatted line to the output.
+static void AppendLine(std::string* output, const char* format, ...) {
+  char line[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  output->append(line);
+  output->push_back('\n');
+}
+
+// Returns true if the name can be used as a C++ identifier.
+static bool IsIdentifier(const std::string& name) {
+  if (name.empty() || (name[0] >= '0' && name[0] <= '9')) {
+    return false;
+  }
+  for (size_t i = 0; i < name.size(); ++i) {
+    char c = name[i];
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+          (c >= '0' && c <= '9') || c == '_')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Strip anything from the name that would end the comment it is written in.
+static std::string CommentSafe(const std::string& name) {
+  std::string result;
+  for (size_t i = 0; i < name.size(); ++i) {
+    char c = name[i];
+    result.push_back(c == '\n' || c == '\r' || c == '\\' ? ' ' : c);
+  }
+  return result;
+}
+
+// Write the condition under which the node is dirty, which is the same check
+// GraphState makes by walking the node's edges and listeners.
+static void AppendDirtyCheck(const Node& node, std::string* output) {
+  std::vector<std::string> checks;
+  char check[64];
+  snprintf(check, sizeof(check), "context->IsTimestampCurrent(%ld)",
+           static_cast<long>(node.timestamp_offset()));
+  checks.push_back(check);
+  for (size_t i = 0; i < node.listener_offsets().size(); ++i) {
+    snprintf(check, sizeof(check), "context->IsListenerCurrent(%ld)",
+             static_cast<long>(node.listener_offsets()[i]));
+    checks.push_back(check);
+  }
+  const ResolvedInputEdge* input_edges = node.resolved_input_edges();
+  for (size_t i = 0; i < node.input_edges().size(); ++i) {
+    if (input_edges[i].connected) {
+      snprintf(check, sizeof(check), "context->IsTimestampCurrent(%ld)",
+               static_cast<long>(input_edges[i].timestamp_offset));
+      checks.push_back(check);
+    }
+  }
+  for (size_t i = 0; i < checks.size(); ++i) {
+    AppendLine(output, "%s%s%s", i == 0 ? "  if (" : "      ",
+               checks[i].c_str(), i + 1 < checks.size() ? " ||" : ") {");
+  }
+}
+
+bool GenerateGraphSource(const Graph& graph, const std::string& function_name,
+                         std::string* output) {
+  if (!IsIdentifier(function_name)) {
+    CallLogFunc(
+        "Could not generate source for graph \"%s\": \"%s\" is not a valid "
+        "function name.",
+        graph.graph_name().c_str(), function_name.c_str());
+    return false;
+  }
+  std::string compiled_graph;
+  if (!CompileGraph(graph, &compiled_graph)) {
+    return false;
+  }
+
+  output->clear();
+  AppendLine(output, "// Generated from graph \"%s\" by GenerateGraphSource.",
+             CommentSafe(graph.graph_name()).c_str());
+  AppendLine(output, "// Do not edit.");
+  AppendLine(output, "");
+  AppendLine(output, "#include \"breadboard/generated_graph.h\"");
+  AppendLine(output, "");
+  AppendLine(output, "namespace {");
+  AppendLine(output, "");
+
+  AppendLine(output, "const uint8_t kCompiledGraph[] = {");
+  for (size_t i = 0; i < compiled_graph.size(); i += kBytesPerLine) {
+    std::string line = "   ";
+    for (size_t j = i; j < compiled_graph.size() && j < i + kBytesPerLine;
+         ++j) {
+      char byte[8];
+      snprintf(byte, sizeof(byte), " 0x%02x,",
+               static_cast<uint8_t>(compiled_graph[j]));
+      line += byte;
+    }
+    AppendLine(output, "%s", line.c_str());
+  }
+  AppendLine(output, "};");
+  AppendLine(output, "");
+
+  AppendLine(output,
+             "void Execute(breadboard::GeneratedGraphContext* context) {");
+  const std::vector<Node*>& executed_nodes = graph.executed_nodes();
+  if (executed_nodes.empty()) {
+    AppendLine(output, "  (void)context;");
+  }
+  for (size_t i = 0; i < executed_nodes.size(); ++i) {
+    const Node& node = *executed_nodes[i];
+    const NodeSignature* signature = node.signature();
+    unsigned int sorted_index = node.sorted_index();
+    AppendLine(output, "  // %s:%s",
+               CommentSafe(*signature->module_name()).c_str(),
+               CommentSafe(signature->node_name()).c_str());
+    AppendDirtyCheck(node, output);
+    AppendLine(output, "    context->ExecuteNode(%u);", sorted_index);
+    AppendLine(output, "  } else {");
+    AppendLine(output, "    context->SkipNode(%u);", sorted_index);
+    AppendLine(output, "  }");
+  }
+  AppendLine(output, "}");
+  AppendLine(output, "");
+  AppendLine(output, "}  // namespace");
+  AppendLine(output, "");
+
+  AppendLine(output, "bool %s(", function_name.c_str());
+  AppendLine(output,
+             "    const breadboard::ModuleRegistry* module_registry,");
+  AppendLine(output, "    breadboard::Graph* graph) {");
+  AppendLine(output, "  if (!breadboard::LoadCompiledGraph(module_registry, "
+                     "kCompiledGraph,");
+  AppendLine(output, "          sizeof(kCompiledGraph), graph)) {");
+  AppendLine(output, "    return false;");
+  AppendLine(output, "  }");
+  AppendLine(output, "  graph->set_generated_execute_func(Execute);");
+  AppendLine(output, "  return true;");
+  AppendLine(output, "}");
+  return true;
+}
+
+GeneratedGraphContext::GeneratedGraphContext(GraphState* graph_state)
+    : graph_state_(graph_state),
+      output_buffer_(&graph_state->output_buffer_),
+      timestamp_(graph_state->timestamp_),
+      sorted_nodes_(&graph_state->graph_->sorted_nodes()),
+      executed_count_(0) {}
+
+void GeneratedGraphContext::ExecuteNode(unsigned int sorted_index) {
+  graph_state_->ExecuteNode((*sorted_nodes_)[sorted_index]);
+  ++executed_count_;
+}
+
+void GeneratedGraphContext::SkipNode(unsigned int sorted_index) {
+  graph_state_->RecordSkip(*(*sorted_nodes_)[sorted_index]);
+}
+
+}  // namespace breadboard
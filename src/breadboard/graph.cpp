@@ -14,16 +14,27 @@
 
 #include "breadboard/graph.h"
 
+#include <algorithm>
 #include <new>
 #include <set>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 
 #include "breadboard/base_node.h"
+#include "breadboard/graph_state.h"
 #include "breadboard/log.h"
 
 namespace breadboard {
 
 Graph::~Graph() {
+  DestroyBaseNodes();
+  // If FinalizeNodes failed before the default values were allocated, there
+  // are none to destroy.
+  if (input_buffer_.size() == 0) {
+    return;
+  }
   // Destruct the default values.
   for (auto node = nodes_.begin(); node != nodes_.end(); ++node) {
     const NodeSignature* signature = node->signature();
@@ -35,7 +46,7 @@ Graph::~Graph() {
         // Only do this on non-void objects. Attempting to access a void edge
         // can be troublesome in the case where the last edge listed is of type
         // void.
-        if (type->size > 0) {
+        if (type->size > 0 && !type->trivially_destructible) {
           uint8_t* ptr = input_buffer_.GetObjectPtr(input_edge.data_offset());
           type->operator_delete_func(ptr);
         }
@@ -50,58 +61,382 @@ Node* Graph::AddNode(const NodeSignature* signature) {
   return &nodes_.back();
 }
 
-// Returns the index of a node in the graph. This takes linear time, but we
-// don't care that much becuase this is only called when there is an error.
-static int NodeIndex(const std::vector<Node>& nodes, const Node& node) {
-  for (size_t i = 0; i < nodes.size(); ++i) {
-    if (&nodes[i] == &node) {
-      return static_cast<int>(i);
+Node* Graph::AddSubgraph(const std::shared_ptr<const Graph>& subgraph) {
+  assert(!nodes_finalized_ && subgraph && subgraph->nodes_finalized_);
+  const NodeSignature* signature = subgraph->subgraph_signature();
+  subgraphs_.push_back(
+      Subgraph(static_cast<unsigned int>(nodes_.size()), subgraph));
+  return AddNode(signature);
+}
+
+// Subgraph nodes never run, since they are replaced when the graph is
+// finalized, so they have no BaseNode.
+static const std::string* SubgraphModuleName() {
+  static const std::string module_name("subgraph");
+  return &module_name;
+}
+
+const NodeSignature* Graph::subgraph_signature() const {
+  assert(nodes_finalized_);
+  std::lock_guard<std::mutex> lock(subgraph_signature_mutex_);
+  if (!subgraph_signature_) {
+    BuildSubgraphSignature();
+  }
+  return subgraph_signature_.get();
+}
+
+void Graph::BuildSubgraphSignature() const {
+  subgraph_signature_.reset(new NodeSignature(
+      SubgraphModuleName(), graph_name_, []() -> BaseNode* { return nullptr; },
+      [](BaseNode*) {}));
+  subgraph_inputs_.clear();
+  subgraph_outputs_.clear();
+  for (size_t i = 0; i < node_positions_.size(); ++i) {
+    unsigned int position = node_positions_[i];
+    if (position == kInvalidNodeIndex) {
+      continue;
+    }
+    const Node& node = nodes_[position];
+    const NodeSignature* signature = node.signature();
+    for (size_t j = 0; j < node.input_edges().size(); ++j) {
+      if (!node.input_edges()[j].connected()) {
+        subgraph_inputs_.push_back(
+            SubgraphEdge(position, static_cast<unsigned int>(j)));
+        subgraph_signature_->AddInputParameter(
+            signature->input_parameters()[j]);
+      }
+    }
+    for (size_t j = 0; j < node.output_edges().size(); ++j) {
+      if (!node.output_edges()[j].connected()) {
+        subgraph_outputs_.push_back(
+            SubgraphEdge(position, static_cast<unsigned int>(j)));
+        subgraph_signature_->AddOutputParameter(
+            signature->output_parameters()[j]);
+      }
     }
   }
-  // Should not ever reach this point: that would mean we're looking for a node
-  // in a different graph.
-  assert(0);
-  return -1;
 }
 
-bool Graph::InsertNode(Node* node) {
-  if (!node->inserted()) {
-    node->set_visited(true);
-    for (size_t i = 0; i < node->input_edges().size(); ++i) {
-      InputEdge& edge = node->input_edges()[i];
-      if (edge.connected()) {
-        Node& dependency = edge.target().GetTargetNode(&nodes_);
-        const Type* input_type = node->signature()->input_parameters()[i].type;
-        const Type* output_type =
-            dependency.signature()
-                ->output_parameters()[edge.target().edge_index()]
-                .type;
-        if (input_type != output_type) {
-          int input_node_index = NodeIndex(nodes_, *node);
-          CallLogFunc(
-              "Could not resolve graph \"%s\": Type mismatch. Node %d, input "
-              "edge %d is type \"%s\" but is connected to node %d, output edge "
-              "%d of type \"%s\".",
-              graph_name_.c_str(), input_node_index, i, input_type->name,
-              edge.target().node_index(), edge.target().edge_index(),
-              output_type->name);
+const Graph::Subgraph* Graph::FindSubgraph(unsigned int node_index) const {
+  auto subgraph = std::lower_bound(
+      subgraphs_.begin(), subgraphs_.end(), node_index,
+      [](const Subgraph& subgraph, unsigned int node_index) {
+        return subgraph.node_index < node_index;
+      });
+  if (subgraph == subgraphs_.end() || subgraph->node_index != node_index) {
+    return nullptr;
+  }
+  return &*subgraph;
+}
+
+const InputEdge* Graph::FindDefaultInputEdge(unsigned int node_index,
+                                             unsigned int edge_index,
+                                             const Type* type) const {
+  assert(nodes_finalized_);
+  if (node_index >= node_positions_.size()) {
+    CallLogFunc(
+        "%s: Attempting to assign a default value on node %d when graph only "
+        "has %d nodes.",
+        graph_name_.c_str(), node_index, static_cast<int>(nodes_.size()));
+    return nullptr;
+  }
+  if (node_positions_[node_index] == kInvalidNodeIndex &&
+      !ResolveSubgraphInput(&node_index, &edge_index)) {
+    return nullptr;
+  }
+  const Node& node = nodes_[node_positions_[node_index]];
+  const NodeSignature* signature = node.signature();
+  if (edge_index >= node.input_edges().size()) {
+    CallLogFunc(
+        "%s: Attempting to assign a default value to node %i (%s:%s), edge "
+        "%d when node only has %d input edges.",
+        graph_name_.c_str(), node_index, signature->module_name()->c_str(),
+        signature->node_name().c_str(), edge_index,
+        static_cast<int>(node.input_edges().size()));
+    return nullptr;
+  }
+  const Type* expected_type = signature->input_parameters()[edge_index].type;
+  if (type != expected_type) {
+    CallLogFunc(
+        "%s: Attempting to assign a default value of the incorrect type to "
+        "node %d (%s:%s), edge %d. Edge got type \"%s\" when it expects type "
+        "\"%s\".",
+        graph_name_.c_str(), node_index, signature->module_name()->c_str(),
+        signature->node_name().c_str(), edge_index, type->name,
+        expected_type->name);
+    return nullptr;
+  }
+  return &node.input_edges()[edge_index];
+}
+
+bool Graph::ResolveSubgraphInput(unsigned int* node_index,
+                                 unsigned int* edge_index) const {
+  const Subgraph* subgraph = FindSubgraph(*node_index);
+  if (!subgraph) {
+    // The graph was loaded in a form that no longer records its subgraphs,
+    // such as a compiled graph, which holds its default values already.
+    CallLogFunc(
+        "%s: Attempting to assign a default value to node %d, which was "
+        "a subgraph node that has been inlined.",
+        graph_name_.c_str(), *node_index);
+    return false;
+  }
+  const std::vector<SubgraphEdge>& inputs = subgraph->inputs;
+  if (*edge_index >= inputs.size()) {
+    CallLogFunc(
+        "%s: Attempting to assign a default value to subgraph node %d, edge "
+        "%d when it only has %d input edges.",
+        graph_name_.c_str(), *node_index, *edge_index,
+        static_cast<int>(inputs.size()));
+    return false;
+  }
+  unsigned int inlined_index =
+      subgraph->first_node_index + inputs[*edge_index].node_position;
+  unsigned int inlined_edge_index = inputs[*edge_index].edge_index;
+  const Node& node = nodes_[node_positions_[inlined_index]];
+  if (node.input_edges()[inlined_edge_index].connected()) {
+    CallLogFunc(
+        "%s: Attempting to assign a default value to subgraph node %d, edge "
+        "%d, which is connected to another node.",
+        graph_name_.c_str(), *node_index, *edge_index);
+    return false;
+  }
+  *node_index = inlined_index;
+  *edge_index = inlined_edge_index;
+  return true;
+}
+
+// Every subgraph node is replaced by copies of the sorted nodes of its
+// subgraph, which go after the nodes that were added directly. Edges that
+// pointed at a subgraph node are then pointed at the node in the copy that
+// the edge stands for, so that nothing after this has to know about
+// subgraphs at all.
+bool Graph::InlineSubgraphs() {
+  if (subgraphs_.empty()) {
+    return true;
+  }
+  size_t node_count = nodes_.size();
+  size_t direct_count = node_count - subgraphs_.size();
+  size_t inlined_count = 0;
+  for (auto subgraph = subgraphs_.begin(); subgraph != subgraphs_.end();
+       ++subgraph) {
+    inlined_count += subgraph->graph->nodes_.size();
+  }
+  std::vector<Node> nodes;
+  nodes.reserve(direct_count + inlined_count);
+  std::vector<Node> subgraph_nodes;
+  subgraph_nodes.reserve(subgraphs_.size());
+  node_positions_.assign(node_count, kInvalidNodeIndex);
+  auto next_subgraph = subgraphs_.begin();
+  for (size_t i = 0; i < node_count; ++i) {
+    if (next_subgraph != subgraphs_.end() && next_subgraph->node_index == i) {
+      ++next_subgraph;
+      subgraph_nodes.push_back(std::move(nodes_[i]));
+      continue;
+    }
+    node_positions_[i] = static_cast<unsigned int>(nodes.size());
+    nodes.push_back(std::move(nodes_[i]));
+  }
+  for (auto subgraph = subgraphs_.begin(); subgraph != subgraphs_.end();
+       ++subgraph) {
+    const Graph& graph = *subgraph->graph;
+    unsigned int first_position = static_cast<unsigned int>(nodes.size());
+    subgraph->first_node_index =
+        static_cast<unsigned int>(node_positions_.size());
+    for (size_t i = 0; i < graph.nodes_.size(); ++i) {
+      const Node& source = graph.nodes_[i];
+      node_positions_.push_back(static_cast<unsigned int>(nodes.size()));
+      nodes.push_back(Node(source.signature()));
+      std::vector<InputEdge>& input_edges = nodes.back().input_edges();
+      input_edges = source.input_edges();
+      for (size_t j = 0; j < input_edges.size(); ++j) {
+        if (input_edges[j].connected()) {
+          const OutputEdgeTarget& target = input_edges[j].target();
+          input_edges[j].SetTarget(first_position + target.node_index(),
+                                   target.edge_index());
+        }
+      }
+    }
+  }
+  nodes_.swap(nodes);
+
+  // Point an edge at the output that the given target, which may be an
+  // output of a subgraph node, stands for.
+  auto redirect = [&](unsigned int node_index, size_t edge_index,
+                      const OutputEdgeTarget& target, InputEdge* edge) {
+    unsigned int target_index = target.node_index();
+    unsigned int target_edge_index = target.edge_index();
+    if (target_index >= node_count) {
+      CallLogFunc(
+          "Could not resolve graph \"%s\": Node %d, input edge %d is "
+          "connected to node %d, which does not exist.",
+          graph_name_.c_str(), node_index, static_cast<int>(edge_index),
+          target_index);
+      return false;
+    }
+    const Subgraph* subgraph = FindSubgraph(target_index);
+    if (!subgraph) {
+      edge->SetTarget(node_positions_[target_index], target_edge_index);
+      return true;
+    }
+    const std::vector<SubgraphEdge>& outputs = subgraph->outputs;
+    if (target_edge_index >= outputs.size()) {
+      CallLogFunc(
+          "Could not resolve graph \"%s\": Node %d, input edge %d is "
+          "connected to subgraph node %d (%s), output edge %d, which does not "
+          "exist.",
+          graph_name_.c_str(), node_index, static_cast<int>(edge_index),
+          target_index, subgraph->graph->graph_name().c_str(),
+          target_edge_index);
+      return false;
+    }
+    unsigned int first_position = static_cast<unsigned int>(
+        direct_count + subgraph->first_node_index - node_count);
+    edge->SetTarget(first_position + outputs[target_edge_index].node_position,
+                    outputs[target_edge_index].edge_index);
+    return true;
+  };
+
+  for (size_t i = 0; i < node_count; ++i) {
+    const Subgraph* subgraph = FindSubgraph(static_cast<unsigned int>(i));
+    if (!subgraph) {
+      // A node that was added directly.
+      std::vector<InputEdge>& input_edges =
+          nodes_[node_positions_[i]].input_edges();
+      for (size_t j = 0; j < input_edges.size(); ++j) {
+        if (input_edges[j].connected() &&
+            !redirect(static_cast<unsigned int>(i), j,
+                      input_edges[j].target(), &input_edges[j])) {
           return false;
-        } else if (dependency.visited()) {
-          // Circular dependency. This is not currently allowed; must be a
-          // directed acyclic graph.
-          CallLogFunc("Could not resolve graph: Circular dependency.");
+        }
+      }
+      continue;
+    }
+    // The connected inputs of a subgraph node are passed on to the inputs of
+    // the inlined nodes that they stand for.
+    const std::vector<InputEdge>& input_edges =
+        subgraph_nodes[subgraph - subgraphs_.data()].input_edges();
+    const std::vector<SubgraphEdge>& inputs = subgraph->inputs;
+    unsigned int first_position = static_cast<unsigned int>(
+        direct_count + subgraph->first_node_index - node_count);
+    for (size_t j = 0; j < input_edges.size(); ++j) {
+      if (input_edges[j].connected()) {
+        Node& node = nodes_[first_position + inputs[j].node_position];
+        if (!redirect(static_cast<unsigned int>(i), j,
+                      input_edges[j].target(),
+                      &node.input_edges()[inputs[j].edge_index])) {
           return false;
-        } else if (!dependency.inserted()) {
-          if (!InsertNode(&dependency)) {
-            // One of the errors above was hit in a recursive call, error out.
-            return false;
-          }
         }
       }
     }
-    node->set_visited(false);
-    node->set_inserted(true);
-    sorted_nodes_.push_back(node);
+  }
+  return true;
+}
+
+// The inlined nodes start out with the default values of the subgraph, which
+// SetDefaultValue may then replace.
+bool Graph::CopySubgraphDefaultValues() {
+  for (auto subgraph = subgraphs_.begin(); subgraph != subgraphs_.end();
+       ++subgraph) {
+    const Graph& graph = *subgraph->graph;
+    for (size_t i = 0; i < graph.nodes_.size(); ++i) {
+      const Node& source = graph.nodes_[i];
+      Node& node = nodes_[node_positions_[subgraph->first_node_index + i]];
+      const NodeSignature* signature = node.signature();
+      for (size_t j = 0; j < node.input_edges().size(); ++j) {
+        const InputEdge& edge = node.input_edges()[j];
+        const Type* type = signature->input_parameters()[j].type;
+        if (edge.connected() || type->size == 0) {
+          continue;
+        }
+        if (!type->placement_copy_func) {
+          CallLogFunc(
+              "Error in graph \"%s\": Subgraph \"%s\" has a default value "
+              "of type \"%s\", which can not be copied.",
+              graph_name_.c_str(), graph.graph_name().c_str(), type->name);
+          return false;
+        }
+        uint8_t* ptr = input_buffer_.GetObjectPtr(edge.data_offset());
+        if (!type->trivially_destructible) {
+          type->operator_delete_func(ptr);
+        }
+        const uint8_t* source_ptr = graph.input_buffer_.GetObjectPtr(
+            source.input_edges()[j].data_offset());
+        type->placement_copy_func(ptr, source_ptr);
+      }
+    }
+  }
+  return true;
+}
+
+// Add the node to sorted_nodes_, after all of the nodes it depends on. This is
+// a depth first search, done with an explicit stack rather than by recursion
+// so that long chains of dependencies can't overflow the call stack. Each
+// entry on the stack is a node along with the next of its input edges to
+// follow. Every node and edge is visited once, and since nodes_ is still in
+// the order the nodes were added, a node's index is found in constant time.
+bool Graph::InsertNode(Node* root, NodeStack* stack) {
+  if (root->inserted()) {
+    return true;
+  }
+  stack->clear();
+  root->set_visited(true);
+  stack->push_back(std::make_pair(root, static_cast<size_t>(0)));
+  while (!stack->empty()) {
+    Node* node = stack->back().first;
+    size_t i = stack->back().second++;
+    if (i == node->input_edges().size()) {
+      // Everything this node depends on has been inserted.
+      stack->pop_back();
+      node->set_visited(false);
+      node->set_inserted(true);
+      node->set_sorted_index(static_cast<unsigned int>(sorted_nodes_.size()));
+      sorted_nodes_.push_back(node);
+      continue;
+    }
+    const InputEdge& edge = node->input_edges()[i];
+    if (!edge.connected()) {
+      continue;
+    }
+    int node_index = static_cast<int>(node - nodes_.data());
+    const OutputEdgeTarget& target = edge.target();
+    if (target.node_index() >= nodes_.size() ||
+        target.edge_index() >= nodes_[target.node_index()]
+                                   .signature()
+                                   ->output_parameters()
+                                   .size()) {
+      CallLogFunc(
+          "Could not resolve graph \"%s\": Node %d, input edge %d is "
+          "connected to node %d, output edge %d, which does not exist.",
+          graph_name_.c_str(), node_index, static_cast<int>(i),
+          target.node_index(), target.edge_index());
+      return false;
+    }
+    Node& dependency = nodes_[target.node_index()];
+    const Type* input_type = node->signature()->input_parameters()[i].type;
+    const Type* output_type =
+        dependency.signature()->output_parameters()[target.edge_index()].type;
+    if (input_type != output_type) {
+      CallLogFunc(
+          "Could not resolve graph \"%s\": Type mismatch. Node %d, input "
+          "edge %d is type \"%s\" but is connected to node %d, output edge "
+          "%d of type \"%s\".",
+          graph_name_.c_str(), node_index, static_cast<int>(i),
+          input_type->name, target.node_index(), target.edge_index(),
+          output_type->name);
+      return false;
+    } else if (dependency.visited()) {
+      // Circular dependency. This is not currently allowed; must be a
+      // directed acyclic graph.
+      CallLogFunc(
+          "Could not resolve graph \"%s\": Circular dependency. Node %d "
+          "depends on node %d, which depends on it in turn.",
+          graph_name_.c_str(), node_index, target.node_index());
+      return false;
+    } else if (!dependency.inserted()) {
+      dependency.set_visited(true);
+      stack->push_back(std::make_pair(&dependency, static_cast<size_t>(0)));
+    }
   }
   return true;
 }
@@ -112,9 +447,12 @@ bool Graph::InsertNode(Node* node) {
 //
 //     https://en.wikipedia.org/wiki/Topological_sorting
 bool Graph::SortGraphNodes() {
+  sorted_nodes_.reserve(nodes_.size());
+  // Shared by every call, so that it is only allocated once.
+  NodeStack stack;
   for (size_t i = 0; i != nodes_.size(); ++i) {
     Node& node = nodes_[i];
-    if (!InsertNode(&node)) {
+    if (!InsertNode(&node, &stack)) {
       // Error in evaluation; report error.
       return false;
     }
@@ -122,6 +460,349 @@ bool Graph::SortGraphNodes() {
   return true;
 }
 
+// Any order that puts every node after all of the nodes on lower levels is
+// still a valid topological order, so the nodes within a level can be arranged
+// freely. The nodes of each level are grouped by signature, with the
+// signatures in the order they are first seen, so that the result does not
+// depend on where the signatures happen to be in memory.
+void Graph::GroupNodesBySignature() {
+  std::vector<size_t> node_levels(nodes_.size(), 0);
+  std::unordered_map<const NodeSignature*, size_t> signature_groups;
+  // Each node's level, group and position in sorted_nodes_. Sorting these
+  // keeps nodes of the same level and group in their current order.
+  std::vector<std::tuple<size_t, size_t, size_t>> keys;
+  keys.reserve(sorted_nodes_.size());
+  for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+    Node* node = sorted_nodes_[i];
+    size_t level = 0;
+    for (size_t j = 0; j < node->input_edges().size(); ++j) {
+      const InputEdge& edge = node->input_edges()[j];
+      if (edge.connected()) {
+        level = std::max(level, node_levels[edge.target().node_index()] + 1);
+      }
+    }
+    node_levels[node - nodes_.data()] = level;
+    size_t group =
+        signature_groups.insert(std::make_pair(node->signature(),
+                                               signature_groups.size()))
+            .first->second;
+    keys.push_back(std::make_tuple(level, group, i));
+  }
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<Node*> grouped_nodes;
+  grouped_nodes.reserve(sorted_nodes_.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    Node* node = sorted_nodes_[std::get<2>(keys[i])];
+    node->set_sorted_index(static_cast<unsigned int>(i));
+    grouped_nodes.push_back(node);
+  }
+  sorted_nodes_.swap(grouped_nodes);
+}
+
+// After sorting, move the nodes themselves into sorted order so that walking
+// sorted_nodes_ reads through memory front to back. Edges refer to nodes by
+// index, so those are updated to match.
+void Graph::ReorderNodes() {
+  std::vector<unsigned int> positions(nodes_.size());
+  for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+    positions[sorted_nodes_[i] - nodes_.data()] = static_cast<unsigned int>(i);
+  }
+  if (subgraphs_.empty()) {
+    node_positions_ = positions;
+  } else {
+    // InlineSubgraphs has already moved the nodes around once.
+    for (size_t i = 0; i < node_positions_.size(); ++i) {
+      if (node_positions_[i] != kInvalidNodeIndex) {
+        node_positions_[i] = positions[node_positions_[i]];
+      }
+    }
+  }
+  std::vector<Node> sorted_nodes;
+  sorted_nodes.reserve(nodes_.size());
+  for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+    sorted_nodes.push_back(std::move(*sorted_nodes_[i]));
+  }
+  nodes_.swap(sorted_nodes);
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    Node& node = nodes_[i];
+    for (size_t j = 0; j < node.input_edges().size(); ++j) {
+      InputEdge& edge = node.input_edges()[j];
+      if (edge.connected()) {
+        const OutputEdgeTarget& target = edge.target();
+        edge.SetTarget(positions[target.node_index()], target.edge_index());
+      }
+    }
+    sorted_nodes_[i] = &node;
+  }
+}
+
+// Rather than have every node allocate its own small arrays, all of the output
+// edges and listener offsets in the graph are allocated in one go. Each node
+// just refers to its own run of them.
+void Graph::BuildEdgeArrays() {
+  size_t output_edge_count = 0;
+  size_t listener_count = 0;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const NodeSignature* signature = nodes_[i].signature();
+    output_edge_count += signature->output_parameters().size();
+    listener_count += signature->event_listeners().size();
+  }
+  output_edges_.assign(output_edge_count, OutputEdge());
+  listener_offsets_.assign(listener_count, 0);
+
+  OutputEdge* output_edges = output_edges_.data();
+  const ptrdiff_t* listener_offsets = listener_offsets_.data();
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    Node& node = nodes_[i];
+    const NodeSignature* signature = node.signature();
+    size_t output_count = signature->output_parameters().size();
+    size_t node_listener_count = signature->event_listeners().size();
+    node.set_output_edges(ArrayRef<OutputEdge>(output_edges, output_count));
+    node.set_listener_offsets(
+        ArrayRef<const ptrdiff_t>(listener_offsets, node_listener_count));
+    output_edges += output_count;
+    listener_offsets += node_listener_count;
+  }
+}
+
+// Record, for each output edge, which nodes need to be executed when it
+// changes. This is what allows a GraphState in worklist mode to find the dirty
+// nodes without checking every node in the graph. The lists of every edge are
+// stored back to back in consumers_: the first pass counts how long each list
+// is, and the second fills them in.
+void Graph::BuildConsumerLists() {
+  std::vector<size_t> consumer_counts(output_edges_.size(), 0);
+  std::vector<unsigned int> last_consumers(output_edges_.size(),
+                                           kInvalidNodeIndex);
+  size_t total_count = 0;
+  for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+    Node* node = sorted_nodes_[i];
+    // Dead nodes are never executed, so there is no need to queue them.
+    if (node->dead()) {
+      continue;
+    }
+    for (size_t j = 0; j < node->input_edges().size(); ++j) {
+      const InputEdge& edge = node->input_edges()[j];
+      if (edge.connected()) {
+        size_t edge_index =
+            &edge.target().GetTargetEdge(&nodes_) - output_edges_.data();
+        // A node may be connected to the same output more than once.
+        if (last_consumers[edge_index] != i) {
+          last_consumers[edge_index] = static_cast<unsigned int>(i);
+          ++consumer_counts[edge_index];
+          ++total_count;
+        }
+      }
+    }
+  }
+
+  consumers_.assign(total_count, 0);
+  std::vector<size_t> consumer_starts(output_edges_.size(), 0);
+  size_t start = 0;
+  for (size_t i = 0; i < output_edges_.size(); ++i) {
+    consumer_starts[i] = start;
+    output_edges_[i].set_consumers(ArrayRef<const unsigned int>(
+        consumers_.data() + start, consumer_counts[i]));
+    start += consumer_counts[i];
+    last_consumers[i] = kInvalidNodeIndex;
+  }
+
+  for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+    Node* node = sorted_nodes_[i];
+    if (node->dead()) {
+      continue;
+    }
+    for (size_t j = 0; j < node->input_edges().size(); ++j) {
+      const InputEdge& edge = node->input_edges()[j];
+      if (edge.connected()) {
+        size_t edge_index =
+            &edge.target().GetTargetEdge(&nodes_) - output_edges_.data();
+        if (last_consumers[edge_index] != i) {
+          last_consumers[edge_index] = static_cast<unsigned int>(i);
+          consumers_[consumer_starts[edge_index]++] =
+              static_cast<unsigned int>(i);
+        }
+      }
+    }
+  }
+}
+
+// Resolve every input edge down to the offsets it reads from, so that nodes
+// don't need to look up the node they are connected to each time they read an
+// input. The edges are laid out in sorted order, which is the order in which
+// the nodes are executed.
+void Graph::BuildResolvedInputEdges() {
+  size_t edge_count = 0;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    edge_count += nodes_[i].input_edges().size();
+  }
+  resolved_input_edges_.clear();
+  resolved_input_edges_.reserve(edge_count);
+  for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+    const Node* node = sorted_nodes_[i];
+    for (size_t j = 0; j < node->input_edges().size(); ++j) {
+      const InputEdge& input_edge = node->input_edges()[j];
+      ResolvedInputEdge resolved_edge;
+      resolved_edge.connected = input_edge.connected();
+      if (input_edge.connected()) {
+        const OutputEdge& output_edge =
+            input_edge.target().GetTargetEdge(&nodes_);
+        resolved_edge.data_offset = output_edge.data_offset();
+        resolved_edge.timestamp_offset = output_edge.timestamp_offset();
+        resolved_edge.dirty_bit = output_edge.dirty_bit();
+      } else {
+        resolved_edge.data_offset = input_edge.data_offset();
+        resolved_edge.timestamp_offset = 0;
+        resolved_edge.dirty_bit = 0;
+      }
+      resolved_input_edges_.push_back(resolved_edge);
+    }
+  }
+
+  // The array has been fully built, so it is now safe to point into it.
+  const ResolvedInputEdge* resolved_edges = resolved_input_edges_.data();
+  for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+    Node* node = sorted_nodes_[i];
+    node->set_resolved_input_edges(resolved_edges);
+    resolved_edges += node->input_edges().size();
+  }
+}
+
+void Graph::AssignDirtyBits() {
+  dirty_bit_count_ = 0;
+  if (dirty_tracking_ != kDirtyTrackingBitset) {
+    return;
+  }
+  unsigned int dirty_bit = static_cast<unsigned int>(sorted_nodes_.size());
+  for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+    Node* node = sorted_nodes_[i];
+    for (size_t j = 0; j < node->output_edges().size(); ++j) {
+      OutputEdge& output_edge = node->output_edges()[j];
+      if (output_edge.connected()) {
+        output_edge.set_dirty_bit(dirty_bit++);
+      }
+    }
+  }
+  dirty_bit_count_ = dirty_bit;
+}
+
+// Add a bit to a node's masks, merging it into the mask for its word if the
+// node already has one.
+static void AddDirtyBit(unsigned int dirty_bit, size_t first_mask,
+                        std::vector<DirtyMask>* masks) {
+  size_t word = dirty_bit / 64;
+  uint64_t bit = uint64_t(1) << (dirty_bit % 64);
+  for (size_t i = first_mask; i < masks->size(); ++i) {
+    if ((*masks)[i].word == word) {
+      (*masks)[i].bits |= bit;
+      return;
+    }
+  }
+  DirtyMask mask = {word, bit};
+  masks->push_back(mask);
+}
+
+void Graph::BuildDirtyMasks() {
+  dirty_masks_.clear();
+  std::vector<size_t> first_masks(sorted_nodes_.size() + 1, 0);
+  if (dirty_tracking_ == kDirtyTrackingBitset) {
+    for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+      const Node* node = sorted_nodes_[i];
+      first_masks[i] = dirty_masks_.size();
+      AddDirtyBit(node->sorted_index(), first_masks[i], &dirty_masks_);
+      const ResolvedInputEdge* input_edges = node->resolved_input_edges();
+      for (size_t j = 0; j < node->input_edges().size(); ++j) {
+        if (input_edges[j].connected) {
+          AddDirtyBit(input_edges[j].dirty_bit, first_masks[i], &dirty_masks_);
+        }
+      }
+    }
+    first_masks[sorted_nodes_.size()] = dirty_masks_.size();
+  }
+
+  // The array has been fully built, so it is now safe to point into it.
+  for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+    sorted_nodes_[i]->set_dirty_masks(ArrayRef<const DirtyMask>(
+        dirty_masks_.data() + first_masks[i],
+        first_masks[i + 1] - first_masks[i]));
+  }
+}
+
+// Only nodes that are not pure can have an effect outside of the graph, such
+// as printing to the console or moving an entity. A pure node is only worth
+// executing if one of its outputs leads to such a node. Since sorted_nodes_
+// lists dependents after their dependencies, walking it backwards visits every
+// node after all of the nodes that read its outputs.
+void Graph::FindDeadNodes() {
+  for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+    Node* node = sorted_nodes_[i];
+    node->set_dead(node->signature()->pure());
+  }
+  for (size_t i = sorted_nodes_.size(); i-- > 0;) {
+    Node* node = sorted_nodes_[i];
+    if (node->dead()) {
+      continue;
+    }
+    for (size_t j = 0; j < node->input_edges().size(); ++j) {
+      const InputEdge& edge = node->input_edges()[j];
+      if (edge.connected()) {
+        edge.target().GetTargetNode(&nodes_).set_dead(false);
+      }
+    }
+  }
+}
+
+// A pure node whose inputs are all either default values or connected to
+// other constant nodes will always produce the same outputs, so there is no
+// point in checking it every time the graph is executed. Since sorted_nodes_
+// lists dependencies before their dependents, a single pass is enough.
+void Graph::FindConstantNodes() {
+  executed_nodes_.clear();
+  for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+    Node* node = sorted_nodes_[i];
+    const NodeSignature* signature = node->signature();
+    bool constant = signature->pure() && signature->event_listeners().empty() &&
+                    !signature->state_type();
+    for (size_t j = 0; constant && j < node->input_edges().size(); ++j) {
+      const InputEdge& edge = node->input_edges()[j];
+      if (edge.connected() &&
+          !edge.target().GetTargetNode(&nodes_).constant()) {
+        constant = false;
+      }
+    }
+    node->set_constant(constant);
+    if (!constant && !node->dead()) {
+      executed_nodes_.push_back(node);
+    }
+  }
+}
+
+// A node's level is one more than the highest level of any node it depends on,
+// and nodes with no connected inputs are on level zero. Since sorted_nodes_
+// lists dependencies before their dependents, a single pass is enough.
+void Graph::BuildExecutionLevels() {
+  std::vector<size_t> node_levels(nodes_.size(), 0);
+  execution_levels_.clear();
+  for (size_t i = 0; i < executed_nodes_.size(); ++i) {
+    Node* node = executed_nodes_[i];
+    size_t level = 0;
+    for (size_t j = 0; j < node->input_edges().size(); ++j) {
+      const InputEdge& edge = node->input_edges()[j];
+      // Constant nodes are never executed, so they can't hold anything up.
+      if (edge.connected() &&
+          !edge.target().GetTargetNode(&nodes_).constant()) {
+        level = std::max(level, node_levels[edge.target().node_index()] + 1);
+      }
+    }
+    node_levels[node - nodes_.data()] = level;
+    if (level >= execution_levels_.size()) {
+      execution_levels_.resize(level + 1);
+    }
+    execution_levels_[level].push_back(node);
+  }
+}
+
 static ptrdiff_t Align(ptrdiff_t ptr, size_t alignment) {
   // Alignment must be a power of 2.
   assert((alignment & (alignment - 1)) == 0);
@@ -144,30 +825,74 @@ static ptrdiff_t AdvanceOffset(ptrdiff_t* offset) {
   return AdvanceOffset(offset, sizeof(T), std::alignment_of<T>::value);
 }
 
+// Objects no bigger than this are considered hot by
+// kOutputBufferLayoutHotCold, so long as they have no destructor to run. This
+// is big enough for a four component vector of floats.
+static const size_t kMaxHotObjectSize = 16;
+
+static bool IsHotObject(const Type* type) {
+  return type->size <= kMaxHotObjectSize && type->trivially_destructible;
+}
+
+void Graph::AddOutputBufferObject(const Type* type, ptrdiff_t offset) {
+  // Void edges have no data at all.
+  if (type->size == 0) {
+    return;
+  }
+  OutputBufferObject object(type, offset);
+  if (!type->trivially_default_constructible) {
+    output_buffer_constructions_.push_back(object);
+  }
+  if (!type->trivially_destructible) {
+    output_buffer_destructions_.push_back(object);
+  }
+  if (!type->trivially_copyable) {
+    output_buffer_copies_.push_back(object);
+  }
+  if (!type->placement_copy_func) {
+    output_buffer_copyable_ = false;
+  }
+}
+
 bool Graph::FinalizeNodes() {
-  // Make sure each node has the proper number of output edges.
-  for (auto node = nodes_.begin(); node != nodes_.end(); ++node) {
+  // Make sure each node has the proper number of input edges.
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    Node* node = &nodes_[i];
     const NodeSignature* signature = node->signature();
-    node->output_edges().resize(signature->output_parameters().size());
+    if (signature->input_parameters().size() != node->input_edges().size()) {
+      CallLogFunc(
+          "Error in graph \"%s\": Node %d got %d edges, but expected %d",
+          graph_name_.c_str(), i, node->input_edges().size(),
+          signature->input_parameters().size());
+      return false;
+    }
   }
 
+  // Sort the nodes first, so that everything laid out below is in the order
+  // the nodes will be executed in.
+  if (!InlineSubgraphs() || !SortGraphNodes()) {
+    return false;
+  }
+  if (execution_order_ == kExecutionOrderGroupedBySignature) {
+    GroupNodesBySignature();
+  }
+  ReorderNodes();
+  BuildEdgeArrays();
+
   // Keep track of the offsets for the input edges and output edges.
   ptrdiff_t current_input_offset = 0;
   ptrdiff_t current_output_offset = 0;
 
+  // Keep track of the largest alignment needed by anything in each buffer.
+  size_t input_alignment = 1;
+  size_t output_alignment = std::alignment_of<Timestamp>::value;
+
   // Look at each node's input edge so we can mark the output edges that are in
   // use, and so that we know how much memory to allocate for the default
   // values.
   for (size_t i = 0; i < nodes_.size(); ++i) {
     Node* node = &nodes_[i];
     const NodeSignature* signature = node->signature();
-    if (signature->input_parameters().size() != node->input_edges().size()) {
-      CallLogFunc(
-          "Error in graph \"%s\": Node %d got %d edges, but expected %d",
-          graph_name_.c_str(), i, node->input_edges().size(),
-          signature->input_parameters().size());
-      return false;
-    }
     for (size_t j = 0; j < signature->input_parameters().size(); ++j) {
       InputEdge& input_edge = node->input_edges()[j];
 
@@ -182,15 +907,123 @@ bool Graph::FinalizeNodes() {
         // allocate it when our blob of memory has been allocated.
         const Type* type = signature->input_parameters()[j].type;
         ptrdiff_t data_offset = AdvanceOffset(&current_input_offset, type);
+        input_alignment = std::max(input_alignment, type->alignment);
         input_edge.SetDataOffset(data_offset);
       }
     }
   }
 
   // Now that we know how much space we're going to need, set the buffer size.
-  input_buffer_.Initialize(current_input_offset);
+  if (!input_buffer_.Initialize(current_input_offset, input_alignment,
+                                allocator_)) {
+    CallLogFunc("Error in graph \"%s\": Out of memory for default values.",
+                graph_name_.c_str());
+    return false;
+  }
 
-  // Construct the default values.
+  ConstructDefaultValues();
+  if (!CopySubgraphDefaultValues()) {
+    return false;
+  }
+  // Everything needed from the subgraphs has been copied, so they may now be
+  // unloaded.
+  for (auto subgraph = subgraphs_.begin(); subgraph != subgraphs_.end();
+       ++subgraph) {
+    subgraph->graph.reset();
+  }
+
+  // All the default values on the unconnected input nodes has been allocated.
+  // Now take care of the output nodes that are connected. Objects are placed
+  // in the order the nodes are executed in. With kOutputBufferLayoutHotCold,
+  // the first pass only places the timestamps and the hot objects, and the
+  // second pass places everything else after them.
+  const bool split = output_buffer_layout_ == kOutputBufferLayoutHotCold;
+  for (int pass = 0; pass < (split ? 2 : 1); ++pass) {
+    const bool hot_pass = pass == 0;
+    // Returns true if an object of the given type is placed in this pass.
+    auto in_pass = [split, hot_pass](const Type* type) {
+      return !split || IsHotObject(type) == hot_pass;
+    };
+    size_t listener_index = 0;
+    for (auto node = nodes_.begin(); node != nodes_.end(); ++node) {
+      if (hot_pass) {
+        ptrdiff_t node_timestamp_offset =
+            AdvanceOffset<Timestamp>(&current_output_offset);
+        node->set_timestamp_offset(node_timestamp_offset);
+      }
+
+      const NodeSignature* signature = node->signature();
+      for (size_t i = 0; i < signature->output_parameters().size(); ++i) {
+        OutputEdge& output_edge = node->output_edges()[i];
+        if (!output_edge.connected()) {
+          continue;
+        }
+        // Every consumer checks the timestamp, so it is always hot.
+        if (hot_pass) {
+          ptrdiff_t timestamp_offset =
+              AdvanceOffset<Timestamp>(&current_output_offset);
+          output_edge.set_timestamp_offset(timestamp_offset);
+        }
+        const Type* type = signature->output_parameters()[i].type;
+        if (in_pass(type)) {
+          // An output that holds the value of a connected input shares the
+          // storage of the edge feeding that input, which has already been
+          // placed since it belongs to an earlier node.
+          int alias = signature->output_alias(i);
+          if (alias >= 0 && node->input_edges()[alias].connected()) {
+            const OutputEdge& source_edge =
+                node->input_edges()[alias].target().GetTargetEdge(&nodes_);
+            output_edge.set_aliased(true);
+            output_edge.set_data_offset(source_edge.data_offset());
+          } else {
+            ptrdiff_t data_offset =
+                AdvanceOffset(&current_output_offset, type);
+            output_alignment = std::max(output_alignment, type->alignment);
+            output_edge.set_data_offset(data_offset);
+          }
+        }
+      }
+
+      // Initialize the listener offsets. Listeners are only touched when an
+      // event is broadcast, so they are cold.
+      for (size_t i = 0; i < signature->event_listeners().size(); ++i) {
+        if (!split || !hot_pass) {
+          ptrdiff_t listener_offset =
+              AdvanceOffset<NodeEventListener>(&current_output_offset);
+          output_alignment = std::max(
+              output_alignment, std::alignment_of<NodeEventListener>::value);
+          listener_offsets_[listener_index] = listener_offset;
+        }
+        ++listener_index;
+      }
+
+      // Make room for the node's per-instance state, if it has any.
+      const Type* state_type = signature->state_type();
+      if (state_type && in_pass(state_type)) {
+        ptrdiff_t state_offset =
+            AdvanceOffset(&current_output_offset, state_type);
+        output_alignment = std::max(output_alignment, state_type->alignment);
+        node->set_state_offset(state_offset);
+      }
+    }
+  }
+
+  output_buffer_size_ = current_output_offset;
+  output_buffer_alignment_ = output_alignment;
+
+  BuildOutputBufferObjects();
+  AnalyzeNodes();
+  if (!ConstructBaseNodes()) {
+    CallLogFunc("Error in graph \"%s\": Out of memory for nodes.",
+                graph_name_.c_str());
+    return false;
+  }
+
+  nodes_finalized_ = true;
+  return true;
+}
+
+void Graph::ConstructDefaultValues() {
   for (auto node = nodes_.begin(); node != nodes_.end(); ++node) {
     const NodeSignature* signature = node->signature();
     for (size_t i = 0; i < signature->input_parameters().size(); ++i) {
@@ -199,50 +1032,392 @@ bool Graph::FinalizeNodes() {
         // If not connected, it has a default value.
         const Type* type = signature->input_parameters()[i].type;
         assert(type);
-        if (type->size > 0) {
+        // The buffer starts out zeroed, so trivial types need no constructor.
+        if (type->size > 0 && !type->trivially_default_constructible) {
           uint8_t* ptr = input_buffer_.GetObjectPtr(input_edge.data_offset());
           type->placement_new_func(ptr);
         }
       }
     }
   }
+}
 
-  // All the default values on the unconnected input nodes has been allocated.
-  // Now take care of the output nodes that are connected.
+void Graph::BuildOutputBufferObjects() {
+  output_buffer_copyable_ = true;
+  output_buffer_constructions_.clear();
+  output_buffer_destructions_.clear();
+  output_buffer_copies_.clear();
   for (auto node = nodes_.begin(); node != nodes_.end(); ++node) {
-    ptrdiff_t node_timestamp_offset =
-        AdvanceOffset<Timestamp>(&current_output_offset);
-    node->set_timestamp_offset(node_timestamp_offset);
-
     const NodeSignature* signature = node->signature();
     for (size_t i = 0; i < signature->output_parameters().size(); ++i) {
-      OutputEdge& output_edge = node->output_edges()[i];
-      if (output_edge.connected()) {
-        const Type* type = signature->output_parameters()[i].type;
-        ptrdiff_t timestamp_offset =
-            AdvanceOffset<Timestamp>(&current_output_offset);
-        ptrdiff_t data_offset = AdvanceOffset(&current_output_offset, type);
-        output_edge.set_timestamp_offset(timestamp_offset);
-        output_edge.set_data_offset(data_offset);
+      const OutputEdge& output_edge = node->output_edges()[i];
+      if (output_edge.connected() && !output_edge.aliased()) {
+        AddOutputBufferObject(signature->output_parameters()[i].type,
+                              output_edge.data_offset());
       }
     }
-
-    // Initialize the listener offsets.
-    for (size_t i = 0; i < signature->event_listeners().size(); ++i) {
-      ptrdiff_t listener_offset =
-          AdvanceOffset<NodeEventListener>(&current_output_offset);
-      node->listener_offsets().push_back(listener_offset);
+    const Type* state_type = signature->state_type();
+    if (state_type) {
+      AddOutputBufferObject(state_type, node->state_offset());
     }
   }
+}
 
-  output_buffer_size_ = current_output_offset;
+void Graph::AnalyzeNodes() {
+  FindDeadNodes();
+  FindConstantNodes();
+  BuildExecutionLevels();
+  BuildConsumerLists();
+  AssignDirtyBits();
+  BuildResolvedInputEdges();
+  BuildDirtyMasks();
+}
 
-  if (!SortGraphNodes()) {
+bool Graph::ConstructBaseNodes() {
+  // Give each signature a run of the buffer big enough for all of its nodes,
+  // in the order the signatures are first executed.
+  std::vector<const NodeSignature*> signatures;
+  std::unordered_map<const NodeSignature*, size_t> counts;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const NodeSignature* signature = nodes_[i].signature();
+    if (signature->placement_new_func() && counts[signature]++ == 0) {
+      signatures.push_back(signature);
+    }
+  }
+  std::unordered_map<const NodeSignature*, ptrdiff_t> offsets;
+  size_t size = 0;
+  size_t alignment = 1;
+  for (size_t i = 0; i < signatures.size(); ++i) {
+    const NodeSignature* signature = signatures[i];
+    size_t signature_alignment = signature->base_node_alignment();
+    size = (size + signature_alignment - 1) & ~(signature_alignment - 1);
+    offsets[signature] = size;
+    size += signature->base_node_size() * counts[signature];
+    alignment = std::max(alignment, signature_alignment);
+  }
+  if (!base_node_buffer_.Initialize(size, alignment, allocator_)) {
     return false;
   }
 
-  nodes_finalized_ = true;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    Node* node = &nodes_[i];
+    const NodeSignature* signature = node->signature();
+    NodePlacementNewFunc placement_new_func = signature->placement_new_func();
+    if (placement_new_func) {
+      ptrdiff_t& offset = offsets[signature];
+      node->set_base_node(
+          placement_new_func(base_node_buffer_.GetObjectPtr(offset)));
+      offset += signature->base_node_size();
+    } else {
+      node->set_base_node(signature->Constructor());
+    }
+  }
   return true;
 }
 
+void Graph::DestroyBaseNodes() {
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    Node* node = &nodes_[i];
+    BaseNode* base_node = node->base_node();
+    if (!base_node) {
+      continue;
+    }
+    const NodeSignature* signature = node->signature();
+    if (signature->placement_new_func()) {
+      base_node->~BaseNode();
+    } else {
+      signature->Destructor(base_node);
+    }
+    node->set_base_node(nullptr);
+  }
+}
+
+template <typename T>
+static size_t VectorMemoryUsage(const std::vector<T>& vector) {
+  return vector.capacity() * sizeof(T);
+}
+
+size_t Graph::memory_usage() const {
+  size_t usage = sizeof(*this) + graph_name_.capacity();
+  usage += VectorMemoryUsage(nodes_);
+  usage += VectorMemoryUsage(sorted_nodes_);
+  usage += VectorMemoryUsage(executed_nodes_);
+  usage += VectorMemoryUsage(node_positions_);
+  usage += VectorMemoryUsage(execution_levels_);
+  for (size_t i = 0; i < execution_levels_.size(); ++i) {
+    usage += VectorMemoryUsage(execution_levels_[i]);
+  }
+  usage += VectorMemoryUsage(resolved_input_edges_);
+  usage += VectorMemoryUsage(output_edges_);
+  usage += VectorMemoryUsage(listener_offsets_);
+  usage += VectorMemoryUsage(consumers_);
+  usage += VectorMemoryUsage(dirty_masks_);
+  usage += VectorMemoryUsage(subgraphs_);
+  for (size_t i = 0; i < subgraphs_.size(); ++i) {
+    usage += VectorMemoryUsage(subgraphs_[i].inputs);
+    usage += VectorMemoryUsage(subgraphs_[i].outputs);
+  }
+  usage += VectorMemoryUsage(output_buffer_constructions_);
+  usage += VectorMemoryUsage(output_buffer_destructions_);
+  usage += VectorMemoryUsage(output_buffer_copies_);
+  usage += input_buffer_.size();
+  usage += base_node_buffer_.size();
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const Node& node = nodes_[i];
+    usage += VectorMemoryUsage(node.input_edges());
+    if (!nodes_finalized_) {
+      continue;
+    }
+    const NodeSignature* signature = node.signature();
+    for (size_t j = 0; j < node.input_edges().size(); ++j) {
+      const InputEdge& edge = node.input_edges()[j];
+      const Type* type = signature->input_parameters()[j].type;
+      if (!edge.connected() && type->memory_usage_func) {
+        usage += type->memory_usage_func(
+            input_buffer_.GetObjectPtr(edge.data_offset()));
+      }
+    }
+  }
+  return usage;
+}
+
+void Graph::GetMemoryStats(MemoryStats* stats) const {
+  size_t usage = memory_usage();
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const Node& node = nodes_[i];
+    const NodeSignature* signature = node.signature();
+    size_t base_node_size = signature->base_node_size();
+    size_t node_usage = sizeof(Node) + base_node_size +
+                        VectorMemoryUsage(node.input_edges()) +
+                        node.output_edges().size() * sizeof(OutputEdge) +
+                        node.listener_offsets().size() * sizeof(ptrdiff_t);
+    usage += base_node_size;
+    stats->base_node_bytes += base_node_size;
+    if (nodes_finalized_) {
+      node_usage += node.input_edges().size() * sizeof(ResolvedInputEdge);
+      for (size_t j = 0; j < node.input_edges().size(); ++j) {
+        const InputEdge& edge = node.input_edges()[j];
+        if (edge.connected()) {
+          continue;
+        }
+        const Type* type = signature->input_parameters()[j].type;
+        size_t heap_usage =
+            type->memory_usage_func
+                ? type->memory_usage_func(
+                      input_buffer_.GetObjectPtr(edge.data_offset()))
+                : 0;
+        stats->heap_value_bytes += heap_usage;
+        stats->AddTypeBytes(type, type->size + heap_usage);
+        node_usage += type->size + heap_usage;
+      }
+    }
+    stats->AddNodeBytes(signature, node_usage);
+  }
+  stats->graph_bytes += usage;
+  stats->total_bytes += usage;
+}
+
+void Graph::AddGraphState(GraphState* graph_state) {
+  std::lock_guard<std::mutex> lock(graph_states_mutex_);
+  graph_state->graph_state_index_ = graph_states_.size();
+  graph_states_.push_back(graph_state);
+}
+
+void Graph::RemoveGraphState(GraphState* graph_state) {
+  std::lock_guard<std::mutex> lock(graph_states_mutex_);
+  // Fill the gap with the last GraphState so that removal takes constant
+  // time, even when thousands of instances are destroyed at once.
+  size_t index = graph_state->graph_state_index_;
+  assert(index < graph_states_.size() && graph_states_[index] == graph_state);
+  graph_states_[index] = graph_states_.back();
+  graph_states_[index]->graph_state_index_ = index;
+  graph_states_.pop_back();
+  if (reloading_) {
+    removed_graph_states_.push_back(graph_state);
+  }
+}
+
+bool Graph::WasGraphStateRemoved(GraphState* graph_state) const {
+  std::lock_guard<std::mutex> lock(graph_states_mutex_);
+  return std::find(removed_graph_states_.begin(), removed_graph_states_.end(),
+                   graph_state) != removed_graph_states_.end();
+}
+
+// Returns the order in which each node was added, given the position that
+// each node in that order was moved to.
+static std::vector<unsigned int> InvertPositions(
+    const std::vector<unsigned int>& positions) {
+  std::vector<unsigned int> order(positions.size());
+  for (size_t i = 0; i < positions.size(); ++i) {
+    if (positions[i] != kInvalidNodeIndex) {
+      order[positions[i]] = static_cast<unsigned int>(i);
+    }
+  }
+  return order;
+}
+
+static bool IsMovable(const Type* type) {
+  return type->size == 0 || type->placement_move_func != nullptr;
+}
+
+void Graph::MatchNodes(const Graph& replacement,
+                       std::vector<unsigned int>* matches) const {
+  matches->assign(replacement.nodes_.size(), kInvalidNodeIndex);
+  std::vector<unsigned int> order = InvertPositions(node_positions_);
+  std::vector<unsigned int> replacement_order =
+      InvertPositions(replacement.node_positions_);
+  size_t count =
+      std::min(node_positions_.size(), replacement.node_positions_.size());
+  for (size_t i = 0; i < count; ++i) {
+    unsigned int position = node_positions_[i];
+    unsigned int replacement_position = replacement.node_positions_[i];
+    // Subgraph nodes have been replaced by their contents.
+    if (position == kInvalidNodeIndex ||
+        replacement_position == kInvalidNodeIndex) {
+      continue;
+    }
+    const Node& node = nodes_[position];
+    const Node& replacement_node = replacement.nodes_[replacement_position];
+    const NodeSignature* signature = node.signature();
+    if (signature != replacement_node.signature()) {
+      continue;
+    }
+
+    bool unchanged = true;
+    for (size_t j = 0; unchanged && j < node.input_edges().size(); ++j) {
+      const InputEdge& edge = node.input_edges()[j];
+      const InputEdge& replacement_edge = replacement_node.input_edges()[j];
+      if (edge.connected() != replacement_edge.connected()) {
+        unchanged = false;
+      } else if (edge.connected()) {
+        // Connections are compared by the order in which the nodes were
+        // added, since the sorted order may have changed.
+        const OutputEdgeTarget& target = edge.target();
+        const OutputEdgeTarget& replacement_target = replacement_edge.target();
+        unchanged = order[target.node_index()] ==
+                        replacement_order[replacement_target.node_index()] &&
+                    target.edge_index() == replacement_target.edge_index();
+      } else {
+        const Type* type = signature->input_parameters()[j].type;
+        unchanged =
+            type->size == 0 ||
+            (type->equality_func &&
+             type->equality_func(
+                 input_buffer_.GetObjectPtr(edge.data_offset()),
+                 replacement.input_buffer_.GetObjectPtr(
+                     replacement_edge.data_offset())));
+      }
+    }
+    // An output that nothing read before has no value to keep, and values
+    // that can't be moved can't be kept either.
+    for (size_t j = 0; unchanged && j < node.output_edges().size(); ++j) {
+      unchanged = !replacement_node.output_edges()[j].connected() ||
+                  (node.output_edges()[j].connected() &&
+                   IsMovable(signature->output_parameters()[j].type));
+    }
+    const Type* state_type = signature->state_type();
+    unchanged = unchanged && (!state_type || IsMovable(state_type));
+    if (unchanged) {
+      (*matches)[replacement_position] = position;
+    }
+  }
+
+  // Constant nodes are only executed when they are initialized, so one that
+  // reads from a changed node has to be initialized again to see the new
+  // value. Nodes are visited in sorted order so that this carries on down
+  // chains of constant nodes.
+  for (size_t i = 0; i < replacement.nodes_.size(); ++i) {
+    const Node& node = replacement.nodes_[i];
+    if ((*matches)[i] == kInvalidNodeIndex || !node.constant()) {
+      continue;
+    }
+    for (size_t j = 0; j < node.input_edges().size(); ++j) {
+      const InputEdge& edge = node.input_edges()[j];
+      if (edge.connected() &&
+          (*matches)[edge.target().node_index()] == kInvalidNodeIndex) {
+        (*matches)[i] = kInvalidNodeIndex;
+        break;
+      }
+    }
+  }
+}
+
+void Graph::SwapNodes(Graph* other) {
+  // Swapping the vectors keeps their elements where they are, so the
+  // pointers between nodes, edges and levels all remain valid.
+  nodes_.swap(other->nodes_);
+  sorted_nodes_.swap(other->sorted_nodes_);
+  executed_nodes_.swap(other->executed_nodes_);
+  node_positions_.swap(other->node_positions_);
+  execution_levels_.swap(other->execution_levels_);
+  resolved_input_edges_.swap(other->resolved_input_edges_);
+  output_edges_.swap(other->output_edges_);
+  listener_offsets_.swap(other->listener_offsets_);
+  consumers_.swap(other->consumers_);
+  subgraphs_.swap(other->subgraphs_);
+  {
+    std::lock(subgraph_signature_mutex_, other->subgraph_signature_mutex_);
+    std::lock_guard<std::mutex> lock(subgraph_signature_mutex_,
+                                     std::adopt_lock);
+    std::lock_guard<std::mutex> other_lock(other->subgraph_signature_mutex_,
+                                           std::adopt_lock);
+    subgraph_inputs_.swap(other->subgraph_inputs_);
+    subgraph_outputs_.swap(other->subgraph_outputs_);
+    subgraph_signature_.swap(other->subgraph_signature_);
+  }
+  input_buffer_.Swap(&other->input_buffer_);
+  base_node_buffer_.Swap(&other->base_node_buffer_);
+  std::swap(output_buffer_size_, other->output_buffer_size_);
+  std::swap(output_buffer_alignment_, other->output_buffer_alignment_);
+  std::swap(output_buffer_layout_, other->output_buffer_layout_);
+  std::swap(execution_order_, other->execution_order_);
+  std::swap(dirty_tracking_, other->dirty_tracking_);
+  std::swap(dirty_bit_count_, other->dirty_bit_count_);
+  dirty_masks_.swap(other->dirty_masks_);
+  std::swap(generated_execute_func_, other->generated_execute_func_);
+  std::swap(output_buffer_copyable_, other->output_buffer_copyable_);
+  output_buffer_constructions_.swap(other->output_buffer_constructions_);
+  output_buffer_destructions_.swap(other->output_buffer_destructions_);
+  output_buffer_copies_.swap(other->output_buffer_copies_);
+  std::swap(nodes_finalized_, other->nodes_finalized_);
+}
+
+void Graph::Reload(Graph* replacement) {
+  assert(nodes_finalized_ && replacement->nodes_finalized_);
+  assert(replacement->graph_states_.empty());
+  std::vector<unsigned int> matches;
+  MatchNodes(*replacement, &matches);
+
+  // Nodes are free to create and destroy GraphStates while they initialize,
+  // so work from a copy of the list rather than holding the lock throughout,
+  // and skip any GraphState that has been destroyed since the copy was made.
+  std::vector<GraphState*> graph_states;
+  {
+    std::lock_guard<std::mutex> lock(graph_states_mutex_);
+    graph_states = graph_states_;
+    reloading_ = true;
+  }
+  // First move the values that are kept into output buffers laid out for the
+  // new nodes, while the old layout is still around to read them from.
+  for (size_t i = 0; i < graph_states.size(); ++i) {
+    if (WasGraphStateRemoved(graph_states[i])) {
+      continue;
+    }
+    graph_states[i]->MigrateOutputBuffer(*replacement, matches);
+  }
+  SwapNodes(replacement);
+  ++reload_count_;
+  // Then initialize the new and changed nodes, which may run arbitrary code,
+  // now that every GraphState is consistent with the new nodes.
+  for (size_t i = 0; i < graph_states.size(); ++i) {
+    if (WasGraphStateRemoved(graph_states[i])) {
+      continue;
+    }
+    graph_states[i]->InitializeChangedNodes(matches);
+  }
+  std::lock_guard<std::mutex> lock(graph_states_mutex_);
+  reloading_ = false;
+  removed_graph_states_.clear();
+}
+
 }  // namespace breadboard
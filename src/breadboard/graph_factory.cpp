@@ -14,32 +14,337 @@
 
 #include "breadboard/graph_factory.h"
 
+#include <cassert>
 #include <string>
+#include <vector>
 
 #include "breadboard/graph.h"
+#include "breadboard/log.h"
 #include "breadboard/module_registry.h"
 
 namespace breadboard {
 
+// The files being parsed on this thread, innermost first, so that graphs that
+// use themselves as subgraphs can be caught.
+struct ParseFrame {
+  const GraphFactory* factory;
+  const std::string* filename;
+  const ParseFrame* parent;
+};
+
+static thread_local const ParseFrame* g_parse_frame = nullptr;
+
+GraphFactory::~GraphFactory() { WaitForPendingGraphs(); }
+
 Graph* GraphFactory::LoadGraph(const char* filename) {
-  // Have we loaded this flatbuffer already?
-  auto iter = loaded_graphs_.find(filename);
-  if (iter != loaded_graphs_.end()) {
-    // If so, return the cached graph.
-    return iter->second.get();
-  } else {
-    // If not, load it and return it.
-    std::string data;
-    if (!load_file_callback_(filename, &data)) {
-      return nullptr;
+  {
+    // Have we loaded this graph already? If so, return the cached graph.
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = loaded_graphs_.find(filename);
+    if (iter != loaded_graphs_.end()) {
+      TouchGraph(&iter->second);
+      pinned_graphs_.insert(filename);
+      return iter->second.graph.get();
+    }
+  }
+  // If not, load it on this thread, or wait for the load already underway.
+  return RequestGraph(filename, nullptr, true).get();
+}
+
+GraphHandle GraphFactory::AcquireGraph(const char* filename) {
+  // Another thread loading a graph may evict this one between it being loaded
+  // and the handle being taken, in which case it is loaded again.
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto iter = loaded_graphs_.find(filename);
+      if (iter != loaded_graphs_.end()) {
+        TouchGraph(&iter->second);
+        return iter->second.graph;
+      }
+    }
+    if (!RequestGraph(filename, nullptr, false).get()) {
+      return GraphHandle();
+    }
+  }
+}
+
+std::shared_future<Graph*> GraphFactory::LoadGraphAsync(const char* filename) {
+  return RequestGraph(filename, job_system_, true);
+}
+
+bool GraphFactory::ReloadGraph(const char* filename) {
+  GraphHandle graph;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = loaded_graphs_.find(filename);
+    if (iter != loaded_graphs_.end()) {
+      // Holding a handle keeps the graph from being evicted meanwhile.
+      graph = iter->second.graph;
+    }
+  }
+  if (!graph) {
+    return AcquireGraph(filename) != nullptr;
+  }
+  Graph replacement(filename);
+  replacement.set_allocator(graph->allocator());
+  replacement.set_dirty_tracking(graph->dirty_tracking());
+  if (!LoadAndParse(filename, &replacement, false)) {
+    CallLogFunc("Could not reload graph \"%s\". Keeping the previous version.",
+                filename);
+    return false;
+  }
+  graph->Reload(&replacement);
+  size_t memory_usage = graph->memory_usage();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = loaded_graphs_.find(filename);
+    if (iter != loaded_graphs_.end()) {
+      memory_usage_ += memory_usage - iter->second.memory_usage;
+      iter->second.memory_usage = memory_usage;
     }
-    Graph* graph = new Graph(filename);
-    if (!ParseData(module_registry_, graph, &data)) {
+  }
+  return true;
+}
+
+Node* GraphFactory::AddSubgraph(Graph* graph, const char* filename) {
+  for (const ParseFrame* frame = g_parse_frame; frame; frame = frame->parent) {
+    if (frame->factory == this && *frame->filename == filename) {
+      CallLogFunc("Could not load graph \"%s\": It uses itself as a subgraph.",
+                  filename);
       return nullptr;
     }
-    loaded_graphs_[filename].reset(graph);
-    return graph;
   }
+  GraphHandle subgraph;
+  bool pending = false;
+  std::unique_ptr<std::promise<Graph*>> promise;
+  {
+    // Look for the graph and start loading it under one lock, so that no load
+    // of it can be started on another thread in between.
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = loaded_graphs_.find(filename);
+    if (iter != loaded_graphs_.end()) {
+      TouchGraph(&iter->second);
+      subgraph = iter->second.graph;
+    } else if (pending_graphs_.count(filename) > 0) {
+      pending = true;
+    } else {
+      promise.reset(new std::promise<Graph*>());
+      pending_graphs_[filename] = promise->get_future().share();
+    }
+  }
+  if (pending) {
+    // The load may be queued on the same JobSystem this is running on, and
+    // waiting for it from one of its jobs could deadlock, so parse the file
+    // again instead.
+    subgraph.reset(new Graph(filename));
+    subgraph->set_allocator(allocator_);
+    if (!LoadAndParse(filename, subgraph.get(), true)) {
+      subgraph.reset();
+    }
+  } else if (promise) {
+    subgraph = LoadPendingGraph(filename, promise.get());
+  }
+  if (!subgraph) {
+    CallLogFunc("Could not load subgraph \"%s\".", filename);
+    return nullptr;
+  }
+  return graph->AddSubgraph(subgraph);
+}
+
+void GraphFactory::WaitForPendingGraphs() {
+  std::vector<std::shared_future<Graph*>> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto iter = pending_graphs_.begin(); iter != pending_graphs_.end();
+         ++iter) {
+      pending.push_back(iter->second);
+    }
+  }
+  for (size_t i = 0; i < pending.size(); ++i) {
+    pending[i].wait();
+  }
+}
+
+std::shared_future<Graph*> GraphFactory::RequestGraph(
+    const std::string& filename, JobSystem* job_system, bool pin) {
+  std::shared_ptr<std::promise<Graph*>> promise =
+      std::make_shared<std::promise<Graph*>>();
+  std::shared_future<Graph*> future = promise->get_future().share();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pin) {
+      pinned_graphs_.insert(filename);
+    }
+    auto loaded = loaded_graphs_.find(filename);
+    if (loaded != loaded_graphs_.end()) {
+      TouchGraph(&loaded->second);
+      promise->set_value(loaded->second.graph.get());
+      return future;
+    }
+    auto pending = pending_graphs_.find(filename);
+    if (pending != pending_graphs_.end()) {
+      return pending->second;
+    }
+    pending_graphs_[filename] = future;
+  }
+  if (job_system) {
+    job_system->Submit([this, filename, promise]() {
+      LoadPendingGraph(filename, promise.get());
+    });
+  } else {
+    LoadPendingGraph(filename, promise.get());
+  }
+  return future;
+}
+
+GraphHandle GraphFactory::LoadPendingGraph(const std::string& filename,
+                                           std::promise<Graph*>* promise) {
+  GraphHandle graph(new Graph(filename));
+  graph->set_allocator(allocator_);
+  if (!LoadAndParse(filename, graph.get(), true)) {
+    graph.reset();
+  }
+  GraphHandle result = graph;
+  {
+    // Graphs that failed to load are not cached, so that they may be retried.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (graph) {
+      CachedGraph& cached_graph = loaded_graphs_[filename];
+      cached_graph.memory_usage = graph->memory_usage();
+      cached_graph.graph = std::move(graph);
+      cached_graph.lru_position = lru_list_.insert(lru_list_.begin(), filename);
+      memory_usage_ += cached_graph.memory_usage;
+      if (memory_budget_ > 0) {
+        EvictGraphs(memory_budget_, filename, false);
+      }
+    } else {
+      pinned_graphs_.erase(filename);
+    }
+    pending_graphs_.erase(filename);
+  }
+  promise->set_value(result.get());
+  return result;
+}
+
+void GraphFactory::set_memory_budget(size_t memory_budget) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  memory_budget_ = memory_budget;
+  if (memory_budget_ > 0) {
+    EvictGraphs(memory_budget_, std::string(), false);
+  }
+}
+
+size_t GraphFactory::memory_budget() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return memory_budget_;
+}
+
+size_t GraphFactory::memory_usage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return memory_usage_;
+}
+
+void GraphFactory::GetMemoryStats(MemoryStats* stats) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t usage = sizeof(*this);
+  for (auto iter = loaded_graphs_.begin(); iter != loaded_graphs_.end();
+       ++iter) {
+    // The filename is held both as the key of the map entry and in the LRU
+    // list.
+    usage += sizeof(GraphMap::value_type) + sizeof(std::string) +
+             2 * iter->first.capacity();
+    iter->second.graph->GetMemoryStats(stats);
+  }
+  stats->graph_factory_bytes += usage;
+  stats->total_bytes += usage;
+}
+
+void GraphFactory::EvictUnusedGraphs() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  EvictGraphs(0, std::string(), true);
+}
+
+void GraphFactory::TouchGraph(CachedGraph* cached_graph) {
+  lru_list_.splice(lru_list_.begin(), lru_list_, cached_graph->lru_position);
+}
+
+void GraphFactory::EvictGraphs(size_t memory_limit, const std::string& keep,
+                               bool evict_pinned) {
+  auto position = lru_list_.end();
+  while (memory_usage_ > memory_limit && position != lru_list_.begin()) {
+    --position;
+    auto iter = loaded_graphs_.find(*position);
+    assert(iter != loaded_graphs_.end());
+    const CachedGraph& cached_graph = iter->second;
+    // Handles are only handed out while the mutex is held, so a graph that
+    // has none now can't gain one before it is destroyed.
+    if (*position == keep || cached_graph.graph.use_count() > 1 ||
+        cached_graph.graph->graph_state_count() > 0 ||
+        (!evict_pinned && pinned_graphs_.count(*position) > 0)) {
+      continue;
+    }
+    pinned_graphs_.erase(*position);
+    memory_usage_ -= cached_graph.memory_usage;
+    loaded_graphs_.erase(iter);
+    position = lru_list_.erase(position);
+  }
+}
+
+void GraphFactory::RegisterGeneratedGraph(const char* filename,
+                                          GeneratedGraphLoader loader) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  generated_graphs_[filename] = loader;
+}
+
+bool GraphFactory::LoadAndParse(const std::string& filename, Graph* graph,
+                                bool use_generated) {
+  if (use_generated) {
+    GeneratedGraphLoader loader = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto iter = generated_graphs_.find(filename);
+      if (iter != generated_graphs_.end()) {
+        loader = iter->second;
+      }
+    }
+    if (loader) {
+      return loader(module_registry_, graph);
+    }
+  }
+  ParseFrame frame = {this, &filename, g_parse_frame};
+  g_parse_frame = &frame;
+  bool result = LoadAndParseFile(filename, graph);
+  g_parse_frame = frame.parent;
+  return result;
+}
+
+bool GraphFactory::LoadAndParseFile(const std::string& filename,
+                                    Graph* graph) {
+  if (load_file_view_callback_) {
+    FileView view;
+    if (!load_file_view_callback_(filename.c_str(), &view)) {
+      return false;
+    }
+    bool result =
+        ParseDataView(module_registry_, graph, view.data, view.size);
+    if (view.release) {
+      view.release(&view);
+    }
+    return result;
+  }
+  std::string data;
+  if (!load_file_callback_(filename.c_str(), &data)) {
+    return false;
+  }
+  return ParseData(module_registry_, graph, &data);
+}
+
+bool GraphFactory::ParseDataView(ModuleRegistry* module_registry,
+                                 Graph* graph, const uint8_t* data,
+                                 size_t size) {
+  std::string copy(reinterpret_cast<const char*>(data), size);
+  return ParseData(module_registry, graph, &copy);
 }
 
 }  // namespace breadboard
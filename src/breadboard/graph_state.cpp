@@ -14,114 +14,868 @@
 
 #include "breadboard/graph_state.h"
 
+#include <algorithm>
+#include <cstring>
 #include <new>
 #include <set>
 #include <type_traits>
 
 #include "breadboard/base_node.h"
+#include "breadboard/event_dispatcher.h"
+#include "breadboard/generated_graph.h"
+#include "breadboard/graph_state_scheduler.h"
+#include "breadboard/graph_world.h"
+#include "breadboard/timer_wheel.h"
 
 namespace breadboard {
 
 GraphState::~GraphState() {
-  // Destruct the per-graph values.
+  if (pending_event_dispatcher_) {
+    pending_event_dispatcher_->RemovePendingGraphState(this);
+  }
+  if (scheduler_) {
+    scheduler_->RemoveGraphState(this);
+  }
+  if (world_) {
+    world_->RemoveGraphState(this);
+  }
+
+  if (graph_) {
+    graph_->RemoveGraphState(this);
+    DestroyOutputBufferObjects(&output_buffer_);
+  }
+}
+
+bool GraphState::Initialize(Graph* graph) {
+  assert(graph->nodes_finalized());
+  if (!InitializeOutputBuffer(*graph)) {
+    return false;
+  }
+  graph_ = graph;
+  graph_->AddGraphState(this);
+  dirty_node_queue_.Initialize(graph_->sorted_nodes().size());
+  ResolveDefaultValues(*graph_);
+
+  // The buffer starts out zeroed, which takes care of the timestamps and of
+  // every object with a trivial default constructor. Only the rest need to
+  // have their constructors run.
+  const std::vector<OutputBufferObject>& constructions =
+      graph_->output_buffer_constructions();
+  for (size_t i = 0; i < constructions.size(); ++i) {
+    uint8_t* ptr = output_buffer_.GetObjectPtr(constructions[i].offset);
+    constructions[i].type->placement_new_func(ptr);
+  }
+  for (auto node = graph_->nodes().begin(); node != graph_->nodes().end();
+       ++node) {
+    InitializeListeners(*node);
+  }
+
+  if (lazy_initialization_) {
+    deferred_initializations_.assign(graph_->sorted_nodes().size(), 0);
+  }
+  for (size_t i = 0; i < graph_->sorted_nodes().size(); ++i) {
+    Node* node = graph_->sorted_nodes()[i];
+    if (ShouldDeferInitialize(*node)) {
+      deferred_initializations_[i] = 1;
+      ++deferred_initialization_count_;
+      continue;
+    }
+    NodeArguments args(node, &graph_->nodes(), &graph_->input_buffer(),
+                       &output_buffer_, timestamp_);
+    args.set_default_values(default_values());
+    node->base_node()->Initialize(&args);
+    if (node->constant() && !node->dead()) {
+      // Constant nodes are skipped by Execute, so this is the one chance they
+      // get to compute their outputs.
+      node->Execute(&args);
+    }
+  }
+  // Anything broadcast during initialization belongs to the old timestamp.
+  dirty_node_queue_.Clear();
+  ++timestamp_;
+  RebuildDirtyBits(*graph_);
+  if (execution_mode_ == kExecutionModePull) {
+    evaluated_timestamps_.assign(graph_->sorted_nodes().size(), 0);
+  }
+  return true;
+}
+
+bool GraphState::InitializeFromPrototype(const GraphState& prototype) {
+  assert(prototype.IsInitialized());
+  Graph* graph = prototype.graph_;
+  if (!graph->output_buffer_copyable()) {
+    CallLogFunc(
+        "Could not copy an instance of graph \"%s\": It holds a type that "
+        "can not be copied.",
+        graph->graph_name().c_str());
+    return false;
+  }
+  if (!InitializeOutputBuffer(*graph)) {
+    return false;
+  }
+  graph_ = graph;
+  graph_->AddGraphState(this);
+  timestamp_ = prototype.timestamp_;
+  if (!timer_wheel_) {
+    timer_wheel_ = prototype.timer_wheel_;
+  }
+  execution_pending_ = prototype.execution_pending_;
+  execution_position_ = prototype.execution_position_;
+  deferred_nodes_ = prototype.deferred_nodes_;
+  // The values copied from the prototype were computed from its overlay.
+  default_value_overlay_ = prototype.default_value_overlay_;
+  default_values_ = prototype.default_values_;
+  // Nodes the prototype has not initialized yet are not initialized in the
+  // copy either.
+  lazy_initialization_ = prototype.lazy_initialization_;
+  deferred_initializations_ = prototype.deferred_initializations_;
+  deferred_initialization_count_ =
+      prototype.deferred_initialization_count_.load();
+  dirty_node_queue_.Initialize(graph_->sorted_nodes().size());
+
+  // Copy the whole buffer in one go, then copy construct the objects that
+  // can't be copied bytewise over the top. Listeners are rebuilt below.
+  const MemoryBuffer& source = prototype.output_buffer_;
+  if (output_buffer_.size() > 0) {
+    memcpy(output_buffer_.GetObjectPtr(0), source.GetObjectPtr(0),
+           output_buffer_.size());
+  }
+  const std::vector<OutputBufferObject>& copies =
+      graph_->output_buffer_copies();
+  for (size_t i = 0; i < copies.size(); ++i) {
+    ptrdiff_t offset = copies[i].offset;
+    copies[i].type->placement_copy_func(output_buffer_.GetObjectPtr(offset),
+                                        source.GetObjectPtr(offset));
+  }
+
+  for (auto node = graph_->nodes().begin(); node != graph_->nodes().end();
+       ++node) {
+    InitializeListeners(*node);
+    for (size_t i = 0; i < node->listener_offsets().size(); ++i) {
+      ptrdiff_t listener_offset = node->listener_offsets()[i];
+      const NodeEventListener* prototype_listener =
+          source.GetObject<NodeEventListener>(listener_offset);
+      CopyListenerBinding(
+          *prototype_listener,
+          output_buffer_.GetObject<NodeEventListener>(listener_offset));
+    }
+  }
+  RebuildDirtyBits(*graph_);
+  if (execution_mode_ == kExecutionModePull) {
+    // A prototype that executes by pushing has already run everything that
+    // changed before its current timestamp.
+    if (prototype.execution_mode_ == kExecutionModePull) {
+      evaluated_timestamps_ = prototype.evaluated_timestamps_;
+    } else {
+      evaluated_timestamps_.assign(graph_->sorted_nodes().size(),
+                                   timestamp_ - 1);
+    }
+  }
+  return true;
+}
+
+bool GraphState::InitializeOutputBuffer(const Graph& graph) {
+  bool allocated;
+  if (memory_buffer_pool_) {
+    assert(memory_buffer_pool_->alignment() >=
+           graph.output_buffer_alignment());
+    allocated = output_buffer_.Initialize(graph.output_buffer_size(),
+                                          memory_buffer_pool_);
+  } else {
+    allocated = output_buffer_.Initialize(
+        graph.output_buffer_size(), graph.output_buffer_alignment(),
+        allocator_ ? allocator_ : graph.allocator());
+  }
+  if (!allocated) {
+    CallLogFunc(
+        "Could not initialize an instance of graph \"%s\": Out of memory.",
+        graph.graph_name().c_str());
+  }
+  return allocated;
+}
+
+void GraphState::DestroyOutputBufferObjects(MemoryBuffer* buffer) {
+  // Only objects with non-trivial destructors need to be visited.
+  const std::vector<OutputBufferObject>& destructions =
+      graph_->output_buffer_destructions();
+  for (size_t i = 0; i < destructions.size(); ++i) {
+    uint8_t* ptr = buffer->GetObjectPtr(destructions[i].offset);
+    destructions[i].type->operator_delete_func(ptr);
+  }
+  for (auto node = graph_->nodes().begin(); node != graph_->nodes().end();
+       ++node) {
+    for (size_t i = 0; i < node->listener_offsets().size(); ++i) {
+      ptrdiff_t listener_offset = node->listener_offsets()[i];
+      NodeEventListener* listener =
+          buffer->GetObject<NodeEventListener>(listener_offset);
+      listener->~NodeEventListener();
+    }
+  }
+}
+
+// Replace the freshly constructed object at the destination with the object
+// at the source, which is left in its moved-from state.
+static void MoveObject(const Type* type, MemoryBuffer* source,
+                       ptrdiff_t source_offset, MemoryBuffer* destination,
+                       ptrdiff_t destination_offset) {
+  if (type->size == 0) {
+    return;
+  }
+  uint8_t* ptr = destination->GetObjectPtr(destination_offset);
+  type->operator_delete_func(ptr);
+  type->placement_move_func(ptr, source->GetObjectPtr(source_offset));
+}
+
+template <typename T>
+static void CopyObject(const MemoryBuffer& source, ptrdiff_t source_offset,
+                       MemoryBuffer* destination,
+                       ptrdiff_t destination_offset) {
+  *destination->GetObject<T>(destination_offset) =
+      *source.GetObject<T>(source_offset);
+}
+
+void GraphState::MigrateOutputBuffer(const Graph& replacement,
+                                     const std::vector<unsigned int>& matches) {
+  MemoryBuffer previous;
+  previous.Swap(&output_buffer_);
+  // The new nodes may no longer fit in the pool's blocks, in which case the
+  // buffer has to come from the heap instead.
+  if (memory_buffer_pool_ &&
+      (memory_buffer_pool_->block_size() < replacement.output_buffer_size() ||
+       memory_buffer_pool_->alignment() <
+           replacement.output_buffer_alignment())) {
+    memory_buffer_pool_ = nullptr;
+  }
+  // There is no way to back out of a reload halfway through.
+  bool allocated = InitializeOutputBuffer(replacement);
+  assert(allocated);
+  (void)allocated;
+  dirty_node_queue_.Initialize(replacement.sorted_nodes().size());
+  ResolveDefaultValues(replacement);
+  // Listeners below may mark their nodes dirty before the bits are rebuilt.
+  dirty_bits_.Initialize(dirty_bit_count(replacement));
+  next_dirty_bits_.Initialize(dirty_bit_count(replacement));
+  // A suspended pass starts over with the new nodes.
+  execution_position_ = 0;
+  deferred_nodes_.clear();
+  // The new nodes have never been evaluated.
+  std::vector<Timestamp> previous_evaluated_timestamps;
+  previous_evaluated_timestamps.swap(evaluated_timestamps_);
+  if (execution_mode_ == kExecutionModePull) {
+    evaluated_timestamps_.assign(replacement.sorted_nodes().size(), 0);
+  }
+  // Unchanged nodes that are still waiting to be initialized keep waiting.
+  // The changed nodes are counted by InitializeChangedNodes.
+  std::vector<uint8_t> previous_deferred_initializations;
+  previous_deferred_initializations.swap(deferred_initializations_);
+  deferred_initialization_count_ = 0;
+  if (lazy_initialization_) {
+    deferred_initializations_.assign(replacement.sorted_nodes().size(), 0);
+  }
+
+  const std::vector<OutputBufferObject>& constructions =
+      replacement.output_buffer_constructions();
+  for (size_t i = 0; i < constructions.size(); ++i) {
+    uint8_t* ptr = output_buffer_.GetObjectPtr(constructions[i].offset);
+    constructions[i].type->placement_new_func(ptr);
+  }
+
+  for (size_t i = 0; i < replacement.sorted_nodes().size(); ++i) {
+    const Node& node = *replacement.sorted_nodes()[i];
+    InitializeListeners(node);
+    if (matches[i] == kInvalidNodeIndex) {
+      continue;
+    }
+    const Node& previous_node = *graph_->sorted_nodes()[matches[i]];
+    const NodeSignature* signature = node.signature();
+    if (!evaluated_timestamps_.empty()) {
+      evaluated_timestamps_[i] = previous_evaluated_timestamps[matches[i]];
+    }
+    if (!deferred_initializations_.empty() &&
+        previous_deferred_initializations[matches[i]]) {
+      deferred_initializations_[i] = 1;
+      ++deferred_initialization_count_;
+    }
+    CopyObject<Timestamp>(previous, previous_node.timestamp_offset(),
+                          &output_buffer_, node.timestamp_offset());
+    for (size_t j = 0; j < node.output_edges().size(); ++j) {
+      const OutputEdge& edge = node.output_edges()[j];
+      if (!edge.connected()) {
+        continue;
+      }
+      const OutputEdge& previous_edge = previous_node.output_edges()[j];
+      CopyObject<Timestamp>(previous, previous_edge.timestamp_offset(),
+                            &output_buffer_, edge.timestamp_offset());
+      // Aliased data is moved along with the edge that owns it.
+      if (edge.aliased() || previous_edge.aliased()) {
+        continue;
+      }
+      MoveObject(signature->output_parameters()[j].type, &previous,
+                 previous_edge.data_offset(), &output_buffer_,
+                 edge.data_offset());
+    }
+    if (signature->state_type()) {
+      MoveObject(signature->state_type(), &previous,
+                 previous_node.state_offset(), &output_buffer_,
+                 node.state_offset());
+    }
+    for (size_t j = 0; j < node.listener_offsets().size(); ++j) {
+      const NodeEventListener* previous_listener =
+          previous.GetObject<NodeEventListener>(
+              previous_node.listener_offsets()[j]);
+      NodeEventListener* listener =
+          output_buffer_.GetObject<NodeEventListener>(
+              node.listener_offsets()[j]);
+      listener->timestamp_ = previous_listener->timestamp_;
+      CopyListenerBinding(*previous_listener, listener);
+      // Keep any event that has arrived but not been handled yet.
+      if (listener->timestamp_ == event_timestamp()) {
+        MarkNodeDirty(static_cast<unsigned int>(i));
+      }
+    }
+  }
+  RebuildDirtyBits(replacement);
+  if (execution_pending_ && execution_mode_ == kExecutionModeWorklist) {
+    // The queue of the suspended pass was lost along with the old layout.
+    // Queue everything that is still dirty, which includes the nodes that the
+    // pass has already executed.
+    for (size_t i = 0; i < replacement.sorted_nodes().size(); ++i) {
+      if (IsDirty(*replacement.sorted_nodes()[i])) {
+        dirty_node_queue_.Push(static_cast<unsigned int>(i));
+      }
+    }
+  }
+
+  // The old objects are destroyed in the old layout, which also takes their
+  // listeners out of their broadcasters' lists.
+  DestroyOutputBufferObjects(&previous);
+}
+
+void GraphState::InitializeChangedNodes(
+    const std::vector<unsigned int>& matches) {
+  DirtyNodeQueue* dirty_node_queue =
+      execution_mode_ == kExecutionModeWorklist ? &dirty_node_queue_
+                                                : nullptr;
+  for (size_t i = 0; i < graph_->sorted_nodes().size(); ++i) {
+    if (matches[i] != kInvalidNodeIndex) {
+      continue;
+    }
+    // Unlike in Initialize, the outputs are set at the current timestamp, so
+    // that the nodes that depend on them run the next time this GraphState is
+    // executed.
+    Node* node = graph_->sorted_nodes()[i];
+    if (ShouldDeferInitialize(*node)) {
+      deferred_initializations_[i] = 1;
+      ++deferred_initialization_count_;
+      continue;
+    }
+    NodeArguments args(node, &graph_->nodes(), &graph_->input_buffer(),
+                       &output_buffer_, timestamp_, dirty_node_queue,
+                       dirty_bits());
+    args.set_default_values(default_values());
+    node->base_node()->Initialize(&args);
+    if (node->constant() && !node->dead()) {
+      node->Execute(&args);
+    }
+  }
+}
+
+void GraphState::ResolveDefaultValues(const Graph& graph) {
+  default_values_.clear();
+  if (!default_value_overlay_) {
+    return;
+  }
+  const std::vector<DefaultValueOverlay::Value>& values =
+      default_value_overlay_->values();
+  for (size_t i = 0; i < values.size(); ++i) {
+    const DefaultValueOverlay::Value& value = values[i];
+    const InputEdge* input_edge = graph.FindDefaultInputEdge(
+        value.node_index, value.edge_index, value.type);
+    if (!input_edge) {
+      continue;
+    }
+    if (input_edge->connected()) {
+      CallLogFunc(
+          "%s: Attempting to assign a default value to node %d, edge %d, "
+          "which is connected to another node.",
+          graph.graph_name().c_str(), value.node_index, value.edge_index);
+      continue;
+    }
+    ResolvedDefaultValue resolved;
+    resolved.data_offset = input_edge->data_offset();
+    resolved.data = value.data;
+    default_values_.push_back(resolved);
+  }
+  std::sort(default_values_.begin(), default_values_.end(),
+            [](const ResolvedDefaultValue& a, const ResolvedDefaultValue& b) {
+              return a.data_offset < b.data_offset;
+            });
+}
+
+void GraphState::InitializeListeners(const Node& node) {
+  const NodeSignature* signature = node.signature();
+  for (size_t i = 0; i < signature->event_listeners().size(); ++i) {
+    const ListenerParameter& listener = signature->event_listeners()[i];
+    uint8_t* ptr = output_buffer_.GetObjectPtr(node.listener_offsets()[i]);
+    new (ptr) NodeEventListener(this, listener.event_id, listener.event_index,
+                                node.sorted_index());
+  }
+}
+
+void GraphState::CopyListenerBinding(const NodeEventListener& source,
+                                     NodeEventListener* listener) {
+  if (source.waiting_on_timer()) {
+    assert(timer_wheel_);
+    // The two GraphStates may be driven by different wheels, which need not
+    // be on the same tick, so carry over how long is left to wait.
+    const TimerWheel* source_wheel = source.graph_state()->timer_wheel();
+    assert(source_wheel);
+    Tick source_tick = source_wheel->current_tick();
+    Tick remaining =
+        source.wake_tick() > source_tick ? source.wake_tick() - source_tick : 0;
+    timer_wheel_->SetTimer(listener, timer_wheel_->current_tick() + remaining);
+  } else if (source.node.in_list()) {
+    source.broadcaster()->RegisterListener(listener);
+  }
+}
+
+void GraphState::BindListeners(EventId event_id,
+                               NodeEventBroadcaster* broadcaster) {
+  assert(IsInitialized());
+  for (auto node = graph_->nodes().begin(); node != graph_->nodes().end();
+       ++node) {
+    const NodeSignature* signature = node->signature();
+    for (size_t i = 0; i < signature->event_listeners().size(); ++i) {
+      if (signature->event_listeners()[i].event_id == event_id) {
+        ptrdiff_t listener_offset = node->listener_offsets()[i];
+        broadcaster->RegisterListener(
+            output_buffer_.GetObject<NodeEventListener>(listener_offset));
+      }
+    }
+  }
+}
+
+template <typename T>
+static size_t VectorMemoryUsage(const std::vector<T>& vector) {
+  return vector.capacity() * sizeof(T);
+}
+
+void GraphState::GetMemoryStats(MemoryStats* stats) const {
+  size_t usage = sizeof(*this) + dirty_node_queue_.memory_usage() +
+                 VectorMemoryUsage(parallel_nodes_) +
+                 VectorMemoryUsage(pinned_nodes_) +
+                 VectorMemoryUsage(deferred_nodes_) +
+                 VectorMemoryUsage(default_values_) +
+                 VectorMemoryUsage(deferred_initializations_) +
+                 VectorMemoryUsage(evaluated_timestamps_) +
+                 VectorMemoryUsage(upstream_stack_) +
+                 VectorMemoryUsage(upstream_nodes_) +
+                 upstream_visited_.capacity() / 8 +
+                 dirty_bits_.memory_usage() +
+                 next_dirty_bits_.memory_usage() + output_buffer_.size();
   if (graph_) {
     for (auto node = graph_->nodes().begin(); node != graph_->nodes().end();
          ++node) {
       const NodeSignature* signature = node->signature();
+      size_t node_usage = sizeof(Timestamp);
       for (size_t i = 0; i < signature->output_parameters().size(); ++i) {
         const OutputEdge& output_edge = node->output_edges()[i];
-        if (output_edge.connected()) {
-          // If connected, it has a per-graph value.
-          const Type* type = signature->output_parameters()[i].type;
-
-          // Destruct timestamp.
-          Timestamp* timestamp = output_buffer_.GetObject<Timestamp>(
-              output_edge.timestamp_offset());
-          timestamp->~Timestamp();
-          (void)timestamp;  // Avoid erroneous "not referenced" warning in VS.
-
-          // Destruct object.
-          // Only do this on non-void objects. Attempting to access a void edge
-          // can be troublesome in the case where the last edge listed is of
-          // type void.
-          if (type->size > 0) {
-            uint8_t* ptr =
-                output_buffer_.GetObjectPtr(output_edge.data_offset());
-            type->operator_delete_func(ptr);
-          }
+        if (!output_edge.connected()) {
+          continue;
+        }
+        if (output_edge.aliased()) {
+          // The data is counted with the edge that owns it.
+          node_usage += sizeof(Timestamp);
+          continue;
         }
+        const Type* type = signature->output_parameters()[i].type;
+        size_t heap_usage =
+            type->memory_usage_func
+                ? type->memory_usage_func(
+                      output_buffer_.GetObjectPtr(output_edge.data_offset()))
+                : 0;
+        usage += heap_usage;
+        stats->heap_value_bytes += heap_usage;
+        stats->AddTypeBytes(type, type->size + heap_usage);
+        node_usage += sizeof(Timestamp) + type->size + heap_usage;
       }
-      for (size_t i = 0; i < node->listener_offsets().size(); ++i) {
-        ptrdiff_t listener_offset = node->listener_offsets()[i];
-        NodeEventListener* listener =
-            output_buffer_.GetObject<NodeEventListener>(listener_offset);
-        listener->~NodeEventListener();
+      node_usage +=
+          signature->event_listeners().size() * sizeof(NodeEventListener);
+      const Type* state_type = signature->state_type();
+      if (state_type) {
+        node_usage += state_type->size;
       }
+      stats->AddNodeBytes(signature, node_usage);
     }
   }
+  stats->graph_state_bytes += usage;
+  stats->total_bytes += usage;
 }
 
-void GraphState::Initialize(Graph* graph) {
-  assert(graph->nodes_finalized());
-  graph_ = graph;
-  output_buffer_.Initialize(graph_->output_buffer_size());
-  for (auto node = graph_->nodes().begin(); node != graph_->nodes().end();
-       ++node) {
-    uint8_t* ptr;
-    const NodeSignature* signature = node->signature();
+void GraphState::Execute() {
+  ExecutionBudget budget;
+  if (execution_pending_) {
+    Execute(&budget);
+  }
+  Execute(&budget);
+}
 
-    // Initialize the memory for the output edges.
-    for (size_t i = 0; i < signature->output_parameters().size(); ++i) {
-      const OutputEdge& output_edge = node->output_edges()[i];
-      if (output_edge.connected()) {
-        const Type* type = signature->output_parameters()[i].type;
+bool GraphState::Execute(ExecutionBudget* budget) {
+  assert(graph_);
+  bool completed;
+  executing_ = true;
+  if (execution_mode_ == kExecutionModeWorklist) {
+    completed = ExecuteWorklist(budget);
+  } else if (execution_mode_ == kExecutionModePull) {
+    completed = ExecutePull(budget);
+  } else if (job_system_) {
+    completed = ExecuteParallel(budget);
+  } else {
+    completed = ExecuteSerial(budget);
+  }
+  executing_ = false;
+  if (!completed) {
+    execution_pending_ = true;
+    return false;
+  }
+  execution_pending_ = false;
+  execution_position_ = 0;
+  AdvanceTimestamp();
+  // The events held back while the pass was suspended now have the current
+  // timestamp.
+  for (size_t i = 0; i < deferred_nodes_.size(); ++i) {
+    dirty_node_queue_.Push(deferred_nodes_[i]);
+  }
+  deferred_nodes_.clear();
+  return true;
+}
+
+bool GraphState::ExecuteSerial(ExecutionBudget* budget) {
+  // The generated function has every offset written into it, but it can't
+  // stop partway through a pass.
+  GeneratedExecuteFunc generated_execute_func =
+      graph_->generated_execute_func();
+  if (generated_execute_func && execution_position_ == 0 &&
+      budget->unlimited()) {
+    GeneratedGraphContext context(this);
+    generated_execute_func(&context);
+    budget->RecordExecutions(context.executed_count_);
+    return true;
+  }
+
+  const std::vector<Node*>& executed_nodes = graph_->executed_nodes();
+  while (execution_position_ < executed_nodes.size()) {
+    Node* node = executed_nodes[execution_position_++];
+    if (IsDirty(*node)) {
+      ExecuteNode(node);
+      budget->RecordExecutions(1);
+      if (execution_position_ < executed_nodes.size() &&
+          budget->exhausted()) {
+        return false;
+      }
+    } else {
+      RecordSkip(*node);
+    }
+  }
+  return true;
+}
+
+void GraphState::ExecuteNode(Node* node) {
+  NodeArguments args(node, &graph_->nodes(), &graph_->input_buffer(),
+                     &output_buffer_, timestamp_, nullptr, dirty_bits());
+  args.set_default_values(default_values());
+  ExecuteNode(node, &args);
+}
+
+void GraphState::ExecuteNode(Node* node, NodeArguments* args) {
+  InitializeDeferredNode(node, args);
+#ifdef BREADBOARD_PROFILING
+  if (profiler_) {
+    Profiler::Clock::time_point start = Profiler::Clock::now();
+    node->Execute(args);
+    profiler_->RecordExecution(*node, start, Profiler::Clock::now());
+    return;
+  }
+#endif  // BREADBOARD_PROFILING
+  node->Execute(args);
+}
+
+bool GraphState::InitializeDeferredNodes(ExecutionBudget* budget) {
+  assert(graph_);
+  DirtyNodeQueue* dirty_node_queue =
+      execution_mode_ == kExecutionModeWorklist ? &dirty_node_queue_
+                                                : nullptr;
+  for (size_t i = 0; i < deferred_initializations_.size(); ++i) {
+    if (deferred_initialization_count_ == 0 || budget->exhausted()) {
+      break;
+    }
+    if (!deferred_initializations_[i]) {
+      continue;
+    }
+    // As when a reloaded node is initialized, the outputs are set at the
+    // current timestamp so that the nodes that depend on them run next.
+    Node* node = graph_->sorted_nodes()[i];
+    NodeArguments args(node, &graph_->nodes(), &graph_->input_buffer(),
+                       &output_buffer_, timestamp_, dirty_node_queue,
+                       dirty_bits());
+    args.set_default_values(default_values());
+    InitializeDeferredNode(node, &args);
+    budget->RecordExecutions(1);
+  }
+  return deferred_initialization_count_ == 0;
+}
+
+void GraphState::RunDeferredInitialize(Node* node, NodeArguments* args) {
+  deferred_initializations_[node->sorted_index()] = 0;
+  --deferred_initialization_count_;
+  node->base_node()->Initialize(args);
+}
 
-        // Initialize timestamp.
-        ptr = output_buffer_.GetObjectPtr(output_edge.timestamp_offset());
-        new (ptr) Timestamp(0);
-
-        // Initialize object.
-        // Only do this on non-void objects. Attempting to access a void edge
-        // can be troublesome in the case where the last edge listed is of
-        // type void.
-        if (type->size > 0) {
-          ptr = output_buffer_.GetObjectPtr(output_edge.data_offset());
-          type->placement_new_func(ptr);
+bool GraphState::ExecuteParallel(ExecutionBudget* budget) {
+  const std::vector<std::vector<Node*>>& levels = graph_->execution_levels();
+  while (execution_position_ < levels.size()) {
+    // Every node on this level depends only on earlier levels, which have all
+    // finished executing, so whether or not a node is dirty is settled.
+    const std::vector<Node*>& level = levels[execution_position_++];
+    parallel_nodes_.clear();
+    pinned_nodes_.clear();
+    for (size_t j = 0; j < level.size(); ++j) {
+      Node* node = level[j];
+      if (IsDirty(*node)) {
+        if (node->signature()->thread_safe()) {
+          parallel_nodes_.push_back(node);
+        } else {
+          pinned_nodes_.push_back(node);
         }
+      } else {
+        RecordSkip(*node);
       }
     }
 
-    // Initialize the memory for the listeners.
-    for (size_t i = 0; i < signature->event_listeners().size(); ++i) {
-      EventId event_id = signature->event_listeners()[i].event_id;
-      ptr = output_buffer_.GetObjectPtr(node->listener_offsets()[i]);
-      new (ptr) NodeEventListener(this, event_id);
+    // Handing a single node to the job system would only add overhead.
+    if (parallel_nodes_.size() > 1) {
+      job_system_->ParallelFor(parallel_nodes_.size(), [this](size_t index) {
+        ExecuteNode(parallel_nodes_[index]);
+      });
+    } else if (parallel_nodes_.size() == 1) {
+      ExecuteNode(parallel_nodes_[0]);
+    }
+    for (size_t j = 0; j < pinned_nodes_.size(); ++j) {
+      ExecuteNode(pinned_nodes_[j]);
+    }
+
+    // The budget can only be checked between levels.
+    size_t executed_count = parallel_nodes_.size() + pinned_nodes_.size();
+    if (executed_count > 0) {
+      budget->RecordExecutions(executed_count);
+      if (execution_position_ < levels.size() && budget->exhausted()) {
+        return false;
+      }
     }
   }
+  return true;
+}
 
-  for (size_t i = 0; i < graph_->sorted_nodes().size(); ++i) {
-    Node* node = graph_->sorted_nodes()[i];
+bool GraphState::ExecuteWorklist(ExecutionBudget* budget) {
+  // Nodes only ever queue nodes that come after them in sorted order, so
+  // popping the lowest position each time runs every node after all of its
+  // dependencies, and at most once.
+  const std::vector<Node*>& sorted_nodes = graph_->sorted_nodes();
+  while (!dirty_node_queue_.empty()) {
+    Node* node = sorted_nodes[dirty_node_queue_.Pop()];
     NodeArguments args(node, &graph_->nodes(), &graph_->input_buffer(),
-                       &output_buffer_, timestamp_);
-    node->base_node()->Initialize(&args);
+                       &output_buffer_, timestamp_, &dirty_node_queue_,
+                       dirty_bits());
+    args.set_default_values(default_values());
+    ExecuteNode(node, &args);
+    budget->RecordExecutions(1);
+    if (!dirty_node_queue_.empty() && budget->exhausted()) {
+      return false;
+    }
   }
-  ++timestamp_;
+  return true;
 }
 
-void GraphState::Execute() {
+bool GraphState::ExecutePull(ExecutionBudget* budget) {
+  const std::vector<Node*>& executed_nodes = graph_->executed_nodes();
+  while (execution_position_ < executed_nodes.size()) {
+    Node* node = executed_nodes[execution_position_++];
+    if (IsStale(*node)) {
+      EvaluateNode(node);
+      budget->RecordExecutions(1);
+      if (execution_position_ < executed_nodes.size() &&
+          budget->exhausted()) {
+        return false;
+      }
+    } else {
+      RecordSkip(*node);
+    }
+  }
+  return true;
+}
+
+const uint8_t* GraphState::QueryInput(unsigned int node_index,
+                                      unsigned int edge_index,
+                                      const Type* type) {
   assert(graph_);
-  for (size_t i = 0; i < graph_->sorted_nodes().size(); ++i) {
-    Node* node = graph_->sorted_nodes()[i];
-    if (IsDirty(*node)) {
-      NodeArguments args(node, &graph_->nodes(), &graph_->input_buffer(),
-                         &output_buffer_, timestamp_);
-      node->base_node()->Execute(&args);
+  if (execution_mode_ != kExecutionModePull) {
+    CallLogFunc(
+        "%s: Attempting to query node %d when the graph state is not in "
+        "kExecutionModePull.",
+        graph_->graph_name().c_str(), node_index);
+    return nullptr;
+  }
+  if (execution_pending_) {
+    CallLogFunc(
+        "%s: Attempting to query node %d while a pass is suspended.",
+        graph_->graph_name().c_str(), node_index);
+    return nullptr;
+  }
+  if (node_index >= graph_->node_positions_.size()) {
+    CallLogFunc(
+        "%s: Attempting to query node %d when graph only has %d nodes.",
+        graph_->graph_name().c_str(), node_index,
+        static_cast<int>(graph_->node_positions_.size()));
+    return nullptr;
+  }
+  if (graph_->node_position(node_index) == kInvalidNodeIndex &&
+      !graph_->ResolveSubgraphInput(&node_index, &edge_index)) {
+    return nullptr;
+  }
+  const Node& node = graph_->nodes()[graph_->node_position(node_index)];
+  const NodeSignature* signature = node.signature();
+  if (edge_index >= node.input_edges().size()) {
+    CallLogFunc(
+        "%s: Attempting to query node %d (%s:%s), edge %d when node only has "
+        "%d input edges.",
+        graph_->graph_name().c_str(), node_index,
+        signature->module_name()->c_str(), signature->node_name().c_str(),
+        edge_index, static_cast<int>(node.input_edges().size()));
+    return nullptr;
+  }
+  const Type* expected_type = signature->input_parameters()[edge_index].type;
+  if (type != expected_type) {
+    CallLogFunc(
+        "%s: Attempting to query node %d (%s:%s), edge %d as type \"%s\" when "
+        "it has type \"%s\".",
+        graph_->graph_name().c_str(), node_index,
+        signature->module_name()->c_str(), signature->node_name().c_str(),
+        edge_index, type->name, expected_type->name);
+    return nullptr;
+  }
+  const ResolvedInputEdge& input_edge = node.resolved_input_edges()[edge_index];
+  if (!input_edge.connected) {
+    // The overlay may replace the Graph's default value.
+    auto value = std::lower_bound(
+        default_values_.begin(), default_values_.end(),
+        input_edge.data_offset,
+        [](const ResolvedDefaultValue& a, ptrdiff_t data_offset) {
+          return a.data_offset < data_offset;
+        });
+    if (value != default_values_.end() &&
+        value->data_offset == input_edge.data_offset) {
+      return value->data;
     }
+    return graph_->input_buffer().GetObjectPtr(input_edge.data_offset);
   }
-  ++timestamp_;
+  EvaluateUpstream(node.input_edges()[edge_index].target().node_index());
+  return output_buffer_.GetObjectPtr(input_edge.data_offset);
+}
+
+void GraphState::EvaluateUpstream(unsigned int sorted_index) {
+  // Gather the node and everything it depends on. Dead nodes are included,
+  // since nothing but a query would ever run them.
+  const std::vector<Node*>& sorted_nodes = graph_->sorted_nodes();
+  upstream_visited_.resize(sorted_nodes.size());
+  upstream_stack_.clear();
+  upstream_nodes_.clear();
+  upstream_stack_.push_back(sorted_index);
+  upstream_visited_[sorted_index] = true;
+  while (!upstream_stack_.empty()) {
+    unsigned int index = upstream_stack_.back();
+    upstream_stack_.pop_back();
+    upstream_nodes_.push_back(index);
+    const Node& node = *sorted_nodes[index];
+    for (size_t i = 0; i < node.input_edges().size(); ++i) {
+      const InputEdge& input_edge = node.input_edges()[i];
+      if (!input_edge.connected()) {
+        continue;
+      }
+      unsigned int dependency = input_edge.target().node_index();
+      if (!upstream_visited_[dependency]) {
+        upstream_visited_[dependency] = true;
+        upstream_stack_.push_back(dependency);
+      }
+    }
+  }
+
+  // Sorted positions are in dependency order, so evaluating in that order
+  // runs every node after the nodes it reads from.
+  std::sort(upstream_nodes_.begin(), upstream_nodes_.end());
+  bool executed = false;
+  for (size_t i = 0; i < upstream_nodes_.size(); ++i) {
+    upstream_visited_[upstream_nodes_[i]] = false;
+    Node* node = sorted_nodes[upstream_nodes_[i]];
+    // Constant nodes computed their outputs when they were initialized.
+    if (node->constant()) {
+      continue;
+    }
+    if (IsStale(*node)) {
+      EvaluateNode(node);
+      executed = true;
+    } else {
+      RecordSkip(*node);
+    }
+  }
+  // Anything that changes from here on has to be newer than what was just
+  // evaluated.
+  if (executed) {
+    AdvanceTimestamp();
+  }
+}
+
+bool GraphState::IsStale(const Node& node) const {
+  Timestamp evaluated = evaluated_timestamps_[node.sorted_index()];
+  if (*output_buffer_.GetObject<Timestamp>(node.timestamp_offset()) >
+      evaluated) {
+    return true;
+  }
+  for (size_t i = 0; i < node.listener_offsets().size(); ++i) {
+    const NodeEventListener* listener =
+        output_buffer_.GetObject<NodeEventListener>(node.listener_offsets()[i]);
+    // Events held for the next pass have a timestamp past the current one.
+    if (listener->timestamp() > evaluated &&
+        listener->timestamp() <= timestamp_) {
+      return true;
+    }
+  }
+  const ResolvedInputEdge* input_edges = node.resolved_input_edges();
+  for (size_t i = 0; i < node.input_edges().size(); ++i) {
+    const ResolvedInputEdge& input_edge = input_edges[i];
+    if (input_edge.connected &&
+        *output_buffer_.GetObject<Timestamp>(input_edge.timestamp_offset) >
+            evaluated) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void GraphState::EvaluateNode(Node* node) {
+  Timestamp* evaluated = &evaluated_timestamps_[node->sorted_index()];
+  NodeArguments args(node, &graph_->nodes(), &graph_->input_buffer(),
+                     &output_buffer_, timestamp_);
+  args.set_dirty_since(*evaluated + 1);
+  args.set_default_values(default_values());
+  *evaluated = timestamp_;
+  ExecuteNode(node, &args);
 }
 
 bool GraphState::IsDirty(const Node& node) const {
+  if (!dirty_bits_.empty()) {
+    return dirty_bits_.TestAny(node.dirty_masks().data(),
+                               node.dirty_masks().size());
+  }
   const Timestamp* node_timestamp =
       output_buffer_.GetObject<Timestamp>(node.timestamp_offset());
   if (*node_timestamp == timestamp_) {
@@ -134,13 +888,12 @@ bool GraphState::IsDirty(const Node& node) const {
       return true;
     }
   }
+  const ResolvedInputEdge* input_edges = node.resolved_input_edges();
   for (size_t i = 0; i < node.input_edges().size(); ++i) {
-    const InputEdge& input_edge = node.input_edges()[i];
-    if (input_edge.connected()) {
-      const OutputEdge& output_edge =
-          input_edge.target().GetTargetEdge(&graph_->nodes());
+    const ResolvedInputEdge& input_edge = input_edges[i];
+    if (input_edge.connected) {
       const Timestamp* timestamp =
-          output_buffer_.GetObject<Timestamp>(output_edge.timestamp_offset());
+          output_buffer_.GetObject<Timestamp>(input_edge.timestamp_offset);
       if (*timestamp == timestamp_) {
         return true;
       }
@@ -149,4 +902,39 @@ bool GraphState::IsDirty(const Node& node) const {
   return false;
 }
 
+void GraphState::RebuildDirtyBits(const Graph& graph) {
+  dirty_bits_.Initialize(dirty_bit_count(graph));
+  next_dirty_bits_.Initialize(dirty_bit_count(graph));
+  if (dirty_bits_.empty()) {
+    return;
+  }
+  for (size_t i = 0; i < graph.sorted_nodes().size(); ++i) {
+    const Node& node = *graph.sorted_nodes()[i];
+    unsigned int sorted_index = static_cast<unsigned int>(i);
+    if (*output_buffer_.GetObject<Timestamp>(node.timestamp_offset()) ==
+        timestamp_) {
+      dirty_bits_.Set(sorted_index);
+    }
+    for (size_t j = 0; j < node.listener_offsets().size(); ++j) {
+      const NodeEventListener* listener =
+          output_buffer_.GetObject<NodeEventListener>(
+              node.listener_offsets()[j]);
+      if (listener->timestamp() == timestamp_) {
+        dirty_bits_.Set(sorted_index);
+      } else if (execution_pending_ &&
+                 listener->timestamp() == timestamp_ + 1) {
+        next_dirty_bits_.Set(sorted_index);
+      }
+    }
+    for (size_t j = 0; j < node.output_edges().size(); ++j) {
+      const OutputEdge& edge = node.output_edges()[j];
+      if (edge.connected() &&
+          *output_buffer_.GetObject<Timestamp>(edge.timestamp_offset()) ==
+              timestamp_) {
+        dirty_bits_.Set(edge.dirty_bit());
+      }
+    }
+  }
+}
+
 }  // namespace breadboard
@@ -0,0 +1,128 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/graph_state_batch.h"
+
+#include <cassert>
+
+#include "breadboard/base_node.h"
+
+namespace breadboard {
+
+bool GraphStateBatch::Initialize(Graph* graph, size_t count) {
+  assert(graph_ == nullptr);
+  graph_ = graph;
+  memory_buffer_pool_.reset(new MemoryBufferPool(
+      graph->output_buffer_size(), graph->output_buffer_alignment(), count,
+      graph->allocator()));
+  graph_states_.reserve(count);
+  graph_state_pointers_.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    if (!AddGraphState()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+GraphState* GraphStateBatch::AddGraphState() {
+  assert(graph_);
+  GraphState* graph_state = new GraphState();
+  graph_states_.push_back(std::unique_ptr<GraphState>(graph_state));
+  graph_state_pointers_.push_back(graph_state);
+  graph_state->set_memory_buffer_pool(memory_buffer_pool_.get());
+  graph_state->set_profiler(profiler_);
+  if (!graph_state->Initialize(graph_)) {
+    graph_state_pointers_.pop_back();
+    graph_states_.pop_back();
+    return nullptr;
+  }
+  return graph_state;
+}
+
+void GraphStateBatch::Execute() {
+  assert(graph_);
+  executor_.Execute(graph_, graph_state_pointers_.data(),
+                    graph_state_pointers_.size(), profiler_);
+}
+
+void BatchExecutor::Execute(Graph* graph, GraphState* const* graph_states,
+                            size_t count, Profiler* profiler) {
+  const std::vector<Node*>& executed_nodes = graph->executed_nodes();
+  for (size_t i = 0; i < executed_nodes.size(); ++i) {
+    Node* node = executed_nodes[i];
+
+    // Find the dirty instances first so that the dirty checks and the node's
+    // Execute function each run back to back.
+    dirty_states_.clear();
+    for (size_t j = 0; j < count; ++j) {
+      GraphState* graph_state = graph_states[j];
+      if (graph_state->IsDirty(*node)) {
+        dirty_states_.push_back(graph_state);
+      } else {
+        graph_state->RecordSkip(*node);
+      }
+    }
+    if (dirty_states_.size() > 1 && ExecuteBatch(graph, node, profiler)) {
+      continue;
+    }
+    for (size_t j = 0; j < dirty_states_.size(); ++j) {
+      dirty_states_[j]->ExecuteNode(node);
+    }
+  }
+  for (size_t i = 0; i < count; ++i) {
+    // Instances executed together are only ever executed all the way through.
+    assert(!graph_states[i]->execution_pending());
+    graph_states[i]->AdvanceTimestamp();
+  }
+}
+
+bool BatchExecutor::ExecuteBatch(Graph* graph, Node* node,
+                                 Profiler* profiler) {
+  batch_arguments_.clear();
+  for (size_t i = 0; i < dirty_states_.size(); ++i) {
+    GraphState* graph_state = dirty_states_[i];
+    batch_arguments_.push_back(NodeArguments(
+        node, &graph->nodes(), &graph->input_buffer(),
+        &graph_state->output_buffer_, graph_state->timestamp_, nullptr,
+        graph_state->dirty_bits()));
+    batch_arguments_.back().set_default_values(graph_state->default_values());
+    graph_state->InitializeDeferredNode(node, &batch_arguments_.back());
+  }
+  NodeBatchArguments args(batch_arguments_.data(), batch_arguments_.size(),
+                          &batch_columns_);
+#ifdef BREADBOARD_PROFILING
+  if (profiler) {
+    Profiler::Clock::time_point start = Profiler::Clock::now();
+    bool executed = node->base_node()->ExecuteBatch(&args);
+    if (executed) {
+      profiler->RecordExecution(*node, start, Profiler::Clock::now(),
+                                dirty_states_.size());
+    }
+    return executed;
+  }
+#else
+  (void)profiler;
+#endif  // BREADBOARD_PROFILING
+  return node->base_node()->ExecuteBatch(&args);
+}
+
+void GraphStateBatch::set_profiler(Profiler* profiler) {
+  profiler_ = profiler;
+  for (size_t i = 0; i < graph_states_.size(); ++i) {
+    graph_states_[i]->set_profiler(profiler);
+  }
+}
+
+}  // namespace breadboard
@@ -0,0 +1,409 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/graph_state_history.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include "breadboard/log.h"
+
+namespace breadboard {
+
+// The most bytes compared and copied as one unit when taking a delta. Smaller
+// blocks make for smaller deltas, but more bookkeeping per snapshot.
+static const size_t kSnapshotBlockSize = 64;
+
+GraphStateHistory::GraphStateHistory(const Graph* graph, size_t capacity)
+    : graph_(graph),
+      blocks_(),
+      node_blocks_(),
+      node_block_starts_(),
+      touched_blocks_(),
+      listener_offsets_(),
+      object_offsets_(),
+      objects_size_(0),
+      objects_alignment_(1),
+      current_(),
+      snapshots_(),
+      first_(0),
+      count_(0) {
+  assert(capacity > 0);
+  BuildLayout();
+  BuildNodeBlocks();
+  current_.resize(graph_->output_buffer_size());
+  snapshots_.reserve(capacity);
+  for (size_t i = 0; i < capacity; ++i) {
+    Snapshot* snapshot = new Snapshot();
+    snapshot->listener_timestamps.resize(listener_offsets_.size());
+    // Enough for every block to change between one snapshot and the next.
+    snapshot->undo_blocks.reserve(blocks_.size());
+    snapshot->undo_bytes.reserve(current_.size());
+    if (objects_size_ > 0) {
+      snapshot->objects.Initialize(objects_size_, objects_alignment_,
+                                   graph_->allocator());
+    }
+    snapshots_.push_back(std::unique_ptr<Snapshot>(snapshot));
+  }
+}
+
+GraphStateHistory::~GraphStateHistory() { Clear(); }
+
+void GraphStateHistory::BuildLayout() {
+  // Everything that can't be copied with memcpy, sorted by offset.
+  std::vector<std::pair<ptrdiff_t, size_t>> excluded;
+  const std::vector<Node>& nodes = graph_->nodes();
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const ArrayRef<const ptrdiff_t>& offsets = nodes[i].listener_offsets();
+    for (size_t j = 0; j < offsets.size(); ++j) {
+      listener_offsets_.push_back(offsets[j]);
+      excluded.push_back(std::make_pair(offsets[j], sizeof(NodeEventListener)));
+    }
+  }
+  const std::vector<OutputBufferObject>& copies =
+      graph_->output_buffer_copies();
+  for (size_t i = 0; i < copies.size(); ++i) {
+    const Type* type = copies[i].type;
+    excluded.push_back(std::make_pair(copies[i].offset, type->size));
+    objects_size_ =
+        (objects_size_ + type->alignment - 1) & ~(type->alignment - 1);
+    object_offsets_.push_back(static_cast<ptrdiff_t>(objects_size_));
+    objects_size_ += type->size;
+    objects_alignment_ = std::max(objects_alignment_, type->alignment);
+  }
+  std::sort(excluded.begin(), excluded.end());
+
+  // Split the gaps between them into blocks.
+  ptrdiff_t buffer_size = static_cast<ptrdiff_t>(graph_->output_buffer_size());
+  ptrdiff_t offset = 0;
+  size_t next = 0;
+  while (offset < buffer_size) {
+    ptrdiff_t end = next < excluded.size() ? excluded[next].first : buffer_size;
+    while (offset < end) {
+      size_t size =
+          std::min(kSnapshotBlockSize, static_cast<size_t>(end - offset));
+      blocks_.push_back(Block(offset, size));
+      offset += size;
+    }
+    if (next < excluded.size()) {
+      offset = std::max(
+          offset, excluded[next].first +
+                      static_cast<ptrdiff_t>(excluded[next].second));
+      ++next;
+    }
+  }
+}
+
+void GraphStateHistory::BuildNodeBlocks() {
+  touched_blocks_.assign(blocks_.size(), 0);
+  const std::vector<Node>& nodes = graph_->nodes();
+  node_block_starts_.reserve(nodes.size() + 1);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    node_block_starts_.push_back(node_blocks_.size());
+    const Node& node = nodes[i];
+    const NodeSignature* signature = node.signature();
+    AddNodeBlocks(node.timestamp_offset(), sizeof(Timestamp));
+    for (size_t j = 0; j < node.output_edges().size(); ++j) {
+      const OutputEdge& edge = node.output_edges()[j];
+      if (!edge.connected()) {
+        continue;
+      }
+      AddNodeBlocks(edge.timestamp_offset(), sizeof(Timestamp));
+      // Aliased edges share the storage of an earlier node's edge.
+      if (!edge.aliased()) {
+        AddNodeBlocks(edge.data_offset(),
+                      signature->output_parameters()[j].type->size);
+      }
+    }
+    if (signature->state_type()) {
+      AddNodeBlocks(node.state_offset(), signature->state_type()->size);
+    }
+    // Clear the marks again, which kept each block from being listed twice.
+    for (size_t j = node_block_starts_.back(); j < node_blocks_.size(); ++j) {
+      touched_blocks_[node_blocks_[j]] = 0;
+    }
+  }
+  node_block_starts_.push_back(node_blocks_.size());
+}
+
+void GraphStateHistory::AddNodeBlocks(ptrdiff_t offset, size_t size) {
+  ptrdiff_t end = offset + static_cast<ptrdiff_t>(size);
+  // Find the first block that ends after the start of the range.
+  auto block = std::upper_bound(
+      blocks_.begin(), blocks_.end(), offset,
+      [](ptrdiff_t value, const Block& block) {
+        return value < block.offset + static_cast<ptrdiff_t>(block.size);
+      });
+  for (; block != blocks_.end() && block->offset < end; ++block) {
+    size_t index = static_cast<size_t>(block - blocks_.begin());
+    if (!touched_blocks_[index]) {
+      touched_blocks_[index] = 1;
+      node_blocks_.push_back(static_cast<unsigned int>(index));
+    }
+  }
+}
+
+bool GraphStateHistory::MayHaveChanged(const GraphState& graph_state,
+                                       const Node& node,
+                                       const Snapshot& previous) const {
+  // Everything a node writes while it executes is done at a timestamp no
+  // older than the one the previous snapshot was saved at, and a node only
+  // executes when something it depends on has such a timestamp.
+  const Timestamp since = previous.timestamp;
+  const MemoryBuffer& buffer = graph_state.output_buffer_;
+  size_t sorted_index = node.sorted_index();
+  if (*buffer.GetObject<Timestamp>(node.timestamp_offset()) >= since) {
+    return true;
+  }
+  for (size_t i = 0; i < node.listener_offsets().size(); ++i) {
+    const NodeEventListener* listener =
+        buffer.GetObject<NodeEventListener>(node.listener_offsets()[i]);
+    if (listener->timestamp() >= since) {
+      return true;
+    }
+  }
+  const ResolvedInputEdge* input_edges = node.resolved_input_edges();
+  for (size_t i = 0; i < node.input_edges().size(); ++i) {
+    if (input_edges[i].connected &&
+        *buffer.GetObject<Timestamp>(input_edges[i].timestamp_offset) >=
+            since) {
+      return true;
+    }
+  }
+  for (size_t i = 0; i < node.output_edges().size(); ++i) {
+    const OutputEdge& edge = node.output_edges()[i];
+    if (edge.connected() &&
+        *buffer.GetObject<Timestamp>(edge.timestamp_offset()) >= since) {
+      return true;
+    }
+  }
+  // Nodes that execute by being pulled may have been evaluated because of
+  // a change from before the snapshot.
+  const std::vector<Timestamp>& evaluated_timestamps =
+      graph_state.evaluated_timestamps_;
+  if (sorted_index < evaluated_timestamps.size() &&
+      evaluated_timestamps[sorted_index] >= since) {
+    return true;
+  }
+  // Nodes that have been initialized since may have set up their state.
+  const std::vector<uint8_t>& deferred = graph_state.deferred_initializations_;
+  const std::vector<uint8_t>& previous_deferred =
+      previous.deferred_initializations;
+  if (sorted_index < previous_deferred.size() &&
+      previous_deferred[sorted_index] &&
+      (sorted_index >= deferred.size() || !deferred[sorted_index])) {
+    return true;
+  }
+  return false;
+}
+
+bool GraphStateHistory::Save(const GraphState& graph_state, uint64_t frame) {
+  assert(graph_state.graph_ == graph_);
+  assert(!graph_state.execution_pending_);
+  assert(count_ == 0 || frame > newest_frame());
+  if (!graph_->output_buffer_copyable()) {
+    CallLogFunc(
+        "Could not save a snapshot of graph \"%s\": It holds a type that can "
+        "not be copied.",
+        graph_->graph_name().c_str());
+    return false;
+  }
+
+  if (count_ == snapshots_.size()) {
+    Snapshot& oldest = snapshot(0);
+    DestroyObjects(&oldest);
+    oldest.undo_blocks.clear();
+    oldest.undo_bytes.clear();
+    first_ = (first_ + 1) % snapshots_.size();
+    --count_;
+  }
+
+  const MemoryBuffer& buffer = graph_state.output_buffer_;
+  if (count_ == 0) {
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+      const Block& block = blocks_[i];
+      memcpy(&current_[block.offset], buffer.GetObjectPtr(block.offset),
+             block.size);
+    }
+  } else {
+    // Record what the changed blocks held on the previous frame, so that it
+    // can be rolled back to. Only the blocks of nodes that may have executed
+    // since then are compared.
+    Snapshot& previous = snapshot(count_ - 1);
+    const std::vector<Node>& nodes = graph_->nodes();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      if (!MayHaveChanged(graph_state, nodes[i], previous)) {
+        continue;
+      }
+      for (size_t j = node_block_starts_[i]; j < node_block_starts_[i + 1];
+           ++j) {
+        touched_blocks_[node_blocks_[j]] = 1;
+      }
+    }
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+      if (!touched_blocks_[i]) {
+        continue;
+      }
+      touched_blocks_[i] = 0;
+      const Block& block = blocks_[i];
+      uint8_t* saved = &current_[block.offset];
+      const uint8_t* live = buffer.GetObjectPtr(block.offset);
+      if (memcmp(saved, live, block.size) == 0) {
+        continue;
+      }
+      previous.undo_blocks.push_back(static_cast<unsigned int>(i));
+      previous.undo_bytes.insert(previous.undo_bytes.end(), saved,
+                                 saved + block.size);
+      memcpy(saved, live, block.size);
+    }
+  }
+
+  Snapshot& next = snapshot(count_);
+  next.frame = frame;
+  next.timestamp = graph_state.timestamp_;
+  next.deferred_initializations = graph_state.deferred_initializations_;
+  next.deferred_initialization_count =
+      graph_state.deferred_initialization_count_.load();
+  for (size_t i = 0; i < listener_offsets_.size(); ++i) {
+    next.listener_timestamps[i] =
+        buffer.GetObject<NodeEventListener>(listener_offsets_[i])->timestamp_;
+  }
+  const std::vector<OutputBufferObject>& copies =
+      graph_->output_buffer_copies();
+  for (size_t i = 0; i < copies.size(); ++i) {
+    copies[i].type->placement_copy_func(
+        next.objects.GetObjectPtr(object_offsets_[i]),
+        buffer.GetObjectPtr(copies[i].offset));
+  }
+  next.objects_constructed = true;
+  ++count_;
+  return true;
+}
+
+bool GraphStateHistory::Restore(uint64_t frame, GraphState* graph_state) {
+  assert(graph_state->graph_ == graph_);
+  assert(!graph_state->execution_pending_);
+  size_t position = 0;
+  while (position < count_ && snapshot(position).frame != frame) {
+    ++position;
+  }
+  if (position == count_) {
+    return false;
+  }
+
+  // Walk current_ back to the frame, discarding the snapshots after it.
+  for (size_t i = count_ - 1; i > position; --i) {
+    Snapshot& discarded = snapshot(i);
+    DestroyObjects(&discarded);
+    discarded.undo_blocks.clear();
+    discarded.undo_bytes.clear();
+    Undo(snapshot(i - 1));
+  }
+  count_ = position + 1;
+  Snapshot& restored = snapshot(position);
+  restored.undo_blocks.clear();
+  restored.undo_bytes.clear();
+
+  MemoryBuffer* buffer = &graph_state->output_buffer_;
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    const Block& block = blocks_[i];
+    memcpy(buffer->GetObjectPtr(block.offset), &current_[block.offset],
+           block.size);
+  }
+  const std::vector<OutputBufferObject>& copies =
+      graph_->output_buffer_copies();
+  for (size_t i = 0; i < copies.size(); ++i) {
+    const Type* type = copies[i].type;
+    uint8_t* live = buffer->GetObjectPtr(copies[i].offset);
+    type->operator_delete_func(live);
+    type->placement_copy_func(
+        live, restored.objects.GetObjectPtr(object_offsets_[i]));
+  }
+  for (size_t i = 0; i < listener_offsets_.size(); ++i) {
+    buffer->GetObject<NodeEventListener>(listener_offsets_[i])->timestamp_ =
+        restored.listener_timestamps[i];
+  }
+  graph_state->timestamp_ = restored.timestamp;
+  // Nodes initialized since the frame was saved are initialized again, since
+  // their outputs are back to how they were before that.
+  graph_state->deferred_initializations_ = restored.deferred_initializations;
+  graph_state->deferred_initialization_count_ =
+      restored.deferred_initialization_count;
+  graph_state->dirty_node_queue_.Clear();
+  graph_state->RebuildDirtyBits(*graph_);
+  // Whatever the restored frame had yet to execute has to be evaluated again.
+  std::vector<Timestamp>& evaluated_timestamps =
+      graph_state->evaluated_timestamps_;
+  for (size_t i = 0; i < evaluated_timestamps.size(); ++i) {
+    evaluated_timestamps[i] =
+        std::min(evaluated_timestamps[i], restored.timestamp - 1);
+  }
+  return true;
+}
+
+void GraphStateHistory::Clear() {
+  for (size_t i = 0; i < count_; ++i) {
+    Snapshot& cleared = snapshot(i);
+    DestroyObjects(&cleared);
+    cleared.undo_blocks.clear();
+    cleared.undo_bytes.clear();
+  }
+  first_ = 0;
+  count_ = 0;
+}
+
+bool GraphStateHistory::Contains(uint64_t frame) const {
+  for (size_t i = 0; i < count_; ++i) {
+    if (snapshot(i).frame == frame) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t GraphStateHistory::oldest_frame() const {
+  assert(count_ > 0);
+  return snapshot(0).frame;
+}
+
+uint64_t GraphStateHistory::newest_frame() const {
+  assert(count_ > 0);
+  return snapshot(count_ - 1).frame;
+}
+
+void GraphStateHistory::DestroyObjects(Snapshot* snapshot) {
+  if (!snapshot->objects_constructed) {
+    return;
+  }
+  const std::vector<OutputBufferObject>& copies =
+      graph_->output_buffer_copies();
+  for (size_t i = 0; i < copies.size(); ++i) {
+    copies[i].type->operator_delete_func(
+        snapshot->objects.GetObjectPtr(object_offsets_[i]));
+  }
+  snapshot->objects_constructed = false;
+}
+
+void GraphStateHistory::Undo(const Snapshot& snapshot) {
+  const uint8_t* bytes = snapshot.undo_bytes.data();
+  for (size_t i = 0; i < snapshot.undo_blocks.size(); ++i) {
+    const Block& block = blocks_[snapshot.undo_blocks[i]];
+    memcpy(&current_[block.offset], bytes, block.size);
+    bytes += block.size;
+  }
+}
+
+}  // namespace breadboard
@@ -0,0 +1,82 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/graph_state_scheduler.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace breadboard {
+
+GraphStateScheduler::~GraphStateScheduler() {
+  for (size_t i = 0; i < graph_states_.size(); ++i) {
+    graph_states_[i]->scheduler_ = nullptr;
+  }
+}
+
+void GraphStateScheduler::AddGraphState(GraphState* graph_state) {
+  assert(graph_state->IsInitialized());
+  assert(graph_state->scheduler_ == nullptr);
+  graph_state->scheduler_ = this;
+  // If the rest of the round wraps around the end of the list, the new
+  // GraphState's turn falls inside it, so it joins the round. Otherwise it
+  // waits for the next one.
+  if (next_graph_state_ + remaining_in_round_ > graph_states_.size()) {
+    ++remaining_in_round_;
+  }
+  graph_states_.push_back(graph_state);
+}
+
+void GraphStateScheduler::RemoveGraphState(GraphState* graph_state) {
+  auto iter =
+      std::find(graph_states_.begin(), graph_states_.end(), graph_state);
+  if (iter == graph_states_.end()) {
+    return;
+  }
+  size_t index = static_cast<size_t>(iter - graph_states_.begin());
+  size_t size = graph_states_.size();
+  // The GraphStates yet to run in this round are the ones from
+  // next_graph_state_ onwards, wrapping around the end.
+  if ((index + size - next_graph_state_) % size < remaining_in_round_) {
+    --remaining_in_round_;
+  }
+  if (index < next_graph_state_) {
+    --next_graph_state_;
+  }
+  graph_states_.erase(iter);
+  if (next_graph_state_ >= graph_states_.size()) {
+    next_graph_state_ = 0;
+  }
+  graph_state->scheduler_ = nullptr;
+}
+
+bool GraphStateScheduler::Execute(ExecutionBudget* budget) {
+  if (remaining_in_round_ == 0) {
+    remaining_in_round_ = graph_states_.size();
+  }
+  while (remaining_in_round_ > 0) {
+    if (budget->nodes_executed() > 0 && budget->exhausted()) {
+      return false;
+    }
+    GraphState* graph_state = graph_states_[next_graph_state_];
+    if (!graph_state->Execute(budget)) {
+      return false;
+    }
+    next_graph_state_ = (next_graph_state_ + 1) % graph_states_.size();
+    --remaining_in_round_;
+  }
+  return true;
+}
+
+}  // namespace breadboard
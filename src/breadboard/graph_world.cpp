@@ -0,0 +1,160 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/graph_world.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace breadboard {
+
+GraphWorld::~GraphWorld() {
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    const GraphGroup& group = *groups_[i];
+    for (size_t j = 0; j < group.shards.size(); ++j) {
+      const Shard& shard = *group.shards[j];
+      for (size_t k = 0; k < shard.graph_states.size(); ++k) {
+        shard.graph_states[k]->world_ = nullptr;
+      }
+    }
+  }
+}
+
+void GraphWorld::AddGraphState(GraphState* graph_state) {
+  assert(graph_state->IsInitialized());
+  assert(graph_state->world_ == nullptr);
+  graph_state->world_ = this;
+  ++graph_state_count_;
+
+  Graph* graph = graph_state->graph_;
+  GraphGroup*& group = group_map_[graph];
+  if (!group) {
+    groups_.push_back(std::unique_ptr<GraphGroup>(new GraphGroup(graph)));
+    group = groups_.back().get();
+  }
+  // Shards only fill up at the back, but GraphStates may have been removed
+  // from any of them.
+  for (size_t i = group->shards.size(); i-- > 0;) {
+    Shard* shard = group->shards[i].get();
+    if (shard->graph_states.size() < shard_size_) {
+      shard->graph_states.push_back(graph_state);
+      return;
+    }
+  }
+  group->shards.push_back(std::unique_ptr<Shard>(new Shard(graph)));
+  group->shards.back()->graph_states.push_back(graph_state);
+}
+
+void GraphWorld::RemoveGraphState(GraphState* graph_state) {
+  if (graph_state->world_ != this) {
+    return;
+  }
+  auto group_iter = group_map_.find(graph_state->graph_);
+  assert(group_iter != group_map_.end());
+  GraphGroup* group = group_iter->second;
+  for (auto shard = group->shards.begin(); shard != group->shards.end();
+       ++shard) {
+    std::vector<GraphState*>& graph_states = (*shard)->graph_states;
+    auto iter = std::find(graph_states.begin(), graph_states.end(), graph_state);
+    if (iter == graph_states.end()) {
+      continue;
+    }
+    *iter = graph_states.back();
+    graph_states.pop_back();
+    if (graph_states.empty()) {
+      group->shards.erase(shard);
+    }
+    break;
+  }
+  if (group->shards.empty()) {
+    group_map_.erase(group_iter);
+    for (auto iter = groups_.begin(); iter != groups_.end(); ++iter) {
+      if (iter->get() == group) {
+        groups_.erase(iter);
+        break;
+      }
+    }
+  }
+  graph_state->world_ = nullptr;
+  --graph_state_count_;
+}
+
+void GraphWorld::Tick() {
+  parallel_shards_.clear();
+  pinned_shards_.clear();
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    GraphGroup& group = *groups_[i];
+    // Reloading a Graph may change which nodes it has.
+    if (group.reload_count != group.graph->reload_count()) {
+      group.thread_safe = IsThreadSafe(*group.graph);
+      group.reload_count = group.graph->reload_count();
+    }
+    std::vector<Shard*>& shards =
+        job_system_ && group.thread_safe ? parallel_shards_ : pinned_shards_;
+    for (size_t j = 0; j < group.shards.size(); ++j) {
+      shards.push_back(group.shards[j].get());
+    }
+  }
+
+  // Handing a single shard to the job system would only add overhead.
+  if (parallel_shards_.size() > 1) {
+    job_system_->ParallelFor(parallel_shards_.size(), [this](size_t index) {
+      ExecuteShard(parallel_shards_[index]);
+    });
+  } else if (parallel_shards_.size() == 1) {
+    ExecuteShard(parallel_shards_[0]);
+  }
+  for (size_t i = 0; i < pinned_shards_.size(); ++i) {
+    ExecuteShard(pinned_shards_[i]);
+  }
+}
+
+void GraphWorld::ExecuteShard(Shard* shard) {
+  shard->batched_states.clear();
+  for (size_t i = 0; i < shard->graph_states.size(); ++i) {
+    GraphState* graph_state = shard->graph_states[i];
+    if (graph_state->execution_pending_) {
+      // Finish the suspended pass, along with a new one, as Execute would.
+      graph_state->Execute();
+    } else if (graph_state->execution_mode_ == kExecutionModeWorklist) {
+      if (!graph_state->dirty_node_queue_.empty()) {
+        graph_state->Execute();
+      }
+    } else if (graph_state->execution_mode_ == kExecutionModePull ||
+               graph_state->job_system_) {
+      graph_state->Execute();
+    } else {
+      shard->batched_states.push_back(graph_state);
+    }
+  }
+  if (shard->batched_states.size() > 1) {
+    shard->executor.Execute(shard->graph, shard->batched_states.data(),
+                            shard->batched_states.size(),
+                            shard->batched_states[0]->profiler_);
+  } else if (shard->batched_states.size() == 1) {
+    shard->batched_states[0]->Execute();
+  }
+}
+
+bool GraphWorld::IsThreadSafe(const Graph& graph) {
+  const std::vector<Node*>& executed_nodes = graph.executed_nodes();
+  for (size_t i = 0; i < executed_nodes.size(); ++i) {
+    if (!executed_nodes[i]->signature()->thread_safe()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace breadboard
@@ -0,0 +1,137 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace breadboard {
+
+namespace {
+
+// The bookkeeping shared between the thread that called ParallelFor and the
+// helper tasks it spawned. Helpers may still be holding a reference to this
+// after the last index has finished, so it is reference counted rather than
+// living on the caller's stack.
+struct ParallelForState {
+  ParallelForState(size_t count_, const ParallelForFunc* func_)
+      : count(count_), func(func_), next_index(0), remaining(count_) {}
+
+  // Run indices until there are none left to claim.
+  void Run() {
+    size_t finished = 0;
+    for (size_t i = next_index++; i < count; i = next_index++) {
+      (*func)(i);
+      ++finished;
+    }
+    if (finished && remaining.fetch_sub(finished) == finished) {
+      std::lock_guard<std::mutex> lock(mutex);
+      done.notify_all();
+    }
+  }
+
+  const size_t count;
+  const ParallelForFunc* func;
+  std::atomic<size_t> next_index;
+  std::atomic<size_t> remaining;
+  std::mutex mutex;
+  std::condition_variable done;
+};
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t worker_count) : shutting_down_(false) {
+  workers_.reserve(worker_count);
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  task_available_.notify_all();
+  for (auto iter = workers_.begin(); iter != workers_.end(); ++iter) {
+    iter->join();
+  }
+}
+
+void ThreadPool::Enqueue(const Task& task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(task);
+  }
+  task_available_.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+  for (;;) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_available_.wait(lock,
+                           [this]() { return shutting_down_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        // Only reachable when shutting down.
+        return;
+      }
+      task = tasks_.front();
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::ParallelFor(size_t count, const ParallelForFunc& func) {
+  if (count == 0) {
+    return;
+  }
+  if (count == 1 || workers_.empty()) {
+    for (size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+    return;
+  }
+
+  std::shared_ptr<ParallelForState> state =
+      std::make_shared<ParallelForState>(count, &func);
+
+  // The calling thread takes part too, so one fewer helper is needed than
+  // there are indices.
+  size_t helper_count = std::min(count - 1, workers_.size());
+  for (size_t i = 0; i < helper_count; ++i) {
+    Enqueue([state]() { state->Run(); });
+  }
+  state->Run();
+
+  // Wait for any indices still running on other threads. If this thread is
+  // itself a worker (nested ParallelFor calls) this can not deadlock, since
+  // every index that has been claimed is actively being run.
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done.wait(lock, [&state]() { return state->remaining == 0; });
+}
+
+void ThreadPool::Submit(const JobFunc& func) {
+  if (workers_.empty()) {
+    func();
+  } else {
+    Enqueue(func);
+  }
+}
+
+}  // namespace breadboard
@@ -17,14 +17,25 @@
 namespace breadboard {
 
 LogFunc g_log_func;
+LogBackend* g_log_backend;
 
 // Register a logging function with the library.
 void RegisterLogFunc(LogFunc log_func) { g_log_func = log_func; }
 
-// Call the registered log function with the provided format string. This does
-// nothing if no logging function has been registered.
+// Register a logging backend with the library.
+void RegisterLogBackend(LogBackend* log_backend) {
+  g_log_backend = log_backend;
+}
+
+// Call the registered log backend or log function with the provided format
+// string. This does nothing if neither has been registered.
 void CallLogFunc(const char* format, ...) {
-  if (g_log_func) {
+  if (g_log_backend) {
+    va_list args;
+    va_start(args, format);
+    g_log_backend->Log(format, args);
+    va_end(args);
+  } else if (g_log_func) {
     va_list args;
     va_start(args, format);
     g_log_func(format, args);
@@ -0,0 +1,78 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/memory_buffer_pool.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace breadboard {
+
+static size_t AlignSize(size_t size, size_t alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+MemoryBufferPool::MemoryBufferPool(size_t block_size, size_t alignment,
+                                   size_t blocks_per_slab,
+                                   Allocator* allocator)
+    : block_size_(block_size),
+      alignment_(alignment),
+      stride_(AlignSize(block_size > 0 ? block_size : 1, alignment)),
+      blocks_per_slab_(blocks_per_slab > 0 ? blocks_per_slab : 1),
+      slab_size_(stride_ * blocks_per_slab_),
+      allocator_(allocator),
+      slabs_(),
+      free_blocks_() {
+  // Alignment must be a power of 2.
+  assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+}
+
+MemoryBufferPool::~MemoryBufferPool() {
+  for (size_t i = 0; i < slabs_.size(); ++i) {
+    allocator_->Free(slabs_[i], slab_size_);
+  }
+}
+
+bool MemoryBufferPool::AllocateSlab() {
+  uint8_t* first_block =
+      static_cast<uint8_t*>(allocator_->Allocate(slab_size_, alignment_));
+  if (!first_block) {
+    return false;
+  }
+  slabs_.push_back(first_block);
+
+  // Push the blocks in reverse so that they are handed out in address order.
+  free_blocks_.reserve(free_blocks_.size() + blocks_per_slab_);
+  for (size_t i = blocks_per_slab_; i > 0; --i) {
+    free_blocks_.push_back(first_block + (i - 1) * stride_);
+  }
+  return true;
+}
+
+uint8_t* MemoryBufferPool::Allocate() {
+  if (free_blocks_.empty() && !AllocateSlab()) {
+    return nullptr;
+  }
+  uint8_t* block = free_blocks_.back();
+  free_blocks_.pop_back();
+  memset(block, 0, block_size_);
+  return block;
+}
+
+void MemoryBufferPool::Free(uint8_t* block) {
+  assert(block);
+  free_blocks_.push_back(block);
+}
+
+}  // namespace breadboard
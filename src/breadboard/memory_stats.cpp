@@ -0,0 +1,50 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/memory_stats.h"
+
+#include "breadboard/node_signature.h"
+
+namespace breadboard {
+
+static void AddBreakdown(const std::map<std::string, size_t>& source,
+                         std::map<std::string, size_t>* destination) {
+  for (auto iter = source.begin(); iter != source.end(); ++iter) {
+    (*destination)[iter->first] += iter->second;
+  }
+}
+
+void MemoryStats::Add(const MemoryStats& other) {
+  total_bytes += other.total_bytes;
+  graph_bytes += other.graph_bytes;
+  graph_state_bytes += other.graph_state_bytes;
+  graph_factory_bytes += other.graph_factory_bytes;
+  base_node_bytes += other.base_node_bytes;
+  heap_value_bytes += other.heap_value_bytes;
+  AddBreakdown(other.module_bytes, &module_bytes);
+  AddBreakdown(other.node_bytes, &node_bytes);
+  AddBreakdown(other.type_bytes, &type_bytes);
+}
+
+void MemoryStats::AddNodeBytes(const NodeSignature* signature, size_t bytes) {
+  const std::string& module_name = *signature->module_name();
+  module_bytes[module_name] += bytes;
+  node_bytes[module_name + ":" + signature->node_name()] += bytes;
+}
+
+void MemoryStats::AddTypeBytes(const Type* type, size_t bytes) {
+  type_bytes[type->name] += bytes;
+}
+
+}  // namespace breadboard
@@ -14,6 +14,8 @@
 
 #include "breadboard/module.h"
 
+#include "breadboard/module_registry.h"
+
 namespace breadboard {
 
 NodeSignature* Module::GetNodeSignature(const std::string& name) {
@@ -36,4 +38,8 @@ const NodeSignature* Module::GetNodeSignature(const std::string& name) const {
   return &iter->second;
 }
 
+void Module::IndexNodeSignature(const NodeSignature* signature) {
+  module_registry_->AddNodeSignatureId(signature);
+}
+
 }  // namespace breadboard
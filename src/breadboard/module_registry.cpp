@@ -13,6 +13,9 @@
 // limitations under the License.
 
 #include "breadboard/module_registry.h"
+
+#include <algorithm>
+
 #include "breadboard/log.h"
 #include "breadboard/version.h"
 
@@ -22,7 +25,7 @@ ModuleRegistry::ModuleRegistry() : version_(&Version()) {}
 
 Module* ModuleRegistry::RegisterModule(const std::string& module_name) {
   auto result =
-      modules_.insert(std::make_pair(module_name, Module(module_name)));
+      modules_.insert(std::make_pair(module_name, Module(module_name, this)));
   ModuleDictionary::iterator iter = result.first;
 
   bool success = result.second;
@@ -46,4 +49,39 @@ const Module* ModuleRegistry::GetModule(const std::string& module_name) const {
   return &iter->second;
 }
 
+static bool CompareIds(
+    const std::pair<NodeSignatureId, const NodeSignature*>& a,
+    NodeSignatureId b) {
+  return a.first < b;
+}
+
+const NodeSignature* ModuleRegistry::GetNodeSignature(
+    NodeSignatureId id) const {
+  auto iter = std::lower_bound(signature_index_.begin(),
+                               signature_index_.end(), id, CompareIds);
+  if (iter == signature_index_.end() || iter->first != id) {
+    CallLogFunc("No node with signature ID %016llx has been registered.",
+                static_cast<unsigned long long>(id));
+    return nullptr;
+  }
+  return iter->second;
+}
+
+void ModuleRegistry::AddNodeSignatureId(const NodeSignature* signature) {
+  NodeSignatureId id = signature->id();
+  auto iter = std::lower_bound(signature_index_.begin(),
+                               signature_index_.end(), id, CompareIds);
+  if (iter != signature_index_.end() && iter->first == id) {
+    // Two different names hashing to the same ID is vanishingly unlikely, but
+    // if it happens the second node can only be loaded by name.
+    CallLogFunc(
+        "Node \"%s:%s\" has the same signature ID as node \"%s:%s\".",
+        signature->module_name()->c_str(), signature->node_name().c_str(),
+        iter->second->module_name()->c_str(),
+        iter->second->node_name().c_str());
+    return;
+  }
+  signature_index_.insert(iter, std::make_pair(id, signature));
+}
+
 }  // namespace breadboard
@@ -47,12 +47,20 @@ const OutputEdge& OutputEdgeTarget::GetTargetEdge(
 
 Node::Node(const NodeSignature* signature)
     : signature_(signature),
-      base_node_(signature->Constructor()),
+      base_node_(nullptr),
+      execute_func_(signature->execute_func()),
       input_edges_(),
+      resolved_input_edges_(nullptr),
       output_edges_(),
+      listener_offsets_(),
+      dirty_masks_(),
       timestamp_offset_(0),
+      state_offset_(0),
+      sorted_index_(kInvalidNodeIndex),
       inserted_(false),
-      visited_(false) {}
+      visited_(false),
+      constant_(false),
+      dead_(false) {}
 
 const Type* GetInputEdgeType(const Node* node, std::size_t index) {
   return node->signature()->input_parameters()[index].type;
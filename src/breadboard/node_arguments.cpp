@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "breadboard/node_arguments.h"
+#include "breadboard/graph_state.h"
 #include "breadboard/node_signature.h"
 
 namespace breadboard {
@@ -66,15 +67,17 @@ void NodeArguments::VerifyOutputPreconditions(
 }
 
 bool NodeArguments::IsInputDirty(size_t argument_index) const {
-  const InputEdge& input_edge = node_->input_edges()[argument_index];
-  if (input_edge.connected()) {
+  const ResolvedInputEdge& input_edge =
+      node_->resolved_input_edges()[argument_index];
+  if (input_edge.connected) {
+    if (dirty_bits_) {
+      return dirty_bits_->Test(input_edge.dirty_bit);
+    }
     // If this edge is connected, look at the timestamp on the output edge it's
     // connected to and see if it matches the current timestamp.
-    const OutputEdgeTarget& target_edge = input_edge.target();
-    const OutputEdge& output_edge = target_edge.GetTargetEdge(nodes_);
     Timestamp* input_edge_timestamp =
-        output_memory_->GetObject<Timestamp>(output_edge.timestamp_offset());
-    return *input_edge_timestamp == timestamp_;
+        output_memory_->GetObject<Timestamp>(input_edge.timestamp_offset);
+    return IsTimestampDirty(*input_edge_timestamp);
   } else {
     // If this edge is not connected, it's a default value that never changes
     // and thus is never considered dirty.
@@ -82,6 +85,42 @@ bool NodeArguments::IsInputDirty(size_t argument_index) const {
   }
 }
 
+uint8_t* NodeArguments::FindDefaultValue(ptrdiff_t data_offset) const {
+  // There are rarely more than a few values, so a binary search is plenty.
+  size_t begin = 0;
+  size_t end = default_values_.size();
+  while (begin < end) {
+    size_t middle = begin + (end - begin) / 2;
+    const ResolvedDefaultValue& value = default_values_[middle];
+    if (value.data_offset == data_offset) {
+      return value.data;
+    } else if (value.data_offset < data_offset) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return nullptr;
+}
+
+bool NodeArguments::IsOutputUnchanged(size_t argument_index,
+                                      const OutputEdge& output_edge,
+                                      const uint8_t* value) const {
+  const Type* type = GetOutputEdgeType(node_, argument_index);
+  if (!type->equality_func) {
+    return false;
+  }
+  // A timestamp of zero means the edge still holds its default value, which
+  // the nodes downstream have not seen yet.
+  const Timestamp* timestamp =
+      output_memory_->GetObject<Timestamp>(output_edge.timestamp_offset());
+  if (*timestamp == 0) {
+    return false;
+  }
+  const uint8_t* data = output_memory_->GetObjectPtr(output_edge.data_offset());
+  return type->equality_func(data, value);
+}
+
 void NodeArguments::VerifyListenerPreconditions(size_t listener_index) const {
   if (listener_index >= node_->listener_offsets().size()) {
     const NodeSignature* signature = node_->signature();
@@ -93,13 +132,113 @@ void NodeArguments::VerifyListenerPreconditions(size_t listener_index) const {
   }
 }
 
+void NodeArguments::VerifyStatePreconditions(size_t size,
+                                             size_t alignment) const {
+  const NodeSignature* signature = node_->signature();
+  const Type* state_type = signature->state_type();
+  if (!state_type) {
+    CallLogFunc("%s:%s: Attempting to get state when node has no state.",
+                signature->module_name()->c_str(),
+                signature->node_name().c_str());
+    assert(0);
+  } else if (size != state_type->size || alignment != state_type->alignment) {
+    CallLogFunc(
+        "%s:%s: Attempting to get state as a type of size %d when it expects "
+        "a type of size %d.",
+        signature->module_name()->c_str(), signature->node_name().c_str(),
+        static_cast<int>(size), static_cast<int>(state_type->size));
+    assert(0);
+  }
+}
+
+void NodeArguments::VerifyPayloadPreconditions(
+    size_t listener_index, const EventPayload& payload,
+    const Type* requested_type) const {
+  if (payload.type != requested_type) {
+    const NodeSignature* signature = node_->signature();
+    CallLogFunc(
+        "%s:%s: Attempting to get a payload of listener %d as type \"%s\" "
+        "when it has type \"%s\".",
+        signature->module_name()->c_str(), signature->node_name().c_str(),
+        static_cast<int>(listener_index), requested_type->name,
+        payload.type->name);
+    assert(0);
+  }
+}
+
+ArrayRef<const EventPayload> NodeArguments::GetListenerPayloads(
+    size_t listener_index) const {
+  VerifyListenerPreconditions(listener_index);
+
+  ptrdiff_t listener_offset = node_->listener_offsets()[listener_index];
+  NodeEventListener* listener =
+      output_memory_->GetObject<NodeEventListener>(listener_offset);
+  if (listener->timestamp() != timestamp_ || !listener->broadcaster()) {
+    return ArrayRef<const EventPayload>();
+  }
+  return listener->broadcaster()->payloads(listener->event_index());
+}
+
+void NodeArguments::UnbindBroadcaster(size_t listener_index) {
+  VerifyListenerPreconditions(listener_index);
+
+  NodeEventListener* listener = GetListener(listener_index);
+  NodeEventBroadcaster* broadcaster = listener->bound_broadcaster();
+  if (broadcaster) {
+    broadcaster->UnregisterListener(listener);
+  }
+}
+
+TimerWheel* NodeArguments::GetTimerWheel(size_t listener_index) const {
+  VerifyListenerPreconditions(listener_index);
+
+  TimerWheel* timer_wheel =
+      GetListener(listener_index)->graph_state()->timer_wheel();
+  if (!timer_wheel) {
+    const NodeSignature* signature = node_->signature();
+    CallLogFunc(
+        "%s:%s: Can not set a timer on listener %d because its GraphState has "
+        "no TimerWheel.",
+        signature->module_name()->c_str(), signature->node_name().c_str(),
+        static_cast<int>(listener_index));
+  }
+  return timer_wheel;
+}
+
+void NodeArguments::SetTimer(size_t listener_index, Tick ticks) {
+  TimerWheel* timer_wheel = GetTimerWheel(listener_index);
+  if (timer_wheel) {
+    timer_wheel->SetTimer(GetListener(listener_index),
+                          timer_wheel->current_tick() + ticks);
+  }
+}
+
+void NodeArguments::SetTimerSeconds(size_t listener_index, double seconds) {
+  TimerWheel* timer_wheel = GetTimerWheel(listener_index);
+  if (timer_wheel) {
+    timer_wheel->SetTimer(
+        GetListener(listener_index),
+        timer_wheel->current_tick() + timer_wheel->SecondsToTicks(seconds));
+  }
+}
+
+void NodeArguments::CancelTimer(size_t listener_index) {
+  VerifyListenerPreconditions(listener_index);
+
+  NodeEventListener* listener = GetListener(listener_index);
+  TimerWheel* timer_wheel = listener->graph_state()->timer_wheel();
+  if (timer_wheel) {
+    timer_wheel->CancelTimer(listener);
+  }
+}
+
 bool NodeArguments::IsListenerDirty(size_t listener_index) const {
   VerifyListenerPreconditions(listener_index);
 
   ptrdiff_t listener_offset = node_->listener_offsets()[listener_index];
   NodeEventListener* listener =
       output_memory_->GetObject<NodeEventListener>(listener_offset);
-  return listener->timestamp() == timestamp_;
+  return IsTimestampDirty(listener->timestamp());
 }
 
 }  // namespace breadboard
@@ -0,0 +1,33 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/node_batch_arguments.h"
+
+namespace breadboard {
+
+uint8_t* NodeBatchArguments::AllocateColumn(size_t size) {
+  if (next_column_ == columns_->size()) {
+    columns_->push_back(std::unique_ptr<MemoryBuffer>());
+  }
+  std::unique_ptr<MemoryBuffer>& column = (*columns_)[next_column_++];
+  // Columns are kept between batches, so they only need to be reallocated
+  // when a batch comes along that is bigger than any seen before.
+  if (!column || column->size() < size) {
+    column.reset(new MemoryBuffer());
+    column->Initialize(std::max<size_t>(size, 1), kColumnAlignment);
+  }
+  return column->GetObjectPtr(0);
+}
+
+}  // namespace breadboard
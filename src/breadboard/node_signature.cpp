@@ -14,12 +14,51 @@
 
 #include "breadboard/node_signature.h"
 
+#include <cassert>
+
+#include "breadboard/base_node.h"
+
 namespace breadboard {
 
+static const uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+static const uint64_t kFnvPrime = 1099511628211ULL;
+
+static uint64_t HashBytes(uint64_t hash, const char* bytes, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<uint8_t>(bytes[i]);
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+NodeSignatureId MakeNodeSignatureId(const std::string& module_name,
+                                    const std::string& node_name) {
+  // The zero byte keeps "ab" + "c" apart from "a" + "bc".
+  uint64_t hash = HashBytes(kFnvOffsetBasis, module_name.data(),
+                            module_name.size());
+  hash = HashBytes(hash, "", 1);
+  return HashBytes(hash, node_name.data(), node_name.size());
+}
+
 BaseNode* NodeSignature::Constructor() const { return constructor_(); }
 
 void NodeSignature::Destructor(BaseNode* base_node) const {
   return destructor_(base_node);
 }
 
+void NodeSignature::SetOutputAlias(int output_index, int input_index) {
+  assert(output_index >= 0 &&
+         static_cast<size_t>(output_index) < output_parameters_.size());
+  assert(input_index >= 0 &&
+         static_cast<size_t>(input_index) < input_parameters_.size());
+  assert(output_parameters_[output_index].type ==
+         input_parameters_[input_index].type);
+  output_aliases_.resize(output_parameters_.size(), -1);
+  output_aliases_[output_index] = input_index;
+}
+
+void NodeSignature::VirtualExecute(BaseNode* base_node, NodeArguments* args) {
+  base_node->Execute(args);
+}
+
 }  // namespace breadboard
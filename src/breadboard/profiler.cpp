@@ -0,0 +1,180 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "breadboard/node_signature.h"
+
+namespace breadboard {
+
+std::string GetNodeTypeName(const Node& node) {
+  const NodeSignature* signature = node.signature();
+  const std::string* module_name = signature->module_name();
+  std::string name = module_name ? *module_name : std::string();
+  name += ":";
+  name += signature->node_name();
+  return name;
+}
+
+static uint64_t ToNanoseconds(Profiler::Clock::duration duration) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+static void AddProfile(const NodeProfile& source, NodeProfile* target) {
+  target->execution_count += source.execution_count;
+  target->skip_count += source.skip_count;
+  target->total_time += source.total_time;
+}
+
+template <typename Entry>
+static bool CompareTotalTime(const Entry& a, const Entry& b) {
+  return a.profile.total_time > b.profile.total_time;
+}
+
+// Writes the string to the JSON document, escaping it as needed.
+static void AppendJsonString(const std::string& str, std::string* json) {
+  json->push_back('"');
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      json->push_back('\\');
+      json->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<int>(c));
+      json->append(escaped);
+    } else {
+      json->push_back(c);
+    }
+  }
+  json->push_back('"');
+}
+
+Profiler::Profiler() : trace_enabled_(false), epoch_(Clock::now()) {}
+
+bool Profiler::IsEnabled() {
+#ifdef BREADBOARD_PROFILING
+  return true;
+#else
+  return false;
+#endif  // BREADBOARD_PROFILING
+}
+
+void Profiler::set_trace_enabled(bool trace_enabled) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  trace_enabled_ = trace_enabled;
+}
+
+void Profiler::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  node_profiles_.clear();
+  trace_events_.clear();
+  epoch_ = Clock::now();
+}
+
+void Profiler::GetNodeProfiles(std::vector<NodeProfileEntry>* profiles) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  profiles->clear();
+  profiles->reserve(node_profiles_.size());
+  for (auto iter = node_profiles_.begin(); iter != node_profiles_.end();
+       ++iter) {
+    NodeProfileEntry entry;
+    entry.node = iter->first;
+    entry.name = GetNodeTypeName(*iter->first);
+    entry.profile = iter->second;
+    profiles->push_back(entry);
+  }
+  std::sort(profiles->begin(), profiles->end(),
+            CompareTotalTime<NodeProfileEntry>);
+}
+
+void Profiler::GetSignatureProfiles(
+    std::vector<SignatureProfileEntry>* profiles) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unordered_map<const NodeSignature*, size_t> indices;
+  profiles->clear();
+  for (auto iter = node_profiles_.begin(); iter != node_profiles_.end();
+       ++iter) {
+    const NodeSignature* signature = iter->first->signature();
+    auto result = indices.insert(std::make_pair(signature, profiles->size()));
+    if (result.second) {
+      SignatureProfileEntry entry;
+      entry.signature = signature;
+      entry.name = GetNodeTypeName(*iter->first);
+      profiles->push_back(entry);
+    }
+    AddProfile(iter->second, &(*profiles)[result.first->second].profile);
+  }
+  std::sort(profiles->begin(), profiles->end(),
+            CompareTotalTime<SignatureProfileEntry>);
+}
+
+void Profiler::ExportChromeTrace(std::string* json) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  json->assign("{\"traceEvents\":[");
+  for (size_t i = 0; i < trace_events_.size(); ++i) {
+    const TraceEvent& event = trace_events_[i];
+    if (i > 0) {
+      json->push_back(',');
+    }
+    // Chrome trace timestamps and durations are in microseconds.
+    char buffer[128];
+    json->append("{\"name\":");
+    AppendJsonString(GetNodeTypeName(*event.node), json);
+    snprintf(buffer, sizeof(buffer),
+             ",\"cat\":\"breadboard\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+             "\"pid\":0,\"tid\":%u}",
+             ToNanoseconds(event.start - epoch_) / 1000.0,
+             ToNanoseconds(event.end - event.start) / 1000.0,
+             event.thread_index);
+    json->append(buffer);
+  }
+  json->append("]}");
+}
+
+void Profiler::RecordExecution(const Node& node, Clock::time_point start,
+                               Clock::time_point end, uint64_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  NodeProfile& profile = node_profiles_[&node];
+  profile.execution_count += count;
+  profile.total_time += ToNanoseconds(end - start);
+  if (trace_enabled_) {
+    TraceEvent event;
+    event.node = &node;
+    event.start = start;
+    event.end = end;
+    event.thread_index = ThreadIndex();
+    trace_events_.push_back(event);
+  }
+}
+
+void Profiler::RecordSkip(const Node& node) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++node_profiles_[&node].skip_count;
+}
+
+unsigned int Profiler::ThreadIndex() {
+  std::thread::id id = std::this_thread::get_id();
+  auto iter = std::find(threads_.begin(), threads_.end(), id);
+  if (iter == threads_.end()) {
+    threads_.push_back(id);
+    return static_cast<unsigned int>(threads_.size() - 1);
+  }
+  return static_cast<unsigned int>(iter - threads_.begin());
+}
+
+}  // namespace breadboard
@@ -0,0 +1,65 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/string_id.h"
+
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+
+namespace breadboard {
+
+namespace {
+
+// Holds the characters of every StringId. Strings may be interned from any
+// thread, so access is guarded by a mutex. The nodes of an unordered_set are
+// never moved, so the strings stay put as the set grows.
+struct StringIdTable {
+  std::mutex mutex;
+  std::unordered_set<std::string> strings;
+};
+
+StringIdTable& GetStringIdTable() {
+  // Constructed on first use so that it is available to StringIds made during
+  // static initialization in other translation units. It is never destroyed,
+  // so that StringIds can still be read during static destruction.
+  static StringIdTable* table = new StringIdTable();
+  return *table;
+}
+
+}  // namespace
+
+StringId::StringId(const char* str) : string_(nullptr) {
+  Intern(str, strlen(str));
+}
+
+StringId::StringId(const std::string& str) : string_(nullptr) {
+  Intern(str.data(), str.size());
+}
+
+void StringId::Intern(const char* data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  StringIdTable& table = GetStringIdTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  string_ = &*table.strings.insert(std::string(data, size)).first;
+}
+
+const std::string& StringId::str() const {
+  static const std::string* empty_string = new std::string();
+  return string_ ? *string_ : *empty_string;
+}
+
+}  // namespace breadboard
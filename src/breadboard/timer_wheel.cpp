@@ -0,0 +1,154 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/timer_wheel.h"
+
+#include <cassert>
+#include <cmath>
+
+#include "breadboard/event_dispatcher.h"
+#include "breadboard/graph_state.h"
+
+namespace breadboard {
+
+BREADBOARD_DEFINE_EVENT(kTimerEventId)
+
+// Each level of the wheel has 2^kSlotBits slots.
+static const unsigned int kSlotBits = 8;
+static const size_t kSlotCount = static_cast<size_t>(1) << kSlotBits;
+static const Tick kSlotMask = kSlotCount - 1;
+static const unsigned int kLevelCount = 4;
+
+TimerWheel::TimerWheel(double seconds_per_tick)
+    : seconds_per_tick_(seconds_per_tick),
+      current_tick_(0),
+      carried_seconds_(0.0),
+      event_dispatcher_(nullptr),
+      slots_(),
+      overflow_(&NodeEventListener::node) {
+  assert(seconds_per_tick > 0.0);
+  slots_.resize(kLevelCount * kSlotCount);
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    slots_[i].reset(new ListenerList(&NodeEventListener::node));
+  }
+}
+
+TimerWheel::~TimerWheel() {
+  // Unlink the listeners so that they don't think they are still waiting.
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    slots_[i]->clear();
+  }
+  overflow_.clear();
+}
+
+Tick TimerWheel::SecondsToTicks(double seconds) const {
+  if (seconds <= 0.0) {
+    return 0;
+  }
+  return static_cast<Tick>(std::ceil(seconds / seconds_per_tick_));
+}
+
+void TimerWheel::SetTimer(NodeEventListener* listener, Tick wake_tick) {
+  // Takes the listener out of whatever list it is in, be it a broadcaster's
+  // or one of these slots.
+  listener->node.remove();
+  listener->broadcaster_ = nullptr;
+  listener->wake_tick_ = wake_tick > current_tick_ ? wake_tick
+                                                   : current_tick_ + 1;
+  Insert(listener);
+}
+
+void TimerWheel::CancelTimer(NodeEventListener* listener) {
+  if (listener->waiting_on_timer()) {
+    listener->node.remove();
+  }
+}
+
+void TimerWheel::Insert(NodeEventListener* listener) {
+  Tick wake_tick = listener->wake_tick_;
+  assert(wake_tick >= current_tick_);
+  Tick distance = wake_tick - current_tick_;
+  for (unsigned int level = 0; level < kLevelCount; ++level) {
+    unsigned int shift = kSlotBits * level;
+    if ((distance >> shift) < kSlotCount) {
+      size_t slot = static_cast<size_t>((wake_tick >> shift) & kSlotMask);
+      slots_[level * kSlotCount + slot]->push_back(*listener);
+      return;
+    }
+  }
+  overflow_.push_back(*listener);
+}
+
+void TimerWheel::Reinsert(ListenerList* listener_list) {
+  while (!listener_list->empty()) {
+    NodeEventListener& listener = listener_list->front();
+    listener.node.remove();
+    Insert(&listener);
+  }
+}
+
+void TimerWheel::Step() {
+  ++current_tick_;
+
+  // Find the highest level whose next slot has come up, and move its timers
+  // down, followed by those of each level below it. A timer only ever moves
+  // to a lower level, and lands in the slot for the current tick once it is
+  // due.
+  unsigned int cascade_levels = 0;
+  while (cascade_levels + 1 < kLevelCount &&
+         (current_tick_ &
+          ((static_cast<Tick>(1) << (kSlotBits * (cascade_levels + 1))) -
+           1)) == 0) {
+    ++cascade_levels;
+  }
+  if (cascade_levels + 1 == kLevelCount &&
+      (current_tick_ &
+       ((static_cast<Tick>(1) << (kSlotBits * kLevelCount)) - 1)) == 0) {
+    Reinsert(&overflow_);
+  }
+  for (unsigned int level = cascade_levels; level > 0; --level) {
+    size_t slot = static_cast<size_t>(
+        (current_tick_ >> (kSlotBits * level)) & kSlotMask);
+    Reinsert(slots_[level * kSlotCount + slot].get());
+  }
+
+  // Nodes executed by a timer can set new timers, but never for the current
+  // tick, so this list only gets shorter.
+  ListenerList& due = *slots_[current_tick_ & kSlotMask];
+  while (!due.empty()) {
+    NodeEventListener& listener = due.front();
+    listener.node.remove();
+    listener.MarkDirty();
+    if (event_dispatcher_) {
+      event_dispatcher_->AddPendingGraphState(listener.graph_state());
+    } else {
+      listener.graph_state()->Execute();
+    }
+  }
+}
+
+void TimerWheel::Advance(Tick ticks) {
+  for (Tick i = 0; i < ticks; ++i) {
+    Step();
+  }
+}
+
+void TimerWheel::AdvanceSeconds(double seconds) {
+  carried_seconds_ += seconds;
+  Tick ticks = static_cast<Tick>(carried_seconds_ / seconds_per_tick_);
+  carried_seconds_ -= static_cast<double>(ticks) * seconds_per_tick_;
+  Advance(ticks);
+}
+
+}  // namespace breadboard
@@ -14,27 +14,98 @@
 
 #include <string>
 
+#include "breadboard/fixed_string.h"
 #include "breadboard/module_registry.h"
 #include "breadboard/modules/debug.h"
 #include "breadboard/modules/logic.h"
 #include "breadboard/modules/math.h"
 #include "breadboard/modules/string.h"
+#include "breadboard/modules/timer.h"
+#include "breadboard/string_id.h"
 #include "breadboard/type_registry.h"
 
 namespace breadboard {
 
+static void SerializeString(const uint8_t* ptr, std::string* output) {
+  output->append(*reinterpret_cast<const std::string*>(ptr));
+}
+
+static bool DeserializeString(const uint8_t* data, size_t size, uint8_t* ptr) {
+  reinterpret_cast<std::string*>(ptr)->assign(
+      reinterpret_cast<const char*>(data), size);
+  return true;
+}
+
+static void SerializeStringId(const uint8_t* ptr, std::string* output) {
+  output->append(reinterpret_cast<const StringId*>(ptr)->str());
+}
+
+static bool DeserializeStringId(const uint8_t* data, size_t size,
+                                uint8_t* ptr) {
+  *reinterpret_cast<StringId*>(ptr) =
+      StringId(std::string(reinterpret_cast<const char*>(data), size));
+  return true;
+}
+
+static void SerializeSmallString(const uint8_t* ptr, std::string* output) {
+  const SmallString* str = reinterpret_cast<const SmallString*>(ptr);
+  output->append(str->data(), str->size());
+}
+
+static bool DeserializeSmallString(const uint8_t* data, size_t size,
+                                   uint8_t* ptr) {
+  return reinterpret_cast<SmallString*>(ptr)->assign(
+      reinterpret_cast<const char*>(data), size);
+}
+
+static size_t StringMemoryUsage(const uint8_t* ptr) {
+  const std::string* str = reinterpret_cast<const std::string*>(ptr);
+  // Short strings may be stored inside the object itself.
+  const char* data = str->data();
+  if (data >= reinterpret_cast<const char*>(str) &&
+      data < reinterpret_cast<const char*>(str + 1)) {
+    return 0;
+  }
+  return str->capacity() + 1;
+}
+
 void InitializeCommonModules(ModuleRegistry* module_registry) {
   TypeRegistry<void>::RegisterType("Pulse");
   TypeRegistry<bool>::RegisterType("Bool");
   TypeRegistry<int>::RegisterType("Int");
   TypeRegistry<float>::RegisterType("Float");
   TypeRegistry<std::string>::RegisterType("String");
+  TypeRegistry<StringId>::RegisterType("StringId");
+  TypeRegistry<SmallString>::RegisterType("SmallString");
+
+  // Allow nodes that suppress unchanged outputs to compare these types.
+  TypeRegistry<bool>::RegisterEqualityFunc();
+  TypeRegistry<int>::RegisterEqualityFunc();
+  TypeRegistry<float>::RegisterEqualityFunc();
+  TypeRegistry<std::string>::RegisterEqualityFunc();
+  TypeRegistry<StringId>::RegisterEqualityFunc();
+  TypeRegistry<SmallString>::RegisterEqualityFunc();
+
+  // Allow default values of these types to be saved in compiled graphs.
+  TypeRegistry<bool>::RegisterSerializationFuncs();
+  TypeRegistry<int>::RegisterSerializationFuncs();
+  TypeRegistry<float>::RegisterSerializationFuncs();
+  TypeRegistry<std::string>::RegisterSerializationFuncs(SerializeString,
+                                                        DeserializeString);
+  TypeRegistry<StringId>::RegisterSerializationFuncs(SerializeStringId,
+                                                     DeserializeStringId);
+  TypeRegistry<SmallString>::RegisterSerializationFuncs(
+      SerializeSmallString, DeserializeSmallString);
+
+  // Count the characters of strings against the memory budget of graphs.
+  TypeRegistry<std::string>::RegisterMemoryUsageFunc(StringMemoryUsage);
 
   InitializeDebugModule(module_registry);
   InitializeLogicModule(module_registry);
   InitializeIntegerMathModule(module_registry);
   InitializeFloatMathModule(module_registry);
   InitializeStringModule(module_registry);
+  InitializeTimerModule(module_registry);
 }
 
 }  // namespace breadboard
@@ -35,6 +35,7 @@ class ConsolePrintNode : public BaseNode {
     node_sig->AddInput<std::string>(kInputString, "String");
 
     node_sig->AddOutput<std::string>(kOutputString, "String");
+    node_sig->set_thread_safe(false);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -16,32 +16,31 @@
 
 #include "breadboard/base_node.h"
 #include "breadboard/module_registry.h"
+#include "breadboard/typed_node.h"
 
 namespace breadboard {
 
 // clang-format off
-#define LOGICAL_NODE(name, op)                        \
-  class name : public BaseNode {                      \
-   public:                                            \
-    enum { kInputA, kInputB };                        \
-    enum { kOutputResult };                           \
-                                                      \
-    static void OnRegister(NodeSignature* node_sig) { \
-      node_sig->AddInput<bool>(kInputA);              \
-      node_sig->AddInput<bool>(kInputB);              \
-      node_sig->AddOutput<bool>(kOutputResult);       \
-    }                                                 \
-                                                      \
-    virtual void Initialize(NodeArguments* args) {    \
-      auto a = args->GetInput<bool>(kInputA);         \
-      auto b = args->GetInput<bool>(kInputB);         \
-      bool result = *a op *b;                         \
-      args->SetOutput(kOutputResult, result);         \
-    }                                                 \
-                                                      \
-    virtual void Execute(NodeArguments* args) {       \
-      Initialize(args);                               \
-    }                                                 \
+#define LOGICAL_NODE(name, op)                                       \
+  class name : public TypedNode<Inputs<bool, bool>, Outputs<bool>> { \
+   public:                                                           \
+    enum { kInputA, kInputB };                                       \
+    enum { kOutputResult };                                          \
+                                                                     \
+    static void OnRegister(NodeSignature* node_sig) {                \
+      TypedNode::OnRegister(node_sig);                               \
+      node_sig->set_pure(true);                                      \
+    }                                                                \
+                                                                     \
+    virtual void Initialize(NodeArguments* args) {                   \
+      bool a = *GetInput<kInputA>(args);                             \
+      bool b = *GetInput<kInputB>(args);                             \
+      SetOutput<kOutputResult>(args, a op b);                        \
+    }                                                                \
+                                                                     \
+    virtual void Execute(NodeArguments* args) {                      \
+      Initialize(args);                                              \
+    }                                                                \
   }
 
 LOGICAL_NODE(AndNode, &&);
@@ -101,6 +100,7 @@ class NotNode : public BaseNode {
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<bool>(kInput, "In");
     node_sig->AddOutput<bool>(kOutput, "Out");
+    node_sig->set_pure(true);
   }
 
   virtual void Initialize(NodeArguments* args) {
@@ -0,0 +1,75 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/modules/loop.h"
+
+#include <vector>
+
+#include "breadboard/base_node.h"
+#include "breadboard/module_registry.h"
+
+namespace breadboard {
+
+BREADBOARD_DEFINE_EVENT(kLoopIterationEventId)
+
+// Outputs the given number of consecutive integers, starting at Start.
+class RangeNode : public BaseNode {
+ public:
+  enum { kInputStart, kInputCount };
+  enum { kOutputList };
+
+  // Holds the integers that the output refers to.
+  struct RangeState {
+    RangeState() {}
+
+    std::vector<int> values;
+
+   private:
+    // Disallow copying, since the output of a copy would refer to the values
+    // of the original.
+    RangeState(const RangeState&);
+    RangeState& operator=(const RangeState&);
+  };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<int>(kInputStart, "Start");
+    node_sig->AddInput<int>(kInputCount, "Count");
+    node_sig->AddOutput<ArrayRef<const int>>(kOutputList, "List");
+    node_sig->SetState<RangeState>();
+  }
+
+  virtual void Initialize(NodeArguments* args) {
+    RangeState* state = args->GetState<RangeState>();
+    int start = *args->GetInput<int>(kInputStart);
+    int count = *args->GetInput<int>(kInputCount);
+    state->values.clear();
+    for (int i = 0; i < count; ++i) {
+      state->values.push_back(start + i);
+    }
+    args->SetOutput(kOutputList, ArrayRef<const int>(state->values.data(),
+                                                     state->values.size()));
+  }
+
+  virtual void Execute(NodeArguments* args) { Initialize(args); }
+};
+
+void InitializeLoopModule(ModuleRegistry* module_registry,
+                          GraphFactory* graph_factory) {
+  TypeRegistry<ArrayRef<const int>>::RegisterType("IntList");
+  Module* module = module_registry->RegisterModule("loop");
+  module->RegisterNode<RangeNode>("range");
+  RegisterLoopNodes<int>(module, graph_factory, "int");
+}
+
+}  // namespace breadboard
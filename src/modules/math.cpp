@@ -21,55 +21,85 @@
 
 namespace breadboard {
 
+// Computes `op(a, b)` on every instance in the batch and sets the output to
+// the result. The work is done in one loop over contiguous columns so that
+// the compiler is free to vectorize it.
+template <typename T, typename Result, typename Op>
+static void ExecuteBinaryBatch(NodeBatchArguments* args, size_t input_a,
+                               size_t input_b, size_t output, Op op) {
+  const T* a = args->GatherInput<T>(input_a);
+  const T* b = args->GatherInput<T>(input_b);
+  Result* result = args->AllocateColumn<Result>();
+  const size_t size = args->size();
+  for (size_t i = 0; i < size; ++i) {
+    result[i] = op(a[i], b[i]);
+  }
+  args->ScatterOutput(output, result);
+}
+
 // clang-format off
-#define COMPARISON_NODE(name, op)                         \
-  template <typename T>                                   \
-  class name : public BaseNode {                          \
-   public:                                                \
-    enum { kInputA, kInputB };                            \
-    enum { kOutputResult };                               \
-                                                          \
-    static void OnRegister(NodeSignature* node_sig) {     \
-      node_sig->AddInput<T>(kInputA, "A");                \
-      node_sig->AddInput<T>(kInputB, "B");                \
-      node_sig->AddOutput<bool>(kOutputResult, "Result"); \
-    }                                                     \
-                                                          \
-    virtual void Initialize(NodeArguments* args) {        \
-      auto a = args->GetInput<T>(kInputA);                \
-      auto b = args->GetInput<T>(kInputB);                \
-      bool result = *a op *b;                             \
-      args->SetOutput(kOutputResult, result);             \
-    }                                                     \
-                                                          \
-    virtual void Execute(NodeArguments* args) {           \
-      Initialize(args);                                   \
-    }                                                     \
-  }
-
-#define ARITHMETIC_NODE(name, op)                     \
-  template <typename T>                               \
-  class name : public BaseNode {                      \
-   public:                                            \
-    enum { kInputA, kInputB };                        \
-    enum { kOutputResult };                           \
-                                                      \
-    static void OnRegister(NodeSignature* node_sig) { \
-      node_sig->AddInput<T>(kInputA);                 \
-      node_sig->AddInput<T>(kInputB);                 \
-      node_sig->AddOutput<T>(kOutputResult);          \
-    }                                                 \
-                                                      \
-    virtual void Initialize(NodeArguments* args) {    \
-      auto a = args->GetInput<T>(kInputA);            \
-      auto b = args->GetInput<T>(kInputB);            \
-      T result = *a op *b;                            \
-      args->SetOutput(kOutputResult, result);         \
-    }                                                 \
-                                                      \
-    virtual void Execute(NodeArguments* args) {       \
-      Initialize(args);                               \
-    }                                                 \
+#define COMPARISON_NODE(name, op)                                        \
+  template <typename T>                                                  \
+  class name : public BaseNode {                                         \
+   public:                                                               \
+    enum { kInputA, kInputB };                                           \
+    enum { kOutputResult };                                              \
+                                                                         \
+    static void OnRegister(NodeSignature* node_sig) {                    \
+      node_sig->AddInput<T>(kInputA, "A");                               \
+      node_sig->AddInput<T>(kInputB, "B");                               \
+      node_sig->AddOutput<bool>(kOutputResult, "Result");                \
+      node_sig->set_pure(true);                                          \
+    }                                                                    \
+                                                                         \
+    virtual void Initialize(NodeArguments* args) {                       \
+      auto a = args->GetInput<T>(kInputA);                               \
+      auto b = args->GetInput<T>(kInputB);                               \
+      bool result = *a op *b;                                            \
+      args->SetOutput(kOutputResult, result);                            \
+    }                                                                    \
+                                                                         \
+    virtual void Execute(NodeArguments* args) {                          \
+      Initialize(args);                                                  \
+    }                                                                    \
+                                                                         \
+    virtual bool ExecuteBatch(NodeBatchArguments* args) {                \
+      ExecuteBinaryBatch<T, bool>(args, kInputA, kInputB, kOutputResult, \
+                                  [](T a, T b) { return a op b; });      \
+      return true;                                                       \
+    }                                                                    \
+  }
+
+#define ARITHMETIC_NODE(name, op)                                     \
+  template <typename T>                                               \
+  class name : public BaseNode {                                      \
+   public:                                                            \
+    enum { kInputA, kInputB };                                        \
+    enum { kOutputResult };                                           \
+                                                                      \
+    static void OnRegister(NodeSignature* node_sig) {                 \
+      node_sig->AddInput<T>(kInputA);                                 \
+      node_sig->AddInput<T>(kInputB);                                 \
+      node_sig->AddOutput<T>(kOutputResult);                          \
+      node_sig->set_pure(true);                                       \
+    }                                                                 \
+                                                                      \
+    virtual void Initialize(NodeArguments* args) {                    \
+      auto a = args->GetInput<T>(kInputA);                            \
+      auto b = args->GetInput<T>(kInputB);                            \
+      T result = *a op *b;                                            \
+      args->SetOutput(kOutputResult, result);                         \
+    }                                                                 \
+                                                                      \
+    virtual void Execute(NodeArguments* args) {                       \
+      Initialize(args);                                               \
+    }                                                                 \
+                                                                      \
+    virtual bool ExecuteBatch(NodeBatchArguments* args) {             \
+      ExecuteBinaryBatch<T, T>(args, kInputA, kInputB, kOutputResult, \
+                               [](T a, T b) { return a op b; });      \
+      return true;                                                    \
+    }                                                                 \
   }
 
 // Returns true if both input values are equal.
@@ -113,13 +143,20 @@ class MaxNode : public BaseNode {
     node_sig->AddInput<T>(kInputA);
     node_sig->AddInput<T>(kInputB);
     node_sig->AddOutput<T>(kOutputMax);
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
     auto a = args->GetInput<T>(kInputA);
-    auto b = args->GetInput<T>(kInputA);
+    auto b = args->GetInput<T>(kInputB);
     args->SetOutput(kOutputMax, std::max(*a, *b));
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    ExecuteBinaryBatch<T, T>(args, kInputA, kInputB, kOutputMax,
+                             [](T a, T b) { return std::max(a, b); });
+    return true;
+  }
 };
 
 template <typename T>
@@ -132,6 +169,7 @@ class MinNode : public BaseNode {
     node_sig->AddInput<T>(kInputA);
     node_sig->AddInput<T>(kInputB);
     node_sig->AddOutput<T>(kOutputMin);
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -139,6 +177,12 @@ class MinNode : public BaseNode {
     auto b = args->GetInput<T>(kInputB);
     args->SetOutput(kOutputMin, std::min(*a, *b));
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    ExecuteBinaryBatch<T, T>(args, kInputA, kInputB, kOutputMin,
+                             [](T a, T b) { return std::min(a, b); });
+    return true;
+  }
 };
 
 template <typename T>
@@ -152,6 +196,7 @@ class ClampNode : public BaseNode {
     node_sig->AddInput<T>(kInputMin);
     node_sig->AddInput<T>(kInputMax);
     node_sig->AddOutput<T>(kOutputValue);
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -160,6 +205,19 @@ class ClampNode : public BaseNode {
     auto c = args->GetInput<T>(kInputMax);
     args->SetOutput(kOutputValue, std::min(std::max(*a, *b), *c));
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    const T* a = args->GatherInput<T>(kInputValue);
+    const T* b = args->GatherInput<T>(kInputMin);
+    const T* c = args->GatherInput<T>(kInputMax);
+    T* result = args->AllocateColumn<T>();
+    const size_t size = args->size();
+    for (size_t i = 0; i < size; ++i) {
+      result[i] = std::min(std::max(a[i], b[i]), c[i]);
+    }
+    args->ScatterOutput(kOutputValue, result);
+    return true;
+  }
 };
 
 template <typename T>
@@ -173,6 +231,7 @@ class LerpNode : public BaseNode {
     node_sig->AddInput<T>(kInputFinish);
     node_sig->AddInput<float>(kInputRatio);
     node_sig->AddOutput<T>(kOutputValue);
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
@@ -182,6 +241,20 @@ class LerpNode : public BaseNode {
     args->SetOutput(kOutputValue,
                     *a + static_cast<T>(static_cast<float>(*b - *a) * (*c)));
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    const T* a = args->GatherInput<T>(kInputStart);
+    const T* b = args->GatherInput<T>(kInputFinish);
+    const float* c = args->GatherInput<float>(kInputRatio);
+    T* result = args->AllocateColumn<T>();
+    const size_t size = args->size();
+    for (size_t i = 0; i < size; ++i) {
+      result[i] =
+          a[i] + static_cast<T>(static_cast<float>(b[i] - a[i]) * c[i]);
+    }
+    args->ScatterOutput(kOutputValue, result);
+    return true;
+  }
 };
 
 class IntToFloatNode : public BaseNode {
@@ -192,12 +265,24 @@ class IntToFloatNode : public BaseNode {
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<int>(kInputValue);
     node_sig->AddOutput<float>(kOutputValue);
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
     auto value = args->GetInput<int>(kInputValue);
     args->SetOutput(kOutputValue, static_cast<float>(*value));
   }
+
+  virtual bool ExecuteBatch(NodeBatchArguments* args) {
+    const int* values = args->GatherInput<int>(kInputValue);
+    float* result = args->AllocateColumn<float>();
+    const size_t size = args->size();
+    for (size_t i = 0; i < size; ++i) {
+      result[i] = static_cast<float>(values[i]);
+    }
+    args->ScatterOutput(kOutputValue, result);
+    return true;
+  }
 };
 
 template <typename T>
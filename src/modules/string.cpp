@@ -15,10 +15,11 @@
 #include "breadboard/modules/string.h"
 
 #include <string>
-#include <sstream>
 
 #include "breadboard/base_node.h"
+#include "breadboard/fixed_string.h"
 #include "breadboard/module_registry.h"
+#include "breadboard/string_id.h"
 
 namespace breadboard {
 
@@ -32,6 +33,7 @@ class EqualsNode : public BaseNode {
     node_sig->AddInput<std::string>(kInputA, "A");
     node_sig->AddInput<std::string>(kInputB, "B");
     node_sig->AddOutput<bool>(kOutputResult, "Result");
+    node_sig->set_pure(true);
   }
 
   virtual void Initialize(NodeArguments* args) {
@@ -52,13 +54,18 @@ class IntToStringNode : public BaseNode {
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<int>(kInputInt, "Int");
     node_sig->AddOutput<std::string>(kOutputString, "String");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
     auto i = args->GetInput<int>(kInputInt);
-    std::stringstream stream;
-    stream << *i;
-    args->SetOutput(kOutputString, stream.str());
+    std::string* str = args->GetMutableOutput<std::string>(kOutputString);
+    if (str) {
+      // Format into the existing string to reuse its memory.
+      char buffer[32];
+      size_t size = FormatInt(*i, 0, buffer, sizeof(buffer) - 1);
+      str->assign(buffer, size);
+    }
   }
 };
 
@@ -71,13 +78,19 @@ class FloatToStringNode : public BaseNode {
   static void OnRegister(NodeSignature* node_sig) {
     node_sig->AddInput<float>(kInputFloat, "Float");
     node_sig->AddOutput<std::string>(kOutputString, "String");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
     auto f = args->GetInput<float>(kInputFloat);
-    std::stringstream stream;
-    stream << *f;
-    args->SetOutput(kOutputString, stream.str());
+    std::string* str = args->GetMutableOutput<std::string>(kOutputString);
+    if (str) {
+      // Format into the existing string to reuse its memory. The shortest
+      // notation matches the default formatting of a std::stringstream.
+      char buffer[32];
+      size_t size = FormatFloat(*f, -1, 0, buffer, sizeof(buffer) - 1);
+      str->assign(buffer, size);
+    }
   }
 };
 
@@ -91,12 +104,200 @@ class ConcatNode : public BaseNode {
     node_sig->AddInput<std::string>(kInputA, "A");
     node_sig->AddInput<std::string>(kInputB, "B");
     node_sig->AddOutput<std::string>(kOutputResult, "Result");
+    node_sig->set_pure(true);
   }
 
   virtual void Execute(NodeArguments* args) {
     auto str_a = args->GetInput<std::string>(kInputA);
     auto str_b = args->GetInput<std::string>(kInputB);
-    args->SetOutput(kOutputResult, *str_a + *str_b);
+    std::string* result = args->GetMutableOutput<std::string>(kOutputResult);
+    if (result) {
+      result->assign(*str_a);
+      result->append(*str_b);
+    }
+  }
+};
+
+// Compares two StringIds, which only needs to compare two pointers.
+class StringIdEqualsNode : public BaseNode {
+ public:
+  enum { kInputA, kInputB };
+  enum { kOutputResult };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<StringId>(kInputA, "A");
+    node_sig->AddInput<StringId>(kInputB, "B");
+    node_sig->AddOutput<bool>(kOutputResult, "Result");
+    node_sig->set_pure(true);
+  }
+
+  virtual void Initialize(NodeArguments* args) {
+    auto id_a = args->GetInput<StringId>(kInputA);
+    auto id_b = args->GetInput<StringId>(kInputB);
+    args->SetOutput(kOutputResult, *id_a == *id_b);
+  }
+
+  virtual void Execute(NodeArguments* args) { Initialize(args); }
+};
+
+// Interns the given string.
+class StringToStringIdNode : public BaseNode {
+ public:
+  enum { kInputString };
+  enum { kOutputStringId };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<std::string>(kInputString, "String");
+    node_sig->AddOutput<StringId>(kOutputStringId, "String ID");
+    node_sig->set_pure(true);
+  }
+
+  virtual void Initialize(NodeArguments* args) {
+    auto str = args->GetInput<std::string>(kInputString);
+    args->SetOutput(kOutputStringId, StringId(*str));
+  }
+
+  virtual void Execute(NodeArguments* args) { Initialize(args); }
+};
+
+// Converts the given StringId back to a string.
+class StringIdToStringNode : public BaseNode {
+ public:
+  enum { kInputStringId };
+  enum { kOutputString };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<StringId>(kInputStringId, "String ID");
+    node_sig->AddOutput<std::string>(kOutputString, "String");
+    node_sig->set_pure(true);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    auto id = args->GetInput<StringId>(kInputStringId);
+    std::string* str = args->GetMutableOutput<std::string>(kOutputString);
+    if (str) {
+      str->assign(id->str());
+    }
+  }
+};
+
+// Formats the given int into a SmallString, padded on the left to the given
+// width.
+class FormatIntNode : public BaseNode {
+ public:
+  enum { kInputInt, kInputWidth };
+  enum { kOutputString };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<int>(kInputInt, "Int");
+    node_sig->AddInput<int>(kInputWidth, "Width");
+    node_sig->AddOutput<SmallString>(kOutputString, "String");
+    node_sig->set_pure(true);
+    node_sig->set_suppress_unchanged_outputs(true);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    auto i = args->GetInput<int>(kInputInt);
+    auto width = args->GetInput<int>(kInputWidth);
+    SmallString str;
+    str.AppendInt(*i, *width);
+    args->SetOutput(kOutputString, str);
+  }
+};
+
+// Formats the given float into a SmallString with the given number of digits
+// after the decimal point, padded on the left to the given width. A negative
+// precision picks the shortest notation, like float_to_string.
+class FormatFloatNode : public BaseNode {
+ public:
+  enum { kInputFloat, kInputPrecision, kInputWidth };
+  enum { kOutputString };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<float>(kInputFloat, "Float");
+    node_sig->AddInput<int>(kInputPrecision, "Precision");
+    node_sig->AddInput<int>(kInputWidth, "Width");
+    node_sig->AddOutput<SmallString>(kOutputString, "String");
+    node_sig->set_pure(true);
+    node_sig->set_suppress_unchanged_outputs(true);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    auto f = args->GetInput<float>(kInputFloat);
+    auto precision = args->GetInput<int>(kInputPrecision);
+    auto width = args->GetInput<int>(kInputWidth);
+    SmallString str;
+    str.AppendFloat(*f, *precision, *width);
+    args->SetOutput(kOutputString, str);
+  }
+};
+
+// Concatenates the given SmallStrings, truncating the result if it does not
+// fit.
+class SmallStringConcatNode : public BaseNode {
+ public:
+  enum { kInputA, kInputB };
+  enum { kOutputResult };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<SmallString>(kInputA, "A");
+    node_sig->AddInput<SmallString>(kInputB, "B");
+    node_sig->AddOutput<SmallString>(kOutputResult, "Result");
+    node_sig->set_pure(true);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    auto str_a = args->GetInput<SmallString>(kInputA);
+    auto str_b = args->GetInput<SmallString>(kInputB);
+    SmallString* result = args->GetMutableOutput<SmallString>(kOutputResult);
+    if (result) {
+      *result = *str_a;
+      result->append(*str_b);
+    }
+  }
+};
+
+// Copies the given string into a SmallString, truncating it if it does not
+// fit.
+class StringToSmallStringNode : public BaseNode {
+ public:
+  enum { kInputString };
+  enum { kOutputSmallString };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<std::string>(kInputString, "String");
+    node_sig->AddOutput<SmallString>(kOutputSmallString, "Small String");
+    node_sig->set_pure(true);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    auto str = args->GetInput<std::string>(kInputString);
+    SmallString* result =
+        args->GetMutableOutput<SmallString>(kOutputSmallString);
+    if (result) {
+      result->assign(str->data(), str->size());
+    }
+  }
+};
+
+// Copies the given SmallString into a string.
+class SmallStringToStringNode : public BaseNode {
+ public:
+  enum { kInputSmallString };
+  enum { kOutputString };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<SmallString>(kInputSmallString, "Small String");
+    node_sig->AddOutput<std::string>(kOutputString, "String");
+    node_sig->set_pure(true);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    auto small_str = args->GetInput<SmallString>(kInputSmallString);
+    std::string* str = args->GetMutableOutput<std::string>(kOutputString);
+    if (str) {
+      str->assign(small_str->data(), small_str->size());
+    }
   }
 };
 
@@ -106,6 +307,14 @@ void InitializeStringModule(ModuleRegistry* module_registry) {
   module->RegisterNode<IntToStringNode>("int_to_string");
   module->RegisterNode<FloatToStringNode>("float_to_string");
   module->RegisterNode<ConcatNode>("concat");
+  module->RegisterNode<StringIdEqualsNode>("string_id_equals");
+  module->RegisterNode<StringToStringIdNode>("to_string_id");
+  module->RegisterNode<StringIdToStringNode>("string_id_to_string");
+  module->RegisterNode<FormatIntNode>("format_int");
+  module->RegisterNode<FormatFloatNode>("format_float");
+  module->RegisterNode<SmallStringConcatNode>("small_string_concat");
+  module->RegisterNode<StringToSmallStringNode>("to_small_string");
+  module->RegisterNode<SmallStringToStringNode>("small_string_to_string");
 }
 
 }  // namespace breadboard
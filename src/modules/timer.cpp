@@ -0,0 +1,119 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "breadboard/modules/timer.h"
+
+#include "breadboard/base_node.h"
+#include "breadboard/module_registry.h"
+#include "breadboard/timer_wheel.h"
+
+namespace breadboard {
+
+// Fires once the given number of seconds after being triggered. Triggering it
+// again while it is waiting does nothing.
+class DelayNode : public BaseNode {
+ public:
+  enum { kInputTrigger, kInputSeconds };
+  enum { kOutputDone };
+  enum { kListenerTimer };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<void>(kInputTrigger, "Trigger");
+    node_sig->AddInput<float>(kInputSeconds, "Seconds");
+    node_sig->AddOutput<void>(kOutputDone, "Done");
+    node_sig->AddListener(kListenerTimer, kTimerEventId);
+    node_sig->set_thread_safe(false);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    if (args->IsListenerDirty(kListenerTimer)) {
+      args->SetOutput(kOutputDone);
+    }
+    if (args->IsInputDirty(kInputTrigger) &&
+        !args->IsTimerSet(kListenerTimer)) {
+      args->SetTimerSeconds(kListenerTimer,
+                            *args->GetInput<float>(kInputSeconds));
+    }
+  }
+};
+
+// Fires once the given number of seconds have passed without it being
+// restarted. Restarting it while it is waiting starts the wait over.
+class TimeoutNode : public BaseNode {
+ public:
+  enum { kInputRestart, kInputCancel, kInputSeconds };
+  enum { kOutputTimeout };
+  enum { kListenerTimer };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<void>(kInputRestart, "Restart");
+    node_sig->AddInput<void>(kInputCancel, "Cancel");
+    node_sig->AddInput<float>(kInputSeconds, "Seconds");
+    node_sig->AddOutput<void>(kOutputTimeout, "Timeout");
+    node_sig->AddListener(kListenerTimer, kTimerEventId);
+    node_sig->set_thread_safe(false);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    if (args->IsListenerDirty(kListenerTimer)) {
+      args->SetOutput(kOutputTimeout);
+    }
+    if (args->IsInputDirty(kInputCancel)) {
+      args->CancelTimer(kListenerTimer);
+    } else if (args->IsInputDirty(kInputRestart)) {
+      args->SetTimerSeconds(kListenerTimer,
+                            *args->GetInput<float>(kInputSeconds));
+    }
+  }
+};
+
+// Fires every given number of seconds between being started and stopped.
+class EveryNode : public BaseNode {
+ public:
+  enum { kInputStart, kInputStop, kInputSeconds };
+  enum { kOutputTick };
+  enum { kListenerTimer };
+
+  static void OnRegister(NodeSignature* node_sig) {
+    node_sig->AddInput<void>(kInputStart, "Start");
+    node_sig->AddInput<void>(kInputStop, "Stop");
+    node_sig->AddInput<float>(kInputSeconds, "Seconds");
+    node_sig->AddOutput<void>(kOutputTick, "Tick");
+    node_sig->AddListener(kListenerTimer, kTimerEventId);
+    node_sig->set_thread_safe(false);
+  }
+
+  virtual void Execute(NodeArguments* args) {
+    bool fired = args->IsListenerDirty(kListenerTimer);
+    if (fired) {
+      args->SetOutput(kOutputTick);
+    }
+    if (args->IsInputDirty(kInputStop)) {
+      args->CancelTimer(kListenerTimer);
+    } else if (args->IsInputDirty(kInputStart) ||
+               (fired && !args->IsTimerSet(kListenerTimer))) {
+      args->SetTimerSeconds(kListenerTimer,
+                            *args->GetInput<float>(kInputSeconds));
+    }
+  }
+};
+
+void InitializeTimerModule(ModuleRegistry* module_registry) {
+  Module* module = module_registry->RegisterModule("timer");
+  module->RegisterNode<DelayNode>("delay");
+  module->RegisterNode<TimeoutNode>("timeout");
+  module->RegisterNode<EveryNode>("every");
+}
+
+}  // namespace breadboard